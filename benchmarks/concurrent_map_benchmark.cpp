@@ -0,0 +1,174 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2018 Tessil
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Throughput of tsl::concurrent_hopscotch_map from 1 to N threads on mixed read/write workloads, 
+ * compared to a tsl::hopscotch_map protected by a single mutex.
+ * 
+ * Each thread runs a fixed number of operations on keys drawn uniformly from [0, 2 * nb_keys), 
+ * the map being prefilled with the even keys. An operation is a find with a probability of read_percent%, 
+ * otherwise an insert or an erase (half each), so the size of the map stays stable.
+ * 
+ * Usage: tsl_concurrent_map_benchmark [max_threads] [nb_keys] [nb_ops_per_thread]
+ * Output, one CSV line per run: map,read_percent,threads,seconds,mops_per_second
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tsl/concurrent_hopscotch_map.h>
+#include <tsl/hopscotch_map.h>
+
+
+namespace {
+
+class concurrent_map_adapter {
+public:
+    explicit concurrent_map_adapter(std::size_t nb_keys): m_map(0) {
+        m_map.reserve(nb_keys);
+    }
+    
+    static const char* name() { return "concurrent_hopscotch_map"; }
+    
+    bool find(std::uint64_t key) const {
+        std::uint64_t value;
+        return m_map.find(key, value);
+    }
+    
+    void insert(std::uint64_t key) { m_map.insert({key, key}); }
+    void erase(std::uint64_t key) { m_map.erase(key); }
+
+private:
+    tsl::concurrent_hopscotch_map<std::uint64_t, std::uint64_t> m_map;
+};
+
+class global_mutex_map_adapter {
+public:
+    explicit global_mutex_map_adapter(std::size_t nb_keys) {
+        m_map.reserve(nb_keys);
+    }
+    
+    static const char* name() { return "mutex_hopscotch_map"; }
+    
+    bool find(std::uint64_t key) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_map.find(key) != m_map.end();
+    }
+    
+    void insert(std::uint64_t key) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_map.insert({key, key});
+    }
+    
+    void erase(std::uint64_t key) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_map.erase(key);
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    tsl::hopscotch_map<std::uint64_t, std::uint64_t> m_map;
+};
+
+
+template<class Map>
+void run_benchmark(unsigned int read_percent, std::size_t nb_threads, 
+                   std::size_t nb_keys, std::size_t nb_ops_per_thread) 
+{
+    Map map(nb_keys);
+    for(std::uint64_t key = 0; key < 2*nb_keys; key += 2) {
+        map.insert(key);
+    }
+    
+    std::vector<std::size_t> nb_found(nb_threads, 0);
+    auto worker = [&](std::size_t ithread) {
+        std::mt19937_64 generator(ithread + 1);
+        std::uniform_int_distribution<std::uint64_t> key_distribution(0, 2*nb_keys - 1);
+        std::uniform_int_distribution<unsigned int> op_distribution(0, 199);
+        
+        for(std::size_t iop = 0; iop < nb_ops_per_thread; iop++) {
+            const std::uint64_t key = key_distribution(generator);
+            const unsigned int op = op_distribution(generator);
+            
+            if(op < 2*read_percent) {
+                nb_found[ithread] += map.find(key)?1:0;
+            }
+            else if(op % 2 == 0) {
+                map.insert(key);
+            }
+            else {
+                map.erase(key);
+            }
+        }
+    };
+    
+    const auto start = std::chrono::steady_clock::now();
+    
+    std::vector<std::thread> threads;
+    for(std::size_t ithread = 1; ithread < nb_threads; ithread++) {
+        threads.emplace_back(worker, ithread);
+    }
+    worker(0);
+    for(std::thread& thread: threads) {
+        thread.join();
+    }
+    
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const double mops = double(nb_threads*nb_ops_per_thread)/seconds/1e6;
+    
+    std::printf("%s,%u,%zu,%.4f,%.2f\n", Map::name(), read_percent, nb_threads, seconds, mops);
+    std::fflush(stdout);
+}
+
+}
+
+
+int main(int argc, char** argv) {
+    const std::size_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    const std::size_t max_threads = (argc > 1)?std::strtoull(argv[1], nullptr, 10):hardware_threads;
+    const std::size_t nb_keys = (argc > 2)?std::strtoull(argv[2], nullptr, 10):1000000;
+    const std::size_t nb_ops_per_thread = (argc > 3)?std::strtoull(argv[3], nullptr, 10):2000000;
+    
+    std::printf("map,read_percent,threads,seconds,mops_per_second\n");
+    for(const unsigned int read_percent: {50u, 90u, 99u}) {
+        for(std::size_t nb_threads = 1; nb_threads <= max_threads; nb_threads *= 2) {
+            run_benchmark<concurrent_map_adapter>(read_percent, nb_threads, nb_keys, nb_ops_per_thread);
+            run_benchmark<global_mutex_map_adapter>(read_percent, nb_threads, nb_keys, nb_ops_per_thread);
+            
+            if(nb_threads < max_threads && nb_threads*2 > max_threads) {
+                nb_threads = max_threads/2;
+            }
+        }
+    }
+    
+    return 0;
+}
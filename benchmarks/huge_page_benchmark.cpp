@@ -0,0 +1,197 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2018 Tessil
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Random lookups in a tsl::hopscotch_map much larger than the caches, with the bucket array allocated
+ * by std::allocator and by tsl::huge_page_allocator (regular pages, transparent huge pages, explicit 2MB
+ * and 1GB huge pages).
+ * 
+ * For each allocator, the map is filled with nb_keys random int64 keys and nb_keys lookups (find_hit) are done
+ * in a random order. The number of data TLB misses of the lookups is read from the hardware counters with
+ * perf_event_open (Linux only, dtlb_misses_per_op is -1 if the counter is not available, e.g. in a VM or
+ * with a restrictive /proc/sys/kernel/perf_event_paranoid).
+ * 
+ * The explicit huge pages must be reserved beforehand (e.g. 'echo 1024 > /proc/sys/vm/nr_hugepages'),
+ * otherwise the allocator falls back to transparent huge pages.
+ * 
+ * Usage: tsl_huge_page_benchmark [nb_keys]
+ * Output: one CSV line per allocator (allocator,workload,nb_ops,seconds,ns_per_op,dtlb_misses_per_op).
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <tsl/hopscotch_map.h>
+#include <tsl/huge_page_allocator.h>
+
+#if defined(__linux__)
+#    include <linux/perf_event.h>
+#    include <sys/ioctl.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#endif
+
+
+namespace {
+
+/*
+ * Counter of the data TLB misses (load misses) of the current thread.
+ */
+class dtlb_miss_counter {
+public:
+    dtlb_miss_counter(): m_fd(-1) {
+#if defined(__linux__)
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        
+        m_fd = int(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+    
+    ~dtlb_miss_counter() {
+#if defined(__linux__)
+        if(m_fd != -1) {
+            ::close(m_fd);
+        }
+#endif
+    }
+    
+    dtlb_miss_counter(const dtlb_miss_counter&) = delete;
+    dtlb_miss_counter& operator=(const dtlb_miss_counter&) = delete;
+    
+    bool available() const {
+        return m_fd != -1;
+    }
+    
+    void start() {
+#if defined(__linux__)
+        if(m_fd != -1) {
+            ::ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+            ::ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+    
+    std::uint64_t stop() {
+        std::uint64_t nb_misses = 0;
+#if defined(__linux__)
+        if(m_fd != -1) {
+            ::ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+            if(::read(m_fd, &nb_misses, sizeof(nb_misses)) != ssize_t(sizeof(nb_misses))) {
+                nb_misses = 0;
+            }
+        }
+#endif
+        return nb_misses;
+    }
+    
+private:
+    int m_fd;
+};
+
+
+template<class Allocator>
+using map_type = tsl::hopscotch_map<std::int64_t, std::int64_t, std::hash<std::int64_t>,
+                                    std::equal_to<std::int64_t>, Allocator>;
+
+template<class Allocator>
+void run_find(const char* allocator_name, const Allocator& allocator,
+              const std::vector<std::int64_t>& keys, const std::vector<std::int64_t>& lookups)
+{
+    map_type<Allocator> map(keys.size(), std::hash<std::int64_t>(), std::equal_to<std::int64_t>(), allocator);
+    for(std::size_t i = 0; i < keys.size(); i++) {
+        map.insert({keys[i], std::int64_t(i)});
+    }
+    
+    // Warm up the page tables and the caches with a first pass.
+    std::int64_t checksum = 0;
+    for(std::int64_t key: lookups) {
+        checksum += map.find(key)->second;
+    }
+    
+    dtlb_miss_counter counter;
+    counter.start();
+    const auto start = std::chrono::high_resolution_clock::now();
+    for(std::int64_t key: lookups) {
+        checksum += map.find(key)->second;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    const std::uint64_t nb_misses = counter.stop();
+    
+    std::printf("%s,find_hit,%zu,%f,%.2f,%.3f\n", allocator_name, lookups.size(), seconds,
+                seconds * 1e9 / double(lookups.size()),
+                counter.available()?double(nb_misses) / double(lookups.size()):-1.0);
+    
+    // Use the checksum so that the lookups are not optimized out.
+    if(checksum == 42) {
+        std::printf("\n");
+    }
+}
+
+}
+
+
+int main(int argc, char** argv) {
+    const std::size_t nb_keys = (argc > 1)?std::strtoull(argv[1], nullptr, 10):20000000;
+    
+    std::mt19937_64 generator(1);
+    std::vector<std::int64_t> keys(nb_keys);
+    for(std::int64_t& key: keys) {
+        key = std::int64_t(generator() >> 1);
+    }
+    
+    std::vector<std::int64_t> lookups = keys;
+    std::shuffle(lookups.begin(), lookups.end(), generator);
+    
+    
+    using value_type = std::pair<std::int64_t, std::int64_t>;
+    using huge_page_allocator = tsl::huge_page_allocator<value_type>;
+    
+    std::printf("allocator,workload,nb_ops,seconds,ns_per_op,dtlb_misses_per_op\n");
+    run_find("std_allocator", std::allocator<value_type>(), keys, lookups);
+    run_find("huge_page_allocator_none", huge_page_allocator(tsl::hh::huge_pages::none), keys, lookups);
+    run_find("huge_page_allocator_transparent", huge_page_allocator(tsl::hh::huge_pages::transparent), keys, lookups);
+    run_find("huge_page_allocator_explicit_2mb", huge_page_allocator(tsl::hh::huge_pages::explicit_2mb), keys, lookups);
+    run_find("huge_page_allocator_explicit_1gb", huge_page_allocator(tsl::hh::huge_pages::explicit_1gb), keys, lookups);
+    run_find("huge_page_allocator_transparent_interleave",
+             huge_page_allocator(tsl::hh::huge_pages::transparent, tsl::hh::numa_policy::interleave), keys, lookups);
+    
+    return 0;
+}
@@ -0,0 +1,452 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2018 Tessil
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Single-threaded microbenchmarks of tsl::hopscotch_map and tsl::bhopscotch_map.
+ * 
+ * Each map is run on the same standard workloads, with integer keys and values (int64), string keys 
+ * (random strings of 24 characters) and int64 keys with large values (128 bytes):
+ * 
+ * - insert_random: insert nb_keys keys in a random order in an empty map;
+ * - insert_random_reserved: same but after a reserve(nb_keys);
+ * - build_range: construct a map from a vector of the nb_keys values with the range constructor;
+ * - build_bulk: same with the bulk constructor (tsl::hh::bulk_construct);
+ * - insert_sequential: insert the keys in increasing order;
+ * - find_hit, find_miss: look up the nb_keys inserted keys (in another random order) and nb_keys absent keys;
+ * - iterate: go through the whole map;
+ * - erase_random: erase half of the keys in a random order;
+ * - rehash: rehash a full map to twice its bucket count;
+ * - memory: bytes allocated by a map holding the nb_keys keys (ns_per_op is 0).
+ * 
+ * The keys are generated from fixed seeds so two runs (e.g. of two commits in a CI) use the same keys.
+ * 
+ * Usage: tsl_map_benchmark [nb_keys] [csv|json]
+ * Output: one CSV line per run (map,payload,workload,nb_ops,seconds,ns_per_op,bytes) 
+ * or a JSON array with an object per run with the same fields.
+ */
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <new>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <tsl/bhopscotch_map.h>
+#include <tsl/hopscotch_map.h>
+
+
+namespace {
+
+std::size_t allocated_bytes = 0;
+
+/*
+ * Allocator keeping track of the number of bytes currently allocated through it in allocated_bytes.
+ */
+template<typename T>
+class counting_allocator {
+public:
+    using value_type = T;
+    
+    counting_allocator() = default;
+    
+    template<typename U> 
+    counting_allocator(const counting_allocator<U>&) noexcept {
+    }
+    
+    T* allocate(std::size_t n) {
+        allocated_bytes += n*sizeof(T);
+        return std::allocator<T>().allocate(n);
+    }
+    
+    void deallocate(T* p, std::size_t n) noexcept {
+        allocated_bytes -= n*sizeof(T);
+        std::allocator<T>().deallocate(p, n);
+    }
+};
+
+template<class T, class U>
+bool operator==(const counting_allocator<T>&, const counting_allocator<U>&) noexcept { 
+    return true; 
+}
+
+template<class T, class U>
+bool operator!=(const counting_allocator<T>&, const counting_allocator<U>&) noexcept { 
+    return false; 
+}
+
+
+struct large_value {
+    std::array<std::uint64_t, 16> data;
+};
+
+
+/*
+ * Payloads, a key type and a value type with the generation of the keys and values.
+ */
+struct int_payload {
+    using key_type = std::int64_t;
+    using value_type = std::int64_t;
+    
+    static const char* name() { return "int64"; }
+    
+    static key_type generate_key(std::mt19937_64& generator) {
+        return std::int64_t(generator() >> 1);
+    }
+    
+    static value_type value(std::size_t i) { 
+        return std::int64_t(i); 
+    }
+    
+    static std::uint64_t checksum(const value_type& value) { 
+        return std::uint64_t(value); 
+    }
+};
+
+struct string_payload {
+    using key_type = std::string;
+    using value_type = std::int64_t;
+    
+    static const char* name() { return "string"; }
+    
+    static key_type generate_key(std::mt19937_64& generator) {
+        static const char characters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+        
+        std::string key(24, ' ');
+        for(char& c: key) {
+            c = characters[generator() % (sizeof(characters) - 1)];
+        }
+        
+        return key;
+    }
+    
+    static value_type value(std::size_t i) { 
+        return std::int64_t(i); 
+    }
+    
+    static std::uint64_t checksum(const value_type& value) { 
+        return std::uint64_t(value); 
+    }
+};
+
+struct large_value_payload {
+    using key_type = std::int64_t;
+    using value_type = large_value;
+    
+    static const char* name() { return "int64_large_value"; }
+    
+    static key_type generate_key(std::mt19937_64& generator) {
+        return int_payload::generate_key(generator);
+    }
+    
+    static value_type value(std::size_t i) {
+        large_value value;
+        value.data.fill(i);
+        
+        return value;
+    }
+    
+    static std::uint64_t checksum(const value_type& value) { 
+        return value.data[0]; 
+    }
+};
+
+
+/*
+ * Maps, NeighborhoodSize and growth policies to benchmark for a payload.
+ */
+template<class Payload, unsigned int NeighborhoodSize, class GrowthPolicy>
+using hmap = tsl::hopscotch_map<typename Payload::key_type, typename Payload::value_type, 
+                                std::hash<typename Payload::key_type>, std::equal_to<typename Payload::key_type>, 
+                                counting_allocator<std::pair<typename Payload::key_type, 
+                                                             typename Payload::value_type>>, 
+                                NeighborhoodSize, false, GrowthPolicy>;
+
+template<class Payload>
+using bhmap = tsl::bhopscotch_map<typename Payload::key_type, typename Payload::value_type, 
+                                  std::hash<typename Payload::key_type>, std::equal_to<typename Payload::key_type>, 
+                                  std::less<typename Payload::key_type>, 
+                                  counting_allocator<std::pair<const typename Payload::key_type, 
+                                                               typename Payload::value_type>>>;
+
+
+struct result {
+    std::string map;
+    std::string payload;
+    std::string workload;
+    std::size_t nb_ops;
+    double seconds;
+    std::size_t bytes;
+};
+
+class results_writer {
+public:
+    explicit results_writer(bool json): m_json(json) {
+        if(!m_json) {
+            std::printf("map,payload,workload,nb_ops,seconds,ns_per_op,bytes\n");
+        }
+    }
+    
+    void add(const result& res) {
+        const double ns_per_op = (res.nb_ops == 0 || res.seconds == 0)?0:res.seconds*1e9/double(res.nb_ops);
+        if(m_json) {
+            std::printf("%s\n  {\"map\": \"%s\", \"payload\": \"%s\", \"workload\": \"%s\", \"nb_ops\": %zu, "
+                        "\"seconds\": %.6f, \"ns_per_op\": %.2f, \"bytes\": %zu}", 
+                        m_nb_results == 0?"[":",", res.map.c_str(), res.payload.c_str(), res.workload.c_str(), 
+                        res.nb_ops, res.seconds, ns_per_op, res.bytes);
+        }
+        else {
+            std::printf("%s,%s,%s,%zu,%.6f,%.2f,%zu\n", res.map.c_str(), res.payload.c_str(), res.workload.c_str(), 
+                        res.nb_ops, res.seconds, ns_per_op, res.bytes);
+        }
+        
+        m_nb_results++;
+        std::fflush(stdout);
+    }
+    
+    void finish() {
+        if(m_json) {
+            std::printf("%s\n", m_nb_results == 0?"[]":"\n]");
+        }
+    }
+
+private:
+    bool m_json;
+    std::size_t m_nb_results = 0;
+};
+
+
+// Prevent the compiler from removing the lookups and the iteration.
+volatile std::uint64_t sink;
+
+class stopwatch {
+public:
+    stopwatch(): m_start(std::chrono::steady_clock::now()) {
+    }
+    
+    double seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point m_start;
+};
+
+
+/*
+ * nb_keys distinct keys to insert, in a random order, and nb_keys other distinct keys which are never inserted.
+ */
+template<class Payload>
+struct workload_keys {
+    using key_type = typename Payload::key_type;
+    
+    explicit workload_keys(std::size_t nb_keys) {
+        std::mt19937_64 generator(42);
+        
+        std::vector<key_type> keys;
+        while(keys.size() < 2*nb_keys) {
+            while(keys.size() < 2*nb_keys + nb_keys/16 + 16) {
+                keys.push_back(Payload::generate_key(generator));
+            }
+            
+            std::sort(keys.begin(), keys.end());
+            keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        }
+        
+        keys.resize(2*nb_keys);
+        std::shuffle(keys.begin(), keys.end(), generator);
+        
+        inserted.assign(keys.begin(), keys.begin() + nb_keys);
+        absent.assign(keys.begin() + nb_keys, keys.end());
+        
+        sorted = inserted;
+        std::sort(sorted.begin(), sorted.end());
+        
+        lookups = inserted;
+        std::shuffle(lookups.begin(), lookups.end(), generator);
+    }
+    
+    std::vector<key_type> inserted;
+    std::vector<key_type> absent;
+    std::vector<key_type> sorted;
+    std::vector<key_type> lookups;
+};
+
+
+template<class Map, class Payload>
+Map filled_map(const workload_keys<Payload>& keys) {
+    Map map;
+    for(std::size_t i = 0; i < keys.inserted.size(); i++) {
+        map.insert({keys.inserted[i], Payload::value(i)});
+    }
+    
+    return map;
+}
+
+template<class Map, class Payload>
+void run_workloads(const char* map_name, const workload_keys<Payload>& keys, results_writer& writer) {
+    const std::size_t nb_keys = keys.inserted.size();
+    auto add_result = [&](const char* workload, std::size_t nb_ops, double seconds, std::size_t bytes) {
+        writer.add(result{map_name, Payload::name(), workload, nb_ops, seconds, bytes});
+    };
+    
+    {
+        Map map;
+        stopwatch watch;
+        for(std::size_t i = 0; i < nb_keys; i++) {
+            map.insert({keys.inserted[i], Payload::value(i)});
+        }
+        add_result("insert_random", nb_keys, watch.seconds(), 0);
+    }
+    
+    {
+        Map map;
+        map.reserve(nb_keys);
+        
+        stopwatch watch;
+        for(std::size_t i = 0; i < nb_keys; i++) {
+            map.insert({keys.inserted[i], Payload::value(i)});
+        }
+        add_result("insert_random_reserved", nb_keys, watch.seconds(), 0);
+    }
+    
+    {
+        std::vector<typename Map::value_type> values;
+        values.reserve(nb_keys);
+        for(std::size_t i = 0; i < nb_keys; i++) {
+            values.emplace_back(keys.inserted[i], Payload::value(i));
+        }
+        
+        stopwatch watch;
+        const Map map(values.begin(), values.end());
+        add_result("build_range", nb_keys, watch.seconds(), 0);
+        
+        stopwatch watch_bulk;
+        const Map map_bulk(tsl::hh::bulk_construct, values.begin(), values.end());
+        add_result("build_bulk", nb_keys, watch_bulk.seconds(), 0);
+    }
+    
+    {
+        Map map;
+        stopwatch watch;
+        for(std::size_t i = 0; i < nb_keys; i++) {
+            map.insert({keys.sorted[i], Payload::value(i)});
+        }
+        add_result("insert_sequential", nb_keys, watch.seconds(), 0);
+    }
+    
+    
+    const std::size_t allocated_bytes_before = allocated_bytes;
+    Map map = filled_map<Map>(keys);
+    add_result("memory", 0, 0, allocated_bytes - allocated_bytes_before);
+    
+    {
+        std::uint64_t checksum = 0;
+        stopwatch watch;
+        for(const auto& key: keys.lookups) {
+            auto it = map.find(key);
+            if(it != map.end()) {
+                checksum += Payload::checksum(it->second);
+            }
+        }
+        add_result("find_hit", nb_keys, watch.seconds(), 0);
+        sink = checksum;
+    }
+    
+    {
+        std::uint64_t checksum = 0;
+        stopwatch watch;
+        for(const auto& key: keys.absent) {
+            checksum += map.count(key);
+        }
+        add_result("find_miss", nb_keys, watch.seconds(), 0);
+        sink = checksum;
+    }
+    
+    {
+        std::uint64_t checksum = 0;
+        stopwatch watch;
+        for(const auto& key_value: map) {
+            checksum += Payload::checksum(key_value.second);
+        }
+        add_result("iterate", nb_keys, watch.seconds(), 0);
+        sink = checksum;
+    }
+    
+    {
+        Map map_copy = map;
+        stopwatch watch;
+        map_copy.rehash(2*map_copy.bucket_count());
+        add_result("rehash", nb_keys, watch.seconds(), 0);
+    }
+    
+    {
+        stopwatch watch;
+        for(std::size_t i = 0; i < nb_keys/2; i++) {
+            map.erase(keys.lookups[i]);
+        }
+        add_result("erase_random", nb_keys/2, watch.seconds(), 0);
+    }
+}
+
+template<class Payload>
+void run_payload(std::size_t nb_keys, results_writer& writer) {
+    const workload_keys<Payload> keys(nb_keys);
+    
+    run_workloads<hmap<Payload, 62, tsl::hh::power_of_two_growth_policy<2>>>("hopscotch_map_pow2_nh62", keys, writer);
+    run_workloads<hmap<Payload, 30, tsl::hh::power_of_two_growth_policy<2>>>("hopscotch_map_pow2_nh30", keys, writer);
+    run_workloads<hmap<Payload, 8, tsl::hh::power_of_two_growth_policy<2>>>("hopscotch_map_pow2_nh8", keys, writer);
+    run_workloads<hmap<Payload, 62, tsl::hh::fibonacci_power_of_two_growth_policy<2>>>("hopscotch_map_fibonacci_nh62", 
+                                                                                       keys, writer);
+    run_workloads<hmap<Payload, 62, tsl::hh::mod_growth_policy<>>>("hopscotch_map_mod_nh62", keys, writer);
+    run_workloads<hmap<Payload, 62, tsl::hh::fastrange_growth_policy<>>>("hopscotch_map_fastrange_nh62", keys, writer);
+    run_workloads<hmap<Payload, 62, tsl::hh::prime_growth_policy>>("hopscotch_map_prime_nh62", keys, writer);
+    run_workloads<hmap<Payload, 62, tsl::hh::reciprocal_prime_growth_policy>>("hopscotch_map_reciprocal_prime_nh62", 
+                                                                               keys, writer);
+    run_workloads<bhmap<Payload>>("bhopscotch_map_pow2_nh62", keys, writer);
+}
+
+}
+
+
+int main(int argc, char** argv) {
+    const std::size_t nb_keys = (argc > 1)?std::strtoull(argv[1], nullptr, 10):1000000;
+    const bool json = (argc > 2 && std::strcmp(argv[2], "json") == 0);
+    
+    results_writer writer(json);
+    run_payload<int_payload>(nb_keys, writer);
+    run_payload<string_payload>(nb_keys, writer);
+    run_payload<large_value_payload>(nb_keys, writer);
+    writer.finish();
+    
+    return 0;
+}
@@ -0,0 +1,753 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2017 Tessil
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef TSL_CONCURRENT_HOPSCOTCH_MAP_H
+#define TSL_CONCURRENT_HOPSCOTCH_MAP_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "hopscotch_hash.h"
+
+
+namespace tsl {
+
+/**
+ * Hash map which can be used concurrently by multiple threads, built on the same hopscotch hash table
+ * as tsl::hopscotch_map.
+ * 
+ * The map is split in shard_count() shards, each shard being an independent hopscotch hash table protected
+ * by its own mutex. The shard of a key is selected from the high bits of its hash (after a multiplicative mix,
+ * so that a weak hash function like an identity still spreads the keys over the shards) while the bucket
+ * of the key inside the shard is selected by the GrowthPolicy as usual (the low bits of the hash with the
+ * default tsl::hh::power_of_two_growth_policy). The hash of a key is computed only once per operation,
+ * outside of the lock.
+ * 
+ * As the elements may be modified or erased by another thread at any time, the map doesn't provide iterators
+ * or references to its elements. Lookups copy the value out (find, at) or pass it to a function called while
+ * the shard is locked (visit, visit_all). The function passed to visit or visit_all must not call the map.
+ * 
+ * If Key and T are trivially copyable, the lookups (find, at, count, contains and the const visit) don't lock 
+ * the shard. The buckets of each shard are versioned (see tsl::hh::segment_versions), a lookup copies the key 
+ * and the value found in the neighborhood and checks that no writer modified the neighborhood in the meantime, 
+ * retrying otherwise. A lookup only falls back to the lock if the key may be in the overflow list of the shard 
+ * or if it was interrupted too many times. The const visit then calls the function on a copy of the element, 
+ * outside of the lock. With GCC < 5, which doesn't provide std::is_trivially_copyable, only the 
+ * lookups of trivial types (std::is_trivial) are lock-free, the others take the lock.
+ * 
+ * Operations on a single key are linearizable. Operations on the whole map (size, clear, visit_all, reserve, ...)
+ * lock the shards one by one and are not atomic relative to the other operations.
+ * 
+ * The template parameters are the same as tsl::hopscotch_map, see its documentation.
+ * 
+ * The map is neither copyable nor movable.
+ */
+template<class Key,
+         class T,
+         class Hash = std::hash<Key>,
+         class KeyEqual = std::equal_to<Key>,
+         class Allocator = std::allocator<std::pair<Key, T>>,
+         unsigned int NeighborhoodSize = 62,
+         bool StoreHash = false,
+         class GrowthPolicy = tsl::hh::power_of_two_growth_policy<2>,
+         class Layout = tsl::hh::aos_layout>
+class concurrent_hopscotch_map: private Hash {
+private:
+    template<typename U>
+    using has_is_transparent = tsl::detail_hopscotch_hash::has_is_transparent<U>;
+    
+    class KeySelect {
+    public:
+        using key_type = Key;
+        
+        const key_type& operator()(const std::pair<Key, T>& key_value) const {
+            return key_value.first;
+        }
+        
+        key_type& operator()(std::pair<Key, T>& key_value) {
+            return key_value.first;
+        }
+    };
+    
+    class ValueSelect {
+    public:
+        using value_type = T;
+        
+        const value_type& operator()(const std::pair<Key, T>& key_value) const {
+            return key_value.second;
+        }
+        
+        value_type& operator()(std::pair<Key, T>& key_value) {
+            return key_value.second;
+        }
+    };
+    
+    
+    using overflow_container_type = std::list<std::pair<Key, T>, Allocator>;
+    
+    /*
+     * The lock-free lookups copy the bytes of the elements while they may be modified, 
+     * only possible if they are trivially copyable.
+     */
+    static const bool OPTIMISTIC_LOOKUPS = detail_hopscotch_hash::is_trivially_copyable<Key>::value && 
+                                           detail_hopscotch_hash::is_trivially_copyable<T>::value && 
+                                           std::is_nothrow_copy_constructible<GrowthPolicy>::value && 
+                                           std::is_nothrow_copy_assignable<GrowthPolicy>::value && 
+                                           NeighborhoodSize <= 64;
+    
+    using versions_type = typename std::conditional<OPTIMISTIC_LOOKUPS, 
+                                                    tsl::hh::segment_versions<>, 
+                                                    tsl::hh::no_bucket_versions>::type;
+    
+    using ht = detail_hopscotch_hash::hopscotch_hash<std::pair<Key, T>, KeySelect, ValueSelect,
+                                                     Hash, KeyEqual,
+                                                     Allocator, NeighborhoodSize,
+                                                     StoreHash, GrowthPolicy,
+                                                     overflow_container_type, Layout, versions_type>;
+    
+    using optimistic_lookup_result = detail_hopscotch_hash::optimistic_lookup_result;
+    
+    /*
+     * Each shard is allocated separately so that the mutexes of two shards don't share a cache line.
+     */
+    struct shard {
+        shard(std::size_t bucket_count, const Hash& hash, const KeyEqual& equal, const Allocator& alloc):
+                    table(bucket_count, hash, equal, alloc, ht::DEFAULT_MAX_LOAD_FACTOR)
+        {
+        }
+        
+        mutable std::mutex mutex;
+        ht table;
+    };
+    
+    using lock_guard = std::lock_guard<std::mutex>;
+
+public:
+    using key_type = typename ht::key_type;
+    using mapped_type = T;
+    using value_type = typename ht::value_type;
+    using size_type = typename ht::size_type;
+    using difference_type = typename ht::difference_type;
+    using hasher = typename ht::hasher;
+    using key_equal = typename ht::key_equal;
+    using allocator_type = typename ht::allocator_type;
+    
+    /**
+     * Default number of shards.
+     */
+    static const size_type DEFAULT_SHARD_COUNT = 64;
+    
+    /**
+     * Maximum number of shards, the shard of a key is selected with at most 16 bits of its hash.
+     */
+    static const size_type MAX_SHARD_COUNT = size_type(1) << 16;
+    
+    
+    /*
+     * Constructors
+     */
+    concurrent_hopscotch_map() : concurrent_hopscotch_map(ht::DEFAULT_INIT_BUCKETS_SIZE) {
+    }
+    
+    /**
+     * The bucket_count buckets are split between the shard_count shards. shard_count is rounded up
+     * to the nearest power of two and limited to MAX_SHARD_COUNT.
+     */
+    explicit concurrent_hopscotch_map(size_type bucket_count,
+                                      size_type shard_count = DEFAULT_SHARD_COUNT,
+                                      const Hash& hash = Hash(),
+                                      const KeyEqual& equal = KeyEqual(),
+                                      const Allocator& alloc = Allocator()) : Hash(hash), m_shard_mask(0)
+    {
+        while(m_shard_mask + 1 < shard_count && m_shard_mask + 1 < MAX_SHARD_COUNT) {
+            m_shard_mask = (m_shard_mask << 1) | 1;
+        }
+        
+        const size_type nb_shards = m_shard_mask + 1;
+        const size_type shard_bucket_count = (bucket_count + nb_shards - 1)/nb_shards;
+        
+        m_shards.reserve(nb_shards);
+        for(size_type ishard = 0; ishard < nb_shards; ishard++) {
+            m_shards.emplace_back(new shard(shard_bucket_count, hash, equal, alloc));
+        }
+    }
+    
+    template<class InputIt, typename std::enable_if<!std::is_integral<InputIt>::value>::type* = nullptr>
+    concurrent_hopscotch_map(InputIt first, InputIt last,
+                             size_type bucket_count = ht::DEFAULT_INIT_BUCKETS_SIZE,
+                             size_type shard_count = DEFAULT_SHARD_COUNT,
+                             const Hash& hash = Hash(),
+                             const KeyEqual& equal = KeyEqual(),
+                             const Allocator& alloc = Allocator()) :
+                             concurrent_hopscotch_map(bucket_count, shard_count, hash, equal, alloc)
+    {
+        insert(first, last);
+    }
+    
+    concurrent_hopscotch_map(std::initializer_list<value_type> init,
+                             size_type bucket_count = ht::DEFAULT_INIT_BUCKETS_SIZE,
+                             size_type shard_count = DEFAULT_SHARD_COUNT,
+                             const Hash& hash = Hash(),
+                             const KeyEqual& equal = KeyEqual(),
+                             const Allocator& alloc = Allocator()) :
+                             concurrent_hopscotch_map(init.begin(), init.end(), bucket_count, shard_count,
+                                                      hash, equal, alloc)
+    {
+    }
+    
+    concurrent_hopscotch_map(const concurrent_hopscotch_map& other) = delete;
+    concurrent_hopscotch_map& operator=(const concurrent_hopscotch_map& other) = delete;
+    
+    allocator_type get_allocator() const { return m_shards.front()->table.get_allocator(); }
+    
+    
+    /*
+     * Capacity
+     */
+    bool empty() const { return size() == 0; }
+    
+    size_type size() const {
+        size_type nb_elements = 0;
+        for(const std::unique_ptr<shard>& s: m_shards) {
+            lock_guard lock(s->mutex);
+            nb_elements += s->table.size();
+        }
+        
+        return nb_elements;
+    }
+    
+    
+    /*
+     * Modifiers
+     */
+    void clear() {
+        for(const std::unique_ptr<shard>& s: m_shards) {
+            lock_guard lock(s->mutex);
+            s->table.clear();
+        }
+    }
+    
+    /**
+     * Return true if the value was inserted, false if an element with an equivalent key was already in the map.
+     */
+    bool insert(const value_type& value) {
+        const std::size_t hash = hash_key(value.first);
+        shard& s = shard_for_hash(hash);
+        
+        lock_guard lock(s.mutex);
+        return s.table.insert_with_hash(hash, value).second;
+    }
+    
+    template<class P, typename std::enable_if<std::is_constructible<value_type, P&&>::value>::type* = nullptr>
+    bool insert(P&& value) {
+        return emplace(std::forward<P>(value));
+    }
+    
+    bool insert(value_type&& value) {
+        const std::size_t hash = hash_key(value.first);
+        shard& s = shard_for_hash(hash);
+        
+        lock_guard lock(s.mutex);
+        return s.table.insert_with_hash(hash, std::move(value)).second;
+    }
+    
+    template<class InputIt>
+    void insert(InputIt first, InputIt last) {
+        for(; first != last; ++first) {
+            insert(*first);
+        }
+    }
+    
+    void insert(std::initializer_list<value_type> ilist) {
+        insert(ilist.begin(), ilist.end());
+    }
+    
+    
+    /**
+     * Return true if the value was inserted, false if obj was assigned to the value of an existing element.
+     */
+    template<class M>
+    bool insert_or_assign(const key_type& k, M&& obj) {
+        return insert_or_assign_impl(k, std::forward<M>(obj));
+    }
+    
+    template<class M>
+    bool insert_or_assign(key_type&& k, M&& obj) {
+        return insert_or_assign_impl(std::move(k), std::forward<M>(obj));
+    }
+    
+    
+    /**
+     * Due to the way elements are stored, emplace will need to move or copy the key-value once.
+     * The method is equivalent to insert(value_type(std::forward<Args>(args)...));
+     * 
+     * Mainly here for compatibility with the std::unordered_map interface.
+     */
+    template<class... Args>
+    bool emplace(Args&&... args) {
+        return insert(value_type(std::forward<Args>(args)...));
+    }
+    
+    template<class... Args>
+    bool try_emplace(const key_type& k, Args&&... args) {
+        return try_emplace_impl(k, std::forward<Args>(args)...);
+    }
+    
+    template<class... Args>
+    bool try_emplace(key_type&& k, Args&&... args) {
+        return try_emplace_impl(std::move(k), std::forward<Args>(args)...);
+    }
+    
+    
+    size_type erase(const key_type& key) { return erase(key, hash_key(key)); }
+    
+    /**
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup to the value if you already have the hash.
+     */
+    size_type erase(const key_type& key, std::size_t precalculated_hash) {
+        shard& s = shard_for_hash(precalculated_hash);
+        
+        lock_guard lock(s.mutex);
+        return s.table.erase(key, precalculated_hash);
+    }
+    
+    /**
+     * This overload only participates in the overload resolution if the typedef KeyEqual::is_transparent exists.
+     * If so, K must be hashable and comparable to Key.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    size_type erase(const K& key) { return erase(key, hash_key(key)); }
+    
+    /**
+     * @copydoc erase(const K& key)
+     * 
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup to the value if you already have the hash.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    size_type erase(const K& key, std::size_t precalculated_hash) {
+        shard& s = shard_for_hash(precalculated_hash);
+        
+        lock_guard lock(s.mutex);
+        return s.table.erase(key, precalculated_hash);
+    }
+    
+    
+    
+    /*
+     * Lookup
+     */
+    
+    /**
+     * Return a copy of the value associated to the key. Throw std::out_of_range if the key is not in the map.
+     */
+    T at(const Key& key) const { return at(key, hash_key(key)); }
+    
+    /**
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    T at(const Key& key, std::size_t precalculated_hash) const {
+        return at_impl(key, precalculated_hash);
+    }
+    
+    /**
+     * This overload only participates in the overload resolution if the typedef KeyEqual::is_transparent exists.
+     * If so, K must be hashable and comparable to Key.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    T at(const K& key) const { return at(key, hash_key(key)); }
+    
+    /**
+     * @copydoc at(const K& key) const
+     * 
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    T at(const K& key, std::size_t precalculated_hash) const {
+        return at_impl(key, precalculated_hash);
+    }
+    
+    
+    size_type count(const Key& key) const { return count(key, hash_key(key)); }
+    
+    /**
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    size_type count(const Key& key, std::size_t precalculated_hash) const {
+        return visit(key, precalculated_hash, [](const key_type& /*key*/, const T& /*value*/) {})?1:0;
+    }
+    
+    /**
+     * This overload only participates in the overload resolution if the typedef KeyEqual::is_transparent exists.
+     * If so, K must be hashable and comparable to Key.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    size_type count(const K& key) const { return count(key, hash_key(key)); }
+    
+    /**
+     * @copydoc count(const K& key) const
+     * 
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    size_type count(const K& key, std::size_t precalculated_hash) const {
+        return visit(key, precalculated_hash, [](const key_type& /*key*/, const T& /*value*/) {})?1:0;
+    }
+    
+    
+    /**
+     * If the key is in the map, copy its value in 'value' and return true. Otherwise return false and
+     * leave 'value' unchanged.
+     */
+    bool find(const Key& key, T& value) const { return find(key, hash_key(key), value); }
+    
+    /**
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    bool find(const Key& key, std::size_t precalculated_hash, T& value) const {
+        return visit(key, precalculated_hash, [&](const key_type& /*key*/, const T& found_value) {
+            value = found_value;
+        });
+    }
+    
+    /**
+     * This overload only participates in the overload resolution if the typedef KeyEqual::is_transparent exists.
+     * If so, K must be hashable and comparable to Key.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    bool find(const K& key, T& value) const { return find(key, hash_key(key), value); }
+    
+    /**
+     * @copydoc find(const K& key, T& value) const
+     * 
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    bool find(const K& key, std::size_t precalculated_hash, T& value) const {
+        return visit(key, precalculated_hash, [&](const key_type& /*key*/, const T& found_value) {
+            value = found_value;
+        });
+    }
+    
+    
+    bool contains(const Key& key) const { return count(key) != 0; }
+    
+    /**
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    bool contains(const Key& key, std::size_t precalculated_hash) const {
+        return count(key, precalculated_hash) != 0;
+    }
+    
+    /**
+     * This overload only participates in the overload resolution if the typedef KeyEqual::is_transparent exists.
+     * If so, K must be hashable and comparable to Key.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    bool contains(const K& key) const { return count(key) != 0; }
+    
+    /**
+     * @copydoc contains(const K& key) const
+     * 
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    bool contains(const K& key, std::size_t precalculated_hash) const {
+        return count(key, precalculated_hash) != 0;
+    }
+    
+    
+    /**
+     * If the key is in the map, call visitor(key, value) while the shard of the key is locked and return true.
+     * Otherwise return false. The value may be modified through the reference.
+     * 
+     * The visitor must not call any method of the map.
+     */
+    template<class K, class Visitor>
+    bool visit(const K& key, Visitor&& visitor) {
+        return visit(key, hash_key(key), std::forward<Visitor>(visitor));
+    }
+    
+    /**
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    template<class K, class Visitor>
+    bool visit(const K& key, std::size_t precalculated_hash, Visitor&& visitor) {
+        shard& s = shard_for_hash(precalculated_hash);
+        
+        lock_guard lock(s.mutex);
+        auto it = s.table.find(key, precalculated_hash);
+        if(it == s.table.end()) {
+            return false;
+        }
+        
+        s.table.modify(it, [&](typename ht::iterator pos) { visitor(pos->first, pos.value()); });
+        return true;
+    }
+    
+    /**
+     * Same as visit but the value is passed as a const reference. If the lookups are lock-free (see above), 
+     * the visitor is called on a copy of the element without holding the lock.
+     */
+    template<class K, class Visitor>
+    bool visit(const K& key, Visitor&& visitor) const {
+        return visit(key, hash_key(key), std::forward<Visitor>(visitor));
+    }
+    
+    template<class K, class Visitor>
+    bool visit(const K& key, std::size_t precalculated_hash, Visitor&& visitor) const {
+        return visit_const_impl(key, precalculated_hash, visitor);
+    }
+    
+    /**
+     * Call visitor(key, value) on each element of the map. Each shard is locked while its elements are visited,
+     * the elements inserted or erased concurrently in the other shards may or may not be visited.
+     * 
+     * The visitor must not call any method of the map.
+     */
+    template<class Visitor>
+    void visit_all(Visitor&& visitor) {
+        for(const std::unique_ptr<shard>& s: m_shards) {
+            lock_guard lock(s->mutex);
+            for(auto it = s->table.begin(); it != s->table.end(); ++it) {
+                s->table.modify(it, [&](typename ht::iterator pos) { visitor(pos->first, pos.value()); });
+            }
+        }
+    }
+    
+    template<class Visitor>
+    void visit_all(Visitor&& visitor) const {
+        for(const std::unique_ptr<shard>& s: m_shards) {
+            lock_guard lock(s->mutex);
+            for(auto it = s->table.cbegin(); it != s->table.cend(); ++it) {
+                visitor(it->first, it->second);
+            }
+        }
+    }
+    
+    
+    
+    /*
+     * Bucket interface
+     */
+    size_type bucket_count() const {
+        size_type nb_buckets = 0;
+        for(const std::unique_ptr<shard>& s: m_shards) {
+            lock_guard lock(s->mutex);
+            nb_buckets += s->table.bucket_count();
+        }
+        
+        return nb_buckets;
+    }
+    
+    size_type shard_count() const noexcept { return m_shards.size(); }
+    
+    
+    /*
+     *  Hash policy
+     */
+    float max_load_factor() const {
+        lock_guard lock(m_shards.front()->mutex);
+        return m_shards.front()->table.max_load_factor();
+    }
+    
+    void max_load_factor(float ml) {
+        for(const std::unique_ptr<shard>& s: m_shards) {
+            lock_guard lock(s->mutex);
+            s->table.max_load_factor(ml);
+        }
+    }
+    
+    /**
+     * Reserve enough space in each shard for count_ elements evenly spread over the shards.
+     */
+    void reserve(size_type count_) {
+        const size_type shard_count_ = (count_ + shard_count() - 1)/shard_count();
+        for(const std::unique_ptr<shard>& s: m_shards) {
+            lock_guard lock(s->mutex);
+            s->table.reserve(shard_count_);
+        }
+    }
+    
+    
+    /*
+     * Observers
+     */
+    hasher hash_function() const { return static_cast<const Hash&>(*this); }
+    key_equal key_eq() const { return m_shards.front()->table.key_eq(); }
+    
+    
+    /*
+     * Other
+     */
+    size_type overflow_size() const {
+        size_type nb_overflow_elements = 0;
+        for(const std::unique_ptr<shard>& s: m_shards) {
+            lock_guard lock(s->mutex);
+            nb_overflow_elements += s->table.overflow_size();
+        }
+        
+        return nb_overflow_elements;
+    }
+
+private:
+    template<class K>
+    std::size_t hash_key(const K& key) const {
+        return Hash::operator()(key);
+    }
+    
+    /*
+     * Fibonacci hashing, the multiplication mixes all the bits of the hash into the high bits of the product.
+     * The top 16 bits are then masked to the number of shards.
+     */
+    std::size_t shard_index(std::size_t hash) const noexcept {
+        const std::uint64_t mixed_hash = std::uint64_t(hash) * UINT64_C(0x9E3779B97F4A7C15);
+        return std::size_t(mixed_hash >> 48) & m_shard_mask;
+    }
+    
+    shard& shard_for_hash(std::size_t hash) noexcept {
+        return *m_shards[shard_index(hash)];
+    }
+    
+    const shard& shard_for_hash(std::size_t hash) const noexcept {
+        return *m_shards[shard_index(hash)];
+    }
+    
+    template<class K, class M>
+    bool insert_or_assign_impl(K&& key, M&& obj) {
+        const std::size_t hash = hash_key(key);
+        shard& s = shard_for_hash(hash);
+        
+        lock_guard lock(s.mutex);
+        auto it = s.table.try_emplace_with_hash(hash, std::forward<K>(key), std::forward<M>(obj));
+        if(!it.second) {
+            s.table.modify(it.first, [&](typename ht::iterator pos) { pos.value() = std::forward<M>(obj); });
+        }
+        
+        return it.second;
+    }
+    
+    template<class K, bool U = OPTIMISTIC_LOOKUPS, typename std::enable_if<!U>::type* = nullptr>
+    T at_impl(const K& key, std::size_t hash) const {
+        const shard& s = shard_for_hash(hash);
+        
+        lock_guard lock(s.mutex);
+        return s.table.at(key, hash);
+    }
+    
+    template<class K, bool U = OPTIMISTIC_LOOKUPS, typename std::enable_if<U>::type* = nullptr>
+    T at_impl(const K& key, std::size_t hash) const {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type value_copy;
+        const bool found = visit(key, hash, [&](const key_type& /*key*/, const T& value) {
+            std::memcpy(&value_copy, std::addressof(value), sizeof(T));
+        });
+        
+        if(!found) {
+            throw std::out_of_range("Couldn't find key.");
+        }
+        
+        return *reinterpret_cast<const T*>(&value_copy);
+    }
+    
+    template<class K, class Visitor, bool U = OPTIMISTIC_LOOKUPS, typename std::enable_if<!U>::type* = nullptr>
+    bool visit_const_impl(const K& key, std::size_t hash, Visitor& visitor) const {
+        return visit_locked(key, hash, visitor);
+    }
+    
+    /*
+     * Copy the key and the value into local buffers during the lock-free lookup and only call the visitor 
+     * on the copies once the lookup has been validated.
+     */
+    template<class K, class Visitor, bool U = OPTIMISTIC_LOOKUPS, typename std::enable_if<U>::type* = nullptr>
+    bool visit_const_impl(const K& key, std::size_t hash, Visitor& visitor) const {
+        typename std::aligned_storage<sizeof(Key), alignof(Key)>::type key_copy;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type value_copy;
+        
+        const optimistic_lookup_result result = shard_for_hash(hash).table.find_optimistic(key, hash, 
+            [&](const value_type& element) {
+                std::memcpy(&key_copy, std::addressof(element.first), sizeof(Key));
+                std::memcpy(&value_copy, std::addressof(element.second), sizeof(T));
+            });
+        
+        switch(result) {
+            case optimistic_lookup_result::found:
+                visitor(*reinterpret_cast<const Key*>(&key_copy), *reinterpret_cast<const T*>(&value_copy));
+                return true;
+            case optimistic_lookup_result::not_found:
+                return false;
+            default:
+                return visit_locked(key, hash, visitor);
+        }
+    }
+    
+    template<class K, class Visitor>
+    bool visit_locked(const K& key, std::size_t hash, Visitor& visitor) const {
+        const shard& s = shard_for_hash(hash);
+        
+        lock_guard lock(s.mutex);
+        auto it = s.table.find(key, hash);
+        if(it == s.table.cend()) {
+            return false;
+        }
+        
+        visitor(it->first, it->second);
+        return true;
+    }
+    
+    template<class K, class... Args>
+    bool try_emplace_impl(K&& key, Args&&... args) {
+        const std::size_t hash = hash_key(key);
+        shard& s = shard_for_hash(hash);
+        
+        lock_guard lock(s.mutex);
+        return s.table.try_emplace_with_hash(hash, std::forward<K>(key), std::forward<Args>(args)...).second;
+    }
+
+private:
+    std::vector<std::unique_ptr<shard>> m_shards;
+    std::size_t m_shard_mask;
+};
+
+} // end namespace tsl
+
+#endif
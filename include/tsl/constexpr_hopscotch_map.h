@@ -0,0 +1,523 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2017 Tessil
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef TSL_CONSTEXPR_HOPSCOTCH_MAP_H
+#define TSL_CONSTEXPR_HOPSCOTCH_MAP_H
+
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "hopscotch_growth_policy.h"
+#include "hopscotch_hash.h"
+
+#if defined(__has_include) && __cplusplus >= 201703L
+#    if __has_include(<string_view>)
+#        include <string_view>
+#        define TSL_HH_HAS_STRING_VIEW
+#    endif
+#endif
+
+
+/*
+ * The tables are built by loops in constexpr functions, which requires the relaxed constexpr of C++14.
+ */
+#if (defined(__cpp_constexpr) && __cpp_constexpr >= 201304) || (defined(_MSVC_LANG) && _MSVC_LANG >= 201402L)
+#    define TSL_HH_HAS_CONSTEXPR_MAP
+#endif
+
+
+#ifdef TSL_HH_HAS_CONSTEXPR_MAP
+namespace tsl {
+
+namespace hh {
+
+/**
+ * Hash usable in constant expressions, the default hash of tsl::constexpr_hopscotch_map (std::hash is not constexpr).
+ * 
+ * Defined for the integral and enum types, for null-terminated strings (const char*) and, in C++17,
+ * for std::string_view. The keys are hashed in the same way at compile time and at runtime, the hash doesn't
+ * need to be stable between different builds.
+ */
+template<class Key, class Enable = void>
+struct constexpr_hash;
+
+template<class Key>
+struct constexpr_hash<Key, typename std::enable_if<std::is_integral<Key>::value || std::is_enum<Key>::value>::type> {
+    constexpr std::size_t operator()(const Key& key) const noexcept {
+        // Multiply by 2^64 / phi and fold the high bits into the low bits used by the mask of the table.
+        const std::size_t hash = std::size_t(static_cast<std::size_t>(key) * detail::FIBONACCI_MULTIPLIER);
+        return hash ^ (hash >> (sizeof(std::size_t) * 4));
+    }
+};
+
+/*
+ * FNV-1a of the characters in [str, str + size), or until the null character if size is CONSTEXPR_HASH_NO_SIZE.
+ */
+static constexpr std::size_t CONSTEXPR_HASH_NO_SIZE = std::size_t(-1);
+
+inline constexpr std::size_t constexpr_fnv1a(const char* str, std::size_t size) noexcept {
+    std::uint64_t hash = UINT64_C(14695981039346656037);
+    for(std::size_t i = 0; (size == CONSTEXPR_HASH_NO_SIZE)?(str[i] != '\0'):(i < size); i++) {
+        hash = (hash ^ std::uint64_t(static_cast<unsigned char>(str[i]))) * UINT64_C(1099511628211);
+    }
+    
+    return std::size_t(hash ^ (hash >> 32));
+}
+
+template<>
+struct constexpr_hash<const char*> {
+    constexpr std::size_t operator()(const char* key) const noexcept {
+        return constexpr_fnv1a(key, CONSTEXPR_HASH_NO_SIZE);
+    }
+};
+
+#ifdef TSL_HH_HAS_STRING_VIEW
+template<>
+struct constexpr_hash<std::string_view> {
+    constexpr std::size_t operator()(std::string_view key) const noexcept {
+        return constexpr_fnv1a(key.data(), key.size());
+    }
+};
+#endif
+
+
+/**
+ * Equality usable in constant expressions, the default KeyEqual of tsl::constexpr_hopscotch_map. Compare
+ * with operator== except the null-terminated strings (const char*) which are compared character by character.
+ */
+template<class Key>
+struct constexpr_equal_to {
+    constexpr bool operator()(const Key& lhs, const Key& rhs) const {
+        return lhs == rhs;
+    }
+};
+
+template<>
+struct constexpr_equal_to<const char*> {
+    constexpr bool operator()(const char* lhs, const char* rhs) const noexcept {
+        std::size_t i = 0;
+        while(lhs[i] != '\0' && lhs[i] == rhs[i]) {
+            i++;
+        }
+        
+        return lhs[i] == rhs[i];
+    }
+};
+
+}
+
+
+namespace detail_hopscotch_hash {
+
+/*
+ * Bucket of a constexpr_hopscotch_map. The neighborhood bitmap follows the scheme of hopscotch_bucket (see
+ * NB_RESERVED_BITS_IN_NEIGHBORHOOD) but the key and the value are plain members, default-constructed
+ * in the empty buckets, so that the buckets can be written in constant expressions.
+ */
+template<class Key, class T, unsigned int NeighborhoodSize>
+struct constexpr_bucket {
+    using neighborhood_bitmap =
+                typename smallest_type_for_min_bits<NeighborhoodSize + NB_RESERVED_BITS_IN_NEIGHBORHOOD>::type;
+    
+    constexpr bool empty() const noexcept {
+        return (neighborhood_infos & 1) == 0;
+    }
+    
+    constexpr bool check_neighbor_presence(std::size_t ineighbor) const noexcept {
+        return ((neighborhood_infos >> (ineighbor + NB_RESERVED_BITS_IN_NEIGHBORHOOD)) & 1) == 1;
+    }
+    
+    constexpr void toggle_neighbor_presence(std::size_t ineighbor) noexcept {
+        neighborhood_infos = neighborhood_bitmap(
+                                neighborhood_infos ^ (1ull << (ineighbor + NB_RESERVED_BITS_IN_NEIGHBORHOOD)));
+    }
+    
+    neighborhood_bitmap neighborhood_infos;
+    Key key;
+    T value;
+};
+
+/*
+ * Default bucket count of a constexpr_hopscotch_map of nb_elements elements: the smallest power of two
+ * giving a load factor <= 0.8.
+ */
+inline constexpr std::size_t constexpr_bucket_count(std::size_t nb_elements) noexcept {
+    const std::size_t min_bucket_count = nb_elements + (nb_elements + 3)/4;
+    
+    std::size_t bucket_count = 1;
+    while(bucket_count < min_bucket_count) {
+        bucket_count *= 2;
+    }
+    
+    return bucket_count;
+}
+
+}
+
+
+/**
+ * Immutable hash map of N elements laid out with hopscotch hashing, which can be built and queried in constant
+ * expressions. Useful for small fixed lookup tables (opcodes, header names, ...): a constexpr map is built
+ * by the compiler and stored in the read-only data of the program, there is no construction at startup
+ * and no heap allocation.
+ * 
+ *     constexpr std::pair<int, const char*> OPCODES[] = {{0x01, "nop"}, {0x02, "load"}, {0x03, "store"}};
+ *     constexpr auto opcodes = tsl::make_constexpr_hopscotch_map(OPCODES);
+ *     static_assert(opcodes.at(0x02)[0] == 'l', "");
+ * 
+ * The elements are inserted with the hopscotch algorithm of tsl::hopscotch_map (linear search of an empty
+ * bucket then displacement towards the home bucket) in a fixed array of BucketCount + NeighborhoodSize - 1
+ * buckets, BucketCount being a power of two (by default the smallest one giving a load factor <= 0.8).
+ * There is no overflow list: if an element can't be placed in its neighborhood, or if two keys are equivalent,
+ * the construction throws (std::length_error, std::invalid_argument), which is a compilation error in a
+ * constant expression. Increase NeighborhoodSize or BucketCount in the first case.
+ * 
+ * Key and T must be literal types, default-constructible and copy-assignable. Hash and KeyEqual must be
+ * default-constructible and usable in constant expressions, see tsl::hh::constexpr_hash and
+ * tsl::hh::constexpr_equal_to which support the integers, the enums, const char* and std::string_view.
+ * 
+ * Requires C++14 (TSL_HH_HAS_CONSTEXPR_MAP is defined if available).
+ */
+template<class Key,
+         class T,
+         std::size_t N,
+         class Hash = tsl::hh::constexpr_hash<Key>,
+         class KeyEqual = tsl::hh::constexpr_equal_to<Key>,
+         unsigned int NeighborhoodSize = 30,
+         std::size_t BucketCount = detail_hopscotch_hash::constexpr_bucket_count(N)>
+class constexpr_hopscotch_map {
+private:
+    using bucket = detail_hopscotch_hash::constexpr_bucket<Key, T, NeighborhoodSize>;
+    
+    static_assert(NeighborhoodSize >= 4 && NeighborhoodSize <= 62, "NeighborhoodSize should be in [4, 62].");
+    static_assert(BucketCount > 0 && (BucketCount & (BucketCount - 1)) == 0, "BucketCount must be a power of two.");
+    static_assert(N <= BucketCount, "BucketCount must be >= N.");
+    
+    static const std::size_t NB_BUCKETS = BucketCount + NeighborhoodSize - 1;
+
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<Key, T>;
+    using size_type = std::size_t;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    
+    class const_iterator {
+        friend class constexpr_hopscotch_map;
+    
+    private:
+        constexpr const_iterator(const bucket* it, const bucket* end) noexcept: m_it(it), m_end(end) {
+            skip_empty_buckets();
+        }
+    
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<const Key&, const T&>;
+        using difference_type = std::ptrdiff_t;
+        using reference = value_type;
+        using pointer = void;
+        
+        constexpr const_iterator() noexcept: m_it(nullptr), m_end(nullptr) {
+        }
+        
+        constexpr const Key& key() const { return m_it->key; }
+        constexpr const T& value() const { return m_it->value; }
+        
+        constexpr reference operator*() const { return reference(m_it->key, m_it->value); }
+        
+        constexpr const_iterator& operator++() {
+            ++m_it;
+            skip_empty_buckets();
+            
+            return *this;
+        }
+        
+        constexpr const_iterator operator++(int) {
+            const_iterator tmp(*this);
+            ++*this;
+            
+            return tmp;
+        }
+        
+        friend constexpr bool operator==(const const_iterator& lhs, const const_iterator& rhs) {
+            return lhs.m_it == rhs.m_it;
+        }
+        
+        friend constexpr bool operator!=(const const_iterator& lhs, const const_iterator& rhs) {
+            return !(lhs == rhs);
+        }
+    
+    private:
+        constexpr void skip_empty_buckets() noexcept {
+            while(m_it != m_end && m_it->empty()) {
+                ++m_it;
+            }
+        }
+    
+    private:
+        const bucket* m_it;
+        const bucket* m_end;
+    };
+    
+    using iterator = const_iterator;
+
+
+    /**
+     * Build the map from the N elements of values. Throw std::invalid_argument if two keys are equivalent
+     * and std::length_error if an element can't be placed in its neighborhood.
+     */
+    constexpr explicit constexpr_hopscotch_map(const value_type (&values)[N]): m_buckets{} {
+        for(std::size_t i = 0; i < N; i++) {
+            insert(values[i].first, values[i].second);
+        }
+    }
+    
+    /**
+     * @copydoc constexpr_hopscotch_map(const value_type (&values)[N])
+     */
+    constexpr explicit constexpr_hopscotch_map(const std::array<value_type, N>& values): m_buckets{} {
+        for(std::size_t i = 0; i < N; i++) {
+            insert(values[i].first, values[i].second);
+        }
+    }
+
+
+    /*
+     * Iterators
+     */
+    constexpr const_iterator begin() const noexcept { return cbegin(); }
+    constexpr const_iterator cbegin() const noexcept { return const_iterator(m_buckets, m_buckets + NB_BUCKETS); }
+    
+    constexpr const_iterator end() const noexcept { return cend(); }
+    constexpr const_iterator cend() const noexcept {
+        return const_iterator(m_buckets + NB_BUCKETS, m_buckets + NB_BUCKETS);
+    }
+
+
+    /*
+     * Capacity
+     */
+    constexpr bool empty() const noexcept { return N == 0; }
+    constexpr size_type size() const noexcept { return N; }
+
+
+    /*
+     * Lookup
+     */
+    
+    /**
+     * Throw std::out_of_range if the key is not in the map (a compilation error in a constant expression).
+     */
+    constexpr const T& at(const Key& key) const { return at(key, hash_key(key)); }
+    
+    /**
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    constexpr const T& at(const Key& key, std::size_t precalculated_hash) const {
+        const bucket* found = find_bucket(key, precalculated_hash);
+        if(found == nullptr) {
+            throw std::out_of_range("Couldn't find key.");
+        }
+        
+        return found->value;
+    }
+    
+    constexpr size_type count(const Key& key) const { return count(key, hash_key(key)); }
+    
+    /**
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    constexpr size_type count(const Key& key, std::size_t precalculated_hash) const {
+        return (find_bucket(key, precalculated_hash) != nullptr)?1:0;
+    }
+    
+    constexpr const_iterator find(const Key& key) const { return find(key, hash_key(key)); }
+    
+    /**
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    constexpr const_iterator find(const Key& key, std::size_t precalculated_hash) const {
+        const bucket* found = find_bucket(key, precalculated_hash);
+        return (found != nullptr)?const_iterator(found, m_buckets + NB_BUCKETS):cend();
+    }
+    
+    constexpr bool contains(const Key& key) const { return count(key) != 0; }
+    
+    /**
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    constexpr bool contains(const Key& key, std::size_t precalculated_hash) const {
+        return count(key, precalculated_hash) != 0;
+    }
+
+
+    /*
+     * Bucket interface
+     */
+    constexpr size_type bucket_count() const noexcept { return BucketCount; }
+
+
+    /*
+     *  Hash policy
+     */
+    constexpr float load_factor() const noexcept { return float(N)/float(BucketCount); }
+
+
+    /*
+     * Observers
+     */
+    constexpr hasher hash_function() const { return Hash(); }
+    constexpr key_equal key_eq() const { return KeyEqual(); }
+
+private:
+    static constexpr std::size_t hash_key(const Key& key) {
+        return Hash()(key);
+    }
+    
+    static constexpr bool compare_keys(const Key& key1, const Key& key2) {
+        return KeyEqual()(key1, key2);
+    }
+    
+    static constexpr std::size_t bucket_for_hash(std::size_t hash) noexcept {
+        return hash & (BucketCount - 1);
+    }
+    
+    /*
+     * Same lookup as hopscotch_hash::find_in_buckets. Return nullptr if the key is not in the map.
+     */
+    constexpr const bucket* find_bucket(const Key& key, std::size_t hash) const {
+        const std::size_t ibucket_for_hash = bucket_for_hash(hash);
+        
+        std::uint64_t neighborhood_infos = m_buckets[ibucket_for_hash].neighborhood_infos >>
+                                           detail_hopscotch_hash::NB_RESERVED_BITS_IN_NEIGHBORHOOD;
+        for(std::size_t ibucket = ibucket_for_hash; neighborhood_infos != 0; ibucket++) {
+            if((neighborhood_infos & 1) == 1 && compare_keys(m_buckets[ibucket].key, key)) {
+                return m_buckets + ibucket;
+            }
+            
+            neighborhood_infos >>= 1;
+        }
+        
+        return nullptr;
+    }
+    
+    /*
+     * Same algorithm as hopscotch_hash::insert_value: search an empty bucket from the home bucket and,
+     * while it's outside of the neighborhood, swap it with an element closer to the home bucket.
+     */
+    constexpr void insert(const Key& key, const T& value) {
+        const std::size_t hash = hash_key(key);
+        if(find_bucket(key, hash) != nullptr) {
+            throw std::invalid_argument("Duplicate key in the elements of the constexpr_hopscotch_map.");
+        }
+        
+        const std::size_t ibucket_for_hash = bucket_for_hash(hash);
+        std::size_t ibucket_empty = ibucket_for_hash;
+        while(ibucket_empty < NB_BUCKETS && !m_buckets[ibucket_empty].empty()) {
+            ibucket_empty++;
+        }
+        
+        while(ibucket_empty < NB_BUCKETS && ibucket_empty - ibucket_for_hash >= NeighborhoodSize) {
+            if(!swap_empty_bucket_closer(ibucket_empty)) {
+                ibucket_empty = NB_BUCKETS;
+            }
+        }
+        
+        if(ibucket_empty == NB_BUCKETS) {
+            throw std::length_error("Couldn't place an element of the constexpr_hopscotch_map in its neighborhood, "
+                                    "increase NeighborhoodSize or BucketCount.");
+        }
+        
+        m_buckets[ibucket_empty].key = key;
+        m_buckets[ibucket_empty].value = value;
+        m_buckets[ibucket_empty].neighborhood_infos |= 1;
+        m_buckets[ibucket_for_hash].toggle_neighbor_presence(ibucket_empty - ibucket_for_hash);
+    }
+    
+    /*
+     * Same as hopscotch_hash::swap_empty_bucket_closer.
+     */
+    constexpr bool swap_empty_bucket_closer(std::size_t& ibucket_empty_in_out) {
+        const std::size_t neighborhood_start = ibucket_empty_in_out - NeighborhoodSize + 1;
+        
+        for(std::size_t to_check = neighborhood_start; to_check < ibucket_empty_in_out; to_check++) {
+            for(std::size_t to_swap = to_check; to_swap < ibucket_empty_in_out; to_swap++) {
+                if(m_buckets[to_check].check_neighbor_presence(to_swap - to_check)) {
+                    m_buckets[ibucket_empty_in_out].key = m_buckets[to_swap].key;
+                    m_buckets[ibucket_empty_in_out].value = m_buckets[to_swap].value;
+                    m_buckets[ibucket_empty_in_out].neighborhood_infos |= 1;
+                    
+                    m_buckets[to_swap].key = Key();
+                    m_buckets[to_swap].value = T();
+                    m_buckets[to_swap].neighborhood_infos &= ~typename bucket::neighborhood_bitmap(1);
+                    
+                    m_buckets[to_check].toggle_neighbor_presence(ibucket_empty_in_out - to_check);
+                    m_buckets[to_check].toggle_neighbor_presence(to_swap - to_check);
+                    
+                    ibucket_empty_in_out = to_swap;
+                    
+                    return true;
+                }
+            }
+        }
+        
+        return false;
+    }
+
+private:
+    bucket m_buckets[NB_BUCKETS];
+};
+
+
+/**
+ * Build a tsl::constexpr_hopscotch_map from an array of N key-value pairs with the default Hash, KeyEqual,
+ * NeighborhoodSize and BucketCount.
+ */
+template<class Key, class T, std::size_t N>
+constexpr constexpr_hopscotch_map<Key, T, N> make_constexpr_hopscotch_map(const std::pair<Key, T> (&values)[N]) {
+    return constexpr_hopscotch_map<Key, T, N>(values);
+}
+
+/**
+ * @copydoc make_constexpr_hopscotch_map(const std::pair<Key, T> (&values)[N])
+ */
+template<class Key, class T, std::size_t N>
+constexpr constexpr_hopscotch_map<Key, T, N>
+make_constexpr_hopscotch_map(const std::array<std::pair<Key, T>, N>& values) {
+    return constexpr_hopscotch_map<Key, T, N>(values);
+}
+
+} // end namespace tsl
+#endif
+
+#endif
@@ -30,6 +30,7 @@
 #include <climits>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <iterator>
 #include <limits>
 #include <ratio>
@@ -197,6 +198,192 @@ private:
 
 
 
+namespace detail {
+
+/**
+ * 2^64 / phi (or 2^32 / phi on 32 bits platforms) used for Fibonacci hashing. The multiplier is odd 
+ * so that the multiplication by it is a bijection.
+ */
+static constexpr const std::size_t FIBONACCI_MULTIPLIER = std::size_t(UINT64_C(0x9E3779B97F4A7C15) >> 
+                                                                      (64 - sizeof(std::size_t) * CHAR_BIT));
+
+/**
+ * Return the high half of the full product a * b, i.e. (a * b) >> (sizeof(std::size_t) * CHAR_BIT).
+ */
+inline std::size_t multiply_high(std::size_t a, std::size_t b) noexcept {
+#if SIZE_MAX <= UINT32_MAX
+    return std::size_t((std::uint64_t(a) * std::uint64_t(b)) >> 32);
+#elif defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 uint128_type;
+    return std::size_t((uint128_type(a) * uint128_type(b)) >> 64);
+#else
+    const std::uint64_t a_low = std::uint64_t(a) & 0xFFFFFFFF;
+    const std::uint64_t a_high = std::uint64_t(a) >> 32;
+    const std::uint64_t b_low = std::uint64_t(b) & 0xFFFFFFFF;
+    const std::uint64_t b_high = std::uint64_t(b) >> 32;
+    
+    const std::uint64_t low_low = a_low * b_low;
+    const std::uint64_t high_low = a_high * b_low;
+    const std::uint64_t low_high = a_low * b_high;
+    const std::uint64_t middle = (low_low >> 32) + (high_low & 0xFFFFFFFF) + low_high;
+    
+    return std::size_t(a_high * b_high + (high_low >> 32) + (middle >> 32));
+#endif
+}
+
+}
+
+/**
+ * Grow the hash table by GrowthFactor::num / GrowthFactor::den, as tsl::hh::mod_growth_policy, but map a hash
+ * to a bucket with a multiplication instead of a modulo, using Lemire's fast range reduction: 
+ * 'bucket = (hash * bucket_count) >> 64' (the high half of the full 128 bits product). 
+ * The bucket count can be any number and the reduction costs a multiplication instead of a division.
+ * 
+ * The fast range reduction uses the high bits of the hash. As some hash functions only set the low bits 
+ * (std::hash of an integer is usually the identity), the hash is first multiplied by 2^64 / phi (Fibonacci 
+ * hashing) so that all its bits contribute to the bucket.
+ * 
+ * As the bucket depends on all the bits of the hash, a hash stored with StoreHash (truncated to 32 bits) 
+ * is not used on rehash, only for the comparisons on lookups.
+ */
+template<class GrowthFactor = std::ratio<3, 2>>
+class fastrange_growth_policy {
+public:
+    explicit fastrange_growth_policy(std::size_t& min_bucket_count_in_out) {
+        if(min_bucket_count_in_out > max_bucket_count()) {
+            throw std::length_error("The hash table exceeds its maxmimum size.");
+        }
+        
+        m_bucket_count = min_bucket_count_in_out;
+    }
+    
+    std::size_t bucket_for_hash(std::size_t hash) const noexcept {
+        return detail::multiply_high(std::size_t(hash * detail::FIBONACCI_MULTIPLIER), m_bucket_count);
+    }
+    
+    std::size_t next_bucket_count() const {
+        if(m_bucket_count == max_bucket_count()) {
+            throw std::length_error("The hash table exceeds its maxmimum size.");
+        }
+        
+        const double next_bucket_count = std::ceil(double(std::max(m_bucket_count, std::size_t(1))) * 
+                                                   REHASH_SIZE_MULTIPLICATION_FACTOR);
+        if(!std::isnormal(next_bucket_count)) {
+            throw std::length_error("The hash table exceeds its maxmimum size.");
+        }
+        
+        if(next_bucket_count > double(max_bucket_count())) {
+            return max_bucket_count();
+        }
+        else {
+            return std::size_t(next_bucket_count);
+        }
+    }
+    
+    std::size_t max_bucket_count() const {
+        return MAX_BUCKET_COUNT;
+    }
+    
+    void clear() noexcept {
+        m_bucket_count = 0;
+    }
+    
+private:
+    static constexpr double REHASH_SIZE_MULTIPLICATION_FACTOR = 1.0 * GrowthFactor::num / GrowthFactor::den;
+    static const std::size_t MAX_BUCKET_COUNT = 
+            std::size_t(double(
+                    std::numeric_limits<std::size_t>::max() / REHASH_SIZE_MULTIPLICATION_FACTOR
+            ));
+            
+    static_assert(REHASH_SIZE_MULTIPLICATION_FACTOR >= 1.1, "Growth factor should be >= 1.1.");
+    
+    std::size_t m_bucket_count;
+};
+
+
+/**
+ * Grow the hash table by a factor of GrowthFactor keeping the bucket count to a power of two, as 
+ * tsl::hh::power_of_two_growth_policy, but map a hash to a bucket with Fibonacci hashing: the hash is multiplied
+ * by 2^64 / phi and the high bits of the product are used as bucket, instead of the low bits of the hash. 
+ * 
+ * A hash function with a poor distribution of its low bits (std::hash of an integer is usually the identity)
+ * will cluster sequential or strided keys in the same neighborhoods with tsl::hh::power_of_two_growth_policy.
+ * The multiplication spreads them over the whole bucket array for the cost of a multiplication and a shift.
+ * 
+ * While the bucket count is <= 2^32, only the 32 least significant bits of the hash are mixed, 
+ * so that the hashes stored with StoreHash (truncated to 32 bits) can still be used on rehash.
+ * 
+ * GrowthFactor must be a power of two >= 2.
+ */
+template<std::size_t GrowthFactor = 2>
+class fibonacci_power_of_two_growth_policy {
+public:
+    explicit fibonacci_power_of_two_growth_policy(std::size_t& min_bucket_count_in_out) {
+        if(min_bucket_count_in_out > max_bucket_count()) {
+            throw std::length_error("The hash table exceeds its maxmimum size.");
+        }
+        
+        std::size_t bucket_count_log2 = 0;
+        while((std::size_t(1) << bucket_count_log2) < min_bucket_count_in_out) {
+            bucket_count_log2++;
+        }
+        
+        if(min_bucket_count_in_out > 0) {
+            min_bucket_count_in_out = std::size_t(1) << bucket_count_log2;
+        }
+        
+        m_bucket_count = min_bucket_count_in_out;
+        if(m_bucket_count <= 1) {
+            // A null hash mask always gives the bucket 0. Avoid a shift by the full width of std::size_t.
+            m_hash_mask = 0;
+            m_shift = NB_BITS - 1;
+        }
+        else {
+            m_hash_mask = (bucket_count_log2 <= 32)?std::size_t(UINT32_MAX):std::numeric_limits<std::size_t>::max();
+            m_shift = NB_BITS - bucket_count_log2;
+        }
+    }
+    
+    std::size_t bucket_for_hash(std::size_t hash) const noexcept {
+        return std::size_t((hash & m_hash_mask) * detail::FIBONACCI_MULTIPLIER) >> m_shift;
+    }
+    
+    std::size_t next_bucket_count() const {
+        if(std::max(m_bucket_count, std::size_t(1)) > max_bucket_count() / GrowthFactor) {
+            throw std::length_error("The hash table exceeds its maxmimum size.");
+        }
+        
+        return std::max(m_bucket_count, std::size_t(1)) * GrowthFactor;
+    }
+    
+    std::size_t max_bucket_count() const {
+        // Largest power of two.
+        return (std::numeric_limits<std::size_t>::max() / 2) + 1;
+    }
+    
+    void clear() noexcept {
+        m_bucket_count = 0;
+        m_hash_mask = 0;
+        m_shift = NB_BITS - 1;
+    }
+    
+private:
+    static constexpr bool is_power_of_two(std::size_t value) {
+        return value != 0 && (value & (value - 1)) == 0;
+    }
+    
+private:
+    static_assert(is_power_of_two(GrowthFactor) && GrowthFactor >= 2, "GrowthFactor must be a power of two >= 2.");
+    
+    static const std::size_t NB_BITS = sizeof(std::size_t) * CHAR_BIT;
+    
+    std::size_t m_bucket_count;
+    std::size_t m_hash_mask;
+    std::size_t m_shift;
+};
+
+
+
 namespace detail {
 
 static constexpr const std::array<std::size_t, 40> PRIMES = {{
@@ -289,6 +476,130 @@ private:
                   "The type of m_iprime is not big enough.");
 }; 
 
+
+/**
+ * Use the same prime numbers as bucket count as tsl::hh::prime_growth_policy, but instead of dispatching 
+ * the modulo through a table of functions (an indirect call on each lookup that can't be inlined), 
+ * precompute a magic multiplier and a shift for the current prime when the policy is created (as libdivide does).
+ * 
+ * 'hash % prime' is then computed inline with a multiplication, a few shifts and substractions:
+ * \code
+ * q = (hash * magic) >> 64; // High half of the 128 bits product
+ * quotient = (((hash - q) >> 1) + q) >> shift;
+ * bucket = hash - quotient * prime;
+ * \endcode
+ * 
+ * The buckets are the same as with tsl::hh::prime_growth_policy.
+ */
+class reciprocal_prime_growth_policy {
+public:
+    explicit reciprocal_prime_growth_policy(std::size_t& min_bucket_count_in_out) {
+        auto it_prime = std::lower_bound(detail::PRIMES.begin(), 
+                                         detail::PRIMES.end(), min_bucket_count_in_out);
+        if(it_prime == detail::PRIMES.end()) {
+            throw std::length_error("The hash table exceeds its maxmimum size.");
+        }
+        
+        set_iprime(static_cast<unsigned int>(std::distance(detail::PRIMES.begin(), it_prime)));
+        if(min_bucket_count_in_out > 0) {
+            min_bucket_count_in_out = *it_prime;
+        }
+        else {
+            min_bucket_count_in_out = 0;
+        }
+    }
+    
+    std::size_t bucket_for_hash(std::size_t hash) const noexcept {
+        const std::size_t q = detail::multiply_high(hash, m_magic);
+        const std::size_t quotient = (((hash - q) >> 1) + q) >> m_shift;
+        
+        return (hash - quotient * m_prime) & m_mask;
+    }
+    
+    std::size_t next_bucket_count() const {
+        if(m_iprime + 1 >= detail::PRIMES.size()) {
+            throw std::length_error("The hash table exceeds its maxmimum size.");
+        }
+        
+        return detail::PRIMES[m_iprime + 1];
+    }   
+    
+    std::size_t max_bucket_count() const {
+        return detail::PRIMES.back();
+    }
+    
+    void clear() noexcept {
+        set_iprime(0);
+    }
+    
+private:
+    void set_iprime(unsigned int iprime) noexcept {
+        m_iprime = iprime;
+        m_prime = detail::PRIMES[iprime];
+        
+        if(m_prime == 1) {
+            // The quotient computation doesn't work with a divisor of 1, the mask makes the bucket always 0.
+            m_magic = 0;
+            m_shift = 0;
+            m_mask = 0;
+            
+            return;
+        }
+        
+        std::size_t log2_prime = 0;
+        while((m_prime >> (log2_prime + 1)) != 0) {
+            log2_prime++;
+        }
+        
+        m_mask = std::numeric_limits<std::size_t>::max();
+        if((m_prime & (m_prime - 1)) == 0) {
+            m_magic = 0;
+            m_shift = log2_prime - 1;
+            
+            return;
+        }
+        
+        
+        /*
+         * Compute floor(2^(NB_BITS + log2_prime) / prime) and its remainder with a long division. 
+         * The quotient fits in NB_BITS bits as prime is not a power of two.
+         */
+        std::size_t proposed_magic = 0;
+        std::size_t remainder = 0;
+        for(std::size_t ibit = NB_BITS + log2_prime + 1; ibit-- > 0;) {
+            const bool remainder_overflows = (remainder >> (NB_BITS - 1)) != 0;
+            remainder = (remainder << 1) | ((ibit == NB_BITS + log2_prime)?1:0);
+            proposed_magic <<= 1;
+            
+            if(remainder_overflows || remainder >= m_prime) {
+                remainder -= m_prime;
+                proposed_magic |= 1;
+            }
+        }
+        
+        proposed_magic += proposed_magic;
+        const std::size_t twice_remainder = remainder + remainder;
+        if(twice_remainder >= m_prime || twice_remainder < remainder) {
+            proposed_magic += 1;
+        }
+        
+        m_magic = proposed_magic + 1;
+        m_shift = log2_prime;
+    }
+    
+private:
+    static const std::size_t NB_BITS = sizeof(std::size_t) * CHAR_BIT;
+    
+    std::size_t m_prime;
+    std::size_t m_magic;
+    std::size_t m_shift;
+    std::size_t m_mask;
+    unsigned int m_iprime;
+    
+    static_assert(std::numeric_limits<decltype(m_iprime)>::max() >= detail::PRIMES.size(), 
+                  "The type of m_iprime is not big enough.");
+}; 
+
 }
 }
 
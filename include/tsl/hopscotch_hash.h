@@ -26,17 +26,21 @@
 
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <exception>
 #include <functional>
 #include <initializer_list>
 #include <iterator>
 #include <limits>
+#include <list>
 #include <memory>
 #include <stdexcept>
+#include <thread>
 #include <tuple>
 #include <type_traits>
 #include <utility>
@@ -49,6 +53,31 @@
 #    define TSL_HH_NO_RANGE_ERASE_WITH_CONST_ITERATOR
 #endif
 
+#if (defined(__GNUC__) && !defined(__clang__) && (__GNUC__ < 5))
+#    define TSL_HH_NO_IS_TRIVIALLY_COPYABLE
+#endif
+
+
+/*
+ * When StoreHash is true and AVX2 is available, find_in_buckets compares the stored truncated hashes 
+ * of the neighborhood with a gather and only checks the keys of the matching candidates. Otherwise the 
+ * candidates are checked one by one with the portable scalar loop, which stops at the first match 
+ * (without a gather, loading the hashes one by one for a SIMD comparison was slower).
+ *
+ * Define TSL_HH_NO_SIMD to use the scalar version even with AVX2 and TSL_HH_LEGACY_NEIGHBORHOOD_SCAN
+ * to use the original bit by bit scan of the neighborhood (useful to check the results of the other versions).
+ */
+#if !defined(TSL_HH_NO_SIMD) && !defined(TSL_HH_LEGACY_NEIGHBORHOOD_SCAN)
+#    if defined(__AVX2__)
+#        define TSL_HH_AVX2
+#        include <immintrin.h>
+#    endif
+#endif
+
+#if defined(_MSC_VER)
+#    include <intrin.h>
+#endif
+
 
 /*
  * Only activate tsl_hh_assert if TSL_DEBUG is defined. 
@@ -63,6 +92,197 @@
 
 
 namespace tsl {
+namespace hh {
+
+/**
+ * Layout of the buckets of the hash table (see the Layout template parameter of tsl::hopscotch_map).
+ * 
+ * With tsl::hh::aos_layout, the default, each bucket stores its metadata (neighborhood bitmap and stored hash)
+ * followed by its value. Only one cache line is usually needed to check a candidate but a neighborhood scan 
+ * has to go over the values of the neighborhood.
+ * 
+ * With tsl::hh::soa_layout, the metadata of the buckets are stored in a dense array and the values in a separate 
+ * one. The neighborhood scan only touches the metadata array, which is faster for big values (more than 32 bytes)
+ * and when StoreHash is true, at the cost of an extra cache miss to access a value.
+ */
+struct aos_layout {
+};
+
+struct soa_layout {
+};
+
+
+/**
+ * Container of the overflow elements, the elements which couldn't be placed in the neighborhood of their 
+ * bucket (see the Overflow template parameter of tsl::hopscotch_map).
+ * 
+ * With tsl::hh::list_overflow, the default, the overflow elements are stored in a std::list. Each element 
+ * needs its own allocation and a lookup in the overflow goes linearly through all of them. 
+ * 
+ * With tsl::hh::flat_overflow, the overflow elements are stored contiguously and indexed by their hash 
+ * in an open-addressed table, a lookup in the overflow only compares the keys of the elements with the 
+ * same hash. Useful when a poor hash function puts a lot of elements in the overflow. An erase leaves the
+ * other overflow elements in place, the iterators and references to them stay valid as with std::list. 
+ * But an insert which grows the array of the overflow elements moves all of them, invalidating the 
+ * iterators, references and pointers to them, unlike with std::list.
+ */
+struct list_overflow {
+};
+
+struct flat_overflow {
+};
+
+
+/**
+ * Versioning of the buckets, used for the lock-free lookups of tsl::concurrent_hopscotch_map.
+ * 
+ * With tsl::hh::no_bucket_versions, the default, the buckets have no version and a table can't be read while 
+ * it's modified.
+ * 
+ * With tsl::hh::segment_versions, the buckets are grouped in segments of 2^SegmentShift buckets and each segment 
+ * has a seqlock-style version, odd while a writer modifies a bucket of the segment. A writer bumps the versions of 
+ * the segments covering the buckets it modifies (insert_in_bucket, erase_from_bucket, swap_empty_bucket_closer, 
+ * overflow flags) and a table version around the operations touching all the buckets (rehash, clear). A reader 
+ * looks up a key in the neighborhood without any lock and retries if one of the versions it read changed.
+ * 
+ * To let a reader access a bucket array which is being replaced by a rehash, the arrays replaced by a rehash 
+ * are retired instead of being freed. The readers count themselves in a few per-thread counters while they 
+ * read and the writer frees the retired arrays at the end of a rehash, clear or later table write which finds 
+ * no reader. A rehash which wouldn't change the bucket count (e.g. a reserve of the current size) is skipped.
+ * 
+ * Only one writer may modify the table at a time and the incremental rehash is not supported. 
+ * Mainly meant to be used through tsl::concurrent_hopscotch_map.
+ */
+struct no_bucket_versions {
+};
+
+template<unsigned int SegmentShift = 6>
+struct segment_versions {
+};
+
+
+/**
+ * Collection of statistics on the hash table (see the Stats template parameter of tsl::hopscotch_map).
+ * 
+ * With tsl::hh::no_stats, the default, nothing is collected and the map has no stats() method. 
+ * 
+ * With tsl::hh::collect_stats, the map counts the events of its insertion algorithm (the tries to move an 
+ * empty bucket closer to the home bucket of the inserted value, the displacements, the insertions in the 
+ * overflow and the rehashes with their cause) and stats() returns a tsl::hh::hopscotch_stats snapshot.
+ * Counting an event is an increment of an integer in the map.
+ */
+struct no_stats {
+};
+
+struct collect_stats {
+};
+
+/**
+ * Snapshot of the statistics of a map returned by stats() (see tsl::hh::collect_stats).
+ * 
+ * The counters count the events since the construction of the map. They belong to the map object, they are 
+ * neither copied, moved nor swapped with the content of the map. The histograms describe the current content.
+ */
+struct hopscotch_stats {
+    std::size_t size = 0;
+    std::size_t bucket_count = 0;
+    std::size_t overflow_size = 0;
+    float load_factor = 0.0f;
+    
+    /**
+     * Number of calls to swap_empty_bucket_closer, trying to move an empty bucket closer to the home 
+     * bucket of a value being inserted.
+     */
+    std::uint64_t nb_swap_empty_bucket_closer = 0;
+    
+    /**
+     * Number of values moved to another bucket of their neighborhood to make room for an insertion.
+     */
+    std::uint64_t nb_displacements = 0;
+    
+    /**
+     * Number of values inserted in the overflow, their neighborhood being full.
+     */
+    std::uint64_t nb_inserts_in_overflow = 0;
+    
+    /**
+     * Number of rehashes (or starts of incremental rehash) triggered by an insert reaching the max load factor.
+     */
+    std::uint64_t nb_rehashes_on_load_factor = 0;
+    
+    /**
+     * Number of rehashes triggered by an insert in a full neighborhood, when will_neighborhood_change_on_rehash
+     * is true (instead of an insertion in the overflow).
+     */
+    std::uint64_t nb_rehashes_on_full_neighborhood = 0;
+    
+    /**
+     * neighbor_offset_histogram[i] is the number of values at the offset i from their home bucket 
+     * (NeighborhoodSize entries, the overflow values are not counted).
+     */
+    std::vector<std::size_t> neighbor_offset_histogram;
+    
+    /**
+     * neighborhood_popcount_histogram[i] is the number of buckets with i values in their neighborhood
+     * (NeighborhoodSize + 1 entries).
+     */
+    std::vector<std::size_t> neighborhood_popcount_histogram;
+    
+    /**
+     * overflow_size_histogram[i] is the number of buckets with i of their values in the overflow, 
+     * for i >= 1 (overflow_size_histogram[0] is always 0). Empty if there is no value in the overflow.
+     */
+    std::vector<std::size_t> overflow_size_histogram;
+};
+
+
+/**
+ * Key of a heterogeneous lookup with its hash already computed, e.g. a std::string_view on a network buffer 
+ * hashed while it was parsed.
+ * 
+ * The find, count, contains, erase and try_emplace methods of tsl::hopscotch_map (and the lookups and erase 
+ * of tsl::hopscotch_set) accept a hashed_key when KeyEqual has an `is_transparent` member. They use 
+ * hash() instead of hashing key() and compare key() with the stored keys without constructing a key_type. 
+ * try_emplace only constructs the key_type from key() if it inserts a new value.
+ * 
+ * hash() must be equal to `hash_function()(key())` of the map.
+ * 
+ * The key is stored by value, K is expected to be a cheap to copy view type.
+ */
+template<class K>
+class hashed_key {
+public:
+    hashed_key(const K& key, std::size_t hash) noexcept(std::is_nothrow_copy_constructible<K>::value): 
+                                                    m_key(key), m_hash(hash)
+    {
+    }
+    
+    const K& key() const noexcept { return m_key; }
+    std::size_t hash() const noexcept { return m_hash; }
+    
+private:
+    K m_key;
+    std::size_t m_hash;
+};
+
+
+/**
+ * Tag selecting the bulk constructors of tsl::hopscotch_map and tsl::hopscotch_set, for tables built once 
+ * from a known set of values and then mostly read.
+ * 
+ * Instead of inserting the values one by one, a bulk constructor sizes the table once, sorts the values 
+ * by home bucket and writes them in their buckets in one sequential pass, without any displacement. 
+ * The values must come from random access iterators dereferencing to the value_type, otherwise the 
+ * constructor is the same as the range constructor.
+ */
+struct bulk_construct_t {
+    explicit bulk_construct_t() = default;
+};
+
+static constexpr bulk_construct_t bulk_construct{};
+
+}
+
 
 namespace detail_hopscotch_hash {
     
@@ -91,6 +311,15 @@ struct has_key_compare<T, typename make_void<typename T::key_compare>::type> : s
 };
 
 
+template<typename T, typename = void>
+struct has_hashed_lookup : std::false_type {
+};
+
+template<typename T>
+struct has_hashed_lookup<T, typename make_void<typename T::hashed_lookup>::type> : std::true_type {
+};
+
+
 template<typename U>
 struct is_power_of_two_policy: std::false_type {
 };
@@ -99,6 +328,26 @@ template<std::size_t GrowthFactor>
 struct is_power_of_two_policy<tsl::hh::power_of_two_growth_policy<GrowthFactor>>: std::true_type {
 };
 
+template<std::size_t GrowthFactor>
+struct is_power_of_two_policy<tsl::hh::fibonacci_power_of_two_growth_policy<GrowthFactor>>: std::true_type {
+};
+
+
+/*
+ * std::is_trivially_copyable, or the stricter std::is_trivial with the standard libraries which don't 
+ * provide it (GCC < 5). The types it rejects only lose the lock-free lookups of tsl::concurrent_hopscotch_map 
+ * and the mapped format.
+ */
+template<typename T>
+struct is_trivially_copyable: 
+#ifdef TSL_HH_NO_IS_TRIVIALLY_COPYABLE
+    std::is_trivial<T>
+#else
+    std::is_trivially_copyable<T>
+#endif
+{
+};
+
 
 
 
@@ -134,7 +383,103 @@ class smallest_type_for_min_bits<MinBits, typename std::enable_if<(MinBits > 32)
 public:
     using type = std::uint_least64_t;
 };
+
+
+/*
+ * Return the index of the least significant bit set to 1 in value. Value must not be 0.
+ */
+inline std::size_t count_trailing_zeros(std::uint64_t value) noexcept {
+    tsl_hh_assert(value != 0);
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<std::size_t>(__builtin_ctzll(value));
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<std::size_t>(index);
+#else
+    std::size_t index = 0;
+    while((value & 1) == 0) {
+        value >>= 1;
+        index++;
+    }
+
+    return index;
+#endif
+}
+
+/*
+ * Return the number of bits needed to represent value, i.e. the index of its most significant bit set to 1 plus one.
+ * Return 0 if value is 0.
+ */
+inline std::size_t bit_width(std::uint64_t value) noexcept {
+    if(value == 0) {
+        return 0;
+    }
+
+#if defined(__GNUC__) || defined(__clang__)
+    return 64 - static_cast<std::size_t>(__builtin_clzll(value));
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<std::size_t>(index) + 1;
+#else
+    std::size_t width = 0;
+    while(value != 0) {
+        value >>= 1;
+        width++;
+    }
+
+    return width;
+#endif
+}
+
+/*
+ * Hint the CPU to load the cache line containing address in the caches for a future read.
+ */
+inline void prefetch_for_read(const void* address) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+    (void) address;
+#endif
+}
+
+/*
+ * Default executor of rehash_parallel and parallel_for_each. Run task(0) in the calling thread and 
+ * the other tasks in nb_tasks - 1 new threads, return once all the tasks are complete.
+ */
+class thread_executor {
+public:
+    template<class Task>
+    void operator()(std::size_t nb_tasks, const Task& task) const {
+        std::vector<std::thread> threads;
+        threads.reserve(nb_tasks);
         
+        try {
+            for(std::size_t itask = 1; itask < nb_tasks; itask++) {
+                threads.emplace_back(std::cref(task), itask);
+            }
+            
+            task(0);
+        }
+        catch(...) {
+            join_all(threads);
+            throw;
+        }
+        
+        join_all(threads);
+    }
+    
+private:
+    static void join_all(std::vector<std::thread>& threads) {
+        for(std::thread& thread: threads) {
+            thread.join();
+        }
+    }
+};
+
 
 
 /*
@@ -185,14 +530,24 @@ protected:
 template<>
 class hopscotch_bucket_hash<true> {
 public:
+    hopscotch_bucket_hash() noexcept: m_hash(0) {
+    }
+
     bool bucket_hash_equal(std::size_t hash) const noexcept {
         return m_hash == truncated_hash_type(hash);
     }
-    
+
     truncated_hash_type truncated_bucket_hash() const noexcept {
         return m_hash;
     }
-    
+
+    /**
+     * Address of the stored hash, used to load the hashes of a whole neighborhood at once.
+     */
+    const truncated_hash_type* truncated_bucket_hash_address() const noexcept {
+        return &m_hash;
+    }
+
 protected:    
     void copy_hash(const hopscotch_bucket_hash& bucket) noexcept {
         m_hash = bucket.m_hash;
@@ -207,8 +562,15 @@ private:
 };
 
 
-template<typename ValueType, unsigned int NeighborhoodSize, bool StoreHash>
-class hopscotch_bucket: public hopscotch_bucket_hash<StoreHash> {
+/**
+ * Metadata of a bucket: the neighborhood bitmap and, if StoreHash is true, the truncated hash of the value
+ * in the bucket.
+ *
+ * With the tsl::hh::aos_layout, it is the base of hopscotch_bucket which adds the value storage. With the 
+ * tsl::hh::soa_layout, the metadata of all the buckets are stored in their own array and the values in another.
+ */
+template<unsigned int NeighborhoodSize, bool StoreHash>
+class hopscotch_bucket_infos: public hopscotch_bucket_hash<StoreHash> {
 private:
     static const std::size_t MIN_NEIGHBORHOOD_SIZE = 4;
     static const std::size_t MAX_NEIGHBORHOOD_SIZE = SMALLEST_TYPE_MAX_BITS_SUPPORTED - NB_RESERVED_BITS_IN_NEIGHBORHOOD; 
@@ -231,63 +593,14 @@ private:
     using bucket_hash = hopscotch_bucket_hash<StoreHash>;
     
 public:
-    using value_type = ValueType;
     using neighborhood_bitmap = 
                 typename smallest_type_for_min_bits<NeighborhoodSize + NB_RESERVED_BITS_IN_NEIGHBORHOOD>::type;
 
 
-    hopscotch_bucket() noexcept: bucket_hash(), m_neighborhood_infos(0) {
+    hopscotch_bucket_infos() noexcept: bucket_hash(), m_neighborhood_infos(0) {
         tsl_hh_assert(empty());
     }
     
-    
-    hopscotch_bucket(const hopscotch_bucket& bucket) 
-        noexcept(std::is_nothrow_copy_constructible<value_type>::value): bucket_hash(bucket), 
-                                                                         m_neighborhood_infos(0) 
-    {
-        if(!bucket.empty()) {
-            ::new (static_cast<void*>(std::addressof(m_value))) value_type(bucket.value());
-        }
-        
-        m_neighborhood_infos = bucket.m_neighborhood_infos;
-    }
-    
-    hopscotch_bucket(hopscotch_bucket&& bucket)
-        noexcept(std::is_nothrow_move_constructible<value_type>::value) : bucket_hash(std::move(bucket)),
-                                                                          m_neighborhood_infos(0) 
-    {
-        if(!bucket.empty()) {
-            ::new (static_cast<void*>(std::addressof(m_value))) value_type(std::move(bucket.value()));
-        }
-        
-        m_neighborhood_infos = bucket.m_neighborhood_infos;
-    }
-     
-    hopscotch_bucket& operator=(const hopscotch_bucket& bucket) 
-        noexcept(std::is_nothrow_copy_constructible<value_type>::value) 
-    {
-        if(this != &bucket) {
-            remove_value();
-            
-            bucket_hash::operator=(bucket);
-            if(!bucket.empty()) {
-                ::new (static_cast<void*>(std::addressof(m_value))) value_type(bucket.value());
-            }
-            
-            m_neighborhood_infos = bucket.m_neighborhood_infos;
-        }
-        
-        return *this;
-    }
-    
-    hopscotch_bucket& operator=(hopscotch_bucket&& ) = delete;
-     
-    ~hopscotch_bucket() noexcept {
-        if(!empty()) {
-            destroy_value();
-        }
-    }
-    
     neighborhood_bitmap neighborhood_infos() const noexcept {
         return neighborhood_bitmap(m_neighborhood_infos >> NB_RESERVED_BITS_IN_NEIGHBORHOOD);
     }
@@ -324,58 +637,11 @@ public:
         return false;
     }
     
-    value_type& value() noexcept {
-        tsl_hh_assert(!empty());
-        return *reinterpret_cast<value_type*>(std::addressof(m_value));
-    }
-    
-    const value_type& value() const noexcept {
-        tsl_hh_assert(!empty());
-        return *reinterpret_cast<const value_type*>(std::addressof(m_value));
-    }
-    
-    template<typename... Args>
-    void set_value_of_empty_bucket(truncated_hash_type hash, Args&&... value_type_args) {
-        tsl_hh_assert(empty());
-        
-        ::new (static_cast<void*>(std::addressof(m_value))) value_type(std::forward<Args>(value_type_args)...);
-        set_empty(false);
-        this->set_hash(hash);
-    }
-    
-    void swap_value_into_empty_bucket(hopscotch_bucket& empty_bucket) {
-        tsl_hh_assert(empty_bucket.empty());
-        if(!empty()) {
-            ::new (static_cast<void*>(std::addressof(empty_bucket.m_value))) value_type(std::move(value()));
-            empty_bucket.copy_hash(*this);
-            empty_bucket.set_empty(false);
-            
-            destroy_value();
-            set_empty(true);
-        }
-    }
-    
-    void remove_value() noexcept {
-        if(!empty()) {
-            destroy_value();
-            set_empty(true);
-        }
-    }
-    
-    void clear() noexcept {
-        if(!empty()) {
-            destroy_value();
-        }
-        
-        m_neighborhood_infos = 0;
-        tsl_hh_assert(empty());
-    }
-    
     static truncated_hash_type truncate_hash(std::size_t hash) noexcept {
         return truncated_hash_type(hash);
     }
     
-private:
+protected:
     void set_empty(bool is_empty) noexcept {
         if(is_empty) {
             m_neighborhood_infos = neighborhood_bitmap(m_neighborhood_infos & ~1);
@@ -385,961 +651,4279 @@ private:
         }
     }
     
-    void destroy_value() noexcept {
-        tsl_hh_assert(!empty());
-        value().~value_type();
-    }
+    void clear_infos() noexcept {
+        m_neighborhood_infos = 0;
+        tsl_hh_assert(empty());
+    }
+    
+    template<class, unsigned int, bool, class, class>
+    friend class hopscotch_buckets_storage;
+    
+    neighborhood_bitmap m_neighborhood_infos;
+};
+
+
+template<typename ValueType, unsigned int NeighborhoodSize, bool StoreHash>
+class hopscotch_bucket: public hopscotch_bucket_infos<NeighborhoodSize, StoreHash> {
+private:
+    using bucket_infos = hopscotch_bucket_infos<NeighborhoodSize, StoreHash>;
+    
+public:
+    using value_type = ValueType;
+    using neighborhood_bitmap = typename bucket_infos::neighborhood_bitmap;
+
+
+    hopscotch_bucket() noexcept: bucket_infos() {
+        tsl_hh_assert(this->empty());
+    }
+    
+    
+    hopscotch_bucket(const hopscotch_bucket& bucket) 
+        noexcept(std::is_nothrow_copy_constructible<value_type>::value): bucket_infos() 
+    {
+        if(!bucket.empty()) {
+            ::new (static_cast<void*>(std::addressof(m_value))) value_type(bucket.value());
+        }
+        
+        bucket_infos::operator=(bucket);
+    }
+    
+    hopscotch_bucket(hopscotch_bucket&& bucket)
+        noexcept(std::is_nothrow_move_constructible<value_type>::value) : bucket_infos() 
+    {
+        if(!bucket.empty()) {
+            ::new (static_cast<void*>(std::addressof(m_value))) value_type(std::move(bucket.value()));
+        }
+        
+        bucket_infos::operator=(bucket);
+    }
+     
+    hopscotch_bucket& operator=(const hopscotch_bucket& bucket) 
+        noexcept(std::is_nothrow_copy_constructible<value_type>::value) 
+    {
+        if(this != &bucket) {
+            remove_value();
+            
+            if(!bucket.empty()) {
+                ::new (static_cast<void*>(std::addressof(m_value))) value_type(bucket.value());
+            }
+            
+            bucket_infos::operator=(bucket);
+        }
+        
+        return *this;
+    }
+    
+    hopscotch_bucket& operator=(hopscotch_bucket&& ) = delete;
+     
+    ~hopscotch_bucket() noexcept {
+        if(!this->empty()) {
+            destroy_value();
+        }
+    }
+    
+    value_type& value() noexcept {
+        tsl_hh_assert(!this->empty());
+        return *reinterpret_cast<value_type*>(std::addressof(m_value));
+    }
+    
+    const value_type& value() const noexcept {
+        tsl_hh_assert(!this->empty());
+        return *reinterpret_cast<const value_type*>(std::addressof(m_value));
+    }
+    
+    /**
+     * Address of the value even if the bucket is empty, for the optimistic lookups which may read a bucket 
+     * emptied concurrently by a writer (see tsl::hh::segment_versions).
+     */
+    const value_type* value_address() const noexcept {
+        return reinterpret_cast<const value_type*>(std::addressof(m_value));
+    }
+    
+    template<typename... Args>
+    void set_value_of_empty_bucket(truncated_hash_type hash, Args&&... value_type_args) {
+        tsl_hh_assert(this->empty());
+        
+        ::new (static_cast<void*>(std::addressof(m_value))) value_type(std::forward<Args>(value_type_args)...);
+        this->set_empty(false);
+        this->set_hash(hash);
+    }
+    
+    void swap_value_into_empty_bucket(hopscotch_bucket& empty_bucket) {
+        tsl_hh_assert(empty_bucket.empty());
+        if(!this->empty()) {
+            ::new (static_cast<void*>(std::addressof(empty_bucket.m_value))) value_type(std::move(value()));
+            empty_bucket.copy_hash(*this);
+            empty_bucket.set_empty(false);
+            
+            destroy_value();
+            this->set_empty(true);
+        }
+    }
+    
+    void remove_value() noexcept {
+        if(!this->empty()) {
+            destroy_value();
+            this->set_empty(true);
+        }
+    }
+    
+    void clear() noexcept {
+        if(!this->empty()) {
+            destroy_value();
+        }
+        
+        this->clear_infos();
+    }
+    
+private:
+    void destroy_value() noexcept {
+        tsl_hh_assert(!this->empty());
+        value().~value_type();
+    }
     
 private:
     using storage = typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type;
     
-    neighborhood_bitmap m_neighborhood_infos;
     storage m_value;
 };
 
 
-/**
- * Internal common class used by (b)hopscotch_map and (b)hopscotch_set.
- * 
- * ValueType is what will be stored by hopscotch_hash (usually std::pair<Key, T> for a map and Key for a set).
- * 
- * KeySelect should be a FunctionObject which takes a ValueType in parameter and returns a reference to the key.
- * 
- * ValueSelect should be a FunctionObject which takes a ValueType in parameter and returns a reference to the value.
- * ValueSelect should be void if there is no value (in a set for example).
+
+/*
+ * The buckets storage of hopscotch_hash. The Layout tag selects how the buckets are stored (see tsl::hh::aos_layout 
+ * and tsl::hh::soa_layout).
  * 
- * OverflowContainer will be used as containers for overflown elements. Usually it should be a list<ValueType>
- * or a set<Key>/map<Key, T>.
+ * The storage gives access to an array of 'bucket_type', each with the metadata of a bucket (neighborhood bitmap, 
+ * stored hash, ...), through 'data()' and to the value in the bucket through 'value(ibucket)'. The values must be
+ * modified through the storage methods. 'iterator' and 'const_iterator' iterate over the buckets and give access
+ * to the 'empty()' and 'value()' methods of a bucket through 'operator->()'.
  */
-template<class ValueType,
-         class KeySelect,
-         class ValueSelect,
-         class Hash,
-         class KeyEqual,
-         class Allocator,
-         unsigned int NeighborhoodSize,
-         bool StoreHash,
-         class GrowthPolicy,
-         class OverflowContainer>
-class hopscotch_hash: private Hash, private KeyEqual, private GrowthPolicy {
-private:
-    template<typename U>
-    using has_mapped_type = typename std::integral_constant<bool, !std::is_same<U, void>::value>;
-    
-    static_assert(noexcept(std::declval<GrowthPolicy>().bucket_for_hash(std::size_t(0))), "GrowthPolicy::bucket_for_hash must be noexcept.");
-    static_assert(noexcept(std::declval<GrowthPolicy>().clear()), "GrowthPolicy::clear must be noexcept.");
-    
+template<class ValueType, unsigned int NeighborhoodSize, bool StoreHash, class Allocator, class Layout>
+class hopscotch_buckets_storage;
+
+
+/*
+ * Array of structures, the value of a bucket is stored right after its metadata in a std::vector of hopscotch_bucket.
+ */
+template<class ValueType, unsigned int NeighborhoodSize, bool StoreHash, class Allocator>
+class hopscotch_buckets_storage<ValueType, NeighborhoodSize, StoreHash, Allocator, tsl::hh::aos_layout> {
 public:
-    template<bool IsConst>
-    class hopscotch_iterator;
-    
-    using key_type = typename KeySelect::key_type;
     using value_type = ValueType;
+    using bucket_type = hopscotch_bucket<ValueType, NeighborhoodSize, StoreHash>;
     using size_type = std::size_t;
-    using difference_type = std::ptrdiff_t;
-    using hasher = Hash;
-    using key_equal = KeyEqual;
-    using allocator_type = Allocator;
-    using reference = value_type&;
-    using const_reference = const value_type&;
-    using pointer = value_type*;
-    using const_pointer = const value_type*;
-    using iterator = hopscotch_iterator<false>;
-    using const_iterator = hopscotch_iterator<true>;
     
 private:
-    using hopscotch_bucket = tsl::detail_hopscotch_hash::hopscotch_bucket<ValueType, NeighborhoodSize, StoreHash>;
-    using neighborhood_bitmap = typename hopscotch_bucket::neighborhood_bitmap;
+    using buckets_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<bucket_type>;
+    using buckets_container_type = std::vector<bucket_type, buckets_allocator>;
     
-    using buckets_allocator = typename std::allocator_traits<allocator_type>::template rebind_alloc<hopscotch_bucket>;
-    using buckets_container_type = std::vector<hopscotch_bucket, buckets_allocator>;  
+public:
+    using allocator_type = buckets_allocator;
+    using iterator = typename buckets_container_type::iterator;
+    using const_iterator = typename buckets_container_type::const_iterator;
     
-    using overflow_container_type = OverflowContainer;
     
-    static_assert(std::is_same<typename overflow_container_type::value_type, ValueType>::value, 
-                  "OverflowContainer should have ValueType as type.");
+    explicit hopscotch_buckets_storage(const Allocator& alloc): m_buckets(alloc) {
+    }
     
-    static_assert(std::is_same<typename overflow_container_type::allocator_type, Allocator>::value, 
-                  "Invalid allocator, not the same type as the value_type.");
+    allocator_type get_allocator() const {
+        return m_buckets.get_allocator();
+    }
+    
+    /**
+     * Only called on an empty storage.
+     */
+    void resize(size_type count) {
+        tsl_hh_assert(m_buckets.empty());
+        
+        // Can't directly construct with the appropriate size in the initializer 
+        // as m_buckets_data(bucket_count, alloc) is not supported by GCC 4.8
+        m_buckets.resize(count);
+    }
     
+    /**
+     * Remove all the values and free the buckets, the storage has a size of 0 afterwards.
+     */
+    void clear() noexcept {
+        m_buckets.clear();
+    }
     
-    using iterator_buckets = typename buckets_container_type::iterator; 
-    using const_iterator_buckets = typename buckets_container_type::const_iterator;
+    /**
+     * Remove all the values and reset the metadata of the buckets, the size of the storage doesn't change.
+     */
+    void clear_buckets() noexcept {
+        for(auto& bucket: m_buckets) {
+            bucket.clear();
+        }
+    }
     
-    using iterator_overflow = typename overflow_container_type::iterator; 
-    using const_iterator_overflow = typename overflow_container_type::const_iterator; 
+    void swap(hopscotch_buckets_storage& other) {
+        using std::swap;
+        swap(m_buckets, other.m_buckets);
+    }
+    
+    bool empty() const noexcept { return m_buckets.empty(); }
+    size_type size() const noexcept { return m_buckets.size(); }
+    size_type max_size() const noexcept { return m_buckets.max_size(); }
+    
+    bucket_type* data() noexcept { return m_buckets.data(); }
+    const bucket_type* data() const noexcept { return m_buckets.data(); }
+    
+    iterator begin() noexcept { return m_buckets.begin(); }
+    const_iterator cbegin() const noexcept { return m_buckets.cbegin(); }
+    iterator end() noexcept { return m_buckets.end(); }
+    const_iterator cend() const noexcept { return m_buckets.cend(); }
+    
+    value_type& value(size_type ibucket) noexcept {
+        return m_buckets[ibucket].value();
+    }
+    
+    const value_type& value(size_type ibucket) const noexcept {
+        return m_buckets[ibucket].value();
+    }
     
-public:    
     /**
-     * The `operator*()` and `operator->()` methods return a const reference and const pointer respectively to the 
-     * stored value type.
-     * 
-     * In case of a map, to get a modifiable reference to the value associated to a key (the `.second` in the 
-     * stored pair), you have to call `value()`.
+     * Prefetch the bucket ibucket for a future lookup.
      */
-    template<bool IsConst>
-    class hopscotch_iterator {
-        friend class hopscotch_hash;
+    void prefetch(size_type ibucket) const noexcept {
+        tsl_hh_assert(ibucket < m_buckets.size());
+        prefetch_for_read(m_buckets.data() + ibucket);
+    }
+    
+    template<typename... Args>
+    void set_value_of_empty_bucket(size_type ibucket, truncated_hash_type hash, Args&&... value_type_args) {
+        m_buckets[ibucket].set_value_of_empty_bucket(hash, std::forward<Args>(value_type_args)...);
+    }
+    
+    void swap_value_into_empty_bucket(size_type ibucket, size_type ibucket_empty) {
+        m_buckets[ibucket].swap_value_into_empty_bucket(m_buckets[ibucket_empty]);
+    }
+    
+    void remove_value(size_type ibucket) noexcept {
+        m_buckets[ibucket].remove_value();
+    }
+    
+    /**
+     * Raw access to the buckets for the optimistic lookups (see tsl::hh::segment_versions), 
+     * 'buckets' is the pointer to the metadata of the buckets used by hopscotch_hash.
+     */
+    class read_view {
+    public:
+        explicit read_view(const bucket_type* buckets) noexcept: m_buckets(buckets) {
+        }
+        
+        const bucket_type& bucket(size_type ibucket) const noexcept { return m_buckets[ibucket]; }
+        const value_type& value(size_type ibucket) const noexcept { return *m_buckets[ibucket].value_address(); }
+    
     private:
-        using iterator_bucket = typename std::conditional<IsConst, 
-                                                            typename hopscotch_hash::const_iterator_buckets, 
-                                                            typename hopscotch_hash::iterator_buckets>::type;
-        using iterator_overflow = typename std::conditional<IsConst, 
-                                                            typename hopscotch_hash::const_iterator_overflow, 
-                                                            typename hopscotch_hash::iterator_overflow>::type;
+        const bucket_type* m_buckets;
+    };
+    
+    read_view make_read_view(const bucket_type* buckets) const noexcept {
+        return read_view(buckets);
+    }
+    
+private:
+    buckets_container_type m_buckets;
+};
+
+
+/*
+ * Structure of arrays, the metadata of the buckets are stored in a std::vector of hopscotch_bucket_infos 
+ * and the values in a separate array of the same size.
+ * 
+ * A neighborhood scan only reads the dense metadata array (the stored hashes are next to the bitmaps), 
+ * the values array is only accessed for the candidates.
+ */
+template<class ValueType, unsigned int NeighborhoodSize, bool StoreHash, class Allocator>
+class hopscotch_buckets_storage<ValueType, NeighborhoodSize, StoreHash, Allocator, tsl::hh::soa_layout>:
+                    private std::allocator_traits<Allocator>::template rebind_alloc<ValueType> 
+{
+public:
+    using value_type = ValueType;
+    using bucket_type = hopscotch_bucket_infos<NeighborhoodSize, StoreHash>;
+    using size_type = std::size_t;
+    
+private:
+    using values_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<ValueType>;
+    using values_allocator_traits = std::allocator_traits<values_allocator>;
+    using values_pointer = typename values_allocator_traits::pointer;
+    
+    using buckets_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<bucket_type>;
+    using buckets_container_type = std::vector<bucket_type, buckets_allocator>;
     
+public:
+    using allocator_type = buckets_allocator;
+    
+    template<bool IsConst>
+    class buckets_iterator {
+        friend class hopscotch_buckets_storage;
         
-        hopscotch_iterator(iterator_bucket buckets_iterator, iterator_bucket buckets_end_iterator, 
-                           iterator_overflow overflow_iterator) noexcept : 
-            m_buckets_iterator(buckets_iterator), m_buckets_end_iterator(buckets_end_iterator),
-            m_overflow_iterator(overflow_iterator)
-        {
+    private:
+        using bucket_pointer = typename std::conditional<IsConst, const bucket_type*, bucket_type*>::type;
+        using value_pointer = typename std::conditional<IsConst, const value_type*, value_type*>::type;
+        
+        buckets_iterator(bucket_pointer bucket, value_pointer value) noexcept: m_bucket(bucket), m_value(value) {
         }
         
     public:
-        using iterator_category = std::forward_iterator_tag;
-        using value_type = const typename hopscotch_hash::value_type;
         using difference_type = std::ptrdiff_t;
-        using reference = value_type&;
-        using pointer = value_type*;
         
-        
-        hopscotch_iterator() noexcept {
+        buckets_iterator() noexcept: m_bucket(nullptr), m_value(nullptr) {
         }
         
         // Copy constructor from iterator to const_iterator.
         template<bool TIsConst = IsConst, typename std::enable_if<TIsConst>::type* = nullptr>
-        hopscotch_iterator(const hopscotch_iterator<!TIsConst>& other) noexcept :
-            m_buckets_iterator(other.m_buckets_iterator), m_buckets_end_iterator(other.m_buckets_end_iterator),
-            m_overflow_iterator(other.m_overflow_iterator)
+        buckets_iterator(const buckets_iterator<!TIsConst>& other) noexcept: m_bucket(other.m_bucket), 
+                                                                             m_value(other.m_value)
         {
         }
-
-        hopscotch_iterator(const hopscotch_iterator& other) = default;
-        hopscotch_iterator(hopscotch_iterator&& other) = default;
-        hopscotch_iterator& operator=(const hopscotch_iterator& other) = default;
-        hopscotch_iterator& operator=(hopscotch_iterator&& other) = default;
         
-        const typename hopscotch_hash::key_type& key() const {
-            if(m_buckets_iterator != m_buckets_end_iterator) {
-                return KeySelect()(m_buckets_iterator->value());
-            }
-            
-            return KeySelect()(*m_overflow_iterator);
+        /**
+         * Give access to empty() and value() of the bucket pointed by the iterator with 'it->empty()' 
+         * and 'it->value()', like a std::vector<hopscotch_bucket>::iterator.
+         */
+        const buckets_iterator* operator->() const noexcept {
+            return this;
         }
-
-        template<class U = ValueSelect, typename std::enable_if<has_mapped_type<U>::value>::type* = nullptr>
-        typename std::conditional<
-                        IsConst, 
-                        const typename U::value_type&, 
-                        typename U::value_type&>::type value() const
-        {
-            if(m_buckets_iterator != m_buckets_end_iterator) {
-                return U()(m_buckets_iterator->value());
-            }
-            
-            return U()(*m_overflow_iterator);
+        
+        bool empty() const noexcept {
+            return m_bucket->empty();
         }
         
-        reference operator*() const { 
-            if(m_buckets_iterator != m_buckets_end_iterator) {
-                return m_buckets_iterator->value();
-            }
-            
-            return *m_overflow_iterator;
+        typename std::conditional<IsConst, const value_type&, value_type&>::type value() const noexcept {
+            tsl_hh_assert(!empty());
+            return *m_value;
         }
         
-        pointer operator->() const { 
-            if(m_buckets_iterator != m_buckets_end_iterator) {
-                return std::addressof(m_buckets_iterator->value()); 
-            }
+        buckets_iterator& operator++() noexcept {
+            ++m_bucket;
+            ++m_value;
             
-            return std::addressof(*m_overflow_iterator); 
+            return *this;
         }
         
-        hopscotch_iterator& operator++() {
-            if(m_buckets_iterator == m_buckets_end_iterator) {
-                ++m_overflow_iterator;
-                return *this;
-            }
-            
-            do {
-                ++m_buckets_iterator;
-            } while(m_buckets_iterator != m_buckets_end_iterator && m_buckets_iterator->empty());
-            
-            return *this; 
+        buckets_iterator operator+(difference_type n) const noexcept {
+            return buckets_iterator(m_bucket + n, m_value + n);
         }
         
-        hopscotch_iterator operator++(int) {
-            hopscotch_iterator tmp(*this);
-            ++*this;
-            
-            return tmp;
+        friend difference_type operator-(const buckets_iterator& lhs, const buckets_iterator& rhs) noexcept {
+            return lhs.m_bucket - rhs.m_bucket;
         }
         
-        friend bool operator==(const hopscotch_iterator& lhs, const hopscotch_iterator& rhs) { 
-            return lhs.m_buckets_iterator == rhs.m_buckets_iterator && 
-                   lhs.m_overflow_iterator == rhs.m_overflow_iterator; 
+        friend bool operator==(const buckets_iterator& lhs, const buckets_iterator& rhs) noexcept { 
+            return lhs.m_bucket == rhs.m_bucket; 
         }
         
-        friend bool operator!=(const hopscotch_iterator& lhs, const hopscotch_iterator& rhs) { 
+        friend bool operator!=(const buckets_iterator& lhs, const buckets_iterator& rhs) noexcept { 
             return !(lhs == rhs); 
         }
         
     private:
-        iterator_bucket m_buckets_iterator;
-        iterator_bucket m_buckets_end_iterator;
-        iterator_overflow m_overflow_iterator;
+        bucket_pointer m_bucket;
+        value_pointer m_value;
     };
     
-public:
-    template<class OC = OverflowContainer, typename std::enable_if<!has_key_compare<OC>::value>::type* = nullptr>
-    hopscotch_hash(size_type bucket_count, 
-                  const Hash& hash,
-                  const KeyEqual& equal,
-                  const Allocator& alloc,
-                  float max_load_factor) :  Hash(hash),
-                                            KeyEqual(equal),
-                                            GrowthPolicy(bucket_count),
-                                            m_buckets_data(alloc), 
-                                            m_overflow_elements(alloc),
-                                            m_buckets(static_empty_bucket_ptr()),
-                                            m_nb_elements(0)
+    using iterator = buckets_iterator<false>;
+    using const_iterator = buckets_iterator<true>;
+    
+    
+    explicit hopscotch_buckets_storage(const Allocator& alloc): values_allocator(alloc), 
+                                                                m_buckets(alloc), m_values(nullptr) 
     {
-        if(bucket_count > max_bucket_count()) {
-            throw std::length_error("The map exceeds its maxmimum size.");
-        }
-        
-        if(bucket_count > 0) {
-            static_assert(NeighborhoodSize - 1 > 0, "");
-            
-            // Can't directly construct with the appropriate size in the initializer 
-            // as m_buckets_data(bucket_count, alloc) is not supported by GCC 4.8
-            m_buckets_data.resize(bucket_count + NeighborhoodSize - 1);
-            m_buckets = m_buckets_data.data();
-        }
-        
-        
-        this->max_load_factor(max_load_factor);
-        
-        
-        // Check in the constructor instead of outside of a function to avoi compilation issues
-        // when value_type is not complete.
-        static_assert(std::is_nothrow_move_constructible<value_type>::value || 
-                      std::is_copy_constructible<value_type>::value, 
-                      "value_type must be either copy constructible or nothrow move constructible.");
     }
     
-    template<class OC = OverflowContainer, typename std::enable_if<has_key_compare<OC>::value>::type* = nullptr>
-    hopscotch_hash(size_type bucket_count, 
-                  const Hash& hash,
-                  const KeyEqual& equal,
-                  const Allocator& alloc,
-                  float max_load_factor,
-                  const typename OC::key_compare& comp) : Hash(hash),
-                                                          KeyEqual(equal),
-                                                          GrowthPolicy(bucket_count),
-                                                          m_buckets_data(alloc), 
-                                                          m_overflow_elements(comp, alloc),
-                                                          m_buckets(static_empty_bucket_ptr()),
-                                                          m_nb_elements(0)
+    hopscotch_buckets_storage(const hopscotch_buckets_storage& other): 
+                values_allocator(values_allocator_traits::select_on_container_copy_construction(other.get_values_allocator())),
+                m_buckets(other.m_buckets), m_values(nullptr)
     {
-        
-        if(bucket_count > max_bucket_count()) {
-            throw std::length_error("The map exceeds its maxmimum size.");
+        if(m_buckets.empty()) {
+            return;
         }
         
-        if(bucket_count > 0) {
-            static_assert(NeighborhoodSize - 1 > 0, "");
+        m_values = allocate_values(m_buckets.size());
+        
+        size_type ibucket = 0;
+        try {
+            for(; ibucket < m_buckets.size(); ibucket++) {
+                if(!m_buckets[ibucket].empty()) {
+                    values_allocator_traits::construct(get_values_allocator(), m_values + ibucket, 
+                                                       other.m_values[ibucket]);
+                }
+            }
+        }
+        catch(...) {
+            // Only the values before ibucket were constructed.
+            for(size_type ibucket_constructed = 0; ibucket_constructed < ibucket; ibucket_constructed++) {
+                if(!m_buckets[ibucket_constructed].empty()) {
+                    values_allocator_traits::destroy(get_values_allocator(), m_values + ibucket_constructed);
+                }
+            }
             
-            // Can't directly construct with the appropriate size in the initializer 
-            // as m_buckets_data(bucket_count, alloc) is not supported by GCC 4.8
-            m_buckets_data.resize(bucket_count + NeighborhoodSize - 1);
-            m_buckets = m_buckets_data.data();
+            deallocate_values(m_values, m_buckets.size());
+            throw;
         }
-        
-        
-        this->max_load_factor(max_load_factor);
-        
-        
-        // Check in the constructor instead of outside of a function to avoi compilation issues
-        // when value_type is not complete.
-        static_assert(std::is_nothrow_move_constructible<value_type>::value || 
-                      std::is_copy_constructible<value_type>::value, 
-                      "value_type must be either copy constructible or nothrow move constructible.");
-    }
-    
-    hopscotch_hash(const hopscotch_hash& other): 
-                          Hash(other),
-                          KeyEqual(other),
-                          GrowthPolicy(other),
-                          m_buckets_data(other.m_buckets_data),
-                          m_overflow_elements(other.m_overflow_elements),
-                          m_buckets(m_buckets_data.empty()?static_empty_bucket_ptr():
-                                                           m_buckets_data.data()),
-                          m_nb_elements(other.m_nb_elements),
-                          m_max_load_factor(other.m_max_load_factor),
-                          m_max_load_threshold_rehash(other.m_max_load_threshold_rehash),
-                          m_min_load_threshold_rehash(other.m_min_load_threshold_rehash) 
-    {
     }
     
-    hopscotch_hash(hopscotch_hash&& other) 
-                        noexcept(
-                            std::is_nothrow_move_constructible<Hash>::value &&
-                            std::is_nothrow_move_constructible<KeyEqual>::value &&
-                            std::is_nothrow_move_constructible<GrowthPolicy>::value &&
-                            std::is_nothrow_move_constructible<buckets_container_type>::value &&
-                            std::is_nothrow_move_constructible<overflow_container_type>::value
-                        ):
-                          Hash(std::move(static_cast<Hash&>(other))),
-                          KeyEqual(std::move(static_cast<KeyEqual&>(other))),
-                          GrowthPolicy(std::move(static_cast<GrowthPolicy&>(other))),
-                          m_buckets_data(std::move(other.m_buckets_data)),
-                          m_overflow_elements(std::move(other.m_overflow_elements)),
-                          m_buckets(m_buckets_data.empty()?static_empty_bucket_ptr():
-                                                           m_buckets_data.data()),
-                          m_nb_elements(other.m_nb_elements),
-                          m_max_load_factor(other.m_max_load_factor),
-                          m_max_load_threshold_rehash(other.m_max_load_threshold_rehash),
-                          m_min_load_threshold_rehash(other.m_min_load_threshold_rehash)
+    hopscotch_buckets_storage(hopscotch_buckets_storage&& other) noexcept: 
+                values_allocator(std::move(other.get_values_allocator())),
+                m_buckets(std::move(other.m_buckets)), m_values(other.m_values)
     {
-        other.GrowthPolicy::clear();
-        other.m_buckets_data.clear();
-        other.m_overflow_elements.clear();
-        other.m_buckets = static_empty_bucket_ptr();
-        other.m_nb_elements = 0;
-        other.m_max_load_threshold_rehash = 0;
-        other.m_min_load_threshold_rehash = 0;
+        other.m_buckets.clear();
+        other.m_values = nullptr;
     }
     
-    hopscotch_hash& operator=(const hopscotch_hash& other) {
+    hopscotch_buckets_storage& operator=(const hopscotch_buckets_storage& other) {
         if(&other != this) {
-            Hash::operator=(other);
-            KeyEqual::operator=(other);
-            GrowthPolicy::operator=(other);
-            
-            m_buckets_data = other.m_buckets_data;
-            m_overflow_elements = other.m_overflow_elements;
-            m_buckets = m_buckets_data.empty()?static_empty_bucket_ptr():
-                                               m_buckets_data.data();
-            m_nb_elements = other.m_nb_elements;
-            m_max_load_factor = other.m_max_load_factor;
-            m_max_load_threshold_rehash = other.m_max_load_threshold_rehash;
-            m_min_load_threshold_rehash = other.m_min_load_threshold_rehash;
+            hopscotch_buckets_storage tmp(other);
+            swap(tmp);
         }
         
         return *this;
     }
     
-    hopscotch_hash& operator=(hopscotch_hash&& other) {
-        other.swap(*this);
-        other.clear();
-        
-        return *this;
+    ~hopscotch_buckets_storage() {
+        clear();
     }
     
     allocator_type get_allocator() const {
-        return m_buckets_data.get_allocator();
+        return m_buckets.get_allocator();
     }
     
+    void resize(size_type count) {
+        tsl_hh_assert(m_buckets.empty() && m_values == nullptr);
+        
+        m_values = allocate_values(count);
+        try {
+            m_buckets.resize(count);
+        }
+        catch(...) {
+            deallocate_values(m_values, count);
+            m_values = nullptr;
+            throw;
+        }
+    }
     
-    /*
-     * Iterators
-     */
-    iterator begin() noexcept {
-        auto begin = m_buckets_data.begin();
-        while(begin != m_buckets_data.end() && begin->empty()) {
-            ++begin;
+    void clear() noexcept {
+        if(m_values != nullptr) {
+            destroy_values();
+            deallocate_values(m_values, m_buckets.size());
+            m_values = nullptr;
         }
         
-        return iterator(begin, m_buckets_data.end(), m_overflow_elements.begin());
+        buckets_container_type empty_buckets(m_buckets.get_allocator());
+        m_buckets.swap(empty_buckets);
     }
     
-    const_iterator begin() const noexcept {
-        return cbegin();
+    void clear_buckets() noexcept {
+        destroy_values();
+        for(auto& bucket: m_buckets) {
+            bucket.clear_infos();
+        }
     }
     
-    const_iterator cbegin() const noexcept {
-        auto begin = m_buckets_data.cbegin();
-        while(begin != m_buckets_data.cend() && begin->empty()) {
-            ++begin;
+    void swap(hopscotch_buckets_storage& other) {
+        using std::swap;
+        if(values_allocator_traits::propagate_on_container_swap::value) {
+            swap(get_values_allocator(), other.get_values_allocator());
         }
         
-        return const_iterator(begin, m_buckets_data.cend(), m_overflow_elements.cbegin());
+        swap(m_buckets, other.m_buckets);
+        swap(m_values, other.m_values);
     }
     
-    iterator end() noexcept {
-        return iterator(m_buckets_data.end(), m_buckets_data.end(), m_overflow_elements.end());
+    bool empty() const noexcept { return m_buckets.empty(); }
+    size_type size() const noexcept { return m_buckets.size(); }
+    
+    size_type max_size() const noexcept { 
+        return std::min(m_buckets.max_size(), size_type(values_allocator_traits::max_size(get_values_allocator())));
     }
     
-    const_iterator end() const noexcept {
-        return cend();
+    bucket_type* data() noexcept { return m_buckets.data(); }
+    const bucket_type* data() const noexcept { return m_buckets.data(); }
+    
+    iterator begin() noexcept { return iterator(m_buckets.data(), values_data()); }
+    const_iterator cbegin() const noexcept { return const_iterator(m_buckets.data(), values_data()); }
+    
+    iterator end() noexcept { 
+        return iterator(m_buckets.data() + m_buckets.size(), values_data() + m_buckets.size()); 
     }
     
-    const_iterator cend() const noexcept {
-        return const_iterator(m_buckets_data.cend(), m_buckets_data.cend(), m_overflow_elements.cend());
+    const_iterator cend() const noexcept { 
+        return const_iterator(m_buckets.data() + m_buckets.size(), values_data() + m_buckets.size()); 
     }
     
+    value_type& value(size_type ibucket) noexcept {
+        tsl_hh_assert(!m_buckets[ibucket].empty());
+        return values_data()[ibucket];
+    }
     
-    /*
-     * Capacity
+    const value_type& value(size_type ibucket) const noexcept {
+        tsl_hh_assert(!m_buckets[ibucket].empty());
+        return values_data()[ibucket];
+    }
+    
+    /**
+     * Prefetch the bucket ibucket, metadata and value, for a future lookup.
      */
-    bool empty() const noexcept {
-        return m_nb_elements == 0;
+    void prefetch(size_type ibucket) const noexcept {
+        tsl_hh_assert(ibucket < m_buckets.size());
+        prefetch_for_read(m_buckets.data() + ibucket);
+        prefetch_for_read(values_data() + ibucket);
     }
     
-    size_type size() const noexcept {
-        return m_nb_elements;
+    template<typename... Args>
+    void set_value_of_empty_bucket(size_type ibucket, truncated_hash_type hash, Args&&... value_type_args) {
+        tsl_hh_assert(m_buckets[ibucket].empty());
+        
+        values_allocator_traits::construct(get_values_allocator(), values_data() + ibucket, 
+                                           std::forward<Args>(value_type_args)...);
+        m_buckets[ibucket].set_empty(false);
+        m_buckets[ibucket].set_hash(hash);
     }
     
-    size_type max_size() const noexcept {
-        return m_buckets_data.max_size();
+    void swap_value_into_empty_bucket(size_type ibucket, size_type ibucket_empty) {
+        tsl_hh_assert(m_buckets[ibucket_empty].empty());
+        if(!m_buckets[ibucket].empty()) {
+            values_allocator_traits::construct(get_values_allocator(), values_data() + ibucket_empty, 
+                                               std::move(values_data()[ibucket]));
+            m_buckets[ibucket_empty].copy_hash(m_buckets[ibucket]);
+            m_buckets[ibucket_empty].set_empty(false);
+            
+            values_allocator_traits::destroy(get_values_allocator(), values_data() + ibucket);
+            m_buckets[ibucket].set_empty(true);
+        }
     }
     
-    /*
-     * Modifiers
+    void remove_value(size_type ibucket) noexcept {
+        if(!m_buckets[ibucket].empty()) {
+            values_allocator_traits::destroy(get_values_allocator(), values_data() + ibucket);
+            m_buckets[ibucket].set_empty(true);
+        }
+    }
+    
+    /**
+     * Raw access to the buckets for the optimistic lookups (see tsl::hh::segment_versions), 
+     * 'buckets' is the pointer to the metadata of the buckets used by hopscotch_hash.
      */
-    void clear() noexcept {
-        for(auto& bucket: m_buckets_data) {
-            bucket.clear();
+    class read_view {
+    public:
+        read_view(const bucket_type* buckets, const value_type* values) noexcept: m_buckets(buckets), 
+                                                                                  m_values(values) 
+        {
         }
         
-        m_overflow_elements.clear();
-        m_nb_elements = 0;
-    }
+        const bucket_type& bucket(size_type ibucket) const noexcept { return m_buckets[ibucket]; }
+        const value_type& value(size_type ibucket) const noexcept { return m_values[ibucket]; }
     
+    private:
+        const bucket_type* m_buckets;
+        const value_type* m_values;
+    };
     
-    std::pair<iterator, bool> insert(const value_type& value) { 
-        return insert_impl(value); 
+    read_view make_read_view(const bucket_type* buckets) const noexcept {
+        return read_view(buckets, values_data());
     }
-        
-    template<class P, typename std::enable_if<std::is_constructible<value_type, P&&>::value>::type* = nullptr>
-    std::pair<iterator, bool> insert(P&& value) { 
-        return insert_impl(value_type(std::forward<P>(value)));
+
+private:
+    values_allocator& get_values_allocator() noexcept {
+        return *this;
     }
     
-    std::pair<iterator, bool> insert(value_type&& value) { 
-        return insert_impl(std::move(value)); 
+    const values_allocator& get_values_allocator() const noexcept {
+        return *this;
     }
     
+    value_type* values_data() const noexcept {
+        return (m_values == nullptr)?nullptr:std::addressof(*m_values);
+    }
     
-    iterator insert(const_iterator hint, const value_type& value) { 
-        if(hint != cend() && compare_keys(KeySelect()(*hint), KeySelect()(value))) { 
-            return mutable_iterator(hint); 
-        }
-        
-        return insert(value).first; 
-    }
-        
-    template<class P, typename std::enable_if<std::is_constructible<value_type, P&&>::value>::type* = nullptr>
-    iterator insert(const_iterator hint, P&& value) {
-        return emplace_hint(hint, std::forward<P>(value)); 
+    values_pointer allocate_values(size_type count) {
+        return values_allocator_traits::allocate(get_values_allocator(), count);
     }
     
-    iterator insert(const_iterator hint, value_type&& value) { 
-        if(hint != cend() && compare_keys(KeySelect()(*hint), KeySelect()(value))) { 
-            return mutable_iterator(hint); 
-        }
-        
-        return insert(std::move(value)).first; 
+    void deallocate_values(values_pointer values, size_type count) noexcept {
+        values_allocator_traits::deallocate(get_values_allocator(), values, count);
     }
     
-    
-    template<class InputIt>
-    void insert(InputIt first, InputIt last) {
-        if(std::is_base_of<std::forward_iterator_tag, 
-                           typename std::iterator_traits<InputIt>::iterator_category>::value) 
-        {
-            const auto nb_elements_insert = std::distance(first, last);
-            const std::size_t nb_elements_in_buckets = m_nb_elements - m_overflow_elements.size();
-            const std::size_t nb_free_buckets = m_max_load_threshold_rehash - nb_elements_in_buckets;
-            tsl_hh_assert(m_nb_elements >= m_overflow_elements.size());
-            tsl_hh_assert(m_max_load_threshold_rehash >= nb_elements_in_buckets);
-            
-            if(nb_elements_insert > 0 && nb_free_buckets < std::size_t(nb_elements_insert)) {
-                reserve(nb_elements_in_buckets + std::size_t(nb_elements_insert));
+    void destroy_values() noexcept {
+        for(size_type ibucket = 0; ibucket < m_buckets.size(); ibucket++) {
+            if(!m_buckets[ibucket].empty()) {
+                values_allocator_traits::destroy(get_values_allocator(), values_data() + ibucket);
             }
         }
-        
-        for(; first != last; ++first) {
-            insert(*first);
-        }
     }
     
+private:
+    buckets_container_type m_buckets;
+    values_pointer m_values;
+};
+
+
+/*
+ * Result of hopscotch_hash::find_optimistic.
+ */
+enum class optimistic_lookup_result {
+    found,
+    not_found,
+    // The key may be in the overflow container or the lookup was interrupted too many times by the writers.
+    retry_with_lock
+};
+
+
+/*
+ * Versions of the buckets of hopscotch_hash (see tsl::hh::no_bucket_versions and tsl::hh::segment_versions).
+ * 
+ * hopscotch_hash calls begin_buckets_write/end_buckets_write around the modifications of the buckets in 
+ * [ibucket_first, ibucket_last] and begin_table_write/end_table_write around the operations which may modify 
+ * all the buckets or replace the bucket array, passing the state of the table to publish for the readers. 
+ * A bucket array replaced by a rehash is given to retire_buckets before the old table is destroyed.
+ */
+template<class Versions, class BucketsStorage, class GrowthPolicy>
+class bucket_versions;
+
+template<class BucketsStorage, class GrowthPolicy>
+class bucket_versions<tsl::hh::no_bucket_versions, BucketsStorage, GrowthPolicy> {
+public:
+    using read_view = typename BucketsStorage::read_view;
     
-    template<class M>
-    std::pair<iterator, bool> insert_or_assign(const key_type& k, M&& obj) { 
-        return insert_or_assign_impl(k, std::forward<M>(obj)); 
+    void begin_buckets_write(std::size_t /*ibucket_first*/, std::size_t /*ibucket_last*/) noexcept {
     }
-
-    template<class M>
-    std::pair<iterator, bool> insert_or_assign(key_type&& k, M&& obj) { 
-        return insert_or_assign_impl(std::move(k), std::forward<M>(obj)); 
+    
+    void end_buckets_write(std::size_t /*ibucket_first*/, std::size_t /*ibucket_last*/) noexcept {
     }
     
+    void begin_table_write(const read_view& /*buckets*/, const GrowthPolicy& /*growth_policy*/, 
+                           bool /*replaces_buckets*/) noexcept 
+    {
+    }
     
-    template<class M>
-    iterator insert_or_assign(const_iterator hint, const key_type& k, M&& obj) {
-        if(hint != cend() && compare_keys(KeySelect()(*hint), k)) { 
-            auto it = mutable_iterator(hint); 
-            it.value() = std::forward<M>(obj);
-            
-            return it;
-        }
-        
-        return insert_or_assign(k, std::forward<M>(obj)).first;
+    void end_table_write(const read_view& /*buckets*/, const GrowthPolicy& /*growth_policy*/) noexcept {
     }
     
-    template<class M>
-    iterator insert_or_assign(const_iterator hint, key_type&& k, M&& obj) {
-        if(hint != cend() && compare_keys(KeySelect()(*hint), k)) {
-            auto it = mutable_iterator(hint); 
-            it.value() = std::forward<M>(obj);
-            
-            return it;
-        }
-        
-        return insert_or_assign(std::move(k), std::forward<M>(obj)).first;
+    void retire_buckets(BucketsStorage& /*buckets_data*/) noexcept {
     }
+};
+
+template<unsigned int SegmentShift, class BucketsStorage, class GrowthPolicy>
+class bucket_versions<tsl::hh::segment_versions<SegmentShift>, BucketsStorage, GrowthPolicy> {
+public:
+    using read_view = typename BucketsStorage::read_view;
     
+    static const std::size_t SEGMENT_SIZE = std::size_t(1) << SegmentShift;
     
-    template<class... Args>
-    std::pair<iterator, bool> emplace(Args&&... args) {
-        return insert(value_type(std::forward<Args>(args)...));
-    }
+    /*
+     * State of the table read by the optimistic lookups. A new one is published each time the bucket array 
+     * is replaced. The previous ones and the bucket arrays they point to are retired and only freed once 
+     * no reader is in a read section (see reclaim_retired).
+     */
+    struct table_view {
+        table_view(const read_view& buckets_, const GrowthPolicy& growth_policy_): buckets(buckets_), 
+                                                                                   growth_policy(growth_policy_) 
+        {
+        }
+        
+        read_view buckets;
+        GrowthPolicy growth_policy;
+    };
     
-    template<class... Args>
-    iterator emplace_hint(const_iterator hint, Args&&... args) {
-        return insert(hint, value_type(std::forward<Args>(args)...));        
-    }
     
-    template<class... Args>
-    std::pair<iterator, bool> try_emplace(const key_type& k, Args&&... args) { 
-        return try_emplace_impl(k, std::forward<Args>(args)...);
+    bucket_versions() noexcept: m_table_version(0), m_view(nullptr), m_table_write_depth(0), 
+                                m_buckets_replaced(false)
+    {
     }
     
-    template<class... Args>
-    std::pair<iterator, bool> try_emplace(key_type&& k, Args&&... args) {
-        return try_emplace_impl(std::move(k), std::forward<Args>(args)...);
-    }
+    bucket_versions(const bucket_versions& other) = delete;
+    bucket_versions& operator=(const bucket_versions& other) = delete;
     
-    template<class... Args>
-    iterator try_emplace(const_iterator hint, const key_type& k, Args&&... args) { 
-        if(hint != cend() && compare_keys(KeySelect()(*hint), k)) { 
-            return mutable_iterator(hint); 
+    void begin_buckets_write(std::size_t ibucket_first, std::size_t ibucket_last) noexcept {
+        if(m_segment_versions == nullptr || m_table_write_depth > 0) {
+            return;
         }
         
-        return try_emplace(k, std::forward<Args>(args)...).first;
+        for(std::size_t isegment = ibucket_first >> SegmentShift; isegment <= (ibucket_last >> SegmentShift); 
+            isegment++) 
+        {
+            std::atomic<std::uint32_t>& version = segment_version(isegment);
+            version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        
+        std::atomic_thread_fence(std::memory_order_release);
     }
     
-    template<class... Args>
-    iterator try_emplace(const_iterator hint, key_type&& k, Args&&... args) {
-        if(hint != cend() && compare_keys(KeySelect()(*hint), k)) { 
-            return mutable_iterator(hint); 
+    void end_buckets_write(std::size_t ibucket_first, std::size_t ibucket_last) noexcept {
+        if(m_segment_versions == nullptr || m_table_write_depth > 0) {
+            return;
         }
         
-        return try_emplace(std::move(k), std::forward<Args>(args)...).first;
+        for(std::size_t isegment = ibucket_first >> SegmentShift; isegment <= (ibucket_last >> SegmentShift); 
+            isegment++) 
+        {
+            std::atomic<std::uint32_t>& version = segment_version(isegment);
+            version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
     }
     
-    
-    /**
-     * Here to avoid `template<class K> size_type erase(const K& key)` being used when
-     * we use an iterator instead of a const_iterator.
+    /*
+     * If replaces_buckets is true, the bucket array may be replaced (rehash) and everything that may throw 
+     * (allocations) for its publication is done here, so that end_table_write and retire_buckets can't fail 
+     * once the table has been modified. Otherwise the method doesn't throw.
      */
-    iterator erase(iterator pos) {
-        return erase(const_iterator(pos));
-    }
-    
-    iterator erase(const_iterator pos) {
-        const std::size_t ibucket_for_hash = bucket_for_hash(hash_key(pos.key()));
+    void begin_table_write(const read_view& buckets, const GrowthPolicy& growth_policy, bool replaces_buckets) {
+        if(replaces_buckets) {
+            // Each write which may replace the bucket array reserves the room for its retire_buckets, 
+            // nested ones included.
+            m_retired_buckets.reserve(m_retired_buckets.size() + 1);
+        }
         
-        if(pos.m_buckets_iterator != pos.m_buckets_end_iterator) {
-            auto it_bucket = m_buckets_data.begin() + std::distance(m_buckets_data.cbegin(), pos.m_buckets_iterator);
-            erase_from_bucket(*it_bucket, ibucket_for_hash);
+        if(m_table_write_depth > 0) {
+            m_table_write_depth++;
+            return;
+        }
+        
+        if(replaces_buckets) {
+            if(m_segment_versions == nullptr) {
+                m_segment_versions.reset(new std::atomic<std::uint32_t>[NB_SEGMENT_VERSIONS]);
+                for(std::size_t i = 0; i < NB_SEGMENT_VERSIONS; i++) {
+                    m_segment_versions[i].store(0, std::memory_order_relaxed);
+                }
+            }
             
-            return ++iterator(it_bucket, m_buckets_data.end(), m_overflow_elements.begin()); 
+            m_pending_view.reset(new table_view(buckets, growth_policy));
+            m_views.reserve(m_views.size() + 1);
         }
-        else {
-            auto it_next_overflow = erase_from_overflow(pos.m_overflow_iterator, ibucket_for_hash);
-            return iterator(m_buckets_data.end(), m_buckets_data.end(), it_next_overflow);
+        
+        m_table_write_depth++;
+        if(m_segment_versions != nullptr) {
+            m_table_version.store(m_table_version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
         }
     }
     
-    iterator erase(const_iterator first, const_iterator last) {
-        if(first == last) {
-            return mutable_iterator(first);
+    void end_table_write(const read_view& buckets, const GrowthPolicy& growth_policy) noexcept {
+        tsl_hh_assert(m_table_write_depth > 0);
+        m_table_write_depth--;
+        if(m_table_write_depth > 0) {
+            return;
         }
         
-        auto to_delete = erase(first);
-        while(to_delete != last) {
-            to_delete = erase(to_delete);
+        if(m_pending_view != nullptr && (m_buckets_replaced || m_view.load(std::memory_order_relaxed) == nullptr)) {
+            m_pending_view->buckets = buckets;
+            m_pending_view->growth_policy = growth_policy;
+            
+            m_views.push_back(std::move(m_pending_view));
+            // seq_cst, see reclaim_retired.
+            m_view.store(m_views.back().get(), std::memory_order_seq_cst);
         }
+        m_pending_view.reset();
+        m_buckets_replaced = false;
         
-        return to_delete;
+        if(m_segment_versions != nullptr) {
+            m_table_version.store(m_table_version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+        
+        reclaim_retired();
     }
     
-    template<class K>
-    size_type erase(const K& key) {
-        return erase(key, hash_key(key));
+    /*
+     * Keep the bucket array replaced by a rehash alive until no reader may still be reading it.
+     * The room for it has been reserved by begin_table_write, the push_back doesn't allocate.
+     */
+    void retire_buckets(BucketsStorage& buckets_data) noexcept {
+        tsl_hh_assert(m_table_write_depth > 0);
+        tsl_hh_assert(m_retired_buckets.size() < m_retired_buckets.capacity());
+        m_retired_buckets.push_back(std::move(buckets_data));
+        m_buckets_replaced = true;
     }
     
-    template<class K>
-    size_type erase(const K& key, std::size_t hash) {
-        const std::size_t ibucket_for_hash = bucket_for_hash(hash);
-
-        hopscotch_bucket* bucket_found = find_in_buckets(key, hash, m_buckets + ibucket_for_hash);
-        if(bucket_found != nullptr) {
-            erase_from_bucket(*bucket_found, ibucket_for_hash);
-
-            return 1;
+    /*
+     * Free the retired bucket arrays and views if no reader is in a read section.
+     * 
+     * A reader increments its counter before loading the view and the writer stores the new view before 
+     * checking the counters, all seq_cst. If the writer sees a counter at 0, every reader of this counter 
+     * which is not done yet incremented it after the check and will load the new view, it can't reach 
+     * a retired array. Otherwise the retired arrays are kept until the next table write finds no reader.
+     */
+    void reclaim_retired() noexcept {
+        if(m_retired_buckets.empty() && m_views.size() <= 1) {
+            return;
         }
         
-        if(m_buckets[ibucket_for_hash].has_overflow()) {
-            auto it_overflow = find_in_overflow(key);
-            if(it_overflow != m_overflow_elements.end()) {
-                erase_from_overflow(it_overflow, ibucket_for_hash);
-                
-                return 1;
+        for(const reader_counter& counter: m_reader_counters) {
+            if(counter.nb_readers.load(std::memory_order_seq_cst) != 0) {
+                return;
             }
         }
         
-        return 0;
-    }
-    
-    void swap(hopscotch_hash& other) {
-        using std::swap;
-        
-        swap(static_cast<Hash&>(*this), static_cast<Hash&>(other));
-        swap(static_cast<KeyEqual&>(*this), static_cast<KeyEqual&>(other));
-        swap(static_cast<GrowthPolicy&>(*this), static_cast<GrowthPolicy&>(other));
-        swap(m_buckets_data, other.m_buckets_data);
-        swap(m_overflow_elements, other.m_overflow_elements);
-        swap(m_buckets, other.m_buckets);
-        swap(m_nb_elements, other.m_nb_elements);
-        swap(m_max_load_factor, other.m_max_load_factor);
-        swap(m_max_load_threshold_rehash, other.m_max_load_threshold_rehash);
-        swap(m_min_load_threshold_rehash, other.m_min_load_threshold_rehash);
+        m_retired_buckets.clear();
+        if(m_views.size() > 1) {
+            m_views.erase(m_views.begin(), m_views.end() - 1);
+        }
     }
     
     
     /*
-     * Lookup
+     * Reader side.
+     * 
+     * A lookup enters a read section with a read_guard before loading the view and leaves it once it 
+     * doesn't access the buckets anymore.
      */
-    template<class K, class U = ValueSelect, typename std::enable_if<has_mapped_type<U>::value>::type* = nullptr>
-    typename U::value_type& at(const K& key) {
-        return at(key, hash_key(key));
+    class read_guard {
+    public:
+        explicit read_guard(const bucket_versions& versions) noexcept: 
+                                m_counter(versions.m_reader_counters[reader_slot()].nb_readers)
+        {
+            m_counter.fetch_add(1, std::memory_order_seq_cst);
+        }
+        
+        read_guard(const read_guard&) = delete;
+        read_guard& operator=(const read_guard&) = delete;
+        
+        ~read_guard() {
+            m_counter.fetch_sub(1, std::memory_order_release);
+        }
+        
+    private:
+        std::atomic<std::size_t>& m_counter;
+    };
+    
+    const table_view* load_view() const noexcept {
+        // seq_cst, see reclaim_retired.
+        return m_view.load(std::memory_order_seq_cst);
     }
     
-    template<class K, class U = ValueSelect, typename std::enable_if<has_mapped_type<U>::value>::type* = nullptr>
-    typename U::value_type& at(const K& key, std::size_t hash) {
-        return const_cast<typename U::value_type&>(static_cast<const hopscotch_hash*>(this)->at(key, hash));
+    std::uint32_t load_table_version() const noexcept {
+        return m_table_version.load(std::memory_order_acquire);
     }
     
+    std::uint32_t load_segment_version(std::size_t ibucket) const noexcept {
+        return segment_version(ibucket >> SegmentShift).load(std::memory_order_acquire);
+    }
     
-    template<class K, class U = ValueSelect, typename std::enable_if<has_mapped_type<U>::value>::type* = nullptr>
-    const typename U::value_type& at(const K& key) const {
-        return at(key, hash_key(key));
+    /*
+     * Return true if the versions read by load_table_version and load_segment_version for the buckets 
+     * ibucket_first and ibucket_last didn't change, the values read in between are then consistent.
+     */
+    bool validate(std::uint32_t table_version, std::size_t ibucket_first, std::uint32_t version_first, 
+                  std::size_t ibucket_last, std::uint32_t version_last) const noexcept 
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        
+        return segment_version(ibucket_first >> SegmentShift).load(std::memory_order_relaxed) == version_first &&
+               segment_version(ibucket_last >> SegmentShift).load(std::memory_order_relaxed) == version_last &&
+               m_table_version.load(std::memory_order_relaxed) == table_version;
+    }
+
+private:
+    std::atomic<std::uint32_t>& segment_version(std::size_t isegment) const noexcept {
+        return m_segment_versions[isegment & (NB_SEGMENT_VERSIONS - 1)];
     }
     
-    template<class K, class U = ValueSelect, typename std::enable_if<has_mapped_type<U>::value>::type* = nullptr>
-    const typename U::value_type& at(const K& key, std::size_t hash) const {
-        using T = typename U::value_type;
+    /*
+     * The readers are spread over NB_READER_COUNTERS counters, one per cache line, so that concurrent 
+     * lookups from different threads don't all write the same cache line. Each thread always uses the same.
+     */
+    static std::size_t reader_slot() noexcept {
+        static std::atomic<std::size_t> next_slot(0);
+        static thread_local const std::size_t slot = next_slot.fetch_add(1, std::memory_order_relaxed) % 
+                                                     NB_READER_COUNTERS;
         
-        const T* value = find_value_impl(key, hash, m_buckets + bucket_for_hash(hash));
-        if(value == nullptr) {
-            throw std::out_of_range("Couldn't find key.");
-        }
-        else {
-            return *value;
-        }
+        return slot;
     }
+
+private:
+    /*
+     * The segments share a fixed number of versions (segment isegment uses the version 
+     * isegment % NB_SEGMENT_VERSIONS) so that the versions never have to be reallocated.
+     */
+    static const std::size_t NB_SEGMENT_VERSIONS = 1024;
     
+    static const std::size_t NB_READER_COUNTERS = 16;
+    static const std::size_t CACHE_LINE_SIZE = 64;
     
-    template<class K, class U = ValueSelect, typename std::enable_if<has_mapped_type<U>::value>::type* = nullptr>
-    typename U::value_type& operator[](K&& key) {
-        using T = typename U::value_type;
-        
-        const std::size_t hash = hash_key(key);
-        const std::size_t ibucket_for_hash = bucket_for_hash(hash);
-        
-        T* value = find_value_impl(key, hash, m_buckets + ibucket_for_hash);
-        if(value != nullptr) {
-            return *value;
-        }
-        else {
-            return insert_value(ibucket_for_hash, hash, std::piecewise_construct, 
-                                                        std::forward_as_tuple(std::forward<K>(key)), 
-                                                        std::forward_as_tuple()).first.value();
+    struct reader_counter {
+        reader_counter() noexcept: nb_readers(0) {
         }
+        
+        std::atomic<std::size_t> nb_readers;
+        char padding[CACHE_LINE_SIZE - sizeof(std::atomic<std::size_t>)];
+    };
+    
+    static_assert(std::is_nothrow_copy_constructible<GrowthPolicy>::value && 
+                  std::is_nothrow_copy_assignable<GrowthPolicy>::value, 
+                  "GrowthPolicy must be nothrow copyable to be used with tsl::hh::segment_versions.");
+    
+    std::unique_ptr<std::atomic<std::uint32_t>[]> m_segment_versions;
+    std::atomic<std::uint32_t> m_table_version;
+    std::atomic<const table_view*> m_view;
+    mutable reader_counter m_reader_counters[NB_READER_COUNTERS];
+    
+    // Writer side, only accessed by the writer.
+    std::vector<std::unique_ptr<table_view>> m_views;
+    std::unique_ptr<table_view> m_pending_view;
+    std::vector<BucketsStorage> m_retired_buckets;
+    std::size_t m_table_write_depth;
+    bool m_buckets_replaced;
+};
+
+
+/*
+ * Event counters of hopscotch_hash (see tsl::hh::no_stats and tsl::hh::collect_stats).
+ * 
+ * hopscotch_hash calls the count_* methods on the events and fill_counters to fill a tsl::hh::hopscotch_stats.
+ * With tsl::hh::no_stats, the class is empty and the calls compile to nothing.
+ */
+template<class Stats>
+class stats_counters;
+
+template<>
+class stats_counters<tsl::hh::no_stats> {
+public:
+    void count_swap_empty_bucket_closer(bool /*displaced*/) noexcept {
     }
     
+    void count_insert_in_overflow() noexcept {
+    }
     
-    template<class K>
-    size_type count(const K& key) const {
-        return count(key, hash_key(key));
+    void count_rehash_on_load_factor() noexcept {
     }
     
-    template<class K>
-    size_type count(const K& key, std::size_t hash) const {
+    void count_rehash_on_full_neighborhood() noexcept {
+    }
+    
+    void fill_counters(tsl::hh::hopscotch_stats& /*stats*/) const noexcept {
+    }
+};
+
+template<>
+class stats_counters<tsl::hh::collect_stats> {
+public:
+    stats_counters() noexcept: m_nb_swap_empty_bucket_closer(0), m_nb_displacements(0), 
+                               m_nb_inserts_in_overflow(0), m_nb_rehashes_on_load_factor(0), 
+                               m_nb_rehashes_on_full_neighborhood(0)
+    {
+    }
+    
+    // The counters stay with the table object, see tsl::hh::hopscotch_stats
+    stats_counters(const stats_counters& /*other*/) noexcept: stats_counters() {
+    }
+    
+    stats_counters& operator=(const stats_counters& /*other*/) noexcept {
+        return *this;
+    }
+    
+    void count_swap_empty_bucket_closer(bool displaced) noexcept {
+        m_nb_swap_empty_bucket_closer++;
+        if(displaced) {
+            m_nb_displacements++;
+        }
+    }
+    
+    void count_insert_in_overflow() noexcept {
+        m_nb_inserts_in_overflow++;
+    }
+    
+    void count_rehash_on_load_factor() noexcept {
+        m_nb_rehashes_on_load_factor++;
+    }
+    
+    void count_rehash_on_full_neighborhood() noexcept {
+        m_nb_rehashes_on_full_neighborhood++;
+    }
+    
+    void fill_counters(tsl::hh::hopscotch_stats& stats) const noexcept {
+        stats.nb_swap_empty_bucket_closer = m_nb_swap_empty_bucket_closer;
+        stats.nb_displacements = m_nb_displacements;
+        stats.nb_inserts_in_overflow = m_nb_inserts_in_overflow;
+        stats.nb_rehashes_on_load_factor = m_nb_rehashes_on_load_factor;
+        stats.nb_rehashes_on_full_neighborhood = m_nb_rehashes_on_full_neighborhood;
+    }
+    
+private:
+    std::uint64_t m_nb_swap_empty_bucket_closer;
+    std::uint64_t m_nb_displacements;
+    std::uint64_t m_nb_inserts_in_overflow;
+    std::uint64_t m_nb_rehashes_on_load_factor;
+    std::uint64_t m_nb_rehashes_on_full_neighborhood;
+};
+
+
+/*
+ * Contiguous container of the overflow elements, used with tsl::hh::flat_overflow.
+ * 
+ * The values are stored in an array of slots in insertion order, each slot also keeping the hash of its 
+ * value. The slots are indexed by an open-addressed table (linear probing, load factor of at most 0.5) 
+ * mapping a hash to the position of its slot, so a lookup only compares the keys of the values with the 
+ * same hash instead of going through all the overflow elements.
+ * 
+ * Erasing a value destroys it and leaves a tombstone in its slot, the other values are not moved and the 
+ * iterators skip the tombstones. The tombstones are removed when an insert needs to grow the slots array.
+ * As a result, an insert invalidates all the iterators and references to the values (as any insert in the 
+ * hash table does), but an erase only invalidates the iterators and references to the erased value, 
+ * as with std::list.
+ */
+template<class ValueType, class Allocator>
+class flat_overflow_container {
+private:
+    struct value_slot {
+        using storage = typename std::aligned_storage<sizeof(ValueType), alignof(ValueType)>::type;
+        
+        ValueType& value() noexcept {
+            return *reinterpret_cast<ValueType*>(std::addressof(m_value));
+        }
+        
+        const ValueType& value() const noexcept {
+            return *reinterpret_cast<const ValueType*>(std::addressof(m_value));
+        }
+        
+        std::size_t m_hash;
+        bool m_alive;
+        storage m_value;
+    };
+    
+    struct index_entry {
+        std::size_t m_hash;
+        // Position of the slot plus one, 0 if the entry is empty.
+        std::size_t m_islot_plus_one;
+    };
+    
+    using slots_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<value_slot>;
+    using index_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<index_entry>;
+    using slots_container_type = std::vector<value_slot, slots_allocator>;
+    using index_container_type = std::vector<index_entry, index_allocator>;
+    
+public:
+    template<bool IsConst>
+    class flat_overflow_iterator;
+    
+    using value_type = ValueType;
+    using allocator_type = Allocator;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+    using iterator = flat_overflow_iterator<false>;
+    using const_iterator = flat_overflow_iterator<true>;
+    
+    /**
+     * Marks the container as indexed by hash, hopscotch_hash uses emplace_hashed and find_hashed on it.
+     */
+    using hashed_lookup = std::true_type;
+    
+    template<bool IsConst>
+    class flat_overflow_iterator {
+        friend class flat_overflow_container;
+    private:
+        using slot_pointer = typename std::conditional<IsConst, const value_slot*, value_slot*>::type;
+        
+        flat_overflow_iterator(slot_pointer slot, slot_pointer slots_end) noexcept: m_slot(slot), 
+                                                                                   m_slots_end(slots_end)
+        {
+            skip_tombstones();
+        }
+        
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = typename std::conditional<IsConst, const ValueType, ValueType>::type;
+        using difference_type = std::ptrdiff_t;
+        using reference = value_type&;
+        using pointer = value_type*;
+        
+        
+        flat_overflow_iterator() noexcept: m_slot(nullptr), m_slots_end(nullptr) {
+        }
+        
+        // Copy constructor from iterator to const_iterator.
+        template<bool TIsConst = IsConst, typename std::enable_if<TIsConst>::type* = nullptr>
+        flat_overflow_iterator(const flat_overflow_iterator<!TIsConst>& other) noexcept: 
+                                                                m_slot(other.m_slot), m_slots_end(other.m_slots_end)
+        {
+        }
+        
+        reference operator*() const { 
+            return m_slot->value(); 
+        }
+        
+        pointer operator->() const { 
+            return std::addressof(m_slot->value()); 
+        }
+        
+        flat_overflow_iterator& operator++() {
+            ++m_slot;
+            skip_tombstones();
+            
+            return *this;
+        }
+        
+        flat_overflow_iterator operator++(int) {
+            flat_overflow_iterator tmp(*this);
+            ++*this;
+            
+            return tmp;
+        }
+        
+        friend bool operator==(const flat_overflow_iterator& lhs, const flat_overflow_iterator& rhs) { 
+            return lhs.m_slot == rhs.m_slot; 
+        }
+        
+        friend bool operator!=(const flat_overflow_iterator& lhs, const flat_overflow_iterator& rhs) { 
+            return !(lhs == rhs); 
+        }
+        
+    private:
+        void skip_tombstones() noexcept {
+            while(m_slot != m_slots_end && !m_slot->m_alive) {
+                ++m_slot;
+            }
+        }
+        
+    private:
+        slot_pointer m_slot;
+        slot_pointer m_slots_end;
+    };
+    
+    
+public:
+    explicit flat_overflow_container(const Allocator& alloc): m_slots(slots_allocator(alloc)), 
+                                                              m_index(index_allocator(alloc)), 
+                                                              m_nb_values(0), m_alloc(alloc)
+    {
+    }
+    
+    flat_overflow_container(const flat_overflow_container& other): 
+                    m_slots(std::allocator_traits<slots_allocator>::select_on_container_copy_construction(
+                                other.m_slots.get_allocator())),
+                    m_index(std::allocator_traits<index_allocator>::select_on_container_copy_construction(
+                                other.m_index.get_allocator())),
+                    m_nb_values(0),
+                    m_alloc(std::allocator_traits<Allocator>::select_on_container_copy_construction(
+                                other.m_alloc))
+    {
+        grow_slots(other.m_nb_values);
+        
+        try {
+            for(const value_slot& slot: other.m_slots) {
+                if(slot.m_alive) {
+                    emplace_slot(slot.m_hash, slot.value());
+                }
+            }
+        }
+        catch(...) {
+            clear();
+            throw;
+        }
+    }
+    
+    flat_overflow_container(flat_overflow_container&& other) noexcept: m_slots(std::move(other.m_slots)), 
+                                                                       m_index(std::move(other.m_index)), 
+                                                                       m_nb_values(other.m_nb_values), 
+                                                                       m_alloc(std::move(other.m_alloc))
+    {
+        other.m_slots.clear();
+        other.m_index.clear();
+        other.m_nb_values = 0;
+    }
+    
+    flat_overflow_container& operator=(const flat_overflow_container& other) {
+        if(&other != this) {
+            flat_overflow_container tmp(other);
+            swap(tmp);
+        }
+        
+        return *this;
+    }
+    
+    flat_overflow_container& operator=(flat_overflow_container&& other) noexcept {
+        other.swap(*this);
+        other.clear();
+        
+        return *this;
+    }
+    
+    ~flat_overflow_container() {
+        destroy_values();
+    }
+    
+    allocator_type get_allocator() const {
+        return m_alloc;
+    }
+    
+    
+    iterator begin() noexcept {
+        return iterator(m_slots.data(), m_slots.data() + m_slots.size());
+    }
+    
+    const_iterator begin() const noexcept {
+        return cbegin();
+    }
+    
+    const_iterator cbegin() const noexcept {
+        return const_iterator(m_slots.data(), m_slots.data() + m_slots.size());
+    }
+    
+    iterator end() noexcept {
+        return iterator(m_slots.data() + m_slots.size(), m_slots.data() + m_slots.size());
+    }
+    
+    const_iterator end() const noexcept {
+        return cend();
+    }
+    
+    const_iterator cend() const noexcept {
+        return const_iterator(m_slots.data() + m_slots.size(), m_slots.data() + m_slots.size());
+    }
+    
+    
+    bool empty() const noexcept {
+        return m_nb_values == 0;
+    }
+    
+    size_type size() const noexcept {
+        return m_nb_values;
+    }
+    
+    void clear() noexcept {
+        destroy_values();
+        m_slots.clear();
+        std::fill(m_index.begin(), m_index.end(), index_entry{0, 0});
+        m_nb_values = 0;
+    }
+    
+    /**
+     * Insert a value with the hash 'hash', which must be the hash of the key of the value. 
+     * Doesn't check if a value with the same key already exists.
+     */
+    template<class... Args>
+    iterator emplace_hashed(std::size_t hash, Args&&... value_type_args) {
+        if(m_slots.size() == m_slots.capacity()) {
+            grow_slots(2*m_nb_values + MIN_SLOTS_CAPACITY);
+        }
+        
+        return emplace_slot(hash, std::forward<Args>(value_type_args)...);
+    }
+    
+    /**
+     * Return an iterator to a value with the hash 'hash' for which 'predicate(value)' is true, end() if none.
+     */
+    template<class Predicate>
+    iterator find_hashed(std::size_t hash, Predicate&& predicate) {
+        const std::size_t islot = find_slot(hash, predicate);
+        return (islot < m_slots.size())?iterator(m_slots.data() + islot, m_slots.data() + m_slots.size()):end();
+    }
+    
+    template<class Predicate>
+    const_iterator find_hashed(std::size_t hash, Predicate&& predicate) const {
+        const std::size_t islot = find_slot(hash, predicate);
+        return (islot < m_slots.size())?const_iterator(m_slots.data() + islot, m_slots.data() + m_slots.size()):
+                                        cend();
+    }
+    
+    /**
+     * Hash of the value pointed by 'pos', as passed to emplace_hashed.
+     */
+    std::size_t stored_hash(const_iterator pos) const noexcept {
+        tsl_hh_assert(pos != cend());
+        return pos.m_slot->m_hash;
+    }
+    
+    iterator erase(const_iterator pos) {
+        tsl_hh_assert(pos != cend());
+        
+        const std::size_t islot = std::size_t(pos.m_slot - m_slots.data());
+        erase_from_index(m_slots[islot].m_hash, islot);
+        
+        m_slots[islot].value().~value_type();
+        m_slots[islot].m_alive = false;
+        m_nb_values--;
+        
+        return iterator(m_slots.data() + islot + 1, m_slots.data() + m_slots.size());
+    }
+    
+    iterator erase(const_iterator first, const_iterator last) {
+        while(first != last) {
+            first = erase(first);
+        }
+        
+        return iterator(m_slots.data() + (last.m_slot - m_slots.data()), m_slots.data() + m_slots.size());
+    }
+    
+    void swap(flat_overflow_container& other) noexcept {
+        using std::swap;
+        
+        swap(m_slots, other.m_slots);
+        swap(m_index, other.m_index);
+        swap(m_nb_values, other.m_nb_values);
+        swap(m_alloc, other.m_alloc);
+    }
+    
+    friend void swap(flat_overflow_container& lhs, flat_overflow_container& rhs) noexcept {
+        lhs.swap(rhs);
+    }
+    
+private:
+    template<class... Args>
+    iterator emplace_slot(std::size_t hash, Args&&... value_type_args) {
+        tsl_hh_assert(m_slots.size() < m_slots.capacity());
+        tsl_hh_assert(2*m_slots.capacity() <= m_index.size());
+        
+        // No reallocation, the capacity has been reserved by grow_slots.
+        m_slots.push_back(value_slot());
+        value_slot& slot = m_slots.back();
+        try {
+            ::new (static_cast<void*>(std::addressof(slot.m_value))) value_type(std::forward<Args>(value_type_args)...);
+        }
+        catch(...) {
+            m_slots.pop_back();
+            throw;
+        }
+        
+        slot.m_hash = hash;
+        slot.m_alive = true;
+        m_nb_values++;
+        
+        const std::size_t islot = m_slots.size() - 1;
+        std::size_t iindex = hash & (m_index.size() - 1);
+        while(m_index[iindex].m_islot_plus_one != 0) {
+            iindex = (iindex + 1) & (m_index.size() - 1);
+        }
+        m_index[iindex] = index_entry{hash, islot + 1};
+        
+        return iterator(m_slots.data() + islot, m_slots.data() + m_slots.size());
+    }
+    
+    template<class Predicate>
+    std::size_t find_slot(std::size_t hash, Predicate& predicate) const {
+        if(m_index.empty()) {
+            return m_slots.size();
+        }
+        
+        const std::size_t mask = m_index.size() - 1;
+        for(std::size_t iindex = hash & mask; m_index[iindex].m_islot_plus_one != 0; iindex = (iindex + 1) & mask) {
+            const index_entry& entry = m_index[iindex];
+            if(entry.m_hash == hash && predicate(m_slots[entry.m_islot_plus_one - 1].value())) {
+                return entry.m_islot_plus_one - 1;
+            }
+        }
+        
+        return m_slots.size();
+    }
+    
+    /*
+     * Remove the entry of the slot 'islot' from the index, shifting back the following entries 
+     * of the cluster which can be moved closer to their ideal position.
+     */
+    void erase_from_index(std::size_t hash, std::size_t islot) noexcept {
+        const std::size_t mask = m_index.size() - 1;
+        
+        std::size_t iempty = hash & mask;
+        while(m_index[iempty].m_islot_plus_one != islot + 1) {
+            tsl_hh_assert(m_index[iempty].m_islot_plus_one != 0);
+            iempty = (iempty + 1) & mask;
+        }
+        
+        for(std::size_t inext = (iempty + 1) & mask; m_index[inext].m_islot_plus_one != 0; 
+            inext = (inext + 1) & mask) 
+        {
+            const std::size_t iideal = m_index[inext].m_hash & mask;
+            if(((inext - iideal) & mask) >= ((inext - iempty) & mask)) {
+                m_index[iempty] = m_index[inext];
+                iempty = inext;
+            }
+        }
+        
+        m_index[iempty] = index_entry{0, 0};
+    }
+    
+    /*
+     * Move the values to a new slots array with a capacity of at least 'min_capacity', removing 
+     * the tombstones, and rebuild the index.
+     */
+    void grow_slots(std::size_t min_capacity) {
+        tsl_hh_assert(min_capacity >= m_nb_values);
+        
+        slots_container_type new_slots(m_slots.get_allocator());
+        new_slots.reserve(min_capacity);
+        
+        std::size_t index_size = 1;
+        while(index_size < 2*new_slots.capacity()) {
+            index_size *= 2;
+        }
+        index_container_type new_index(index_size, index_entry{0, 0}, m_index.get_allocator());
+        
+        
+        flat_overflow_container new_container(m_alloc);
+        new_container.m_slots.swap(new_slots);
+        new_container.m_index.swap(new_index);
+        
+        static_assert(std::is_nothrow_move_constructible<value_type>::value || 
+                      std::is_copy_constructible<value_type>::value, 
+                      "value_type must be either copy constructible or nothrow move constructible.");
+        for(value_slot& slot: m_slots) {
+            if(slot.m_alive) {
+                new_container.emplace_slot(slot.m_hash, std::move_if_noexcept(slot.value()));
+            }
+        }
+        
+        new_container.swap(*this);
+    }
+    
+    void destroy_values() noexcept {
+        for(value_slot& slot: m_slots) {
+            if(slot.m_alive) {
+                slot.value().~value_type();
+                slot.m_alive = false;
+            }
+        }
+    }
+    
+private:
+    static const std::size_t MIN_SLOTS_CAPACITY = 4;
+    
+    slots_container_type m_slots;
+    index_container_type m_index;
+    std::size_t m_nb_values;
+    Allocator m_alloc;
+};
+
+
+template<class Overflow, class ValueType, class Allocator>
+struct overflow_container_selector;
+
+template<class ValueType, class Allocator>
+struct overflow_container_selector<tsl::hh::list_overflow, ValueType, Allocator> {
+    using type = std::list<ValueType, Allocator>;
+};
+
+template<class ValueType, class Allocator>
+struct overflow_container_selector<tsl::hh::flat_overflow, ValueType, Allocator> {
+    using type = flat_overflow_container<ValueType, Allocator>;
+};
+
+
+/*
+ * Format written by hopscotch_hash::write_mapped and read in place by tsl::mapped_hopscotch_map:
+ * 
+ * - a mapped_header, padded to MAPPED_BUCKETS_OFFSET bytes;
+ * - the header.nb_buckets buckets of the bucket array (including the NeighborhoodSize - 1 buckets after 
+ *   bucket_count()) as mapped_bucket<Key, T>, in the same order;
+ * - the header.nb_overflow_elements overflow elements as mapped_bucket<Key, T>.
+ * 
+ * The neighborhood_infos of a bucket have the same bits as in hopscotch_bucket_infos. The growth policy is 
+ * rebuilt from header.bucket_count. The file is only readable on a platform with the same endianness 
+ * and the same layout for mapped_bucket<Key, T>, the reader checks both.
+ */
+static const char MAPPED_MAGIC[8] = {'T', 'S', 'L', 'H', 'H', 'M', 'A', 'P'};
+static const std::uint32_t MAPPED_FORMAT_VERSION = 1;
+static const std::uint32_t MAPPED_BYTE_ORDER_MARK = 0x01020304;
+static const std::uint64_t MAPPED_BUCKETS_OFFSET = 128;
+
+struct mapped_header {
+    char magic[8];
+    std::uint32_t format_version;
+    std::uint32_t byte_order_mark;
+    std::uint32_t neighborhood_size;
+    std::uint32_t store_hash;
+    std::uint32_t bucket_size;
+    std::uint32_t key_size;
+    std::uint32_t value_size;
+    float max_load_factor;
+    std::uint64_t bucket_count;
+    std::uint64_t nb_buckets;
+    std::uint64_t nb_elements;
+    std::uint64_t nb_overflow_elements;
+};
+
+static_assert(sizeof(mapped_header) <= MAPPED_BUCKETS_OFFSET, "");
+
+template<class Key, class T>
+struct mapped_bucket {
+    std::uint64_t neighborhood_infos;
+    truncated_hash_type truncated_hash;
+    Key key;
+    T value;
+};
+
+
+/**
+ * Node handle returned by extract, holding a value removed from a map or a set with the hash of its key
+ * (similar to the C++17 node handles). 
+ * 
+ * As the values of a hopscotch_hash are stored directly in the buckets, the value is moved into the node handle 
+ * instead of transferring the ownership of an allocated node. The node handle itself never allocates.
+ * 
+ * The hash is reused when the node is inserted in a map or set with a stateless hash function (std::is_empty), 
+ * unless the key has been modified through key().
+ */
+template<class ValueType, class KeySelect, class ValueSelect>
+class hopscotch_node_handle {
+private:
+    template<typename U>
+    using has_mapped_type = typename std::integral_constant<bool, !std::is_same<U, void>::value>;
+    
+    template<class, class, class, class, class, class, unsigned int, bool, class, class, class, class, class>
+    friend class hopscotch_hash;
+    
+public:
+    using value_type = ValueType;
+    using key_type = typename KeySelect::key_type;
+    
+    hopscotch_node_handle() noexcept: m_hash(0), m_has_value(false), m_hash_valid(false) {
+    }
+    
+    hopscotch_node_handle(hopscotch_node_handle&& other) 
+                    noexcept(std::is_nothrow_move_constructible<value_type>::value): m_hash(other.m_hash), 
+                                                                                       m_has_value(false),
+                                                                                       m_hash_valid(other.m_hash_valid)
+    {
+        if(other.m_has_value) {
+            ::new (static_cast<void*>(std::addressof(m_value))) value_type(std::move(other.value_ref()));
+            m_has_value = true;
+            other.reset();
+        }
+    }
+    
+    hopscotch_node_handle& operator=(hopscotch_node_handle&& other) 
+                    noexcept(std::is_nothrow_move_constructible<value_type>::value)
+    {
+        if(&other != this) {
+            reset();
+            
+            m_hash = other.m_hash;
+            m_hash_valid = other.m_hash_valid;
+            if(other.m_has_value) {
+                ::new (static_cast<void*>(std::addressof(m_value))) value_type(std::move(other.value_ref()));
+                m_has_value = true;
+                other.reset();
+            }
+        }
+        
+        return *this;
+    }
+    
+    hopscotch_node_handle(const hopscotch_node_handle& other) = delete;
+    hopscotch_node_handle& operator=(const hopscotch_node_handle& other) = delete;
+    
+    ~hopscotch_node_handle() {
+        reset();
+    }
+    
+    bool empty() const noexcept {
+        return !m_has_value;
+    }
+    
+    explicit operator bool() const noexcept {
+        return m_has_value;
+    }
+    
+    /**
+     * Only for maps. Modifying the key makes the hash stored in the node stale, it will be recomputed on insert.
+     */
+    template<class U = ValueSelect, typename std::enable_if<has_mapped_type<U>::value>::type* = nullptr>
+    key_type& key() {
+        tsl_hh_assert(m_has_value);
+        m_hash_valid = false;
+        
+        return const_cast<key_type&>(KeySelect()(value_ref()));
+    }
+    
+    template<class U = ValueSelect, typename std::enable_if<has_mapped_type<U>::value>::type* = nullptr>
+    typename U::value_type& mapped() {
+        tsl_hh_assert(m_has_value);
+        return U()(value_ref());
+    }
+    
+    /**
+     * Only for sets.
+     */
+    template<class U = ValueSelect, typename std::enable_if<!has_mapped_type<U>::value>::type* = nullptr>
+    value_type& value() {
+        tsl_hh_assert(m_has_value);
+        return value_ref();
+    }
+    
+    void swap(hopscotch_node_handle& other) {
+        hopscotch_node_handle tmp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(tmp);
+    }
+    
+    friend void swap(hopscotch_node_handle& lhs, hopscotch_node_handle& rhs) {
+        lhs.swap(rhs);
+    }
+    
+private:
+    template<class... Args>
+    explicit hopscotch_node_handle(std::size_t hash, Args&&... value_type_args): m_hash(hash), m_has_value(false), 
+                                                                                 m_hash_valid(true)
+    {
+        ::new (static_cast<void*>(std::addressof(m_value))) value_type(std::forward<Args>(value_type_args)...);
+        m_has_value = true;
+    }
+    
+    value_type& value_ref() noexcept {
+        return *reinterpret_cast<value_type*>(std::addressof(m_value));
+    }
+    
+    void reset() noexcept {
+        if(m_has_value) {
+            value_ref().~value_type();
+            m_has_value = false;
+        }
+    }
+    
+private:
+    using storage = typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type;
+    
+    storage m_value;
+    std::size_t m_hash;
+    bool m_has_value;
+    bool m_hash_valid;
+};
+
+/**
+ * Result of the insertion of a node handle (similar to the C++17 insert_return_type). If the insertion failed
+ * because of an equivalent key, node holds the value which was not inserted and position points to the element
+ * with the equivalent key.
+ */
+template<class Iterator, class NodeType>
+struct hopscotch_insert_return_type {
+    Iterator position;
+    bool inserted;
+    NodeType node;
+};
+
+/**
+ * Pair of iterators usable in a range-based for loop, returned by partition.
+ */
+template<class Iterator>
+class hopscotch_range {
+public:
+    hopscotch_range(Iterator first, Iterator last): m_first(first), m_last(last) {
+    }
+    
+    Iterator begin() const {
+        return m_first;
+    }
+    
+    Iterator end() const {
+        return m_last;
+    }
+    
+private:
+    Iterator m_first;
+    Iterator m_last;
+};
+
+
+/**
+ * Internal common class used by (b)hopscotch_map and (b)hopscotch_set.
+ * 
+ * ValueType is what will be stored by hopscotch_hash (usually std::pair<Key, T> for a map and Key for a set).
+ * 
+ * KeySelect should be a FunctionObject which takes a ValueType in parameter and returns a reference to the key.
+ * 
+ * ValueSelect should be a FunctionObject which takes a ValueType in parameter and returns a reference to the value.
+ * ValueSelect should be void if there is no value (in a set for example).
+ * 
+ * OverflowContainer will be used as containers for overflown elements. Usually it should be a list<ValueType>,
+ * a set<Key>/map<Key, T> or a flat_overflow_container<ValueType> (indexed by the hash of the elements).
+ * 
+ * Layout defines how the buckets are stored, tsl::hh::aos_layout or tsl::hh::soa_layout.
+ * 
+ * Versions defines if the buckets are versioned for lock-free lookups, tsl::hh::no_bucket_versions 
+ * or tsl::hh::segment_versions.
+ * 
+ * Stats defines if the events of the insertion algorithm are counted, tsl::hh::no_stats or tsl::hh::collect_stats.
+ */
+template<class ValueType,
+         class KeySelect,
+         class ValueSelect,
+         class Hash,
+         class KeyEqual,
+         class Allocator,
+         unsigned int NeighborhoodSize,
+         bool StoreHash,
+         class GrowthPolicy,
+         class OverflowContainer,
+         class Layout = tsl::hh::aos_layout,
+         class Versions = tsl::hh::no_bucket_versions,
+         class Stats = tsl::hh::no_stats>
+class hopscotch_hash: private Hash, private KeyEqual, private GrowthPolicy, 
+                      private bucket_versions<Versions, 
+                                              hopscotch_buckets_storage<ValueType, NeighborhoodSize, StoreHash, 
+                                                                        Allocator, Layout>, 
+                                              GrowthPolicy>,
+                      private stats_counters<Stats>
+{
+private:
+    template<typename U>
+    using has_mapped_type = typename std::integral_constant<bool, !std::is_same<U, void>::value>;
+    
+    static_assert(noexcept(std::declval<GrowthPolicy>().bucket_for_hash(std::size_t(0))), "GrowthPolicy::bucket_for_hash must be noexcept.");
+    static_assert(noexcept(std::declval<GrowthPolicy>().clear()), "GrowthPolicy::clear must be noexcept.");
+
+    /**
+     * True if neighborhood_hash_match compares the stored hashes itself (AVX2 version), find_in_buckets
+     * doesn't have to compare them again.
+     */
+#if defined(TSL_HH_AVX2)
+    static constexpr bool NEIGHBORHOOD_HASH_MATCH_IS_EXACT = StoreHash;
+#else
+    static constexpr bool NEIGHBORHOOD_HASH_MATCH_IS_EXACT = false;
+#endif
+    
+public:
+    template<bool IsConst>
+    class hopscotch_iterator;
+    
+    using key_type = typename KeySelect::key_type;
+    using value_type = ValueType;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    using allocator_type = Allocator;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+    using pointer = value_type*;
+    using const_pointer = const value_type*;
+    using iterator = hopscotch_iterator<false>;
+    using const_iterator = hopscotch_iterator<true>;
+    using node_type = hopscotch_node_handle<ValueType, KeySelect, ValueSelect>;
+    using insert_return_type = hopscotch_insert_return_type<iterator, node_type>;
+    using range = hopscotch_range<iterator>;
+    using const_range = hopscotch_range<const_iterator>;
+    
+private:
+    using buckets_container_type = hopscotch_buckets_storage<ValueType, NeighborhoodSize, StoreHash, 
+                                                             Allocator, Layout>;
+    
+    // Metadata of a bucket (and, with tsl::hh::aos_layout, its value), see hopscotch_buckets_storage.
+    using hopscotch_bucket = typename buckets_container_type::bucket_type;
+    using neighborhood_bitmap = typename hopscotch_bucket::neighborhood_bitmap;
+    
+    using bucket_versions_type = bucket_versions<Versions, buckets_container_type, GrowthPolicy>;
+    using stats_counters_type = stats_counters<Stats>;
+    
+    using overflow_container_type = OverflowContainer;
+    
+    static_assert(std::is_same<typename overflow_container_type::value_type, ValueType>::value, 
+                  "OverflowContainer should have ValueType as type.");
+    
+    static_assert(std::is_same<typename overflow_container_type::allocator_type, Allocator>::value, 
+                  "Invalid allocator, not the same type as the value_type.");
+    
+    
+    using iterator_buckets = typename buckets_container_type::iterator; 
+    using const_iterator_buckets = typename buckets_container_type::const_iterator;
+    
+    using iterator_overflow = typename overflow_container_type::iterator; 
+    using const_iterator_overflow = typename overflow_container_type::const_iterator; 
+    
+    /*
+     * Hash, home bucket and index in [first, last) of an element of insert_bulk.
+     */
+    struct bulk_insert_entry {
+        std::size_t hash;
+        std::uint32_t ibucket_for_hash;
+        std::uint32_t index;
+    };
+    
+    // The scratch entries of insert_bulk use the allocator of the map, as the buckets.
+    using bulk_insert_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<bulk_insert_entry>;
+    using bulk_insert_entries = std::vector<bulk_insert_entry, bulk_insert_allocator>;
+    
+    /*
+     * True if the elements of [first, last) can be placed by insert_bulk: random access iterators 
+     * dereferencing to value_type.
+     */
+    template<class InputIt>
+    using is_bulk_insertable = std::integral_constant<bool, 
+                std::is_base_of<std::random_access_iterator_tag, 
+                                typename std::iterator_traits<InputIt>::iterator_category>::value &&
+                std::is_same<typename std::decay<typename std::iterator_traits<InputIt>::reference>::type, 
+                             value_type>::value>;
+    
+public:    
+    /**
+     * The `operator*()` and `operator->()` methods return a const reference and const pointer respectively to the 
+     * stored value type.
+     * 
+     * In case of a map, to get a modifiable reference to the value associated to a key (the `.second` in the 
+     * stored pair), you have to call `value()`.
+     * 
+     * During an incremental rehash, the iterator first goes through the elements not yet migrated 
+     * (in the old table) and then through the elements of the current table.
+     */
+    template<bool IsConst>
+    class hopscotch_iterator {
+        friend class hopscotch_hash;
+    private:
+        using iterator_bucket = typename std::conditional<IsConst, 
+                                                            typename hopscotch_hash::const_iterator_buckets, 
+                                                            typename hopscotch_hash::iterator_buckets>::type;
+        using iterator_overflow = typename std::conditional<IsConst, 
+                                                            typename hopscotch_hash::const_iterator_overflow, 
+                                                            typename hopscotch_hash::iterator_overflow>::type;
+        using table_pointer = typename std::conditional<IsConst, 
+                                                        const hopscotch_hash*, 
+                                                        hopscotch_hash*>::type;
+    
+        
+        hopscotch_iterator(iterator_bucket buckets_iterator, iterator_bucket buckets_end_iterator, 
+                           iterator_overflow overflow_iterator, table_pointer next_table = nullptr) noexcept : 
+            m_buckets_iterator(buckets_iterator), m_buckets_end_iterator(buckets_end_iterator),
+            m_overflow_iterator(overflow_iterator), m_next_table(next_table)
+        {
+        }
+        
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = const typename hopscotch_hash::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = value_type&;
+        using pointer = value_type*;
+        
+        
+        hopscotch_iterator() noexcept: m_next_table(nullptr) {
+        }
+        
+        // Copy constructor from iterator to const_iterator.
+        template<bool TIsConst = IsConst, typename std::enable_if<TIsConst>::type* = nullptr>
+        hopscotch_iterator(const hopscotch_iterator<!TIsConst>& other) noexcept :
+            m_buckets_iterator(other.m_buckets_iterator), m_buckets_end_iterator(other.m_buckets_end_iterator),
+            m_overflow_iterator(other.m_overflow_iterator), m_next_table(other.m_next_table)
+        {
+        }
+
+        hopscotch_iterator(const hopscotch_iterator& other) = default;
+        hopscotch_iterator(hopscotch_iterator&& other) = default;
+        hopscotch_iterator& operator=(const hopscotch_iterator& other) = default;
+        hopscotch_iterator& operator=(hopscotch_iterator&& other) = default;
+        
+        const typename hopscotch_hash::key_type& key() const {
+            if(m_buckets_iterator != m_buckets_end_iterator) {
+                return KeySelect()(m_buckets_iterator->value());
+            }
+            
+            return KeySelect()(*m_overflow_iterator);
+        }
+
+        template<class U = ValueSelect, typename std::enable_if<has_mapped_type<U>::value>::type* = nullptr>
+        typename std::conditional<
+                        IsConst, 
+                        const typename U::value_type&, 
+                        typename U::value_type&>::type value() const
+        {
+            if(m_buckets_iterator != m_buckets_end_iterator) {
+                return U()(m_buckets_iterator->value());
+            }
+            
+            return U()(*m_overflow_iterator);
+        }
+        
+        reference operator*() const { 
+            if(m_buckets_iterator != m_buckets_end_iterator) {
+                return m_buckets_iterator->value();
+            }
+            
+            return *m_overflow_iterator;
+        }
+        
+        pointer operator->() const { 
+            if(m_buckets_iterator != m_buckets_end_iterator) {
+                return std::addressof(m_buckets_iterator->value()); 
+            }
+            
+            return std::addressof(*m_overflow_iterator); 
+        }
+        
+        hopscotch_iterator& operator++() {
+            if(m_buckets_iterator == m_buckets_end_iterator) {
+                ++m_overflow_iterator;
+            }
+            else {
+                do {
+                    ++m_buckets_iterator;
+                } while(m_buckets_iterator != m_buckets_end_iterator && m_buckets_iterator->empty());
+            }
+            
+            if(m_next_table != nullptr) {
+                skip_to_next_table_if_at_end();
+            }
+            
+            return *this; 
+        }
+        
+        hopscotch_iterator operator++(int) {
+            hopscotch_iterator tmp(*this);
+            ++*this;
+            
+            return tmp;
+        }
+        
+        friend bool operator==(const hopscotch_iterator& lhs, const hopscotch_iterator& rhs) { 
+            return lhs.m_buckets_iterator == rhs.m_buckets_iterator && 
+                   lhs.m_overflow_iterator == rhs.m_overflow_iterator; 
+        }
+        
+        friend bool operator!=(const hopscotch_iterator& lhs, const hopscotch_iterator& rhs) { 
+            return !(lhs == rhs); 
+        }
+        
+    private:
+        /*
+         * If the iterator is at the end of the old table of an incremental rehash, 
+         * move it to the first element of the current table.
+         */
+        void skip_to_next_table_if_at_end() noexcept {
+            tsl_hh_assert(m_next_table != nullptr && m_next_table->m_old_table != nullptr);
+            if(m_buckets_iterator == m_buckets_end_iterator && 
+               m_overflow_iterator == m_next_table->m_old_table->m_overflow_elements.end()) 
+            {
+                *this = m_next_table->begin_current_table();
+            }
+        }
+        
+    private:
+        iterator_bucket m_buckets_iterator;
+        iterator_bucket m_buckets_end_iterator;
+        iterator_overflow m_overflow_iterator;
+        
+        /*
+         * Non-null only if the iterator is in the old table of an incremental rehash, points to the table 
+         * (owning the old table) whose elements come after the elements of the old table.
+         */
+        table_pointer m_next_table;
+    };
+    
+public:
+    template<class OC = OverflowContainer, typename std::enable_if<!has_key_compare<OC>::value>::type* = nullptr>
+    hopscotch_hash(size_type bucket_count, 
+                  const Hash& hash,
+                  const KeyEqual& equal,
+                  const Allocator& alloc,
+                  float max_load_factor) :  Hash(hash),
+                                            KeyEqual(equal),
+                                            GrowthPolicy(bucket_count),
+                                            m_buckets_data(alloc), 
+                                            m_overflow_elements(alloc),
+                                            m_buckets(static_empty_bucket_ptr()),
+                                            m_nb_elements(0),
+                                            m_min_load_factor(0),
+                                            m_incremental_rehash_ibucket(0),
+                                            m_incremental_rehash_step(0)
+    {
+        if(bucket_count > max_bucket_count()) {
+            throw std::length_error("The map exceeds its maxmimum size.");
+        }
+        
+        if(bucket_count > 0) {
+            static_assert(NeighborhoodSize - 1 > 0, "");
+            
+            m_buckets_data.resize(bucket_count + NeighborhoodSize - 1);
+            m_buckets = m_buckets_data.data();
+        }
+        
+        
+        this->max_load_factor(max_load_factor);
+        
+        // Publish the initial state of the table for the lock-free lookups (with tsl::hh::segment_versions)
+        {
+            table_write_guard guard(*this);
+        }
+        
+        
+        // Check in the constructor instead of outside of a function to avoi compilation issues
+        // when value_type is not complete.
+        static_assert(std::is_nothrow_move_constructible<value_type>::value || 
+                      std::is_copy_constructible<value_type>::value, 
+                      "value_type must be either copy constructible or nothrow move constructible.");
+    }
+    
+    template<class OC = OverflowContainer, typename std::enable_if<has_key_compare<OC>::value>::type* = nullptr>
+    hopscotch_hash(size_type bucket_count, 
+                  const Hash& hash,
+                  const KeyEqual& equal,
+                  const Allocator& alloc,
+                  float max_load_factor,
+                  const typename OC::key_compare& comp) : Hash(hash),
+                                                          KeyEqual(equal),
+                                                          GrowthPolicy(bucket_count),
+                                                          m_buckets_data(alloc), 
+                                                          m_overflow_elements(comp, alloc),
+                                                          m_buckets(static_empty_bucket_ptr()),
+                                                          m_nb_elements(0),
+                                                          m_min_load_factor(0),
+                                                          m_incremental_rehash_ibucket(0),
+                                                          m_incremental_rehash_step(0)
+    {
+        
+        if(bucket_count > max_bucket_count()) {
+            throw std::length_error("The map exceeds its maxmimum size.");
+        }
+        
+        if(bucket_count > 0) {
+            static_assert(NeighborhoodSize - 1 > 0, "");
+            
+            m_buckets_data.resize(bucket_count + NeighborhoodSize - 1);
+            m_buckets = m_buckets_data.data();
+        }
+        
+        
+        this->max_load_factor(max_load_factor);
+        
+        // Publish the initial state of the table for the lock-free lookups (with tsl::hh::segment_versions)
+        {
+            table_write_guard guard(*this);
+        }
+        
+        
+        // Check in the constructor instead of outside of a function to avoi compilation issues
+        // when value_type is not complete.
+        static_assert(std::is_nothrow_move_constructible<value_type>::value || 
+                      std::is_copy_constructible<value_type>::value, 
+                      "value_type must be either copy constructible or nothrow move constructible.");
+    }
+    
+    hopscotch_hash(const hopscotch_hash& other): 
+                          Hash(other),
+                          KeyEqual(other),
+                          GrowthPolicy(other),
+                          stats_counters_type(),
+                          m_buckets_data(other.m_buckets_data),
+                          m_overflow_elements(other.m_overflow_elements),
+                          m_buckets(m_buckets_data.empty()?static_empty_bucket_ptr():
+                                                           m_buckets_data.data()),
+                          m_nb_elements(other.m_nb_elements),
+                          m_max_load_factor(other.m_max_load_factor),
+                          m_max_load_threshold_rehash(other.m_max_load_threshold_rehash),
+                          m_min_load_threshold_rehash(other.m_min_load_threshold_rehash),
+                          m_min_load_factor(other.m_min_load_factor),
+                          m_min_load_threshold_shrink(other.m_min_load_threshold_shrink),
+                          m_old_table(other.m_old_table == nullptr?nullptr:
+                                                                   new hopscotch_hash(*other.m_old_table)),
+                          m_incremental_rehash_ibucket(other.m_incremental_rehash_ibucket),
+                          m_incremental_rehash_step(other.m_incremental_rehash_step)
+    {
+    }
+    
+    hopscotch_hash(hopscotch_hash&& other) 
+                        noexcept(
+                            std::is_nothrow_move_constructible<Hash>::value &&
+                            std::is_nothrow_move_constructible<KeyEqual>::value &&
+                            std::is_nothrow_move_constructible<GrowthPolicy>::value &&
+                            std::is_nothrow_move_constructible<buckets_container_type>::value &&
+                            std::is_nothrow_move_constructible<overflow_container_type>::value
+                        ):
+                          Hash(std::move(static_cast<Hash&>(other))),
+                          KeyEqual(std::move(static_cast<KeyEqual&>(other))),
+                          GrowthPolicy(std::move(static_cast<GrowthPolicy&>(other))),
+                          m_buckets_data(std::move(other.m_buckets_data)),
+                          m_overflow_elements(std::move(other.m_overflow_elements)),
+                          m_buckets(m_buckets_data.empty()?static_empty_bucket_ptr():
+                                                           m_buckets_data.data()),
+                          m_nb_elements(other.m_nb_elements),
+                          m_max_load_factor(other.m_max_load_factor),
+                          m_max_load_threshold_rehash(other.m_max_load_threshold_rehash),
+                          m_min_load_threshold_rehash(other.m_min_load_threshold_rehash),
+                          m_min_load_factor(other.m_min_load_factor),
+                          m_min_load_threshold_shrink(other.m_min_load_threshold_shrink),
+                          m_old_table(std::move(other.m_old_table)),
+                          m_incremental_rehash_ibucket(other.m_incremental_rehash_ibucket),
+                          m_incremental_rehash_step(other.m_incremental_rehash_step)
+    {
+        other.GrowthPolicy::clear();
+        other.m_buckets_data.clear();
+        other.m_overflow_elements.clear();
+        other.m_buckets = static_empty_bucket_ptr();
+        other.m_nb_elements = 0;
+        other.m_max_load_threshold_rehash = 0;
+        other.m_min_load_threshold_rehash = 0;
+        other.m_min_load_threshold_shrink = 0;
+    }
+    
+    hopscotch_hash& operator=(const hopscotch_hash& other) {
+        if(&other != this) {
+            Hash::operator=(other);
+            KeyEqual::operator=(other);
+            GrowthPolicy::operator=(other);
+            
+            m_buckets_data = other.m_buckets_data;
+            m_overflow_elements = other.m_overflow_elements;
+            m_buckets = m_buckets_data.empty()?static_empty_bucket_ptr():
+                                               m_buckets_data.data();
+            m_nb_elements = other.m_nb_elements;
+            m_max_load_factor = other.m_max_load_factor;
+            m_max_load_threshold_rehash = other.m_max_load_threshold_rehash;
+            m_min_load_threshold_rehash = other.m_min_load_threshold_rehash;
+            m_min_load_factor = other.m_min_load_factor;
+            m_min_load_threshold_shrink = other.m_min_load_threshold_shrink;
+            
+            m_old_table.reset(other.m_old_table == nullptr?nullptr:new hopscotch_hash(*other.m_old_table));
+            m_incremental_rehash_ibucket = other.m_incremental_rehash_ibucket;
+            m_incremental_rehash_step = other.m_incremental_rehash_step;
+        }
+        
+        return *this;
+    }
+    
+    hopscotch_hash& operator=(hopscotch_hash&& other) {
+        other.swap(*this);
+        other.clear();
+        
+        return *this;
+    }
+    
+    allocator_type get_allocator() const {
+        return m_buckets_data.get_allocator();
+    }
+    
+    
+    /*
+     * Iterators
+     */
+    iterator begin() noexcept {
+        if(m_old_table != nullptr) {
+            return to_composite_iterator(m_old_table->begin());
+        }
+        
+        return begin_current_table();
+    }
+    
+    const_iterator begin() const noexcept {
+        return cbegin();
+    }
+    
+    const_iterator cbegin() const noexcept {
+        if(m_old_table != nullptr) {
+            return to_composite_iterator(static_cast<const hopscotch_hash&>(*m_old_table).cbegin());
+        }
+        
+        return begin_current_table();
+    }
+    
+    iterator end() noexcept {
+        return iterator(m_buckets_data.end(), m_buckets_data.end(), m_overflow_elements.end());
+    }
+    
+    const_iterator end() const noexcept {
+        return cend();
+    }
+    
+    const_iterator cend() const noexcept {
+        return const_iterator(m_buckets_data.cend(), m_buckets_data.cend(), m_overflow_elements.cend());
+    }
+    
+    
+    /*
+     * Partitions
+     */
+    range partition(std::size_t ipartition, std::size_t nb_partitions) noexcept {
+        tsl_hh_assert(ipartition < nb_partitions);
+        
+        iterator first = (ipartition == 0)?begin():begin_at_bucket(partition_first_bucket(ipartition, nb_partitions));
+        iterator last = (ipartition + 1 == nb_partitions)?
+                            end():begin_at_bucket(partition_first_bucket(ipartition + 1, nb_partitions));
+        
+        return range(first, last);
+    }
+    
+    const_range partition(std::size_t ipartition, std::size_t nb_partitions) const noexcept {
+        tsl_hh_assert(ipartition < nb_partitions);
+        
+        const_iterator first = (ipartition == 0)?
+                                    cbegin():begin_at_bucket(partition_first_bucket(ipartition, nb_partitions));
+        const_iterator last = (ipartition + 1 == nb_partitions)?
+                                    cend():begin_at_bucket(partition_first_bucket(ipartition + 1, nb_partitions));
+        
+        return const_range(first, last);
+    }
+    
+    template<class Function>
+    void parallel_for_each(std::size_t nb_threads, const Function& function) const {
+        parallel_for_each(nb_threads, function, thread_executor());
+    }
+    
+    template<class Function, class Executor>
+    void parallel_for_each(std::size_t nb_tasks, const Function& function, Executor&& executor) const {
+        nb_tasks = std::max(nb_tasks, std::size_t(1));
+        if(nb_tasks == 1) {
+            for(const value_type& value: partition(0, 1)) {
+                function(value);
+            }
+            
+            return;
+        }
+        
+        run_parallel_tasks(executor, nb_tasks, [&](std::size_t itask) {
+            for(const value_type& value: partition(itask, nb_tasks)) {
+                function(value);
+            }
+        });
+    }
+    
+    
+    /*
+     * Capacity
+     */
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+    
+    size_type size() const noexcept {
+        return (m_old_table == nullptr)?m_nb_elements:m_nb_elements + m_old_table->m_nb_elements;
+    }
+    
+    size_type max_size() const noexcept {
+        return m_buckets_data.max_size();
+    }
+    
+    /*
+     * Modifiers
+     */
+    void clear() noexcept {
+        table_write_guard guard(*this, false);
+        m_buckets_data.clear_buckets();
+        
+        m_overflow_elements.clear();
+        m_nb_elements = 0;
+        
+        m_old_table.reset();
+    }
+    
+    
+    std::pair<iterator, bool> insert(const value_type& value) { 
+        return insert_impl(value); 
+    }
+        
+    template<class P, typename std::enable_if<std::is_constructible<value_type, P&&>::value>::type* = nullptr>
+    std::pair<iterator, bool> insert(P&& value) { 
+        return insert_impl(value_type(std::forward<P>(value)));
+    }
+    
+    std::pair<iterator, bool> insert(value_type&& value) { 
+        return insert_impl(std::move(value)); 
+    }
+    
+    
+    iterator insert(const_iterator hint, const value_type& value) { 
+        if(hint != cend() && compare_keys(KeySelect()(*hint), KeySelect()(value))) { 
+            return mutable_iterator(hint); 
+        }
+        
+        return insert(value).first; 
+    }
+        
+    template<class P, typename std::enable_if<std::is_constructible<value_type, P&&>::value>::type* = nullptr>
+    iterator insert(const_iterator hint, P&& value) {
+        return emplace_hint(hint, std::forward<P>(value)); 
+    }
+    
+    iterator insert(const_iterator hint, value_type&& value) { 
+        if(hint != cend() && compare_keys(KeySelect()(*hint), KeySelect()(value))) { 
+            return mutable_iterator(hint); 
+        }
+        
+        return insert(std::move(value)).first; 
+    }
+    
+    
+    template<class InputIt>
+    void insert(InputIt first, InputIt last) {
+        if(std::is_base_of<std::forward_iterator_tag, 
+                           typename std::iterator_traits<InputIt>::iterator_category>::value) 
+        {
+            reserve_for_insert(std::distance(first, last));
+        }
+        
+        for(; first != last; ++first) {
+            insert(*first);
+        }
+    }
+    
+    /*
+     * Insert [first, last) in the empty table by writing the elements directly in their buckets, used by the 
+     * tsl::hh::bulk_construct_t constructors. Inserting the elements one by one writes to a random bucket for 
+     * each element, displaces the other elements to make room and checks the load factor on each insert. Instead:
+     * 1. The table is sized once for all the elements.
+     * 2. The elements are hashed and their (hash, home bucket, index) entries partitioned by ranges of 
+     *    2^BULK_INSERT_RANGE_BITS home buckets (stable counting sort on the high bits of the home bucket).
+     * 3. Range after range, the entries of the range are sorted by home bucket in a small buffer which stays 
+     *    in the cache (stable counting sort on the low bits) and the buckets are filled in one sequential pass: 
+     *    each element goes in the first bucket which is both at or after its home bucket and after the last 
+     *    filled bucket, no element is ever displaced.
+     * 4. The few elements whose bucket would be outside of their neighborhood are inserted at the end 
+     *    as usual (insert_with_hash), with displacements or in the overflow.
+     * 
+     * The sorts being stable, the first of equivalent elements is kept, as with insert.
+     * 
+     * Temporarily uses 32 bytes per element (on 64-bit), allocated with the allocator of the map. Same as 
+     * insert(first, last) if the table is not empty, if the iterators are not random access iterators 
+     * dereferencing to value_type or if there are more than 2^32 elements or buckets.
+     */
+    template<class InputIt, typename std::enable_if<is_bulk_insertable<InputIt>::value>::type* = nullptr>
+    void insert_bulk(InputIt first, InputIt last) {
+        if(m_nb_elements != 0 || m_old_table != nullptr) {
+            insert(first, last);
+            return;
+        }
+        
+        const std::size_t nb_values = std::size_t(std::distance(first, last));
+        if(nb_values == 0) {
+            return;
+        }
+        
+        reserve_for_insert(nb_values);
+        if(nb_values > std::numeric_limits<std::uint32_t>::max() || 
+           bucket_count() > std::numeric_limits<std::uint32_t>::max()) 
+        {
+            insert(first, last);
+            return;
+        }
+        
+        const std::size_t bucket_bits = bit_width(bucket_count() - 1);
+        const std::size_t range_bits = BULK_INSERT_RANGE_BITS;
+        const std::size_t range_shift = std::min(bucket_bits, range_bits);
+        const std::size_t nb_ranges = std::size_t(1) << (bucket_bits - range_shift);
+        
+        const bulk_insert_allocator entries_allocator(get_allocator());
+        std::vector<std::size_t> range_offsets(nb_ranges + 1, 0);
+        bulk_insert_entries partitioned(nb_values, bulk_insert_entry(), entries_allocator);
+        {
+            bulk_insert_entries entries(entries_allocator);
+            entries.reserve(nb_values);
+            for(std::size_t i = 0; i < nb_values; i++) {
+                const std::size_t hash = hash_key(KeySelect()(first[i]));
+                const std::size_t ibucket_for_hash = bucket_for_hash(hash);
+                
+                entries.push_back(bulk_insert_entry{hash, static_cast<std::uint32_t>(ibucket_for_hash), 
+                                                    static_cast<std::uint32_t>(i)});
+                range_offsets[(ibucket_for_hash >> range_shift) + 1]++;
+            }
+            
+            for(std::size_t irange = 1; irange <= nb_ranges; irange++) {
+                range_offsets[irange] += range_offsets[irange - 1];
+            }
+            
+            std::vector<std::size_t> next_offsets(range_offsets.begin(), range_offsets.end() - 1);
+            for(const bulk_insert_entry& entry: entries) {
+                partitioned[next_offsets[entry.ibucket_for_hash >> range_shift]++] = entry;
+            }
+        }
+        
+        bulk_insert_entries range_entries(entries_allocator);
+        std::vector<std::size_t> bucket_offsets((std::size_t(1) << range_shift) + 1);
+        bulk_insert_entries deferred_entries(entries_allocator);
+        std::size_t ibucket_next_empty = 0;
+        
+        for(std::size_t irange = 0; irange < nb_ranges; irange++) {
+            sort_by_home_bucket(partitioned.data() + range_offsets[irange], 
+                                partitioned.data() + range_offsets[irange + 1], 
+                                range_shift, range_entries, bucket_offsets);
+            
+            for(std::size_t ientry = 0; ientry < range_entries.size(); ientry++) {
+                if(ientry + BULK_INSERT_PREFETCH_DISTANCE < range_entries.size()) {
+                    const std::size_t index = range_entries[ientry + BULK_INSERT_PREFETCH_DISTANCE].index;
+                    prefetch_for_read(std::addressof(static_cast<const value_type&>(first[index])));
+                }
+                
+                const bulk_insert_entry& entry = range_entries[ientry];
+                
+                // All the buckets in [ibucket_for_hash, ibucket_next_empty) are already filled.
+                const std::size_t ibucket = std::max(std::size_t(entry.ibucket_for_hash), ibucket_next_empty);
+                if(ibucket - entry.ibucket_for_hash >= NeighborhoodSize) {
+                    deferred_entries.push_back(entry);
+                    continue;
+                }
+                
+                if(find_in_buckets(KeySelect()(first[entry.index]), entry.hash, 
+                                   m_buckets + entry.ibucket_for_hash) != nullptr) 
+                {
+                    continue;
+                }
+                
+                insert_in_bucket(ibucket, entry.ibucket_for_hash, entry.hash, first[entry.index]);
+                ibucket_next_empty = ibucket + 1;
+            }
+        }
+        
+        for(const bulk_insert_entry& entry: deferred_entries) {
+            insert_with_hash(entry.hash, first[entry.index]);
+        }
+    }
+    
+    template<class InputIt, typename std::enable_if<!is_bulk_insertable<InputIt>::value>::type* = nullptr>
+    void insert_bulk(InputIt first, InputIt last) {
+        insert(first, last);
+    }
+    
+    /*
+     * Insert the elements by batches of INSERT_BATCH_SIZE. The hashes of a batch are computed and 
+     * the home buckets prefetched first. Then the elements which have an empty bucket in their neighborhood 
+     * are placed directly while the elements needing a displacement (or an insertion in the overflow 
+     * container) are deferred to the end of the batch.
+     */
+    template<class ForwardIt, class OutputIt>
+    OutputIt insert_batch(ForwardIt first, ForwardIt last, OutputIt out) {
+        reserve_for_insert(std::distance(first, last));
+        
+        std::size_t hashes[INSERT_BATCH_SIZE];
+        bool inserted[INSERT_BATCH_SIZE];
+        
+        ForwardIt deferred_elements[INSERT_BATCH_SIZE];
+        std::size_t deferred_hashes[INSERT_BATCH_SIZE];
+        
+        while(first != last) {
+            advance_incremental_rehash(INSERT_BATCH_SIZE);
+            
+            const ForwardIt first_in_batch = first;
+            
+            std::size_t nb_elements_in_batch = 0;
+            for(; nb_elements_in_batch < INSERT_BATCH_SIZE && first != last; ++nb_elements_in_batch, ++first) {
+                const std::size_t hash = hash_key(KeySelect()(*first));
+                hashes[nb_elements_in_batch] = hash;
+                
+                if(!m_buckets_data.empty()) {
+                    m_buckets_data.prefetch(bucket_for_hash(hash));
+                }
+            }
+            
+            
+            std::size_t nb_deferred = 0;
+            ForwardIt it_element = first_in_batch;
+            for(std::size_t i = 0; i < nb_elements_in_batch; ++i, ++it_element) {
+                const std::size_t hash = hashes[i];
+                const std::size_t ibucket_for_hash = bucket_for_hash(hash);
+                
+                inserted[i] = !contains_impl(KeySelect()(*it_element), hash, ibucket_for_hash) && 
+                              !contains_deferred(KeySelect()(*it_element), hash, 
+                                                 deferred_elements, deferred_hashes, nb_deferred);
+                if(!inserted[i]) {
+                    continue;
+                }
+                
+                if((m_nb_elements - m_overflow_elements.size()) < m_max_load_threshold_rehash) {
+                    const std::size_t ibucket_empty = find_empty_bucket(ibucket_for_hash);
+                    if(ibucket_empty < m_buckets_data.size() && ibucket_empty - ibucket_for_hash < NeighborhoodSize) {
+                        insert_in_bucket(ibucket_empty, ibucket_for_hash, hash, *it_element);
+                        continue;
+                    }
+                }
+                
+                deferred_elements[nb_deferred] = it_element;
+                deferred_hashes[nb_deferred] = hash;
+                nb_deferred++;
+            }
+            
+            for(std::size_t i = 0; i < nb_deferred; i++) {
+                insert_value(bucket_for_hash(deferred_hashes[i]), deferred_hashes[i], *deferred_elements[i]);
+            }
+            
+            for(std::size_t i = 0; i < nb_elements_in_batch; i++) {
+                *out = inserted[i];
+                ++out;
+            }
+        }
+        
+        return out;
+    }
+    
+    
+    template<class M>
+    std::pair<iterator, bool> insert_or_assign(const key_type& k, M&& obj) { 
+        return insert_or_assign_impl(k, std::forward<M>(obj)); 
+    }
+
+    template<class M>
+    std::pair<iterator, bool> insert_or_assign(key_type&& k, M&& obj) { 
+        return insert_or_assign_impl(std::move(k), std::forward<M>(obj)); 
+    }
+    
+    
+    template<class M>
+    iterator insert_or_assign(const_iterator hint, const key_type& k, M&& obj) {
+        if(hint != cend() && compare_keys(KeySelect()(*hint), k)) { 
+            auto it = mutable_iterator(hint); 
+            it.value() = std::forward<M>(obj);
+            
+            return it;
+        }
+        
+        return insert_or_assign(k, std::forward<M>(obj)).first;
+    }
+    
+    template<class M>
+    iterator insert_or_assign(const_iterator hint, key_type&& k, M&& obj) {
+        if(hint != cend() && compare_keys(KeySelect()(*hint), k)) {
+            auto it = mutable_iterator(hint); 
+            it.value() = std::forward<M>(obj);
+            
+            return it;
+        }
+        
+        return insert_or_assign(std::move(k), std::forward<M>(obj)).first;
+    }
+    
+    
+    template<class... Args>
+    std::pair<iterator, bool> emplace(Args&&... args) {
+        return insert(value_type(std::forward<Args>(args)...));
+    }
+    
+    template<class... Args>
+    iterator emplace_hint(const_iterator hint, Args&&... args) {
+        return insert(hint, value_type(std::forward<Args>(args)...));        
+    }
+    
+    template<class... Args>
+    std::pair<iterator, bool> try_emplace(const key_type& k, Args&&... args) { 
+        return try_emplace_impl(k, std::forward<Args>(args)...);
+    }
+    
+    template<class... Args>
+    std::pair<iterator, bool> try_emplace(key_type&& k, Args&&... args) {
+        return try_emplace_impl(std::move(k), std::forward<Args>(args)...);
+    }
+    
+    template<class... Args>
+    iterator try_emplace(const_iterator hint, const key_type& k, Args&&... args) { 
+        if(hint != cend() && compare_keys(KeySelect()(*hint), k)) { 
+            return mutable_iterator(hint); 
+        }
+        
+        return try_emplace(k, std::forward<Args>(args)...).first;
+    }
+    
+    template<class... Args>
+    iterator try_emplace(const_iterator hint, key_type&& k, Args&&... args) {
+        if(hint != cend() && compare_keys(KeySelect()(*hint), k)) { 
+            return mutable_iterator(hint); 
+        }
+        
+        return try_emplace(std::move(k), std::forward<Args>(args)...).first;
+    }
+    
+    /*
+     * Same as try_emplace and insert but with the hash of the key already computed, 
+     * hash must be equal to hash_function()(key).
+     */
+    template<typename P, class... Args>
+    std::pair<iterator, bool> try_emplace_with_hash(std::size_t hash, P&& key, Args&&... args_value) {
+        advance_incremental_rehash();
+        
+        const std::size_t ibucket_for_hash = bucket_for_hash(hash);
+        
+        // Check if already presents
+        auto it_find = find_impl(key, hash, m_buckets + ibucket_for_hash);
+        if(it_find != end()) {
+            return std::make_pair(it_find, false);
+        }
+        
+        return insert_value(ibucket_for_hash, hash, std::piecewise_construct, 
+                                                    std::forward_as_tuple(std::forward<P>(key)), 
+                                                    std::forward_as_tuple(std::forward<Args>(args_value)...));
+    }
+    
+    template<typename P>
+    std::pair<iterator, bool> insert_with_hash(std::size_t hash, P&& value) {
+        advance_incremental_rehash();
+        
+        const std::size_t ibucket_for_hash = bucket_for_hash(hash);
+        
+        // Check if already presents
+        auto it_find = find_impl(KeySelect()(value), hash, m_buckets + ibucket_for_hash);
+        if(it_find != end()) {
+            return std::make_pair(it_find, false);
+        }
+        
+        
+        return insert_value(ibucket_for_hash, hash, std::forward<P>(value));
+    }
+    
+    
+    /**
+     * Here to avoid `template<class K> size_type erase(const K& key)` being used when
+     * we use an iterator instead of a const_iterator.
+     */
+    iterator erase(iterator pos) {
+        return erase(const_iterator(pos));
+    }
+    
+    iterator erase(const_iterator pos) {
+        if(pos.m_next_table != nullptr) {
+            return erase_from_old_table(pos);
+        }
+        
+        return erase_with_hash(pos, hash_key(pos.key()));
+    }
+    
+    iterator erase(const_iterator first, const_iterator last) {
+        if(first == last) {
+            return mutable_iterator(first);
+        }
+        
+        auto to_delete = erase(first);
+        while(to_delete != last) {
+            to_delete = erase(to_delete);
+        }
+        
+        return to_delete;
+    }
+    
+    template<class K>
+    size_type erase(const K& key) {
+        return erase(key, hash_key(key));
+    }
+    
+    template<class K>
+    size_type erase(const K& key, std::size_t hash) {
+        const std::size_t ibucket_for_hash = bucket_for_hash(hash);
+
+        hopscotch_bucket* bucket_found = find_in_buckets(key, hash, m_buckets + ibucket_for_hash);
+        if(bucket_found != nullptr) {
+            erase_from_bucket(std::size_t(bucket_found - m_buckets), ibucket_for_hash);
+            shrink_if_under_min_load_factor();
+
+            return 1;
+        }
+        
+        if(m_buckets[ibucket_for_hash].has_overflow()) {
+            auto it_overflow = find_in_overflow(key, hash);
+            if(it_overflow != m_overflow_elements.end()) {
+                erase_from_overflow(it_overflow, ibucket_for_hash);
+                shrink_if_under_min_load_factor();
+                
+                return 1;
+            }
+        }
+        
+        if(m_old_table != nullptr) {
+            const size_type nb_erased = m_old_table->erase(key, hash);
+            release_old_table_if_empty();
+            
+            return nb_erased;
+        }
+        
+        return 0;
+    }
+    
+    /*
+     * Node handles
+     */
+    node_type extract(const_iterator pos) {
+        if(pos.m_next_table != nullptr) {
+            node_type node = m_old_table->extract(to_old_table_iterator(pos));
+            release_old_table_if_empty();
+            
+            return node;
+        }
+        
+        return extract_with_hash(pos, hash_key(pos.key()));
+    }
+    
+    template<class K>
+    node_type extract(const K& key) {
+        return extract(key, hash_key(key));
+    }
+    
+    template<class K>
+    node_type extract(const K& key, std::size_t hash) {
+        const_iterator it = find(key, hash);
+        if(it == cend()) {
+            return node_type();
+        }
+        
+        if(it.m_next_table != nullptr) {
+            return extract(it);
+        }
+        
+        return extract_with_hash(it, hash);
+    }
+    
+    insert_return_type insert(node_type&& node) {
+        if(node.empty()) {
+            return insert_return_type{end(), false, node_type()};
+        }
+        
+        const std::size_t hash = (node.m_hash_valid && std::is_empty<Hash>::value)?
+                                    node.m_hash:hash_key(KeySelect()(node.value_ref()));
+        
+        auto it_inserted = insert_with_hash(hash, std::move(node.value_ref()));
+        if(!it_inserted.second) {
+            return insert_return_type{it_inserted.first, false, std::move(node)};
+        }
+        
+        node.reset();
+        return insert_return_type{it_inserted.first, true, node_type()};
+    }
+    
+    iterator insert(const_iterator hint, node_type&& node) {
+        if(!node.empty() && hint != cend() && compare_keys(KeySelect()(*hint), KeySelect()(node.value_ref()))) { 
+            return mutable_iterator(hint); 
+        }
+        
+        return insert(std::move(node)).position;
+    }
+    
+    /**
+     * Move the elements of source whose key is not in this table to this table. The elements of source
+     * with a key already present stay in source.
+     * 
+     * If the hash function is stateless (std::is_empty) and the hashes are stored (StoreHash), the stored hashes 
+     * of the elements in the buckets of source are reused when the growth policy allows it 
+     * (see USE_STORED_HASH_ON_REHASH) and the keys are not hashed again.
+     */
+    void merge(hopscotch_hash& source) {
+        if(&source == this) {
+            return;
+        }
+        
+        source.finish_incremental_rehash();
+        
+        for(std::size_t ibucket = 0; ibucket < source.m_buckets_data.size(); ibucket++) {
+            if(source.m_buckets[ibucket].empty()) {
+                continue;
+            }
+            
+            value_type& value = source.m_buckets_data.value(ibucket);
+            
+            const bool use_stored_hash = std::is_empty<Hash>::value && 
+                                         !has_hashed_lookup<OverflowContainer>::value &&
+                                         source.USE_STORED_HASH_ON_REHASH(source.bucket_count()) && 
+                                         USE_STORED_HASH_ON_REHASH(bucket_count());
+            const std::size_t source_hash = source.USE_STORED_HASH_ON_REHASH(source.bucket_count())?
+                                                source.m_buckets[ibucket].truncated_bucket_hash():
+                                                source.hash_key(KeySelect()(value));
+            const std::size_t hash = use_stored_hash?source_hash:hash_key(KeySelect()(value));
+            
+            if(find(KeySelect()(value), hash) != end()) {
+                continue;
+            }
+            
+            merge_value(hash, use_stored_hash, std::move(value));
+            source.erase_from_bucket(ibucket, source.bucket_for_hash(source_hash));
+        }
+        
+        for(auto it = source.m_overflow_elements.begin(); it != source.m_overflow_elements.end();) {
+            const std::size_t hash = hash_key(KeySelect()(*it));
+            if(find(KeySelect()(*it), hash) != end()) {
+                ++it;
+                continue;
+            }
+            
+            const std::size_t source_hash = source.hash_key(KeySelect()(*it));
+            insert_with_hash(hash, std::move(*it));
+            it = source.erase_from_overflow(it, source.bucket_for_hash(source_hash));
+        }
+        
+        source.shrink_if_under_min_load_factor();
+    }
+    
+    void swap(hopscotch_hash& other) {
+        using std::swap;
+        
+        swap_table_content(other);
+        swap(m_old_table, other.m_old_table);
+        swap(m_incremental_rehash_ibucket, other.m_incremental_rehash_ibucket);
+        swap(m_incremental_rehash_step, other.m_incremental_rehash_step);
+    }
+    
+    
+    /*
+     * Lookup
+     */
+    template<class K, class U = ValueSelect, typename std::enable_if<has_mapped_type<U>::value>::type* = nullptr>
+    typename U::value_type& at(const K& key) {
+        return at(key, hash_key(key));
+    }
+    
+    template<class K, class U = ValueSelect, typename std::enable_if<has_mapped_type<U>::value>::type* = nullptr>
+    typename U::value_type& at(const K& key, std::size_t hash) {
+        return const_cast<typename U::value_type&>(static_cast<const hopscotch_hash*>(this)->at(key, hash));
+    }
+    
+    
+    template<class K, class U = ValueSelect, typename std::enable_if<has_mapped_type<U>::value>::type* = nullptr>
+    const typename U::value_type& at(const K& key) const {
+        return at(key, hash_key(key));
+    }
+    
+    template<class K, class U = ValueSelect, typename std::enable_if<has_mapped_type<U>::value>::type* = nullptr>
+    const typename U::value_type& at(const K& key, std::size_t hash) const {
+        using T = typename U::value_type;
+        
+        const T* value = find_value_impl(key, hash, m_buckets + bucket_for_hash(hash));
+        if(value == nullptr) {
+            throw std::out_of_range("Couldn't find key.");
+        }
+        else {
+            return *value;
+        }
+    }
+    
+    
+    template<class K, class U = ValueSelect, typename std::enable_if<has_mapped_type<U>::value>::type* = nullptr>
+    typename U::value_type& operator[](K&& key) {
+        using T = typename U::value_type;
+        
+        advance_incremental_rehash();
+        
+        const std::size_t hash = hash_key(key);
+        const std::size_t ibucket_for_hash = bucket_for_hash(hash);
+        
+        T* value = find_value_impl(key, hash, m_buckets + ibucket_for_hash);
+        if(value != nullptr) {
+            return *value;
+        }
+        else {
+            return insert_value(ibucket_for_hash, hash, std::piecewise_construct, 
+                                                        std::forward_as_tuple(std::forward<K>(key)), 
+                                                        std::forward_as_tuple()).first.value();
+        }
+    }
+    
+    
+    template<class K>
+    size_type count(const K& key) const {
+        return count(key, hash_key(key));
+    }
+    
+    template<class K>
+    size_type count(const K& key, std::size_t hash) const {
         return count_impl(key, hash, m_buckets + bucket_for_hash(hash));
     }
     
     
-    template<class K>
-    iterator find(const K& key) {
-        return find(key, hash_key(key));
+    template<class K>
+    iterator find(const K& key) {
+        return find(key, hash_key(key));
+    }
+    
+    template<class K>
+    iterator find(const K& key, std::size_t hash) {
+        return find_impl(key, hash, m_buckets + bucket_for_hash(hash));
+    }
+    
+    
+    template<class K>
+    const_iterator find(const K& key) const {
+        return find(key, hash_key(key));
+    }
+    
+    template<class K>
+    const_iterator find(const K& key, std::size_t hash) const {
+        return find_impl(key, hash, m_buckets + bucket_for_hash(hash));
+    }
+    
+    
+    template<class K>
+    bool contains(const K& key) const {
+        return contains(key, hash_key(key));
+    }
+    
+    template<class K>
+    bool contains(const K& key, std::size_t hash) const {
+        return count(key, hash) != 0;
+    }
+    
+    
+    template<class ForwardIt, class OutputIt>
+    OutputIt find_batch(ForwardIt first, ForwardIt last, OutputIt out) {
+        return lookup_batch(*this, first, last, computed_hashes(), out, find_lookup());
+    }
+    
+    template<class ForwardIt, class HashIt, class OutputIt>
+    OutputIt find_batch(ForwardIt first, ForwardIt last, HashIt first_hash, OutputIt out) {
+        return lookup_batch(*this, first, last, precalculated_hashes<HashIt>(first_hash), out, find_lookup());
+    }
+    
+    template<class ForwardIt, class OutputIt>
+    OutputIt find_batch(ForwardIt first, ForwardIt last, OutputIt out) const {
+        return lookup_batch(*this, first, last, computed_hashes(), out, find_lookup());
+    }
+    
+    template<class ForwardIt, class HashIt, class OutputIt>
+    OutputIt find_batch(ForwardIt first, ForwardIt last, HashIt first_hash, OutputIt out) const {
+        return lookup_batch(*this, first, last, precalculated_hashes<HashIt>(first_hash), out, find_lookup());
+    }
+    
+    
+    template<class ForwardIt, class OutputIt>
+    OutputIt count_batch(ForwardIt first, ForwardIt last, OutputIt out) const {
+        return lookup_batch(*this, first, last, computed_hashes(), out, count_lookup());
+    }
+    
+    template<class ForwardIt, class HashIt, class OutputIt>
+    OutputIt count_batch(ForwardIt first, ForwardIt last, HashIt first_hash, OutputIt out) const {
+        return lookup_batch(*this, first, last, precalculated_hashes<HashIt>(first_hash), out, count_lookup());
+    }
+    
+    
+    template<class ForwardIt, class OutputIt>
+    OutputIt contains_batch(ForwardIt first, ForwardIt last, OutputIt out) const {
+        return lookup_batch(*this, first, last, computed_hashes(), out, contains_lookup());
+    }
+    
+    template<class ForwardIt, class HashIt, class OutputIt>
+    OutputIt contains_batch(ForwardIt first, ForwardIt last, HashIt first_hash, OutputIt out) const {
+        return lookup_batch(*this, first, last, precalculated_hashes<HashIt>(first_hash), out, contains_lookup());
+    }
+    
+    
+    /*
+     * Write the table in the mapped format (see mapped_header) by calling writer(const char* data, std::size_t size) 
+     * with the consecutive chunks of the output.
+     */
+    template<class Writer, class U = ValueSelect, typename std::enable_if<has_mapped_type<U>::value>::type* = nullptr>
+    void write_mapped(Writer& writer) const {
+        using bucket_type = mapped_bucket<typename KeySelect::key_type, typename U::value_type>;
+        static_assert(is_trivially_copyable<typename KeySelect::key_type>::value && 
+                      is_trivially_copyable<typename U::value_type>::value, 
+                      "Key and T must be trivially copyable to be written in the mapped format.");
+        
+        if(m_old_table != nullptr) {
+            throw std::logic_error("The incremental rehash must be finished before writing the map.");
+        }
+        
+        char header_data[MAPPED_BUCKETS_OFFSET] = {};
+        mapped_header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, MAPPED_MAGIC, sizeof(header.magic));
+        header.format_version = MAPPED_FORMAT_VERSION;
+        header.byte_order_mark = MAPPED_BYTE_ORDER_MARK;
+        header.neighborhood_size = NeighborhoodSize;
+        header.store_hash = StoreHash?1:0;
+        header.bucket_size = std::uint32_t(sizeof(bucket_type));
+        header.key_size = std::uint32_t(sizeof(typename KeySelect::key_type));
+        header.value_size = std::uint32_t(sizeof(typename U::value_type));
+        header.max_load_factor = m_max_load_factor;
+        header.bucket_count = bucket_count();
+        header.nb_buckets = m_buckets_data.size();
+        header.nb_elements = m_nb_elements;
+        header.nb_overflow_elements = m_overflow_elements.size();
+        std::memcpy(header_data, &header, sizeof(header));
+        writer(static_cast<const char*>(header_data), sizeof(header_data));
+        
+        // Zero-initialized so that the padding bytes of the output are deterministic
+        std::vector<bucket_type> chunk(MAPPED_WRITE_CHUNK_SIZE, bucket_type());
+        std::size_t chunk_size = 0;
+        auto flush_chunk = [&]() {
+            writer(reinterpret_cast<const char*>(chunk.data()), chunk_size*sizeof(bucket_type));
+            std::fill(chunk.begin(), chunk.begin() + chunk_size, bucket_type());
+            chunk_size = 0;
+        };
+        auto append = [&](std::uint64_t neighborhood_infos, truncated_hash_type hash, const value_type* value) {
+            bucket_type& bucket = chunk[chunk_size];
+            bucket.neighborhood_infos = neighborhood_infos;
+            bucket.truncated_hash = hash;
+            if(value != nullptr) {
+                bucket.key = KeySelect()(*value);
+                bucket.value = U()(*value);
+            }
+            
+            chunk_size++;
+            if(chunk_size == chunk.size()) {
+                flush_chunk();
+            }
+        };
+        
+        for(std::size_t ibucket = 0; ibucket < m_buckets_data.size(); ibucket++) {
+            const hopscotch_bucket& bucket = m_buckets[ibucket];
+            append(serialized_neighborhood_infos(bucket), bucket.truncated_bucket_hash(), 
+                   bucket.empty()?nullptr:&m_buckets_data.value(ibucket));
+        }
+        
+        for(const value_type& value: m_overflow_elements) {
+            append(1, StoreHash?hopscotch_bucket::truncate_hash(hash_key(KeySelect()(value))):0, &value);
+        }
+        
+        if(chunk_size > 0) {
+            flush_chunk();
+        }
+    }
+    
+    
+    /*
+     * Serialization protocol:
+     * - SERIALIZATION_PROTOCOL_VERSION, NeighborhoodSize and StoreHash as std::uint32_t;
+     * - bucket_count(), the size of the bucket array, the number of elements and the number of overflow 
+     *   elements as std::uint64_t, then the max load factor as a float;
+     * - for each bucket of the bucket array: its neighborhood infos as std::uint64_t (same bits as in 
+     *   hopscotch_bucket_infos), its truncated hash as std::uint32_t if StoreHash is true and its value 
+     *   if the bucket isn't empty;
+     * - the overflow elements.
+     */
+    template<class Serializer>
+    void serialize(Serializer& serializer) const {
+        if(m_old_table != nullptr) {
+            throw std::logic_error("The incremental rehash must be finished before serializing the map.");
+        }
+        
+        serialize_value(serializer, std::uint32_t(SERIALIZATION_PROTOCOL_VERSION));
+        serialize_value(serializer, std::uint32_t(NeighborhoodSize));
+        serialize_value(serializer, std::uint32_t(StoreHash?1:0));
+        serialize_value(serializer, std::uint64_t(bucket_count()));
+        serialize_value(serializer, std::uint64_t(m_buckets_data.size()));
+        serialize_value(serializer, std::uint64_t(m_nb_elements));
+        serialize_value(serializer, std::uint64_t(m_overflow_elements.size()));
+        serialize_value(serializer, m_max_load_factor);
+        
+        for(std::size_t ibucket = 0; ibucket < m_buckets_data.size(); ibucket++) {
+            const hopscotch_bucket& bucket = m_buckets[ibucket];
+            
+            serialize_value(serializer, serialized_neighborhood_infos(bucket));
+            if(StoreHash) {
+                serialize_value(serializer, std::uint32_t(bucket.truncated_bucket_hash()));
+            }
+            
+            if(!bucket.empty()) {
+                serializer(m_buckets_data.value(ibucket));
+            }
+        }
+        
+        for(const value_type& value: m_overflow_elements) {
+            serializer(value);
+        }
+    }
+    
+    /*
+     * Deserialize into this table, which must be empty.
+     * 
+     * If hash_compatible is true, the hash function, key equal and growth policy are assumed to be the same 
+     * as the ones of the serialized table and the bucket array is restored as it was, without hashing 
+     * the elements in the buckets. Otherwise the elements are inserted one by one.
+     */
+    template<class Deserializer>
+    void deserialize(Deserializer& deserializer, bool hash_compatible) {
+        tsl_hh_assert(m_nb_elements == 0 && m_buckets_data.empty());
+        
+        const std::uint32_t version = deserialize_value<std::uint32_t>(deserializer);
+        if(version != SERIALIZATION_PROTOCOL_VERSION) {
+            throw std::runtime_error("Can't deserialize the hopscotch_map/set. The protocol version header is invalid.");
+        }
+        
+        const std::uint32_t neighborhood_size = deserialize_value<std::uint32_t>(deserializer);
+        const bool store_hash = deserialize_value<std::uint32_t>(deserializer) != 0;
+        const std::uint64_t bucket_count_ds = deserialize_value<std::uint64_t>(deserializer);
+        const std::uint64_t nb_buckets_ds = deserialize_value<std::uint64_t>(deserializer);
+        const std::uint64_t nb_elements_ds = deserialize_value<std::uint64_t>(deserializer);
+        const std::uint64_t nb_overflow_elements_ds = deserialize_value<std::uint64_t>(deserializer);
+        const float max_load_factor_ds = deserialize_value<float>(deserializer);
+        
+        if(nb_overflow_elements_ds > nb_elements_ds || 
+           nb_buckets_ds > std::numeric_limits<std::size_t>::max() || 
+           nb_elements_ds > std::numeric_limits<std::size_t>::max()) 
+        {
+            throw std::runtime_error("Deserialized size is invalid.");
+        }
+        
+        if(!hash_compatible) {
+            this->max_load_factor(max_load_factor_ds);
+            if(nb_elements_ds > 0) {
+                reserve(size_type(nb_elements_ds));
+            }
+            
+            for(std::uint64_t ibucket = 0; ibucket < nb_buckets_ds; ibucket++) {
+                const std::uint64_t neighborhood_infos = deserialize_value<std::uint64_t>(deserializer);
+                if(store_hash) {
+                    deserialize_value<std::uint32_t>(deserializer);
+                }
+                
+                if((neighborhood_infos & 1) != 0) {
+                    insert(deserialize_value<value_type>(deserializer));
+                }
+            }
+            
+            for(std::uint64_t i = 0; i < nb_overflow_elements_ds; i++) {
+                insert(deserialize_value<value_type>(deserializer));
+            }
+            
+            if(size() != nb_elements_ds) {
+                throw std::runtime_error("Deserialized elements count doesn't match the serialized one.");
+            }
+            
+            return;
+        }
+        
+        
+        if(neighborhood_size != NeighborhoodSize || store_hash != StoreHash) {
+            throw std::runtime_error("The NeighborhoodSize or StoreHash of the serialized map doesn't match, "
+                                     "deserialize with hash_compatible set to false.");
+        }
+        
+        hopscotch_hash new_table = new_hopscotch_hash(size_type(bucket_count_ds));
+        if(new_table.bucket_count() != bucket_count_ds || new_table.m_buckets_data.size() != nb_buckets_ds) {
+            throw std::runtime_error("The GrowthPolicy of the serialized map doesn't match, "
+                                     "deserialize with hash_compatible set to false.");
+        }
+        new_table.max_load_factor(max_load_factor_ds);
+        
+        // Each element in the buckets must be the neighbor of one bucket
+        std::size_t nb_neighbors = 0;
+        for(std::size_t ibucket = 0; ibucket < new_table.m_buckets_data.size(); ibucket++) {
+            const std::uint64_t neighborhood_infos = deserialize_value<std::uint64_t>(deserializer);
+            const truncated_hash_type hash = StoreHash?truncated_hash_type(deserialize_value<std::uint32_t>(deserializer)):0;
+            
+            if((neighborhood_infos & 1) != 0) {
+                new_table.m_buckets_data.set_value_of_empty_bucket(ibucket, hash, 
+                                                                   deserialize_value<value_type>(deserializer));
+                new_table.m_nb_elements++;
+            }
+            
+            std::uint64_t neighbors = neighborhood_infos >> NB_RESERVED_BITS_IN_NEIGHBORHOOD;
+            while(neighbors != 0) {
+                const std::size_t ineighbor = count_trailing_zeros(neighbors);
+                if(ineighbor >= NeighborhoodSize || ibucket + ineighbor >= new_table.m_buckets_data.size()) {
+                    throw std::runtime_error("Deserialized neighborhood is invalid.");
+                }
+                
+                new_table.m_buckets[ibucket].toggle_neighbor_presence(ineighbor);
+                nb_neighbors++;
+                neighbors &= neighbors - 1;
+            }
+            
+            new_table.m_buckets[ibucket].set_overflow((neighborhood_infos & 2) != 0);
+        }
+        
+        for(std::uint64_t i = 0; i < nb_overflow_elements_ds; i++) {
+            value_type value = deserialize_value<value_type>(deserializer);
+            const std::size_t hash = new_table.hash_key(KeySelect()(value));
+            new_table.insert_in_overflow(new_table.bucket_for_hash(hash), hash, std::move(value));
+        }
+        
+        if(nb_neighbors != new_table.m_nb_elements - new_table.m_overflow_elements.size() || 
+           new_table.m_nb_elements != nb_elements_ds) 
+        {
+            throw std::runtime_error("Deserialized elements count doesn't match the serialized one.");
+        }
+        
+        new_table.swap_table_content(*this);
+    }
+    
+    
+    /*
+     * Lock-free lookup, only available with tsl::hh::segment_versions. It may run concurrently with one writer 
+     * modifying the table.
+     * 
+     * If the key is found, read(value) is called with the element, possibly while a writer modifies it. read must 
+     * only copy the bytes of the value and the copy may only be used if found is returned. read may be called 
+     * more than once. The keys of the neighborhood are also compared while they may be modified, Key and KeyEqual 
+     * should thus be trivial (e.g. integers).
+     * 
+     * Return retry_with_lock if the key may be in the overflow container or if the lookup was interrupted 
+     * by the writers too many times, the lookup must then be done again while holding the writer lock.
+     */
+    template<class K, class Read, class V = Versions, 
+             typename std::enable_if<!std::is_same<V, tsl::hh::no_bucket_versions>::value>::type* = nullptr>
+    optimistic_lookup_result find_optimistic(const K& key, std::size_t hash, Read&& read) const {
+        static_assert(bucket_versions_type::SEGMENT_SIZE >= NeighborhoodSize, 
+                      "A neighborhood must not span more than two segments.");
+        
+        const typename bucket_versions_type::read_guard read_guard(versions());
+        for(std::size_t attempt = 0; attempt < MAX_OPTIMISTIC_LOOKUP_ATTEMPTS; attempt++) {
+            const std::uint32_t table_version = versions().load_table_version();
+            if((table_version & 1) != 0) {
+                continue;
+            }
+            
+            const typename bucket_versions_type::table_view* view = versions().load_view();
+            if(view == nullptr) {
+                return optimistic_lookup_result::retry_with_lock;
+            }
+            
+            const std::size_t ibucket = view->growth_policy.bucket_for_hash(hash);
+            const std::size_t ibucket_last = ibucket + NeighborhoodSize - 1;
+            const std::uint32_t version_first = versions().load_segment_version(ibucket);
+            const std::uint32_t version_last = versions().load_segment_version(ibucket_last);
+            if(((version_first | version_last) & 1) != 0) {
+                continue;
+            }
+            
+            const hopscotch_bucket& bucket = view->buckets.bucket(ibucket);
+            bool found = false;
+            
+            std::uint64_t candidates = bucket.neighborhood_infos();
+            while(candidates != 0) {
+                const std::size_t icandidate = ibucket + count_trailing_zeros(candidates);
+                if((!StoreHash || view->buckets.bucket(icandidate).bucket_hash_equal(hash)) && 
+                   compare_keys(KeySelect()(view->buckets.value(icandidate)), key))
+                {
+                    read(view->buckets.value(icandidate));
+                    found = true;
+                    break;
+                }
+                
+                candidates &= candidates - 1;
+            }
+            
+            if(!found && bucket.has_overflow()) {
+                return optimistic_lookup_result::retry_with_lock;
+            }
+            
+            if(versions().validate(table_version, ibucket, version_first, ibucket_last, version_last)) {
+                return found?optimistic_lookup_result::found:optimistic_lookup_result::not_found;
+            }
+        }
+        
+        return optimistic_lookup_result::retry_with_lock;
+    }
+    
+    /*
+     * Call modifier(pos) to modify the value pointed by pos in place. With tsl::hh::segment_versions, 
+     * the modification is seen as a write of the bucket by the concurrent lock-free lookups.
+     */
+    template<class Modifier>
+    void modify(iterator pos, Modifier&& modifier) {
+        if(pos.m_next_table == nullptr && pos.m_buckets_iterator != pos.m_buckets_end_iterator) {
+            const std::size_t ibucket = std::size_t(pos.m_buckets_iterator - m_buckets_data.begin());
+            
+            buckets_write_guard guard(*this, ibucket, ibucket);
+            modifier(pos);
+        }
+        else {
+            modifier(pos);
+        }
+    }
+    
+    
+    template<class K>
+    std::pair<iterator, iterator> equal_range(const K& key) {
+        return equal_range(key, hash_key(key));
+    }
+    
+    template<class K>
+    std::pair<iterator, iterator> equal_range(const K& key, std::size_t hash) {
+        iterator it = find(key, hash);
+        return std::make_pair(it, (it == end())?it:std::next(it));
+    }
+    
+    
+    template<class K>
+    std::pair<const_iterator, const_iterator> equal_range(const K& key) const {
+        return equal_range(key, hash_key(key));
+    }
+    
+    template<class K>
+    std::pair<const_iterator, const_iterator> equal_range(const K& key, std::size_t hash) const {
+        const_iterator it = find(key, hash);
+        return std::make_pair(it, (it == cend())?it:std::next(it));
+    }
+    
+    /*
+     * Bucket interface 
+     */
+    size_type bucket_count() const {
+        /*
+         * So that the last bucket can have NeighborhoodSize neighbors, the size of the bucket array is a little
+         * bigger than the real number of buckets when not empty. 
+         * We could use some of the buckets at the beginning, but it is faster this way as we avoid extra checks.
+         */
+        if(m_buckets_data.empty()) {
+            return 0;
+        }
+        
+        return m_buckets_data.size() - NeighborhoodSize + 1; 
+    }
+    
+    size_type max_bucket_count() const {
+        const std::size_t max_bucket_count = std::min(GrowthPolicy::max_bucket_count(), m_buckets_data.max_size());
+        return max_bucket_count - NeighborhoodSize + 1;
+    }
+    
+    
+    /*
+     *  Hash policy 
+     */
+    float load_factor() const {
+        if(bucket_count() == 0) {
+            return 0;
+        }
+        
+        return float(size())/float(bucket_count());
+    }
+    
+    float max_load_factor() const {
+        return m_max_load_factor;
+    }
+    
+    void max_load_factor(float ml) {
+        m_max_load_factor = std::max(0.1f, std::min(ml, 0.95f));
+        m_max_load_threshold_rehash = size_type(float(bucket_count())*m_max_load_factor);
+        m_min_load_threshold_rehash = size_type(float(bucket_count())*MIN_LOAD_FACTOR_FOR_REHASH);
+        
+        min_load_factor(m_min_load_factor);
+    }
+    
+    float min_load_factor() const {
+        return m_min_load_factor;
+    }
+    
+    void min_load_factor(float ml) {
+        m_min_load_factor = std::max(0.0f, std::min(ml, m_max_load_factor*MAX_MIN_LOAD_FACTOR_RATIO));
+        m_min_load_threshold_shrink = size_type(float(bucket_count())*m_min_load_factor);
+    }
+    
+    void rehash(size_type count_) {
+        finish_incremental_rehash();
+        rehash_current_table(count_);
+    }
+    
+    void shrink_to_fit() {
+        finish_incremental_rehash();
+        shrink_current_table(m_max_load_factor);
+    }
+    
+    void reserve(size_type count_) {
+        rehash(size_type(std::ceil(float(count_)/max_load_factor())));
+    }
+    
+    void rehash_parallel(size_type count_, std::size_t nb_threads) {
+        rehash_parallel(count_, nb_threads, thread_executor());
+    }
+    
+    template<class Executor>
+    void rehash_parallel(size_type count_, std::size_t nb_tasks, Executor&& executor) {
+        finish_incremental_rehash();
+        
+        count_ = std::max(count_, size_type(std::ceil(float(m_nb_elements)/max_load_factor())));
+        if(skip_same_size_rehash(count_)) {
+            return;
+        }
+        
+        rehash_parallel_impl(count_, nb_tasks, executor);
+    }
+    
+    void reserve_parallel(size_type count_, std::size_t nb_threads) {
+        reserve_parallel(count_, nb_threads, thread_executor());
     }
     
-    template<class K>
-    iterator find(const K& key, std::size_t hash) {
-        return find_impl(key, hash, m_buckets + bucket_for_hash(hash));
+    template<class Executor>
+    void reserve_parallel(size_type count_, std::size_t nb_tasks, Executor&& executor) {
+        rehash_parallel(size_type(std::ceil(float(count_)/max_load_factor())), nb_tasks, 
+                        std::forward<Executor>(executor));
+    }
+    
+    /*
+     * Incremental rehash
+     */
+    size_type incremental_rehash_step() const noexcept {
+        return m_incremental_rehash_step;
+    }
+    
+    void incremental_rehash_step(size_type nb_buckets_per_insert) {
+        m_incremental_rehash_step = nb_buckets_per_insert;
+        if(m_incremental_rehash_step == 0) {
+            finish_incremental_rehash();
+        }
+    }
+    
+    bool incremental_rehash_in_progress() const noexcept {
+        return m_old_table != nullptr;
+    }
+    
+    void finish_incremental_rehash() {
+        while(m_old_table != nullptr) {
+            migrate_from_old_table(std::numeric_limits<size_type>::max());
+        }
+    }
+    
+    
+    /*
+     * Observers
+     */
+    hasher hash_function() const {
+        return static_cast<const Hash&>(*this);
+    }
+    
+    key_equal key_eq() const {
+        return static_cast<const KeyEqual&>(*this);
+    }
+    
+    /*
+     * Other
+     */
+    iterator mutable_iterator(const_iterator pos) {
+        if(pos.m_next_table != nullptr) {
+            return to_composite_iterator(m_old_table->mutable_iterator(to_old_table_iterator(pos)));
+        }
+        
+        if(pos.m_buckets_iterator != pos.m_buckets_end_iterator) {
+            // Get a non-const iterator
+            auto it = m_buckets_data.begin() + (pos.m_buckets_iterator - m_buckets_data.cbegin());
+            return iterator(it, m_buckets_data.end(), m_overflow_elements.begin());
+        }
+        else {
+            // Get a non-const iterator
+            auto it = mutable_overflow_iterator(pos.m_overflow_iterator);
+            return iterator(m_buckets_data.end(), m_buckets_data.end(), it);
+        }
+    }
+    
+    size_type overflow_size() const noexcept {
+        return (m_old_table == nullptr)?m_overflow_elements.size():
+                                        m_overflow_elements.size() + m_old_table->m_overflow_elements.size();
+    }
+    
+    template<class U = OverflowContainer, typename std::enable_if<has_key_compare<U>::value>::type* = nullptr>
+    typename U::key_compare key_comp() const {
+        return m_overflow_elements.key_comp();
+    }
+    
+    /*
+     * Counters of the events (only non-zero with tsl::hh::collect_stats) and histograms of the current table 
+     * (and of the old table during an incremental rehash). Goes through all the buckets.
+     */
+    tsl::hh::hopscotch_stats stats() const {
+        tsl::hh::hopscotch_stats stats;
+        stats.size = size();
+        stats.bucket_count = bucket_count();
+        stats.overflow_size = overflow_size();
+        stats.load_factor = load_factor();
+        stats_counters_type::fill_counters(stats);
+        
+        stats.neighbor_offset_histogram.resize(NeighborhoodSize, 0);
+        stats.neighborhood_popcount_histogram.resize(NeighborhoodSize + 1, 0);
+        
+        add_to_histograms(stats);
+        if(m_old_table != nullptr) {
+            m_old_table->add_to_histograms(stats);
+        }
+        
+        return stats;
+    }
+    
+    
+private:
+    bucket_versions_type& versions() noexcept {
+        return *this;
+    }
+    
+    const bucket_versions_type& versions() const noexcept {
+        return *this;
     }
     
+    /*
+     * Mark the buckets in [ibucket_first, ibucket_last] as being modified for the lock-free lookups 
+     * during the lifetime of the guard (see tsl::hh::segment_versions).
+     */
+    class buckets_write_guard {
+    public:
+        buckets_write_guard(hopscotch_hash& table, std::size_t ibucket_first, std::size_t ibucket_last) noexcept: 
+                                m_table(table), m_ibucket_first(ibucket_first), m_ibucket_last(ibucket_last)
+        {
+            m_table.versions().begin_buckets_write(m_ibucket_first, m_ibucket_last);
+        }
+        
+        buckets_write_guard(const buckets_write_guard&) = delete;
+        buckets_write_guard& operator=(const buckets_write_guard&) = delete;
+        
+        ~buckets_write_guard() {
+            m_table.versions().end_buckets_write(m_ibucket_first, m_ibucket_last);
+        }
+    
+    private:
+        hopscotch_hash& m_table;
+        std::size_t m_ibucket_first;
+        std::size_t m_ibucket_last;
+    };
+    
+    /*
+     * Mark the whole table as being modified for the lock-free lookups during the lifetime of the guard 
+     * and publish the new state of the table (bucket array and growth policy) at the end.
+     */
+    class table_write_guard {
+    public:
+        /*
+         * Only throws if replaces_buckets is true, in which case the guard prepares the publication of 
+         * a new bucket array.
+         */
+        explicit table_write_guard(hopscotch_hash& table, bool replaces_buckets = true): m_table(table) {
+            m_table.versions().begin_table_write(m_table.m_buckets_data.make_read_view(m_table.m_buckets), 
+                                                 static_cast<const GrowthPolicy&>(m_table), replaces_buckets);
+        }
+        
+        table_write_guard(const table_write_guard&) = delete;
+        table_write_guard& operator=(const table_write_guard&) = delete;
+        
+        ~table_write_guard() {
+            m_table.versions().end_table_write(m_table.m_buckets_data.make_read_view(m_table.m_buckets), 
+                                               static_cast<const GrowthPolicy&>(m_table));
+        }
+    
+    private:
+        hopscotch_hash& m_table;
+    };
+    
+    /**
+     * Value stored in 'bucket', which must be a non-empty bucket of m_buckets_data.
+     */
+    const value_type& bucket_value(const hopscotch_bucket* bucket) const noexcept {
+        tsl_hh_assert(bucket >= m_buckets_data.data() && bucket < m_buckets_data.data() + m_buckets_data.size());
+        return m_buckets_data.value(std::size_t(bucket - m_buckets_data.data()));
+    }
     
     template<class K>
-    const_iterator find(const K& key) const {
-        return find(key, hash_key(key));
+    std::size_t hash_key(const K& key) const {
+        return Hash::operator()(key);
+    }
+    
+    template<class K1, class K2>
+    bool compare_keys(const K1& key1, const K2& key2) const {
+        return KeyEqual::operator()(key1, key2);
+    }
+    
+    std::size_t bucket_for_hash(std::size_t hash) const {
+        const std::size_t bucket = GrowthPolicy::bucket_for_hash(hash);
+        tsl_hh_assert(bucket < m_buckets_data.size() || (bucket == 0 && m_buckets_data.empty()));
+        
+        return bucket;
+    }
+    
+    template<typename U = value_type, 
+             typename std::enable_if<std::is_nothrow_move_constructible<U>::value>::type* = nullptr>
+    void rehash_impl(size_type count_) {
+        table_write_guard guard(*this);
+        hopscotch_hash new_map = new_hopscotch_hash(count_);
+        
+        if(!m_overflow_elements.empty()) {
+            new_map.m_overflow_elements.swap(m_overflow_elements);
+            new_map.m_nb_elements += new_map.m_overflow_elements.size();
+            
+            for(const value_type& value : new_map.m_overflow_elements) {
+                const std::size_t ibucket_for_hash = new_map.bucket_for_hash(new_map.hash_key(KeySelect()(value)));
+                new_map.m_buckets[ibucket_for_hash].set_overflow(true);
+            }
+        }
+        
+        try {
+            const bool use_stored_hash = USE_STORED_HASH_ON_REHASH(new_map.bucket_count());
+            for(std::size_t ibucket = 0; ibucket < m_buckets_data.size(); ibucket++) {
+                if(m_buckets[ibucket].empty()) {
+                    continue;
+                }
+                
+                const std::size_t hash = use_stored_hash?
+                                            m_buckets[ibucket].truncated_bucket_hash():
+                                            new_map.hash_key(KeySelect()(m_buckets_data.value(ibucket)));
+                const std::size_t ibucket_for_hash = new_map.bucket_for_hash(hash);
+                
+                new_map.insert_value(ibucket_for_hash, hash, std::move(m_buckets_data.value(ibucket)));
+                
+                
+                erase_from_bucket(ibucket, bucket_for_hash(hash));
+            }
+        } 
+        /*
+         * The call to insert_value may throw an exception if an element is added to the overflow
+         * list. Rollback the elements in this case.
+         */
+        catch(...) {
+            m_overflow_elements.swap(new_map.m_overflow_elements);
+            
+            const bool use_stored_hash = USE_STORED_HASH_ON_REHASH(new_map.bucket_count());
+            for(std::size_t ibucket = 0; ibucket < new_map.m_buckets_data.size(); ibucket++) {
+                if(new_map.m_buckets[ibucket].empty()) {
+                    continue;
+                }
+                
+                const std::size_t hash = use_stored_hash?
+                                            new_map.m_buckets[ibucket].truncated_bucket_hash():
+                                            hash_key(KeySelect()(new_map.m_buckets_data.value(ibucket)));
+                const std::size_t ibucket_for_hash = bucket_for_hash(hash);
+                
+                // The elements we insert were not in the overflow list before the switch.
+                // They will not be go in the overflow list if we rollback the switch.
+                insert_value(ibucket_for_hash, hash, std::move(new_map.m_buckets_data.value(ibucket)));
+            }
+            
+            throw;
+        }
+        
+        new_map.swap_table_content(*this);
+        versions().retire_buckets(new_map.m_buckets_data);
+    }
+    
+    template<typename U = value_type, 
+             typename std::enable_if<std::is_copy_constructible<U>::value && 
+                                     !std::is_nothrow_move_constructible<U>::value>::type* = nullptr>
+    void rehash_impl(size_type count_) {
+        table_write_guard guard(*this);
+        hopscotch_hash new_map = new_hopscotch_hash(count_);
+                
+        const bool use_stored_hash = USE_STORED_HASH_ON_REHASH(new_map.bucket_count());
+        for(std::size_t ibucket = 0; ibucket < m_buckets_data.size(); ibucket++) {
+            if(m_buckets[ibucket].empty()) {
+                continue;
+            }
+            
+            const std::size_t hash = use_stored_hash?
+                                         m_buckets[ibucket].truncated_bucket_hash():
+                                         new_map.hash_key(KeySelect()(m_buckets_data.value(ibucket)));
+            const std::size_t ibucket_for_hash = new_map.bucket_for_hash(hash);
+            
+            new_map.insert_value(ibucket_for_hash, hash, 
+                                 static_cast<const value_type&>(m_buckets_data.value(ibucket)));
+        }
+        
+        for(const value_type& value: m_overflow_elements) {
+            const std::size_t hash = new_map.hash_key(KeySelect()(value));
+            const std::size_t ibucket_for_hash = new_map.bucket_for_hash(hash);
+            
+            new_map.insert_value(ibucket_for_hash, hash, value);
+        }
+            
+        new_map.swap_table_content(*this);
+        versions().retire_buckets(new_map.m_buckets_data);
+    }
+    
+    /*
+     * Parallel rehash.
+     * 
+     * The new bucket array is split in nb_tasks contiguous ranges of buckets. Each task places the elements 
+     * whose home bucket is in its range without ever looking outside of it, so the tasks never touch the same 
+     * bucket. The work is done in five steps, each step being a call to the executor:
+     * 1. Hash the elements of a slice of the old buckets and count them by destination range.
+     * 2. Scatter the indexes of the old buckets, grouped by destination range (counting sort).
+     * 3. Compute the final position of each element in the scratch arrays 'placements' (index of the 
+     *    old bucket moved in each new bucket) and 'neighborhoods' (neighborhood bitmap of each new bucket), 
+     *    with the same displacement algorithm as insert_value but restricted to the range of the task. 
+     *    The few elements which can't be placed in their range (the range is full near its end) are deferred 
+     *    and placed sequentially afterwards on the whole array.
+     * 4. (Sequential) Set the overflow flags in the new buckets and move the overflow elements, as in rehash_impl.
+     * 5. Move the values to their new bucket.
+     * 
+     * Everything which may throw (hash function, allocations) is done before step 5, the map is left unchanged 
+     * if an exception is thrown. If an element can't be placed without an overflow or a new rehash, 
+     * fallback to rehash_impl.
+     */
+    template<class Executor, typename U = value_type, 
+             typename std::enable_if<std::is_nothrow_move_constructible<U>::value>::type* = nullptr>
+    void rehash_parallel_impl(size_type count_, std::size_t nb_tasks, Executor& executor) {
+        table_write_guard guard(*this);
+        
+        nb_tasks = std::min(nb_tasks, count_/MIN_BUCKETS_PER_REHASH_TASK);
+        if(nb_tasks <= 1 || m_nb_elements == m_overflow_elements.size()) {
+            rehash_impl(count_);
+            return;
+        }
+        
+        hopscotch_hash new_map = new_hopscotch_hash(count_);
+        
+        const std::size_t nb_old_buckets = m_buckets_data.size();
+        const std::size_t nb_new_buckets = new_map.m_buckets_data.size();
+        const std::size_t old_range_size = (nb_old_buckets + nb_tasks - 1)/nb_tasks;
+        const std::size_t new_range_size = (new_map.bucket_count() + nb_tasks - 1)/nb_tasks;
+        
+        auto old_range_begin = [&](std::size_t itask) { return std::min(itask*old_range_size, nb_old_buckets); };
+        auto new_range_begin = [&](std::size_t itask) { 
+            return (itask == nb_tasks)?nb_new_buckets:std::min(itask*new_range_size, nb_new_buckets); 
+        };
+        auto destination_task = [&](std::size_t hash) { 
+            return std::min(new_map.bucket_for_hash(hash)/new_range_size, nb_tasks - 1); 
+        };
+        
+        
+        // 1. Hash and count
+        const bool use_stored_hash = USE_STORED_HASH_ON_REHASH(new_map.bucket_count());
+        std::unique_ptr<std::size_t[]> hashes(new std::size_t[nb_old_buckets]);
+        std::vector<std::size_t> counts(nb_tasks*nb_tasks, 0);
+        
+        run_parallel_tasks(executor, nb_tasks, [&](std::size_t itask) {
+            std::size_t* task_counts = counts.data() + itask*nb_tasks;
+            for(std::size_t ibucket = old_range_begin(itask); ibucket < old_range_begin(itask + 1); ibucket++) {
+                if(m_buckets[ibucket].empty()) {
+                    continue;
+                }
+                
+                hashes[ibucket] = use_stored_hash?m_buckets[ibucket].truncated_bucket_hash():
+                                                  new_map.hash_key(KeySelect()(m_buckets_data.value(ibucket)));
+                task_counts[destination_task(hashes[ibucket])]++;
+            }
+        });
+        
+        
+        // 2. Scatter
+        std::vector<std::size_t> offsets(nb_tasks*nb_tasks);
+        std::vector<std::size_t> destination_begin(nb_tasks + 1);
+        std::size_t nb_values = 0;
+        for(std::size_t idestination = 0; idestination < nb_tasks; idestination++) {
+            destination_begin[idestination] = nb_values;
+            for(std::size_t isource = 0; isource < nb_tasks; isource++) {
+                offsets[isource*nb_tasks + idestination] = nb_values;
+                nb_values += counts[isource*nb_tasks + idestination];
+            }
+        }
+        destination_begin[nb_tasks] = nb_values;
+        
+        std::unique_ptr<std::size_t[]> old_ibuckets(new std::size_t[nb_values]);
+        run_parallel_tasks(executor, nb_tasks, [&](std::size_t itask) {
+            std::size_t* task_offsets = offsets.data() + itask*nb_tasks;
+            for(std::size_t ibucket = old_range_begin(itask); ibucket < old_range_begin(itask + 1); ibucket++) {
+                if(!m_buckets[ibucket].empty()) {
+                    old_ibuckets[task_offsets[destination_task(hashes[ibucket])]++] = ibucket;
+                }
+            }
+        });
+        
+        
+        // 3. Placement
+        std::unique_ptr<std::size_t[]> placements(new std::size_t[nb_new_buckets]);
+        std::unique_ptr<neighborhood_bitmap[]> neighborhoods(new neighborhood_bitmap[nb_new_buckets]);
+        std::vector<std::vector<std::size_t>> deferred(nb_tasks);
+        
+        run_parallel_tasks(executor, nb_tasks, [&](std::size_t itask) {
+            std::fill(placements.get() + new_range_begin(itask), placements.get() + new_range_begin(itask + 1), 
+                      std::size_t(NO_PLACEMENT));
+            std::fill(neighborhoods.get() + new_range_begin(itask), neighborhoods.get() + new_range_begin(itask + 1), 
+                      neighborhood_bitmap(0));
+            
+            for(std::size_t i = destination_begin[itask]; i < destination_begin[itask + 1]; i++) {
+                const std::size_t ibucket_old = old_ibuckets[i];
+                if(!place_for_rehash(placements.get(), neighborhoods.get(), 
+                                     new_map.bucket_for_hash(hashes[ibucket_old]), ibucket_old, 
+                                     new_range_begin(itask), new_range_begin(itask + 1))) 
+                {
+                    deferred[itask].push_back(ibucket_old);
+                }
+            }
+        });
+        
+        for(const std::vector<std::size_t>& task_deferred: deferred) {
+            for(const std::size_t ibucket_old: task_deferred) {
+                if(!place_for_rehash(placements.get(), neighborhoods.get(), 
+                                     new_map.bucket_for_hash(hashes[ibucket_old]), ibucket_old, 
+                                     0, nb_new_buckets)) 
+                {
+                    rehash_impl(count_);
+                    return;
+                }
+            }
+        }
+        
+        
+        // 4. Overflow
+        std::vector<std::size_t> overflow_ibuckets_for_hash;
+        overflow_ibuckets_for_hash.reserve(m_overflow_elements.size());
+        for(const value_type& value: m_overflow_elements) {
+            overflow_ibuckets_for_hash.push_back(new_map.bucket_for_hash(new_map.hash_key(KeySelect()(value))));
+        }
+        
+        // Nothing can throw from here
+        for(const std::size_t ibucket_for_hash: overflow_ibuckets_for_hash) {
+            new_map.m_buckets[ibucket_for_hash].set_overflow(true);
+        }
+        new_map.m_overflow_elements.swap(m_overflow_elements);
+        
+        
+        // 5. Move
+        std::vector<char> moved_ranges(nb_tasks, 0);
+        auto move_range = [&](std::size_t itask) noexcept {
+            for(std::size_t ibucket = new_range_begin(itask); ibucket < new_range_begin(itask + 1); ibucket++) {
+                const std::size_t ibucket_old = placements[ibucket];
+                if(ibucket_old != NO_PLACEMENT) {
+                    new_map.m_buckets_data.set_value_of_empty_bucket(ibucket, 
+                                                                     hopscotch_bucket::truncate_hash(hashes[ibucket_old]), 
+                                                                     std::move(m_buckets_data.value(ibucket_old)));
+                    m_buckets_data.remove_value(ibucket_old);
+                }
+                
+                for(std::size_t ineighbor = 0; ineighbor < NeighborhoodSize; ineighbor++) {
+                    if(((neighborhoods[ibucket] >> ineighbor) & 1) == 1) {
+                        new_map.m_buckets[ibucket].toggle_neighbor_presence(ineighbor);
+                    }
+                }
+            }
+            
+            moved_ranges[itask] = 1;
+        };
+        
+        /*
+         * The executor may fail to run some tasks (e.g. if a thread can't be created), 
+         * we can't rollback anymore, run them in this thread.
+         */
+        try {
+            executor(nb_tasks, move_range);
+        }
+        catch(...) {
+        }
+        
+        for(std::size_t itask = 0; itask < nb_tasks; itask++) {
+            if(moved_ranges[itask] == 0) {
+                move_range(itask);
+            }
+        }
+        
+        new_map.m_nb_elements = m_nb_elements;
+        m_nb_elements = 0;
+        new_map.swap_table_content(*this);
+        versions().retire_buckets(new_map.m_buckets_data);
     }
     
-    template<class K>
-    const_iterator find(const K& key, std::size_t hash) const {
-        return find_impl(key, hash, m_buckets + bucket_for_hash(hash));
+    template<class Executor, typename U = value_type, 
+             typename std::enable_if<!std::is_nothrow_move_constructible<U>::value>::type* = nullptr>
+    void rehash_parallel_impl(size_type count_, std::size_t /*nb_tasks*/, Executor& /*executor*/) {
+        rehash_impl(count_);
     }
     
-    
-    template<class K>
-    bool contains(const K& key) const {
-        return contains(key, hash_key(key));
+    /*
+     * Call task(itask) for each itask in [0, nb_tasks) through the executor and rethrow the first exception 
+     * thrown by a task, if any, once they are all complete.
+     */
+    template<class Executor, class Task>
+    static void run_parallel_tasks(Executor& executor, std::size_t nb_tasks, const Task& task) {
+        std::vector<std::exception_ptr> exceptions(nb_tasks);
+        executor(nb_tasks, [&](std::size_t itask) noexcept {
+            try {
+                task(itask);
+            }
+            catch(...) {
+                exceptions[itask] = std::current_exception();
+            }
+        });
+        
+        for(const std::exception_ptr& exception: exceptions) {
+            if(exception) {
+                std::rethrow_exception(exception);
+            }
+        }
     }
     
-    template<class K>
-    bool contains(const K& key, std::size_t hash) const {
-        return count(key, hash) != 0;
+    /*
+     * Copy the entries of [entries_first, entries_last), which all have the same home bucket >> range_shift, 
+     * to sorted_entries in the order of their home bucket (stable counting sort on the range_shift low bits).
+     * 
+     * bucket_offsets must have (1 << range_shift) + 1 elements, it's only passed to reuse its memory.
+     */
+    static void sort_by_home_bucket(const bulk_insert_entry* entries_first, const bulk_insert_entry* entries_last, 
+                                    std::size_t range_shift, bulk_insert_entries& sorted_entries, 
+                                    std::vector<std::size_t>& bucket_offsets) 
+    {
+        const std::size_t mask = (std::size_t(1) << range_shift) - 1;
+        tsl_hh_assert(bucket_offsets.size() == mask + 2);
+        
+        std::fill(bucket_offsets.begin(), bucket_offsets.end(), 0);
+        for(const bulk_insert_entry* entry = entries_first; entry != entries_last; ++entry) {
+            bucket_offsets[(entry->ibucket_for_hash & mask) + 1]++;
+        }
+        for(std::size_t i = 1; i < bucket_offsets.size(); i++) {
+            bucket_offsets[i] += bucket_offsets[i - 1];
+        }
+        
+        sorted_entries.resize(std::size_t(entries_last - entries_first));
+        for(const bulk_insert_entry* entry = entries_first; entry != entries_last; ++entry) {
+            sorted_entries[bucket_offsets[entry->ibucket_for_hash & mask]++] = *entry;
+        }
     }
     
-    
-    template<class K>
-    std::pair<iterator, iterator> equal_range(const K& key) {
-        return equal_range(key, hash_key(key));
+    /*
+     * Place the element of the old bucket ibucket_old, which belongs to ibucket_for_hash, in the scratch arrays 
+     * of rehash_parallel_impl. Same algorithm as insert_value with find_empty_bucket and swap_empty_bucket_closer, 
+     * but only the buckets in [ibucket_begin, ibucket_end) are read or modified.
+     * 
+     * Return false if no position could be found in the range.
+     */
+    static bool place_for_rehash(std::size_t* placements, neighborhood_bitmap* neighborhoods, 
+                                 std::size_t ibucket_for_hash, std::size_t ibucket_old, 
+                                 std::size_t ibucket_begin, std::size_t ibucket_end) noexcept
+    {
+        tsl_hh_assert(ibucket_begin <= ibucket_for_hash && ibucket_for_hash < ibucket_end);
+        
+        const std::size_t limit = std::min(ibucket_for_hash + MAX_PROBES_FOR_EMPTY_BUCKET, ibucket_end);
+        std::size_t ibucket_empty = ibucket_for_hash;
+        while(ibucket_empty < limit && placements[ibucket_empty] != NO_PLACEMENT) {
+            ibucket_empty++;
+        }
+        
+        if(ibucket_empty == limit) {
+            return false;
+        }
+        
+        while(ibucket_empty - ibucket_for_hash >= NeighborhoodSize) {
+            if(!swap_empty_placement_closer(placements, neighborhoods, ibucket_empty, ibucket_begin)) {
+                return false;
+            }
+        }
+        
+        placements[ibucket_empty] = ibucket_old;
+        neighborhoods[ibucket_for_hash] = neighborhood_bitmap(neighborhoods[ibucket_for_hash] | 
+                                                              (1ull << (ibucket_empty - ibucket_for_hash)));
+        
+        return true;
     }
     
-    template<class K>
-    std::pair<iterator, iterator> equal_range(const K& key, std::size_t hash) {
-        iterator it = find(key, hash);
-        return std::make_pair(it, (it == end())?it:std::next(it));
+    static bool swap_empty_placement_closer(std::size_t* placements, neighborhood_bitmap* neighborhoods, 
+                                            std::size_t& ibucket_empty_in_out, std::size_t ibucket_begin) noexcept
+    {
+        tsl_hh_assert(ibucket_empty_in_out >= NeighborhoodSize);
+        const std::size_t neighborhood_start = std::max(ibucket_empty_in_out - NeighborhoodSize + 1, ibucket_begin);
+        
+        for(std::size_t to_check = neighborhood_start; to_check < ibucket_empty_in_out; to_check++) {
+            for(std::size_t to_swap = to_check; to_swap < ibucket_empty_in_out; to_swap++) {
+                if(((neighborhoods[to_check] >> (to_swap - to_check)) & 1) == 1) {
+                    placements[ibucket_empty_in_out] = placements[to_swap];
+                    placements[to_swap] = NO_PLACEMENT;
+                    
+                    neighborhoods[to_check] = neighborhood_bitmap(neighborhoods[to_check] ^ 
+                                                                  (1ull << (ibucket_empty_in_out - to_check)) ^ 
+                                                                  (1ull << (to_swap - to_check)));
+                    
+                    ibucket_empty_in_out = to_swap;
+                    return true;
+                }
+            }
+        }
+        
+        return false;
     }
     
+    /*
+     * Neighborhood infos of bucket with the same bits as in hopscotch_bucket_infos, for the serialization.
+     */
+    static std::uint64_t serialized_neighborhood_infos(const hopscotch_bucket& bucket) noexcept {
+        return (std::uint64_t(bucket.neighborhood_infos()) << NB_RESERVED_BITS_IN_NEIGHBORHOOD) | 
+               (bucket.has_overflow()?2:0) | (bucket.empty()?0:1);
+    }
     
-    template<class K>
-    std::pair<const_iterator, const_iterator> equal_range(const K& key) const {
-        return equal_range(key, hash_key(key));
+    template<class Serializer, class U>
+    static void serialize_value(Serializer& serializer, const U& value) {
+        serializer(value);
     }
     
-    template<class K>
-    std::pair<const_iterator, const_iterator> equal_range(const K& key, std::size_t hash) const {
-        const_iterator it = find(key, hash);
-        return std::make_pair(it, (it == cend())?it:std::next(it));
+    template<class U, class Deserializer>
+    static U deserialize_value(Deserializer& deserializer) {
+        // MSVC < 2017 is not conformant, circumvent the problem by removing the template keyword
+#if defined (_MSC_VER) && _MSC_VER < 1910
+        return deserializer.operator()<U>();
+#else
+        return deserializer.template operator()<U>();
+#endif
     }
     
     /*
-     * Bucket interface 
+     * Swap the buckets, overflow elements and policies with other but not the incremental rehash state.
      */
-    size_type bucket_count() const {
-        /*
-         * So that the last bucket can have NeighborhoodSize neighbors, the size of the bucket array is a little
-         * bigger than the real number of buckets when not empty. 
-         * We could use some of the buckets at the beginning, but it is faster this way as we avoid extra checks.
-         */
-        if(m_buckets_data.empty()) {
-            return 0;
-        }
+    void swap_table_content(hopscotch_hash& other) {
+        using std::swap;
         
-        return m_buckets_data.size() - NeighborhoodSize + 1; 
-    }
-    
-    size_type max_bucket_count() const {
-        const std::size_t max_bucket_count = std::min(GrowthPolicy::max_bucket_count(), m_buckets_data.max_size());
-        return max_bucket_count - NeighborhoodSize + 1;
+        swap(static_cast<Hash&>(*this), static_cast<Hash&>(other));
+        swap(static_cast<KeyEqual&>(*this), static_cast<KeyEqual&>(other));
+        swap(static_cast<GrowthPolicy&>(*this), static_cast<GrowthPolicy&>(other));
+        m_buckets_data.swap(other.m_buckets_data);
+        swap(m_overflow_elements, other.m_overflow_elements);
+        swap(m_buckets, other.m_buckets);
+        swap(m_nb_elements, other.m_nb_elements);
+        swap(m_max_load_factor, other.m_max_load_factor);
+        swap(m_max_load_threshold_rehash, other.m_max_load_threshold_rehash);
+        swap(m_min_load_threshold_rehash, other.m_min_load_threshold_rehash);
+        swap(m_min_load_factor, other.m_min_load_factor);
+        swap(m_min_load_threshold_shrink, other.m_min_load_threshold_shrink);
     }
     
-    
     /*
-     *  Hash policy 
+     * Rehash the elements of this table, the elements of m_old_table (if any) stay where they are.
      */
-    float load_factor() const {
-        if(bucket_count() == 0) {
-            return 0;
+    void rehash_current_table(size_type count_) {
+        count_ = std::max(count_, size_type(std::ceil(float(m_nb_elements)/max_load_factor())));
+        if(skip_same_size_rehash(count_)) {
+            return;
         }
         
-        return float(m_nb_elements)/float(bucket_count());
-    }
-    
-    float max_load_factor() const {
-        return m_max_load_factor;
+        rehash_impl(count_);
     }
     
-    void max_load_factor(float ml) {
-        m_max_load_factor = std::max(0.1f, std::min(ml, 0.95f));
-        m_max_load_threshold_rehash = size_type(float(bucket_count())*m_max_load_factor);
-        m_min_load_threshold_rehash = size_type(float(bucket_count())*MIN_LOAD_FACTOR_FOR_REHASH);
+    /*
+     * With tsl::hh::segment_versions, a rehash retires the current bucket array until no reader uses it. 
+     * Don't replace the array with a copy of the same size, e.g. on a periodic reserve of the current size.
+     */
+    bool skip_same_size_rehash(size_type count_) const {
+        if(std::is_same<Versions, tsl::hh::no_bucket_versions>::value || m_buckets_data.empty() || 
+           m_old_table != nullptr) 
+        {
+            return false;
+        }
+        
+        // The growth policy may round up count_
+        GrowthPolicy policy(count_);
+        return count_ == bucket_count();
     }
     
-    void rehash(size_type count_) {
-        count_ = std::max(count_, size_type(std::ceil(float(size())/max_load_factor())));
-        rehash_impl(count_);
+    /*
+     * Rehash this table to the smallest bucket count keeping the load factor under target_load_factor,
+     * only if the growth policy gives a smaller bucket count than the current one.
+     */
+    void shrink_current_table(float target_load_factor) {
+        tsl_hh_assert(m_old_table == nullptr);
+        
+        std::size_t count_ = std::size_t(std::ceil(float(m_nb_elements)/target_load_factor));
+        if(count_ > 0) {
+            // The growth policy may round up count_
+            GrowthPolicy policy(count_);
+        }
+        
+        if(count_ < bucket_count()) {
+            rehash_impl(count_);
+        }
     }
     
-    void reserve(size_type count_) {
-        rehash(size_type(std::ceil(float(count_)/max_load_factor())));
+    /*
+     * Called after an erase by key. If the size went under the min load factor, shrink the table to 
+     * a load factor of max_load_factor()/2. As the min load factor is at most max_load_factor()/4, 
+     * the load factor after the shrink is far from both thresholds and alternating inserts and erases
+     * can't make the table grow and shrink repeatedly.
+     */
+    void shrink_if_under_min_load_factor() {
+        if(m_nb_elements < m_min_load_threshold_shrink && m_old_table == nullptr) {
+            shrink_current_table(m_max_load_factor/2);
+        }
     }
     
-    
     /*
-     * Observers
+     * Incremental rehash.
+     * 
+     * Instead of moving all the elements to a new bucket array when the max load factor is reached, 
+     * the current buckets are moved to m_old_table and this table continues with an empty bucket array 
+     * of count_ buckets. Each insert then migrates the elements of m_incremental_rehash_step buckets 
+     * of m_old_table. Until the migration is complete, the lookups which don't find a key in this table 
+     * look in m_old_table.
+     * 
+     * The overflow elements are directly moved to the new table, only the overflow flag of their 
+     * home bucket in the new table has to be set (as in rehash_impl).
      */
-    hasher hash_function() const {
-        return static_cast<const Hash&>(*this);
+    void start_incremental_rehash(size_type count_) {
+        tsl_hh_assert(m_old_table == nullptr);
+        
+        std::unique_ptr<hopscotch_hash> new_table(new hopscotch_hash(new_hopscotch_hash(count_)));
+        for(const value_type& value: m_overflow_elements) {
+            const std::size_t ibucket_for_hash = new_table->bucket_for_hash(new_table->hash_key(KeySelect()(value)));
+            new_table->m_buckets[ibucket_for_hash].set_overflow(true);
+        }
+        
+        new_table->m_overflow_elements.swap(m_overflow_elements);
+        new_table->m_nb_elements += new_table->m_overflow_elements.size();
+        m_nb_elements -= new_table->m_overflow_elements.size();
+        
+        // This table takes the new buckets and new_table keeps the buckets to migrate
+        swap_table_content(*new_table);
+        m_old_table = std::move(new_table);
+        m_incremental_rehash_ibucket = 0;
+        
+        release_old_table_if_empty();
     }
     
-    key_equal key_eq() const {
-        return static_cast<const KeyEqual&>(*this);
+    void advance_incremental_rehash(size_type nb_inserts = 1) {
+        if(m_old_table != nullptr) {
+            tsl_hh_assert(m_incremental_rehash_step > 0);
+            migrate_from_old_table(std::max(m_incremental_rehash_step*nb_inserts, 
+                                            min_nb_buckets_to_migrate(nb_inserts)));
+        }
     }
     
     /*
-     * Other
+     * Number of buckets of m_old_table which must be migrated before the next nb_inserts inserts so that 
+     * the migration is finished before this table reaches its max load threshold. Otherwise the growth of 
+     * this table would rehash all its elements at once while the migration is still in progress.
+     * 
+     * Once all the elements are migrated, this table will have nb_elements_migrated elements and can still 
+     * take nb_inserts_left inserts. The remaining buckets are spread over these inserts.
      */
-    iterator mutable_iterator(const_iterator pos) {
-        if(pos.m_buckets_iterator != pos.m_buckets_end_iterator) {
-            // Get a non-const iterator
-            auto it = m_buckets_data.begin() + std::distance(m_buckets_data.cbegin(), pos.m_buckets_iterator);
-            return iterator(it, m_buckets_data.end(), m_overflow_elements.begin());
-        }
-        else {
-            // Get a non-const iterator
-            auto it = mutable_overflow_iterator(pos.m_overflow_iterator);
-            return iterator(m_buckets_data.end(), m_buckets_data.end(), it);
+    size_type min_nb_buckets_to_migrate(size_type nb_inserts) const {
+        tsl_hh_assert(m_old_table != nullptr);
+        
+        const size_type nb_buckets_left = m_old_table->m_buckets_data.size() - m_incremental_rehash_ibucket;
+        const size_type nb_elements_migrated = (m_nb_elements - m_overflow_elements.size()) + 
+                                               m_old_table->m_nb_elements;
+        if(nb_elements_migrated + nb_inserts >= m_max_load_threshold_rehash) {
+            return nb_buckets_left;
         }
+        
+        const size_type nb_inserts_left = m_max_load_threshold_rehash - nb_elements_migrated;
+        return size_type(std::ceil(double(nb_buckets_left)*double(nb_inserts)/double(nb_inserts_left)));
     }
     
-    size_type overflow_size() const noexcept {
-        return m_overflow_elements.size();
+    /*
+     * Move the elements of the next nb_buckets buckets of m_old_table to this table. 
+     * Release m_old_table once it's empty.
+     */
+    void migrate_from_old_table(size_type nb_buckets) {
+        tsl_hh_assert(m_old_table != nullptr);
+        hopscotch_hash& old_table = *m_old_table;
+        
+        const size_type ibucket_end = (old_table.m_buckets_data.size() - m_incremental_rehash_ibucket > nb_buckets)?
+                                          m_incremental_rehash_ibucket + nb_buckets:
+                                          old_table.m_buckets_data.size();
+        for(; m_incremental_rehash_ibucket < ibucket_end && !old_table.empty(); m_incremental_rehash_ibucket++) {
+            const std::size_t ibucket = m_incremental_rehash_ibucket;
+            if(old_table.m_buckets[ibucket].empty()) {
+                continue;
+            }
+            
+            const std::size_t hash = USE_STORED_HASH_ON_REHASH(bucket_count())?
+                                        old_table.m_buckets[ibucket].truncated_bucket_hash():
+                                        hash_key(KeySelect()(old_table.m_buckets_data.value(ibucket)));
+            
+            // If insert_value throws, the value is still in old_table and m_incremental_rehash_ibucket unchanged.
+            insert_value(bucket_for_hash(hash), hash, std::move_if_noexcept(old_table.m_buckets_data.value(ibucket)));
+            old_table.erase_from_bucket(ibucket, old_table.bucket_for_hash(hash));
+        }
+        
+        release_old_table_if_empty();
     }
     
-    template<class U = OverflowContainer, typename std::enable_if<has_key_compare<U>::value>::type* = nullptr>
-    typename U::key_compare key_comp() const {
-        return m_overflow_elements.key_comp();
+    void release_old_table_if_empty() noexcept {
+        if(m_old_table != nullptr && m_old_table->empty()) {
+            m_old_table.reset();
+        }
     }
     
-    
-private:
-    template<class K>
-    std::size_t hash_key(const K& key) const {
-        return Hash::operator()(key);
+    iterator begin_current_table() noexcept {
+        auto begin = m_buckets_data.begin();
+        while(begin != m_buckets_data.end() && begin->empty()) {
+            ++begin;
+        }
+        
+        return iterator(begin, m_buckets_data.end(), m_overflow_elements.begin());
     }
     
-    template<class K1, class K2>
-    bool compare_keys(const K1& key1, const K2& key2) const {
-        return KeyEqual::operator()(key1, key2);
+    const_iterator begin_current_table() const noexcept {
+        auto begin = m_buckets_data.cbegin();
+        while(begin != m_buckets_data.cend() && begin->empty()) {
+            ++begin;
+        }
+        
+        return const_iterator(begin, m_buckets_data.cend(), m_overflow_elements.cbegin());
     }
     
-    std::size_t bucket_for_hash(std::size_t hash) const {
-        const std::size_t bucket = GrowthPolicy::bucket_for_hash(hash);
-        tsl_hh_assert(bucket < m_buckets_data.size() || (bucket == 0 && m_buckets_data.empty()));
+    /*
+     * Iterator to the first element of this table (not of m_old_table) in a bucket >= ibucket 
+     * or, if there is none, in the overflow elements.
+     */
+    iterator begin_at_bucket(std::size_t ibucket) noexcept {
+        auto it = m_buckets_data.begin() + ibucket;
+        while(it != m_buckets_data.end() && it->empty()) {
+            ++it;
+        }
         
-        return bucket;
+        return iterator(it, m_buckets_data.end(), m_overflow_elements.begin());
     }
     
-    template<typename U = value_type, 
-             typename std::enable_if<std::is_nothrow_move_constructible<U>::value>::type* = nullptr>
-    void rehash_impl(size_type count_) {
-        hopscotch_hash new_map = new_hopscotch_hash(count_);
-        
-        if(!m_overflow_elements.empty()) {
-            new_map.m_overflow_elements.swap(m_overflow_elements);
-            new_map.m_nb_elements += new_map.m_overflow_elements.size();
-            
-            for(const value_type& value : new_map.m_overflow_elements) {
-                const std::size_t ibucket_for_hash = new_map.bucket_for_hash(new_map.hash_key(KeySelect()(value)));
-                new_map.m_buckets[ibucket_for_hash].set_overflow(true);
-            }
+    const_iterator begin_at_bucket(std::size_t ibucket) const noexcept {
+        auto it = m_buckets_data.cbegin() + ibucket;
+        while(it != m_buckets_data.cend() && it->empty()) {
+            ++it;
         }
         
-        try {
-            const bool use_stored_hash = USE_STORED_HASH_ON_REHASH(new_map.bucket_count());
-            for(auto it_bucket = m_buckets_data.begin(); it_bucket != m_buckets_data.end(); ++it_bucket) {
-                if(it_bucket->empty()) {
-                    continue;
-                }
-                
-                const std::size_t hash = use_stored_hash?
-                                            it_bucket->truncated_bucket_hash():
-                                            new_map.hash_key(KeySelect()(it_bucket->value()));
-                const std::size_t ibucket_for_hash = new_map.bucket_for_hash(hash);
-                
-                new_map.insert_value(ibucket_for_hash, hash, std::move(it_bucket->value()));
-                
-                
-                erase_from_bucket(*it_bucket, bucket_for_hash(hash));
-            }
-        } 
-        /*
-         * The call to insert_value may throw an exception if an element is added to the overflow
-         * list. Rollback the elements in this case.
-         */
-        catch(...) {
-            m_overflow_elements.swap(new_map.m_overflow_elements);
-            
-            const bool use_stored_hash = USE_STORED_HASH_ON_REHASH(new_map.bucket_count());
-            for(auto it_bucket = new_map.m_buckets_data.begin(); it_bucket != new_map.m_buckets_data.end(); ++it_bucket) {
-                if(it_bucket->empty()) {
-                    continue;
-                }
-                
-                const std::size_t hash = use_stored_hash?
-                                            it_bucket->truncated_bucket_hash():
-                                            hash_key(KeySelect()(it_bucket->value()));
-                const std::size_t ibucket_for_hash = bucket_for_hash(hash);
-                
-                // The elements we insert were not in the overflow list before the switch.
-                // They will not be go in the overflow list if we rollback the switch.
-                insert_value(ibucket_for_hash, hash, std::move(it_bucket->value()));
-            }
-            
-            throw;
-        }
+        return const_iterator(it, m_buckets_data.cend(), m_overflow_elements.cbegin());
+    }
+    
+    /*
+     * The buckets are split in nb_partitions contiguous ranges whose sizes differ by at most one. 
+     * The overflow elements and the elements of m_old_table, if any, are respectively in the last 
+     * and the first partitions.
+     */
+    std::size_t partition_first_bucket(std::size_t ipartition, std::size_t nb_partitions) const noexcept {
+        const std::size_t nb_buckets = m_buckets_data.size();
+        return ipartition*(nb_buckets/nb_partitions) + std::min(ipartition, nb_buckets%nb_partitions);
+    }
+    
+    /*
+     * Convert an iterator of m_old_table to an iterator of this table.
+     */
+    iterator to_composite_iterator(iterator it_old_table) noexcept {
+        tsl_hh_assert(m_old_table != nullptr && it_old_table.m_next_table == nullptr);
+        it_old_table.m_next_table = this;
+        it_old_table.skip_to_next_table_if_at_end();
         
-        new_map.swap(*this);
+        return it_old_table;
     }
     
-    template<typename U = value_type, 
-             typename std::enable_if<std::is_copy_constructible<U>::value && 
-                                     !std::is_nothrow_move_constructible<U>::value>::type* = nullptr>
-    void rehash_impl(size_type count_) {
-        hopscotch_hash new_map = new_hopscotch_hash(count_);
-                
-        const bool use_stored_hash = USE_STORED_HASH_ON_REHASH(new_map.bucket_count());
-        for(const hopscotch_bucket& bucket: m_buckets_data) {
-            if(bucket.empty()) {
-                continue;
-            }
-            
-            const std::size_t hash = use_stored_hash?
-                                         bucket.truncated_bucket_hash():
-                                         new_map.hash_key(KeySelect()(bucket.value()));
-            const std::size_t ibucket_for_hash = new_map.bucket_for_hash(hash);
+    const_iterator to_composite_iterator(const_iterator it_old_table) const noexcept {
+        tsl_hh_assert(m_old_table != nullptr && it_old_table.m_next_table == nullptr);
+        it_old_table.m_next_table = this;
+        it_old_table.skip_to_next_table_if_at_end();
+        
+        return it_old_table;
+    }
+    
+    /*
+     * Convert an iterator of this table pointing to an element of m_old_table to an iterator of m_old_table.
+     */
+    const_iterator to_old_table_iterator(const_iterator pos) const noexcept {
+        tsl_hh_assert(pos.m_next_table == this);
+        pos.m_next_table = nullptr;
+        
+        return pos;
+    }
+    
+    iterator erase_from_old_table(const_iterator pos) {
+        tsl_hh_assert(m_old_table != nullptr);
+        
+        iterator it_next = to_composite_iterator(m_old_table->erase(to_old_table_iterator(pos)));
+        release_old_table_if_empty();
+        
+        return it_next;
+    }
+    
+    /*
+     * Erase the element at pos of this table (not of m_old_table), hash must be the hash of its key.
+     * The key isn't read, the value at pos may have been moved.
+     */
+    iterator erase_with_hash(const_iterator pos, std::size_t hash) {
+        tsl_hh_assert(pos.m_next_table == nullptr);
+        const std::size_t ibucket_for_hash = bucket_for_hash(hash);
+        
+        if(pos.m_buckets_iterator != pos.m_buckets_end_iterator) {
+            const std::size_t ibucket_for_value = std::size_t(pos.m_buckets_iterator - m_buckets_data.cbegin());
+            erase_from_bucket(ibucket_for_value, ibucket_for_hash);
             
-            new_map.insert_value(ibucket_for_hash, hash, bucket.value());
+            return ++iterator(m_buckets_data.begin() + ibucket_for_value, m_buckets_data.end(), 
+                              m_overflow_elements.begin()); 
+        }
+        else {
+            auto it_next_overflow = erase_from_overflow(pos.m_overflow_iterator, ibucket_for_hash);
+            return iterator(m_buckets_data.end(), m_buckets_data.end(), it_next_overflow);
         }
+    }
+    
+    /*
+     * Move the element at pos of this table (not of m_old_table) in a node handle and erase it, 
+     * hash must be the hash of its key.
+     */
+    node_type extract_with_hash(const_iterator pos, std::size_t hash) {
+        // The elements are never const in the table, only the access through a const_iterator is.
+        node_type node(hash, std::move(const_cast<value_type&>(*pos)));
+        erase_with_hash(pos, hash);
         
-        for(const value_type& value: m_overflow_elements) {
-            const std::size_t hash = new_map.hash_key(KeySelect()(value));
-            const std::size_t ibucket_for_hash = new_map.bucket_for_hash(hash);
-            
-            new_map.insert_value(ibucket_for_hash, hash, value);
+        return node;
+    }
+    
+    /*
+     * Insert value, known to be absent, for merge. If hash_is_truncated, hash is a stored hash and is only valid 
+     * for the current bucket count. If the table grows during the insertion to a bucket count where 
+     * USE_STORED_HASH_ON_REHASH doesn't hold anymore, the value is placed again with the full hash of its key.
+     */
+    void merge_value(std::size_t hash, bool hash_is_truncated, value_type&& value) {
+        const size_type bucket_count_before = bucket_count();
+        iterator it = insert_with_hash(hash, std::move(value)).first;
+        
+        if(hash_is_truncated && bucket_count() != bucket_count_before && !USE_STORED_HASH_ON_REHASH(bucket_count())) {
+            node_type node = extract_with_hash(it, hash);
+            insert_with_hash(hash_key(KeySelect()(node.value_ref())), std::move(node.value_ref()));
         }
-            
-        new_map.swap(*this);
+    }
+    
+    template<class K>
+    iterator find_in_old_table(const K& key, std::size_t hash) {
+        iterator it = m_old_table->find(key, hash);
+        return (it == m_old_table->end())?end():to_composite_iterator(it);
+    }
+    
+    template<class K>
+    const_iterator find_in_old_table(const K& key, std::size_t hash) const {
+        const hopscotch_hash& old_table = *m_old_table;
+        
+        const_iterator it = old_table.find(key, hash);
+        return (it == old_table.cend())?cend():to_composite_iterator(it);
     }
     
 #ifdef TSL_HH_NO_RANGE_ERASE_WITH_CONST_ITERATOR
@@ -1364,27 +4948,50 @@ private:
         
         // Check if we can remove the overflow flag
         tsl_hh_assert(m_buckets[ibucket_for_hash].has_overflow());
-        for(const value_type& value: m_overflow_elements) {
-            const std::size_t bucket_for_value = bucket_for_hash(hash_key(KeySelect()(value)));
-            if(bucket_for_value == ibucket_for_hash) {
-                return it_next;
-            }
+        if(overflow_has_values_for_bucket(ibucket_for_hash)) {
+            return it_next;
         }
         
+        buckets_write_guard guard(*this, ibucket_for_hash, ibucket_for_hash);
         m_buckets[ibucket_for_hash].set_overflow(false);
         return it_next;
     }
     
+    template<class U = OverflowContainer, typename std::enable_if<!has_hashed_lookup<U>::value>::type* = nullptr>
+    bool overflow_has_values_for_bucket(std::size_t ibucket) const {
+        for(const value_type& value: m_overflow_elements) {
+            if(bucket_for_hash(hash_key(KeySelect()(value))) == ibucket) {
+                return true;
+            }
+        }
+        
+        return false;
+    }
+    
+    /*
+     * Same as above but use the hashes stored in the overflow container instead of hashing all the keys.
+     */
+    template<class U = OverflowContainer, typename std::enable_if<has_hashed_lookup<U>::value>::type* = nullptr>
+    bool overflow_has_values_for_bucket(std::size_t ibucket) const {
+        for(auto it = m_overflow_elements.cbegin(); it != m_overflow_elements.cend(); ++it) {
+            if(bucket_for_hash(m_overflow_elements.stored_hash(it)) == ibucket) {
+                return true;
+            }
+        }
+        
+        return false;
+    }
+    
 
     /**
-     * bucket_for_value is the bucket in which the value is.
+     * ibucket_for_value is the bucket in which the value is.
      * ibucket_for_hash is the bucket where the value belongs.
      */
-    void erase_from_bucket(hopscotch_bucket& bucket_for_value, std::size_t ibucket_for_hash) noexcept {
-        const std::size_t ibucket_for_value = std::distance(m_buckets_data.data(), &bucket_for_value);
+    void erase_from_bucket(std::size_t ibucket_for_value, std::size_t ibucket_for_hash) noexcept {
         tsl_hh_assert(ibucket_for_value >= ibucket_for_hash);
         
-        bucket_for_value.remove_value();
+        buckets_write_guard guard(*this, ibucket_for_hash, ibucket_for_value);
+        m_buckets_data.remove_value(ibucket_for_value);
         m_buckets[ibucket_for_hash].toggle_neighbor_presence(ibucket_for_value - ibucket_for_hash);
         m_nb_elements--;
     }
@@ -1404,38 +5011,26 @@ private:
     template<typename P, class... Args>
     std::pair<iterator, bool> try_emplace_impl(P&& key, Args&&... args_value) {
         const std::size_t hash = hash_key(key);
-        const std::size_t ibucket_for_hash = bucket_for_hash(hash);
-        
-        // Check if already presents
-        auto it_find = find_impl(key, hash, m_buckets + ibucket_for_hash);
-        if(it_find != end()) {
-            return std::make_pair(it_find, false);
-        }
-        
-        return insert_value(ibucket_for_hash, hash, std::piecewise_construct, 
-                                                    std::forward_as_tuple(std::forward<P>(key)), 
-                                                    std::forward_as_tuple(std::forward<Args>(args_value)...));
+        return try_emplace_with_hash(hash, std::forward<P>(key), std::forward<Args>(args_value)...);
     }
     
     template<typename P>
     std::pair<iterator, bool> insert_impl(P&& value) {
         const std::size_t hash = hash_key(KeySelect()(value));
-        const std::size_t ibucket_for_hash = bucket_for_hash(hash);
-        
-        // Check if already presents
-        auto it_find = find_impl(KeySelect()(value), hash, m_buckets + ibucket_for_hash);
-        if(it_find != end()) {
-            return std::make_pair(it_find, false);
-        }
-        
-        
-        return insert_value(ibucket_for_hash, hash, std::forward<P>(value));
+        return insert_with_hash(hash, std::forward<P>(value));
     }
     
     template<typename... Args>
     std::pair<iterator, bool> insert_value(std::size_t ibucket_for_hash, std::size_t hash, Args&&... value_type_args) {
         if((m_nb_elements - m_overflow_elements.size()) >= m_max_load_threshold_rehash) {
-            rehash(GrowthPolicy::next_bucket_count());
+            stats_counters_type::count_rehash_on_load_factor();
+            if(m_incremental_rehash_step > 0 && m_old_table == nullptr) {
+                start_incremental_rehash(GrowthPolicy::next_bucket_count());
+            }
+            else {
+                rehash_current_table(GrowthPolicy::next_bucket_count());
+            }
+            
             ibucket_for_hash = bucket_for_hash(hash);
         }
         
@@ -1452,16 +5047,18 @@ private:
                 }
             }
             // else, try to swap values to get a closer empty bucket
-            while(swap_empty_bucket_closer(ibucket_empty));
+            while(swap_empty_bucket_closer_counted(ibucket_empty));
         }
             
         // Load factor is too low or a rehash will not change the neighborhood, put the value in overflow list
         if(size() < m_min_load_threshold_rehash || !will_neighborhood_change_on_rehash(ibucket_for_hash)) {
-            auto it = insert_in_overflow(ibucket_for_hash, std::forward<Args>(value_type_args)...);
+            stats_counters_type::count_insert_in_overflow();
+            auto it = insert_in_overflow(ibucket_for_hash, hash, std::forward<Args>(value_type_args)...);
             return std::make_pair(iterator(m_buckets_data.end(), m_buckets_data.end(), it), true);
         }
     
-        rehash(GrowthPolicy::next_bucket_count());
+        stats_counters_type::count_rehash_on_full_neighborhood();
+        rehash_current_table(GrowthPolicy::next_bucket_count());
         ibucket_for_hash = bucket_for_hash(hash);
         
         return insert_value(ibucket_for_hash, hash, std::forward<Args>(value_type_args)...);
@@ -1484,7 +5081,7 @@ private:
             
             const size_t hash = use_stored_hash?
                                     m_buckets[ibucket].truncated_bucket_hash():
-                                    hash_key(KeySelect()(m_buckets[ibucket].value()));
+                                    hash_key(KeySelect()(m_buckets_data.value(ibucket)));
             if(bucket_for_hash(hash) != expand_growth_policy.bucket_for_hash(hash)) {
                 return true;
             }
@@ -1519,7 +5116,10 @@ private:
     {
         tsl_hh_assert(ibucket_empty >= ibucket_for_hash );
         tsl_hh_assert(m_buckets[ibucket_empty].empty());
-        m_buckets[ibucket_empty].set_value_of_empty_bucket(hopscotch_bucket::truncate_hash(hash), std::forward<Args>(value_type_args)...);
+        
+        buckets_write_guard guard(*this, ibucket_for_hash, ibucket_empty);
+        m_buckets_data.set_value_of_empty_bucket(ibucket_empty, hopscotch_bucket::truncate_hash(hash), 
+                                                 std::forward<Args>(value_type_args)...);
         
         tsl_hh_assert(!m_buckets[ibucket_for_hash].empty());
         m_buckets[ibucket_for_hash].toggle_neighbor_presence(ibucket_empty - ibucket_for_hash);
@@ -1528,10 +5128,14 @@ private:
         return m_buckets_data.begin() + ibucket_empty;
     }
     
-    template<class... Args, class U = OverflowContainer, typename std::enable_if<!has_key_compare<U>::value>::type* = nullptr>
-    iterator_overflow insert_in_overflow(std::size_t ibucket_for_hash, Args&&... value_type_args) {
+    template<class... Args, class U = OverflowContainer, 
+             typename std::enable_if<!has_key_compare<U>::value && !has_hashed_lookup<U>::value>::type* = nullptr>
+    iterator_overflow insert_in_overflow(std::size_t ibucket_for_hash, std::size_t /*hash*/, 
+                                         Args&&... value_type_args) 
+    {
         auto it = m_overflow_elements.emplace(m_overflow_elements.end(), std::forward<Args>(value_type_args)...);
         
+        buckets_write_guard guard(*this, ibucket_for_hash, ibucket_for_hash);
         m_buckets[ibucket_for_hash].set_overflow(true);
         m_nb_elements++;
             
@@ -1539,9 +5143,23 @@ private:
     }
     
     template<class... Args, class U = OverflowContainer, typename std::enable_if<has_key_compare<U>::value>::type* = nullptr>
-    iterator_overflow insert_in_overflow(std::size_t ibucket_for_hash, Args&&... value_type_args) {
+    iterator_overflow insert_in_overflow(std::size_t ibucket_for_hash, std::size_t /*hash*/, 
+                                         Args&&... value_type_args) 
+    {
         auto it = m_overflow_elements.emplace(std::forward<Args>(value_type_args)...).first;
         
+        buckets_write_guard guard(*this, ibucket_for_hash, ibucket_for_hash);
+        m_buckets[ibucket_for_hash].set_overflow(true);
+        m_nb_elements++;
+        
+        return it;
+    }
+    
+    template<class... Args, class U = OverflowContainer, typename std::enable_if<has_hashed_lookup<U>::value>::type* = nullptr>
+    iterator_overflow insert_in_overflow(std::size_t ibucket_for_hash, std::size_t hash, Args&&... value_type_args) {
+        auto it = m_overflow_elements.emplace_hashed(hash, std::forward<Args>(value_type_args)...);
+        
+        buckets_write_guard guard(*this, ibucket_for_hash, ibucket_for_hash);
         m_buckets[ibucket_for_hash].set_overflow(true);
         m_nb_elements++;
         
@@ -1567,7 +5185,8 @@ private:
                     tsl_hh_assert(m_buckets[ibucket_empty_in_out].empty());
                     tsl_hh_assert(!m_buckets[to_swap].empty());
                     
-                    m_buckets[to_swap].swap_value_into_empty_bucket(m_buckets[ibucket_empty_in_out]);
+                    buckets_write_guard guard(*this, to_check, ibucket_empty_in_out);
+                    m_buckets_data.swap_value_into_empty_bucket(to_swap, ibucket_empty_in_out);
                     
                     tsl_hh_assert(!m_buckets[to_check].check_neighbor_presence(ibucket_empty_in_out - to_check));
                     tsl_hh_assert(m_buckets[to_check].check_neighbor_presence(to_swap - to_check));
@@ -1589,6 +5208,53 @@ private:
         return false;
     }
     
+    bool swap_empty_bucket_closer_counted(std::size_t& ibucket_empty_in_out) {
+        const bool displaced = swap_empty_bucket_closer(ibucket_empty_in_out);
+        stats_counters_type::count_swap_empty_bucket_closer(displaced);
+        
+        return displaced;
+    }
+    
+    void add_to_histograms(tsl::hh::hopscotch_stats& stats) const {
+        const std::size_t nb_home_buckets = bucket_count();
+        for(std::size_t ibucket = 0; ibucket < nb_home_buckets; ibucket++) {
+            neighborhood_bitmap neighbors = m_buckets[ibucket].neighborhood_infos();
+            
+            std::size_t nb_neighbors = 0;
+            while(neighbors != 0) {
+                stats.neighbor_offset_histogram[count_trailing_zeros(neighbors)]++;
+                nb_neighbors++;
+                neighbors &= neighborhood_bitmap(neighbors - 1);
+            }
+            
+            stats.neighborhood_popcount_histogram[nb_neighbors]++;
+        }
+        
+        
+        if(m_overflow_elements.empty()) {
+            return;
+        }
+        
+        std::vector<std::size_t> overflow_ibuckets;
+        overflow_ibuckets.reserve(m_overflow_elements.size());
+        for(const value_type& value: m_overflow_elements) {
+            overflow_ibuckets.push_back(bucket_for_hash(hash_key(KeySelect()(value))));
+        }
+        std::sort(overflow_ibuckets.begin(), overflow_ibuckets.end());
+        
+        for(auto it = overflow_ibuckets.begin(); it != overflow_ibuckets.end(); ) {
+            const auto it_next = std::upper_bound(it, overflow_ibuckets.end(), *it);
+            const std::size_t nb_values_in_overflow = std::size_t(std::distance(it, it_next));
+            
+            if(stats.overflow_size_histogram.size() <= nb_values_in_overflow) {
+                stats.overflow_size_histogram.resize(nb_values_in_overflow + 1, 0);
+            }
+            stats.overflow_size_histogram[nb_values_in_overflow]++;
+            
+            it = it_next;
+        }
+    }
+    
     
     
     template<class K, class U = ValueSelect, typename std::enable_if<has_mapped_type<U>::value>::type* = nullptr>
@@ -1608,27 +5274,154 @@ private:
     {
         const hopscotch_bucket* bucket_found = find_in_buckets(key, hash, bucket_for_hash);
         if(bucket_found != nullptr) {
-            return std::addressof(ValueSelect()(bucket_found->value()));
+            return std::addressof(ValueSelect()(bucket_value(bucket_found)));
         }
         
         if(bucket_for_hash->has_overflow()) {
-            auto it_overflow = find_in_overflow(key);
+            auto it_overflow = find_in_overflow(key, hash);
             if(it_overflow != m_overflow_elements.end()) {
                 return std::addressof(ValueSelect()(*it_overflow));
             }
         }
         
+        if(m_old_table != nullptr) {
+            return m_old_table->find_value_impl(key, hash, m_old_table->m_buckets + m_old_table->bucket_for_hash(hash));
+        }
+        
         return nullptr;
     }
     
+    /*
+     * Batch lookups. The keys in [first, last) are processed by groups of LOOKUP_BATCH_SIZE keys. The hashes 
+     * of a group are computed (or read from the precalculated hashes) and the home bucket of each key 
+     * is prefetched before any lookup of the group is resolved. The cache misses on the buckets of a group 
+     * can then be overlapped instead of stalling each lookup in turn.
+     * 
+     * The result of 'lookup(table, key, hash)' is written to 'out' for each key.
+     */
+    template<class Table, class ForwardIt, class HashSource, class OutputIt, class Lookup>
+    static OutputIt lookup_batch(Table& table, ForwardIt first, ForwardIt last, HashSource hashes_source, 
+                                 OutputIt out, Lookup lookup) 
+    {
+        std::size_t hashes[LOOKUP_BATCH_SIZE];
+        
+        while(first != last) {
+            const ForwardIt first_in_batch = first;
+            
+            std::size_t nb_keys_in_batch = 0;
+            for(; nb_keys_in_batch < LOOKUP_BATCH_SIZE && first != last; ++nb_keys_in_batch, ++first) {
+                const std::size_t hash = hashes_source(table, *first);
+                hashes[nb_keys_in_batch] = hash;
+                
+                if(!table.m_buckets_data.empty()) {
+                    table.m_buckets_data.prefetch(table.bucket_for_hash(hash));
+                }
+            }
+            
+            ForwardIt it_key = first_in_batch;
+            for(std::size_t i = 0; i < nb_keys_in_batch; ++i, ++it_key) {
+                *out = lookup(table, *it_key, hashes[i]);
+                ++out;
+            }
+        }
+        
+        return out;
+    }
+    
+    struct computed_hashes {
+        template<class K>
+        std::size_t operator()(const hopscotch_hash& table, const K& key) const {
+            return table.hash_key(key);
+        }
+    };
+    
+    template<class HashIt>
+    class precalculated_hashes {
+    public:
+        explicit precalculated_hashes(HashIt first_hash): m_hash_iterator(first_hash) {
+        }
+        
+        template<class K>
+        std::size_t operator()(const hopscotch_hash& /*table*/, const K& /*key*/) {
+            const std::size_t hash = *m_hash_iterator;
+            ++m_hash_iterator;
+            
+            return hash;
+        }
+        
+    private:
+        HashIt m_hash_iterator;
+    };
+    
+    struct find_lookup {
+        template<class Table, class K>
+        auto operator()(Table& table, const K& key, std::size_t hash) const -> decltype(table.find(key, hash)) {
+            return table.find(key, hash);
+        }
+    };
+    
+    struct count_lookup {
+        template<class K>
+        size_type operator()(const hopscotch_hash& table, const K& key, std::size_t hash) const {
+            return table.count(key, hash);
+        }
+    };
+    
+    struct contains_lookup {
+        template<class K>
+        bool operator()(const hopscotch_hash& table, const K& key, std::size_t hash) const {
+            return table.contains(key, hash);
+        }
+    };
+    
+    /*
+     * Reserve enough buckets to insert nb_elements_insert new elements without rehash if needed.
+     */
+    template<class Distance>
+    void reserve_for_insert(Distance nb_elements_insert) {
+        const std::size_t nb_elements_in_buckets = m_nb_elements - m_overflow_elements.size();
+        const std::size_t nb_free_buckets = m_max_load_threshold_rehash - nb_elements_in_buckets;
+        tsl_hh_assert(m_nb_elements >= m_overflow_elements.size());
+        tsl_hh_assert(m_max_load_threshold_rehash >= nb_elements_in_buckets);
+        
+        if(nb_elements_insert > 0 && nb_free_buckets < std::size_t(nb_elements_insert)) {
+            reserve(nb_elements_in_buckets + std::size_t(nb_elements_insert));
+        }
+    }
+    
+    template<class K>
+    bool contains_impl(const K& key, std::size_t hash, std::size_t ibucket_for_hash) const {
+        return count_impl(key, hash, m_buckets + ibucket_for_hash) != 0;
+    }
+    
+    /*
+     * Return true if one of the nb_deferred elements, not yet inserted by insert_batch, 
+     * has a key equivalent to key.
+     */
+    template<class K, class ForwardIt>
+    bool contains_deferred(const K& key, std::size_t hash, const ForwardIt* deferred_elements, 
+                           const std::size_t* deferred_hashes, std::size_t nb_deferred) const 
+    {
+        for(std::size_t i = 0; i < nb_deferred; i++) {
+            if(deferred_hashes[i] == hash && compare_keys(KeySelect()(*deferred_elements[i]), key)) {
+                return true;
+            }
+        }
+        
+        return false;
+    }
+    
     template<class K>
     size_type count_impl(const K& key, std::size_t hash, const hopscotch_bucket* bucket_for_hash) const {
         if(find_in_buckets(key, hash, bucket_for_hash) != nullptr) {
             return 1;
         }
-        else if(bucket_for_hash->has_overflow() && find_in_overflow(key) != m_overflow_elements.cend()) {
+        else if(bucket_for_hash->has_overflow() && find_in_overflow(key, hash) != m_overflow_elements.cend()) {
             return 1;
         }
+        else if(m_old_table != nullptr) {
+            return m_old_table->count(key, hash);
+        }
         else {
             return 0;
         }
@@ -1638,31 +5431,44 @@ private:
     iterator find_impl(const K& key, std::size_t hash, hopscotch_bucket* bucket_for_hash) {
         hopscotch_bucket* bucket_found = find_in_buckets(key, hash, bucket_for_hash);
         if(bucket_found != nullptr) {
-            return iterator(m_buckets_data.begin() + std::distance(m_buckets_data.data(), bucket_found), 
+            return iterator(m_buckets_data.begin() + (bucket_found - m_buckets_data.data()), 
                             m_buckets_data.end(), m_overflow_elements.begin());
         }
         
-        if(!bucket_for_hash->has_overflow()) {
-            return end();
+        if(bucket_for_hash->has_overflow()) {
+            auto it_overflow = find_in_overflow(key, hash);
+            if(it_overflow != m_overflow_elements.end() || m_old_table == nullptr) {
+                return iterator(m_buckets_data.end(), m_buckets_data.end(), it_overflow);
+            }
+        }
+        
+        if(m_old_table != nullptr) {
+            return find_in_old_table(key, hash);
         }
         
-        return iterator(m_buckets_data.end(), m_buckets_data.end(), find_in_overflow(key));
+        return end();
     }
     
     template<class K>
     const_iterator find_impl(const K& key, std::size_t hash, const hopscotch_bucket* bucket_for_hash) const {
         const hopscotch_bucket* bucket_found = find_in_buckets(key, hash, bucket_for_hash);
         if(bucket_found != nullptr) {
-            return const_iterator(m_buckets_data.cbegin() + std::distance(m_buckets_data.data(), bucket_found), 
+            return const_iterator(m_buckets_data.cbegin() + (bucket_found - m_buckets_data.data()), 
                                   m_buckets_data.cend(), m_overflow_elements.cbegin());
         }
         
-        if(!bucket_for_hash->has_overflow()) {
-            return cend();
+        if(bucket_for_hash->has_overflow()) {
+            auto it_overflow = find_in_overflow(key, hash);
+            if(it_overflow != m_overflow_elements.cend() || m_old_table == nullptr) {
+                return const_iterator(m_buckets_data.cend(), m_buckets_data.cend(), it_overflow);
+            }
+        }
+        
+        if(m_old_table != nullptr) {
+            return find_in_old_table(key, hash);
         }
-
         
-        return const_iterator(m_buckets_data.cend(), m_buckets_data.cend(), find_in_overflow(key));
+        return cend();
     }
     
     template<class K>
@@ -1677,13 +5483,30 @@ private:
      * Return a pointer to the bucket which has the value, nullptr otherwise.
      */
     template<class K>
-    const hopscotch_bucket* find_in_buckets(const K& key, std::size_t hash, const hopscotch_bucket* bucket_for_hash) const {      
+    const hopscotch_bucket* find_in_buckets(const K& key, std::size_t hash, const hopscotch_bucket* bucket_for_hash) const {
         (void) hash; // Avoid warning of unused variable when StoreHash is false;
 
-        // TODO Try to optimize the function. 
-        // I tried to use ffs and  __builtin_ffs functions but I could not reduce the time the function
-        // takes with -march=native
-        
+#ifndef TSL_HH_LEGACY_NEIGHBORHOOD_SCAN
+        std::uint64_t candidates = bucket_for_hash->neighborhood_infos();
+        if(StoreHash && candidates != 0) {
+            candidates &= neighborhood_hash_match(bucket_for_hash, hash, candidates);
+        }
+
+        // Only visit the buckets of the neighborhood which belong to bucket_for_hash and,
+        // with AVX2, which also have a matching truncated hash.
+        while(candidates != 0) {
+            const hopscotch_bucket* candidate = bucket_for_hash + count_trailing_zeros(candidates);
+            if((!StoreHash || NEIGHBORHOOD_HASH_MATCH_IS_EXACT || candidate->bucket_hash_equal(hash)) &&
+                compare_keys(KeySelect()(bucket_value(candidate)), key))
+            {
+                return candidate;
+            }
+
+            candidates &= candidates - 1;
+        }
+
+        return nullptr;
+#else
         neighborhood_bitmap neighborhood_infos = bucket_for_hash->neighborhood_infos();
         while(neighborhood_infos != 0) {
             if((neighborhood_infos & 1) == 1) {
@@ -1691,7 +5514,7 @@ private:
                 // If StoreHash is false, bucket_hash_equal is a no-op. Avoiding the call is there to help 
                 // GCC optimizes `hash` parameter away, it seems to not be able to do without this hint.
                 if((!StoreHash || bucket_for_hash->bucket_hash_equal(hash)) && 
-                    compare_keys(KeySelect()(bucket_for_hash->value()), key)) 
+                    compare_keys(KeySelect()(bucket_value(bucket_for_hash)), key)) 
                 {
                     return bucket_for_hash;
                 }
@@ -1700,22 +5523,70 @@ private:
             ++bucket_for_hash;
             neighborhood_infos = neighborhood_bitmap(neighborhood_infos >> 1);
         }
-        
+
         return nullptr;
+#endif
     }
-    
+
+    /*
+     * Return a bitmap where the bit 'i' is set to 1 if the truncated hash stored in 'bucket_for_hash + i'
+     * is equal to the truncated 'hash'. Only the buckets up to the most significant bit set in
+     * 'neighborhood_infos' are compared, the other bits of the result are unspecified.
+     *
+     * Without AVX2, return 'neighborhood_infos' as is and let find_in_buckets compare the hashes one by one.
+     */
+#if defined(TSL_HH_AVX2)
+    template<bool SH = StoreHash, typename std::enable_if<SH>::type* = nullptr>
+    static std::uint64_t neighborhood_hash_match(const hopscotch_bucket* bucket_for_hash, std::size_t hash,
+                                                 std::uint64_t neighborhood_infos) noexcept
+    {
+        static_assert(sizeof(hopscotch_bucket) <= std::size_t(std::numeric_limits<int>::max() / 8), "");
+        const int stride = int(sizeof(hopscotch_bucket));
+
+        const std::size_t nb_buckets = bit_width(neighborhood_infos);
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i offsets = _mm256_mullo_epi32(lanes, _mm256_set1_epi32(stride));
+        const __m256i searched_hash = _mm256_set1_epi32(int(hopscotch_bucket::truncate_hash(hash)));
+
+        std::uint64_t matches = 0;
+        for(std::size_t ibucket = 0; ibucket < nb_buckets; ibucket += 8) {
+            // Don't load the hashes past the neighborhood, they may be outside of the buckets array.
+            const __m256i load_mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(int(nb_buckets - ibucket)), lanes);
+            const int* hashes_address =
+                    reinterpret_cast<const int*>((bucket_for_hash + ibucket)->truncated_bucket_hash_address());
+
+            const __m256i hashes = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), hashes_address,
+                                                               offsets, load_mask, 1);
+            const __m256i equal = _mm256_and_si256(_mm256_cmpeq_epi32(hashes, searched_hash), load_mask);
+
+            matches |= std::uint64_t(unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(equal)))) << ibucket;
+        }
+
+        return matches;
+    }
+#endif
+
+    template<bool SH = StoreHash, typename std::enable_if<!SH || !NEIGHBORHOOD_HASH_MATCH_IS_EXACT>::type* = nullptr>
+    static std::uint64_t neighborhood_hash_match(const hopscotch_bucket* /*bucket_for_hash*/, std::size_t /*hash*/,
+                                                 std::uint64_t neighborhood_infos) noexcept
+    {
+        return neighborhood_infos;
+    }
+
 
     
-    template<class K, class U = OverflowContainer, typename std::enable_if<!has_key_compare<U>::value>::type* = nullptr>
-    iterator_overflow find_in_overflow(const K& key) {
+    template<class K, class U = OverflowContainer, 
+             typename std::enable_if<!has_key_compare<U>::value && !has_hashed_lookup<U>::value>::type* = nullptr>
+    iterator_overflow find_in_overflow(const K& key, std::size_t /*hash*/) {
         return std::find_if(m_overflow_elements.begin(), m_overflow_elements.end(), 
                             [&](const value_type& value) { 
                                 return compare_keys(key, KeySelect()(value)); 
                             });
     }
     
-    template<class K, class U = OverflowContainer, typename std::enable_if<!has_key_compare<U>::value>::type* = nullptr>
-    const_iterator_overflow find_in_overflow(const K& key) const {
+    template<class K, class U = OverflowContainer, 
+             typename std::enable_if<!has_key_compare<U>::value && !has_hashed_lookup<U>::value>::type* = nullptr>
+    const_iterator_overflow find_in_overflow(const K& key, std::size_t /*hash*/) const {
         return std::find_if(m_overflow_elements.cbegin(), m_overflow_elements.cend(), 
                             [&](const value_type& value) { 
                                 return compare_keys(key, KeySelect()(value)); 
@@ -1723,27 +5594,47 @@ private:
     }
     
     template<class K, class U = OverflowContainer, typename std::enable_if<has_key_compare<U>::value>::type* = nullptr>
-    iterator_overflow find_in_overflow(const K& key) {
+    iterator_overflow find_in_overflow(const K& key, std::size_t /*hash*/) {
         return m_overflow_elements.find(key);
     }
     
     template<class K, class U = OverflowContainer, typename std::enable_if<has_key_compare<U>::value>::type* = nullptr>
-    const_iterator_overflow find_in_overflow(const K& key) const {
+    const_iterator_overflow find_in_overflow(const K& key, std::size_t /*hash*/) const {
         return m_overflow_elements.find(key);
     }
     
+    template<class K, class U = OverflowContainer, typename std::enable_if<has_hashed_lookup<U>::value>::type* = nullptr>
+    iterator_overflow find_in_overflow(const K& key, std::size_t hash) {
+        return m_overflow_elements.find_hashed(hash, [&](const value_type& value) { 
+                                                         return compare_keys(key, KeySelect()(value)); 
+                                                     });
+    }
+    
+    template<class K, class U = OverflowContainer, typename std::enable_if<has_hashed_lookup<U>::value>::type* = nullptr>
+    const_iterator_overflow find_in_overflow(const K& key, std::size_t hash) const {
+        return m_overflow_elements.find_hashed(hash, [&](const value_type& value) { 
+                                                         return compare_keys(key, KeySelect()(value)); 
+                                                     });
+    }
+    
     
     
     template<class U = OverflowContainer, typename std::enable_if<!has_key_compare<U>::value>::type* = nullptr>
     hopscotch_hash new_hopscotch_hash(size_type bucket_count) {
-        return hopscotch_hash(bucket_count, static_cast<Hash&>(*this), static_cast<KeyEqual&>(*this), 
-                              get_allocator(), m_max_load_factor);
+        hopscotch_hash new_table(bucket_count, static_cast<Hash&>(*this), static_cast<KeyEqual&>(*this), 
+                                 get_allocator(), m_max_load_factor);
+        new_table.min_load_factor(m_min_load_factor);
+        
+        return new_table;
     }
     
     template<class U = OverflowContainer, typename std::enable_if<has_key_compare<U>::value>::type* = nullptr>
     hopscotch_hash new_hopscotch_hash(size_type bucket_count) {
-        return hopscotch_hash(bucket_count, static_cast<Hash&>(*this), static_cast<KeyEqual&>(*this), 
-                              get_allocator(), m_max_load_factor, m_overflow_elements.key_comp());
+        hopscotch_hash new_table(bucket_count, static_cast<Hash&>(*this), static_cast<KeyEqual&>(*this), 
+                                 get_allocator(), m_max_load_factor, m_overflow_elements.key_comp());
+        new_table.min_load_factor(m_min_load_factor);
+        
+        return new_table;
     }
     
 public:    
@@ -1752,13 +5643,35 @@ public:
     
 private:    
     static const std::size_t MAX_PROBES_FOR_EMPTY_BUCKET = 12*NeighborhoodSize;
+    static const std::size_t LOOKUP_BATCH_SIZE = 16;
+    static const std::size_t INSERT_BATCH_SIZE = 16;
+    static const std::size_t MAX_OPTIMISTIC_LOOKUP_ATTEMPTS = 16;
+    static const std::size_t MAPPED_WRITE_CHUNK_SIZE = 1024;
+    static const std::uint32_t SERIALIZATION_PROTOCOL_VERSION = 1;
+    
+    /*
+     * Minimum number of buckets in the new array for each task of rehash_parallel, 
+     * a smaller range is not worth the synchronization.
+     */
+    static const std::size_t MIN_BUCKETS_PER_REHASH_TASK = 4096;
+    static const std::size_t NO_PLACEMENT = std::numeric_limits<std::size_t>::max();
+    
+    static const std::size_t BULK_INSERT_PREFETCH_DISTANCE = 16;
+    static const std::size_t BULK_INSERT_RANGE_BITS = 12;
     static constexpr float MIN_LOAD_FACTOR_FOR_REHASH = 0.1f;
     
+    /*
+     * The min load factor can't be greater than max_load_factor() * MAX_MIN_LOAD_FACTOR_RATIO (see 
+     * shrink_if_under_min_load_factor).
+     */
+    static constexpr float MAX_MIN_LOAD_FACTOR_RATIO = 0.25f;
+    
     /**
      * We can only use the hash on rehash if the size of the hash type is the same as the stored one or
      * if we use a power of two modulo. In the case of the power of two modulo, we just mask
      * the least significant bytes, we just have to check that the truncated_hash_type didn't truncated
-     * too much bytes.
+     * too much bytes (tsl::hh::fibonacci_power_of_two_growth_policy only mixes the 32 least significant bits
+     * of the hash while the bucket count fits in them).
      */
     template<class T = size_type, typename std::enable_if<std::is_same<T, truncated_hash_type>::value>::type* = nullptr>
     static bool USE_STORED_HASH_ON_REHASH(size_type /*bucket_count*/) {
@@ -1767,10 +5680,10 @@ private:
     
     template<class T = size_type, typename std::enable_if<!std::is_same<T, truncated_hash_type>::value>::type* = nullptr>
     static bool USE_STORED_HASH_ON_REHASH(size_type bucket_count) {
-        (void) bucket_count;
         if(StoreHash && is_power_of_two_policy<GrowthPolicy>::value) {
-            tsl_hh_assert(bucket_count > 0);
-            return (bucket_count - 1) <= std::numeric_limits<truncated_hash_type>::max();
+            // An empty table (e.g. after rehash(0) on an empty map) has nothing to rehash.
+            return bucket_count > 0 && 
+                   (bucket_count - 1) <= std::numeric_limits<truncated_hash_type>::max();
         }
         else {
             return false;   
@@ -1812,6 +5725,32 @@ private:
      * If the neighborhood of a bucket is full before the min is reacher, the elements are put into m_overflow_elements.
      */
     size_type m_min_load_threshold_rehash;
+    
+    /**
+     * Min load factor under which an erase shrinks the table, 0 if the automatic shrink is disabled.
+     */
+    float m_min_load_factor;
+    
+    /**
+     * Size of the hash table under which an erase shrinks the table (bucket_count() * m_min_load_factor).
+     */
+    size_type m_min_load_threshold_shrink;
+    
+    /**
+     * Table with the elements not yet migrated by an incremental rehash, nullptr if there is no incremental 
+     * rehash in progress. The old table never has an m_old_table itself.
+     */
+    std::unique_ptr<hopscotch_hash> m_old_table;
+    
+    /**
+     * Index of the next bucket of m_old_table to migrate.
+     */
+    size_type m_incremental_rehash_ibucket;
+    
+    /**
+     * Number of buckets of m_old_table migrated on each insert. The incremental rehash is disabled if 0.
+     */
+    size_type m_incremental_rehash_step;
 };
 
 } // end namespace detail_hopscotch_hash
@@ -59,6 +59,26 @@ namespace tsl {
  * to a power of two and uses a mask to map the hash to a bucket instead of the slow modulo.
  * You may define your own growth policy, check tsl::power_of_two_growth_policy for the interface.
  * 
+ * Layout defines how the buckets are stored in memory. By default (tsl::hh::aos_layout) each value is stored
+ * alongside its neighborhood bitmap (and stored hash). With tsl::hh::soa_layout the bitmaps are kept in one 
+ * contiguous array and the values in another, which keeps the probing of a neighborhood within a few cache
+ * lines for large values, at the cost of an extra memory access when the value is compared or returned.
+ * The layout doesn't change the behaviour of the map.
+ * 
+ * Overflow defines how the elements which can't be placed in the neighborhood of their bucket are stored. 
+ * By default (tsl::hh::list_overflow) they are stored in a std::list and looked up linearly. 
+ * With tsl::hh::flat_overflow they are stored contiguously and indexed by their hash, which keeps the lookups 
+ * fast if a poor hash function puts a lot of elements in the overflow. They differ for the iterators, 
+ * references and pointers to the overflow elements. With tsl::hh::list_overflow they follow the iterators 
+ * invalidation rules below, the overflow elements are never moved by an insert. With tsl::hh::flat_overflow 
+ * the overflow elements are stored in a growable array: an insert in the overflow which grows it also moves 
+ * all the overflow elements and invalidates the iterators, references and pointers to them.
+ * 
+ * Stats defines if statistics are collected. By default (tsl::hh::no_stats) nothing is collected. With 
+ * tsl::hh::collect_stats the map counts the displacements, the insertions in the overflow and the rehashes 
+ * and provides a stats() method returning them with some histograms of the neighborhoods (see 
+ * tsl::hh::hopscotch_stats).
+ * 
  * If the destructors of Key or T throw an exception, behaviour of the class is undefined.
  * 
  * Iterators invalidation:
@@ -67,6 +87,8 @@ namespace tsl {
  *    if a displacement is needed to resolve a collision (which mean that most of the time, 
  *    insert will invalidate the iterators). Or if there is a rehash.
  *  - erase: iterator on the erased element is the only one which become invalid.
+ *  - erase by key: if a min_load_factor is set and the map shrinks, invalidate the iterators.
+ *  - shrink_to_fit: invalidate the iterators if the map shrinks.
  */
 template<class Key, 
          class T, 
@@ -75,7 +97,10 @@ template<class Key,
          class Allocator = std::allocator<std::pair<Key, T>>,
          unsigned int NeighborhoodSize = 62,
          bool StoreHash = false,
-         class GrowthPolicy = tsl::hh::power_of_two_growth_policy<2>>
+         class GrowthPolicy = tsl::hh::power_of_two_growth_policy<2>,
+         class Layout = tsl::hh::aos_layout,
+         class Overflow = tsl::hh::list_overflow,
+         class Stats = tsl::hh::no_stats>
 class hopscotch_map {
 private:    
     template<typename U>
@@ -108,12 +133,14 @@ private:
     };
     
     
-    using overflow_container_type = std::list<std::pair<Key, T>, Allocator>;
+    using overflow_container_type = typename detail_hopscotch_hash::overflow_container_selector<
+                                                Overflow, std::pair<Key, T>, Allocator>::type;
     using ht = detail_hopscotch_hash::hopscotch_hash<std::pair<Key, T>, KeySelect, ValueSelect,
                                                      Hash, KeyEqual, 
                                                      Allocator, NeighborhoodSize, 
                                                      StoreHash, GrowthPolicy,
-                                                     overflow_container_type>;
+                                                     overflow_container_type, Layout, 
+                                                     tsl::hh::no_bucket_versions, Stats>;
     
 public:
     using key_type = typename ht::key_type;
@@ -130,6 +157,10 @@ public:
     using const_pointer = typename ht::const_pointer;
     using iterator = typename ht::iterator;
     using const_iterator = typename ht::const_iterator;
+    using node_type = typename ht::node_type;
+    using insert_return_type = typename ht::insert_return_type;
+    using range = typename ht::range;
+    using const_range = typename ht::const_range;
     
     
     
@@ -185,6 +216,23 @@ public:
                 const Allocator& alloc) : hopscotch_map(first, last, bucket_count, hash, KeyEqual(), alloc)
     {
     }
+    
+    /**
+     * Bulk constructor, same result as the range constructor but faster for a large [first, last) as the 
+     * values are sorted by home bucket and written in their buckets in one sequential pass 
+     * (see tsl::hh::bulk_construct_t). The first of equivalent values is kept.
+     * 
+     * Temporarily uses 32 bytes per value of [first, last) on a 64-bit platform, allocated with alloc.
+     */
+    template<class InputIt>
+    hopscotch_map(tsl::hh::bulk_construct_t, InputIt first, InputIt last,
+                size_type bucket_count = ht::DEFAULT_INIT_BUCKETS_SIZE,
+                const Hash& hash = Hash(),
+                const KeyEqual& equal = KeyEqual(),
+                const Allocator& alloc = Allocator()) : hopscotch_map(bucket_count, hash, equal, alloc)
+    {
+        m_ht.insert_bulk(first, last);
+    }
 
     hopscotch_map(std::initializer_list<value_type> init,
                     size_type bucket_count = ht::DEFAULT_INIT_BUCKETS_SIZE,
@@ -234,6 +282,47 @@ public:
     const_iterator end() const noexcept { return m_ht.end(); }
     const_iterator cend() const noexcept { return m_ht.cend(); }
     
+    /**
+     * Split the map in nb_partitions ranges which can be iterated independently, for example 
+     * by different threads, and return the range number ipartition (ipartition < nb_partitions). 
+     * 
+     * The bucket array is split in nb_partitions contiguous ranges of buckets of similar sizes. The 
+     * elements stored in the overflow container are part of the last range and, during an incremental 
+     * rehash, the elements not yet migrated are part of the first range. Together, the ranges contain 
+     * each element of the map exactly once. The ranges are invalidated as the iterators.
+     */
+    range partition(std::size_t ipartition, std::size_t nb_partitions) noexcept { 
+        return m_ht.partition(ipartition, nb_partitions); 
+    }
+    
+    const_range partition(std::size_t ipartition, std::size_t nb_partitions) const noexcept { 
+        return m_ht.partition(ipartition, nb_partitions); 
+    }
+    
+    /**
+     * Call function(value) for each value of the map, where value is a const reference to a value_type, 
+     * from nb_threads threads (the calling thread and nb_threads - 1 new threads), each thread iterating 
+     * over one partition(ithread, nb_threads). The function is called concurrently and must not modify 
+     * the map. 
+     * 
+     * If a call to function throws, the other threads still complete their partitions and the first exception 
+     * is then rethrown.
+     */
+    template<class Function>
+    void parallel_for_each(std::size_t nb_threads, const Function& function) const { 
+        m_ht.parallel_for_each(nb_threads, function); 
+    }
+    
+    /**
+     * Same as parallel_for_each(nb_threads, function) but the map is split in nb_tasks partitions 
+     * which are iterated by tasks run through executor (see rehash_parallel for the requirements 
+     * on executor).
+     */
+    template<class Function, class Executor>
+    void parallel_for_each(std::size_t nb_tasks, const Function& function, Executor&& executor) const { 
+        m_ht.parallel_for_each(nb_tasks, function, std::forward<Executor>(executor)); 
+    }
+    
     
     /*
      * Capacity
@@ -286,6 +375,20 @@ public:
     void insert(std::initializer_list<value_type> ilist) { 
         m_ht.insert(ilist.begin(), ilist.end()); 
     }
+    
+    /**
+     * Insert the elements in [first, last), which must dereference to value_type, and write to 'out' 
+     * for each element a bool: true if the element was inserted, false if an element with an equivalent key 
+     * was already in the map (or earlier in the range). Return the output iterator past the last written bool.
+     * 
+     * Faster than insert(first, last) for large ranges: the map reserves the needed buckets once, 
+     * hashes and prefetches the elements by small batches and delays the elements needing a displacement 
+     * to the end of their batch. Use std::make_move_iterator to move the elements instead of copying them.
+     */
+    template<class ForwardIt, class OutputIt>
+    OutputIt insert_batch(ForwardIt first, ForwardIt last, OutputIt out) { 
+        return m_ht.insert_batch(first, last, out); 
+    }
 
     
     
@@ -361,6 +464,19 @@ public:
         return m_ht.try_emplace(hint, std::move(k), std::forward<Args>(args)...);
     }
     
+    /**
+     * This overload only participates in the overload resolution if the typedef KeyEqual::is_transparent exists. 
+     * If so, K must be comparable to Key and Key constructible from K.
+     * 
+     * Use the hash precalculated in 'key' (see tsl::hh::hashed_key). The key_type is only constructed 
+     * from key.key() if the value is inserted.
+     */
+    template<class K, class... Args, class KE = KeyEqual, 
+             typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr> 
+    std::pair<iterator, bool> try_emplace(const tsl::hh::hashed_key<K>& key, Args&&... args) {
+        return m_ht.try_emplace_with_hash(key.hash(), key.key(), std::forward<Args>(args)...);
+    }
+    
     
 
     
@@ -395,6 +511,73 @@ public:
         return m_ht.erase(key, precalculated_hash); 
     }
     
+    /**
+     * @copydoc erase(const K& key)
+     * 
+     * Use the hash precalculated in 'key' (see tsl::hh::hashed_key).
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr> 
+    size_type erase(const tsl::hh::hashed_key<K>& key) { return m_ht.erase(key.key(), key.hash()); }
+    
+    
+    /**
+     * Remove the element at pos and return it in a node handle. The value is moved into the node handle 
+     * with the hash of its key, no memory allocation is done.
+     */
+    node_type extract(const_iterator pos) { return m_ht.extract(pos); }
+    
+    /**
+     * Remove the element with the key equivalent to key and return it in a node handle. 
+     * Return an empty node handle if there is no such element.
+     */
+    node_type extract(const key_type& key) { return m_ht.extract(key); }
+    
+    /**
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Usefull to speed-up the lookup to the value if you already have the hash.
+     */
+    node_type extract(const key_type& key, std::size_t precalculated_hash) { 
+        return m_ht.extract(key, precalculated_hash); 
+    }
+    
+    /**
+     * This overload only participates in the overload resolution if the typedef KeyEqual::is_transparent exists. 
+     * If so, K must be hashable and comparable to Key.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    node_type extract(const K& key) { return m_ht.extract(key); }
+    
+    /**
+     * @copydoc extract(const K& key)
+     * 
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Usefull to speed-up the lookup to the value if you already have the hash.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    node_type extract(const K& key, std::size_t precalculated_hash) { 
+        return m_ht.extract(key, precalculated_hash); 
+    }
+    
+    /**
+     * Insert the value of the node handle. If the hash function is stateless, the hash stored in the node 
+     * handle is reused and the key is not hashed again.
+     * 
+     * If an element with an equivalent key already exists, the node handle is returned in the node member 
+     * of the result and position points to the existing element.
+     */
+    insert_return_type insert(node_type&& node) { return m_ht.insert(std::move(node)); }
+    iterator insert(const_iterator hint, node_type&& node) { return m_ht.insert(hint, std::move(node)); }
+    
+    /**
+     * Move the elements of source with a key not present in the map to the map. The elements with 
+     * an equivalent key stay in source. 
+     * 
+     * If the hash function is stateless and the hashes are stored (StoreHash = true) with a power of two 
+     * growth policy, the hashes stored in source are reused instead of hashing the keys again.
+     */
+    void merge(hopscotch_map& source) { m_ht.merge(source.m_ht); }
+    void merge(hopscotch_map&& source) { m_ht.merge(source.m_ht); }
+    
     
     
     
@@ -484,6 +667,14 @@ public:
     template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr> 
     size_type count(const K& key, std::size_t precalculated_hash) const { return m_ht.count(key, precalculated_hash); }
     
+    /**
+     * @copydoc count(const K& key) const
+     * 
+     * Use the hash precalculated in 'key' (see tsl::hh::hashed_key).
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr> 
+    size_type count(const tsl::hh::hashed_key<K>& key) const { return m_ht.count(key.key(), key.hash()); }
+    
     
     
     
@@ -537,6 +728,20 @@ public:
         return m_ht.find(key, precalculated_hash); 
     }
     
+    /**
+     * @copydoc find(const K& key)
+     * 
+     * Use the hash precalculated in 'key' (see tsl::hh::hashed_key).
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr> 
+    iterator find(const tsl::hh::hashed_key<K>& key) { return m_ht.find(key.key(), key.hash()); }
+    
+    /**
+     * @copydoc find(const tsl::hh::hashed_key<K>& key)
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr> 
+    const_iterator find(const tsl::hh::hashed_key<K>& key) const { return m_ht.find(key.key(), key.hash()); }
+    
     
     
     
@@ -568,6 +773,91 @@ public:
         return m_ht.contains(key, precalculated_hash); 
     }
     
+    /**
+     * @copydoc contains(const K& key) const
+     * 
+     * Use the hash precalculated in 'key' (see tsl::hh::hashed_key).
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr> 
+    bool contains(const tsl::hh::hashed_key<K>& key) const { return m_ht.contains(key.key(), key.hash()); }
+    
+    
+    /**
+     * For each key in [first, last), write to 'out' an iterator to the element with a key equivalent 
+     * to the key, or end() if there is none. Return the output iterator past the last written element.
+     * 
+     * The keys are looked up by small batches: the hashes of a batch are computed and the home buckets 
+     * prefetched before the lookups are resolved, overlapping the cache misses of the lookups. 
+     * Faster than successive calls to find if the map doesn't fit in the cache.
+     * 
+     * The keys must be of type Key, or of any type hashable and comparable to Key if the typedef 
+     * KeyEqual::is_transparent exists.
+     */
+    template<class ForwardIt, class OutputIt>
+    OutputIt find_batch(ForwardIt first, ForwardIt last, OutputIt out) { 
+        return m_ht.find_batch(first, last, out); 
+    }
+    
+    /**
+     * @copydoc find_batch(ForwardIt first, ForwardIt last, OutputIt out)
+     * 
+     * Use the hash values in [first_hash, first_hash + std::distance(first, last)) instead of hashing 
+     * the keys. Each hash value should be the same as hash_function()(key). Usefull to speed-up the lookups 
+     * if you already have the hashes.
+     */
+    template<class ForwardIt, class HashIt, class OutputIt>
+    OutputIt find_batch(ForwardIt first, ForwardIt last, HashIt first_hash, OutputIt out) { 
+        return m_ht.find_batch(first, last, first_hash, out); 
+    }
+    
+    /**
+     * @copydoc find_batch(ForwardIt first, ForwardIt last, OutputIt out)
+     */
+    template<class ForwardIt, class OutputIt>
+    OutputIt find_batch(ForwardIt first, ForwardIt last, OutputIt out) const { 
+        return m_ht.find_batch(first, last, out); 
+    }
+    
+    /**
+     * @copydoc find_batch(ForwardIt first, ForwardIt last, HashIt first_hash, OutputIt out)
+     */
+    template<class ForwardIt, class HashIt, class OutputIt>
+    OutputIt find_batch(ForwardIt first, ForwardIt last, HashIt first_hash, OutputIt out) const { 
+        return m_ht.find_batch(first, last, first_hash, out); 
+    }
+    
+    /**
+     * Same as find_batch but write count(key), a size_type, for each key.
+     */
+    template<class ForwardIt, class OutputIt>
+    OutputIt count_batch(ForwardIt first, ForwardIt last, OutputIt out) const { 
+        return m_ht.count_batch(first, last, out); 
+    }
+    
+    /**
+     * Same as find_batch but write count(key, precalculated_hash), a size_type, for each key.
+     */
+    template<class ForwardIt, class HashIt, class OutputIt>
+    OutputIt count_batch(ForwardIt first, ForwardIt last, HashIt first_hash, OutputIt out) const { 
+        return m_ht.count_batch(first, last, first_hash, out); 
+    }
+    
+    /**
+     * Same as find_batch but write contains(key), a bool, for each key.
+     */
+    template<class ForwardIt, class OutputIt>
+    OutputIt contains_batch(ForwardIt first, ForwardIt last, OutputIt out) const { 
+        return m_ht.contains_batch(first, last, out); 
+    }
+    
+    /**
+     * Same as find_batch but write contains(key, precalculated_hash), a bool, for each key.
+     */
+    template<class ForwardIt, class HashIt, class OutputIt>
+    OutputIt contains_batch(ForwardIt first, ForwardIt last, HashIt first_hash, OutputIt out) const { 
+        return m_ht.contains_batch(first, last, first_hash, out); 
+    }
+    
     
     
     
@@ -640,9 +930,105 @@ public:
     float max_load_factor() const { return m_ht.max_load_factor(); }
     void max_load_factor(float ml) { m_ht.max_load_factor(ml); }
     
+    /**
+     * Load factor under which an erase by key shrinks the map to a load factor of max_load_factor()/2 
+     * (invalidating the iterators). The erases through an iterator never shrink the map.
+     * 0 (default) disables the automatic shrink. The value is limited to max_load_factor()/4 so that alternating 
+     * inserts and erases around a threshold can't make the map grow and shrink repeatedly.
+     */
+    float min_load_factor() const { return m_ht.min_load_factor(); }
+    void min_load_factor(float ml) { m_ht.min_load_factor(ml); }
+    
     void rehash(size_type count_) { m_ht.rehash(count_); }
     void reserve(size_type count_) { m_ht.reserve(count_); }
     
+    /**
+     * Rehash the map to the smallest bucket count able to hold its elements under max_load_factor(),
+     * if the growth policy allows a smaller bucket count than the current one.
+     */
+    void shrink_to_fit() { m_ht.shrink_to_fit(); }
+    
+    /**
+     * Same as rehash(count_) but the elements are moved to the new bucket array by nb_threads threads 
+     * (the calling thread and nb_threads - 1 new threads).
+     * 
+     * The new bucket array is split in contiguous ranges, one per thread, and each thread places the elements 
+     * belonging to its range. Only the few elements which don't fit near the end of a range are placed by 
+     * a single thread. The hash function may be called concurrently from multiple threads. The rehash is done 
+     * by a single thread if value_type is not nothrow move constructible or if the map is too small for the 
+     * parallelism to be worth it.
+     * 
+     * Temporarily uses about 2 * sizeof(std::size_t) bytes per old and new bucket in addition to the new bucket array.
+     * If an exception is thrown, the map is left unchanged.
+     */
+    void rehash_parallel(size_type count_, std::size_t nb_threads) { m_ht.rehash_parallel(count_, nb_threads); }
+    
+    /**
+     * Same as rehash_parallel(count_, nb_threads) but the work is split in nb_tasks tasks which are run 
+     * through executor, for example to use an existing thread pool. 
+     * 
+     * The executor is called as executor(nb_tasks, task) where task is a callable taking a std::size_t, 
+     * it must call task(i) exactly once for each i in [0, nb_tasks), concurrently or not, and only return 
+     * (or throw) once all the started calls are complete. The executor is called multiple times.
+     */
+    template<class Executor>
+    void rehash_parallel(size_type count_, std::size_t nb_tasks, Executor&& executor) { 
+        m_ht.rehash_parallel(count_, nb_tasks, std::forward<Executor>(executor)); 
+    }
+    
+    /**
+     * Same as reserve(count_) but with the rehash done by rehash_parallel.
+     */
+    void reserve_parallel(size_type count_, std::size_t nb_threads) { m_ht.reserve_parallel(count_, nb_threads); }
+    
+    template<class Executor>
+    void reserve_parallel(size_type count_, std::size_t nb_tasks, Executor&& executor) { 
+        m_ht.reserve_parallel(count_, nb_tasks, std::forward<Executor>(executor)); 
+    }
+    
+    /**
+     * Number of buckets migrated on each insert during an incremental rehash, 0 if the incremental rehash 
+     * is disabled (default).
+     */
+    size_type incremental_rehash_step() const noexcept { return m_ht.incremental_rehash_step(); }
+    
+    /**
+     * Enable the incremental rehash if nb_buckets_per_insert > 0, disable it otherwise (and finish any 
+     * incremental rehash in progress).
+     * 
+     * When the incremental rehash is enabled and the map has to grow because the max load factor is reached, 
+     * the map only allocates the new bucket array and keeps the old one. Each following insert (insert, emplace, 
+     * try_emplace, insert_or_assign, operator[], ...) then moves the elements of the next nb_buckets_per_insert 
+     * buckets of the old array to the new one. Until all the elements are migrated, lookups and erases which 
+     * don't find a key in the new array look for it in the old one. This bounds the work done by a single insert 
+     * instead of moving all the elements at once, at the cost of slower unsuccessful lookups during the migration.
+     * 
+     * An insert migrates more than nb_buckets_per_insert buckets if needed to finish the migration before the new 
+     * array reaches the max load factor. A growth factor g and a max load factor lf leave about 
+     * lf*(g - 1)*old_bucket_count inserts for the migration of old_bucket_count buckets, so an insert migrates 
+     * up to max(nb_buckets_per_insert, ceil(1/(lf*(g - 1)))) buckets: 2 with the default growth factor of 2 and 
+     * max load factor of 0.8, 3 with a growth factor of 1.5.
+     * 
+     * The migration is finished by rehash, reserve and finish_incremental_rehash. If the new array itself needs 
+     * a rehash while a migration is in progress because a neighborhood is full (which depends on the hash 
+     * function), the elements of the new array are moved at once. Lookups and erases don't migrate any element 
+     * as they must not invalidate the iterators.
+     */
+    void incremental_rehash_step(size_type nb_buckets_per_insert) { 
+        m_ht.incremental_rehash_step(nb_buckets_per_insert); 
+    }
+    
+    /**
+     * Return true if some elements are still in the old bucket array of an incremental rehash.
+     */
+    bool incremental_rehash_in_progress() const noexcept { return m_ht.incremental_rehash_in_progress(); }
+    
+    /**
+     * Move all the elements remaining in the old bucket array of an incremental rehash (if any) 
+     * to the new one and release the old array.
+     */
+    void finish_incremental_rehash() { m_ht.finish_incremental_rehash(); }
+    
     
     /*
      * Observers
@@ -663,6 +1049,71 @@ public:
     
     size_type overflow_size() const noexcept { return m_ht.overflow_size(); }
     
+    /**
+     * Snapshot of the statistics of the map, only available with tsl::hh::collect_stats as Stats parameter
+     * (see tsl::hh::hopscotch_stats). The histograms are computed by going through all the buckets, 
+     * the method is O(bucket_count()).
+     */
+    template<class U = Stats, typename std::enable_if<std::is_same<U, tsl::hh::collect_stats>::value>::type* = nullptr>
+    tsl::hh::hopscotch_stats stats() const {
+        return m_ht.stats();
+    }
+    
+    /**
+     * Write the map in the format of tsl::mapped_hopscotch_map, which can then serve lookups directly 
+     * from the written bytes (e.g. a memory-mapped file) without rebuilding the map.
+     * 
+     * The output is passed in consecutive chunks to writer(const char* data, std::size_t size). 
+     * Key and T must be trivially copyable and the mapped map must use the same Hash, KeyEqual, 
+     * NeighborhoodSize, StoreHash and GrowthPolicy. Throw std::logic_error if an incremental rehash 
+     * is in progress.
+     * 
+     * Example:
+     * @code
+     * std::ofstream file("map.bin", std::ios::binary);
+     * auto writer = [&](const char* data, std::size_t size) { file.write(data, size); };
+     * map.write_mapped(writer);
+     * @endcode
+     */
+    template<class Writer>
+    void write_mapped(Writer& writer) const { m_ht.write_mapped(writer); }
+    
+    /**
+     * Serialize the map through the serializer parameter.
+     * 
+     * The serializer must be a function object supporting the call `serializer(const U& value)` where U is 
+     * std::uint32_t, std::uint64_t, float and `std::pair<Key, T>`. It's up to the serializer to write these values 
+     * in a portable way (endianness, size of the types) if needed.
+     * 
+     * The bucket array is serialized as it is, with the neighborhood infos of each bucket, so that a map 
+     * with the same hash function and growth policy can be deserialized without rehashing its elements 
+     * (see deserialize). Throw std::logic_error if an incremental rehash is in progress.
+     */
+    template<class Serializer>
+    void serialize(Serializer& serializer) const { m_ht.serialize(serializer); }
+    
+    /**
+     * Deserialize a map previously serialized with serialize through the deserializer parameter.
+     * 
+     * The deserializer must be a function object supporting the call `U deserializer()` (i.e. 
+     * `deserializer.template operator()<U>()`) for the same types as the serializer.
+     * 
+     * If hash_compatible is true, the hash function, key equal, NeighborhoodSize, StoreHash and GrowthPolicy 
+     * must be the same as the ones of the serialized map. The bucket array is then rebuilt directly from the 
+     * serialized neighborhood infos, only the overflow elements are hashed. The deserialization throws 
+     * std::runtime_error if the NeighborhoodSize, StoreHash or bucket count don't match but a different hash 
+     * function can't be detected and results in undefined behaviour.
+     * 
+     * If hash_compatible is false, the elements are inserted one by one in a new map.
+     */
+    template<class Deserializer>
+    static hopscotch_map deserialize(Deserializer& deserializer, bool hash_compatible = false) {
+        hopscotch_map map(0);
+        map.m_ht.deserialize(deserializer, hash_compatible);
+        
+        return map;
+    }
+    
     friend bool operator==(const hopscotch_map& lhs, const hopscotch_map& rhs) {
         if(lhs.size() != rhs.size()) {
             return false;
@@ -0,0 +1,328 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2018 Tessil
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef TSL_HUGE_PAGE_ALLOCATOR_H
+#define TSL_HUGE_PAGE_ALLOCATOR_H
+
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <vector>
+
+
+#if defined(__linux__)
+#    define TSL_HH_HAS_HUGE_PAGES
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#endif
+
+
+namespace tsl {
+
+namespace hh {
+
+/**
+ * Pages backing the large allocations of tsl::huge_page_allocator.
+ */
+enum class huge_pages {
+    /**
+     * Regular pages (the allocation is still mapped with mmap, e.g. to apply a NUMA policy).
+     */
+    none,
+    /**
+     * Regular pages with an madvise(MADV_HUGEPAGE) hint, the kernel backs the mapping with transparent
+     * huge pages of 2MB when it can. The mapping is aligned on 2MB.
+     */
+    transparent,
+    /**
+     * Explicit 2MB huge pages (MAP_HUGETLB), taken from the pool reserved in /proc/sys/vm/nr_hugepages.
+     * If the pool is empty, fall back to transparent huge pages.
+     */
+    explicit_2mb,
+    /**
+     * Explicit 1GB huge pages (MAP_HUGETLB | MAP_HUGE_1GB). If none is available,
+     * fall back to transparent huge pages. The allocations are rounded up to a multiple of 1GB.
+     */
+    explicit_1gb
+};
+
+/**
+ * NUMA placement of the large allocations of tsl::huge_page_allocator.
+ */
+enum class numa_policy {
+    /**
+     * Default policy of the thread, usually the node of the CPU touching the page first.
+     */
+    system_default,
+    /**
+     * Interleave the pages over all the allowed NUMA nodes.
+     */
+    interleave,
+    /**
+     * Put all the pages on the given NUMA node.
+     */
+    bind_node
+};
+
+}
+
+
+namespace detail_hopscotch_hash {
+
+/**
+ * Map and unmap the memory of the large allocations of tsl::huge_page_allocator.
+ */
+class huge_page_mapping {
+public:
+    static const std::size_t HUGE_PAGE_SIZE = std::size_t(2) * 1024 * 1024;
+    static const std::size_t GIGANTIC_PAGE_SIZE = std::size_t(1024) * 1024 * 1024;
+    
+    /**
+     * Size of the mapping for an allocation of nb_bytes, rounded up to the size of the pages.
+     */
+    static std::size_t mapping_size(std::size_t nb_bytes, tsl::hh::huge_pages pages) {
+        const std::size_t page_size = (pages == tsl::hh::huge_pages::explicit_1gb)?std::size_t(GIGANTIC_PAGE_SIZE):
+                                                                                   std::size_t(HUGE_PAGE_SIZE);
+        if(nb_bytes > std::numeric_limits<std::size_t>::max() - page_size) {
+            throw std::bad_alloc();
+        }
+        
+        return (nb_bytes + page_size - 1) / page_size * page_size;
+    }
+
+#ifdef TSL_HH_HAS_HUGE_PAGES
+    static void* map(std::size_t size, tsl::hh::huge_pages pages,
+                     tsl::hh::numa_policy numa, unsigned int numa_node)
+    {
+        void* data = MAP_FAILED;
+        if(pages == tsl::hh::huge_pages::explicit_2mb || pages == tsl::hh::huge_pages::explicit_1gb) {
+            int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+#ifdef MAP_HUGE_SHIFT
+            flags |= (pages == tsl::hh::huge_pages::explicit_1gb)?(30 << MAP_HUGE_SHIFT):(21 << MAP_HUGE_SHIFT);
+#endif
+            data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        }
+        
+        if(data == MAP_FAILED) {
+            data = map_aligned(size, (pages == tsl::hh::huge_pages::none)?0:std::size_t(HUGE_PAGE_SIZE));
+            if(data == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+
+#ifdef MADV_HUGEPAGE
+            if(pages != tsl::hh::huge_pages::none) {
+                ::madvise(data, size, MADV_HUGEPAGE);
+            }
+#endif
+        }
+        
+        // The NUMA policy is only a hint, the allocation doesn't fail if it can't be applied.
+        apply_numa_policy(data, size, numa, numa_node);
+        
+        return data;
+    }
+    
+    static void unmap(void* data, std::size_t size) noexcept {
+        ::munmap(data, size);
+    }
+    
+private:
+    /*
+     * Map size bytes aligned on alignment by mapping alignment more bytes and unmapping the excess
+     * on each side, the result can then be unmapped in one munmap call.
+     */
+    static void* map_aligned(std::size_t size, std::size_t alignment) {
+        if(alignment == 0) {
+            return ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        }
+        
+        void* data = ::mmap(nullptr, size + alignment, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(data == MAP_FAILED) {
+            return MAP_FAILED;
+        }
+        
+        const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(data);
+        const std::uintptr_t aligned_address = (address + alignment - 1) / alignment * alignment;
+        
+        const std::size_t head_size = std::size_t(aligned_address - address);
+        const std::size_t tail_size = alignment - head_size;
+        if(head_size > 0) {
+            ::munmap(data, head_size);
+        }
+        if(tail_size > 0) {
+            ::munmap(reinterpret_cast<void*>(aligned_address + size), tail_size);
+        }
+        
+        return reinterpret_cast<void*>(aligned_address);
+    }
+    
+    static void apply_numa_policy(void* data, std::size_t size, tsl::hh::numa_policy numa, unsigned int numa_node) {
+#ifdef SYS_mbind
+        // Values of MPOL_BIND and MPOL_INTERLEAVE in <numaif.h>, not included to avoid a dependency on libnuma.
+        static const int MPOL_BIND_MODE = 2;
+        static const int MPOL_INTERLEAVE_MODE = 3;
+        static const std::size_t NB_BITS_PER_WORD = sizeof(unsigned long) * CHAR_BIT;
+        
+        if(numa == tsl::hh::numa_policy::system_default) {
+            return;
+        }
+        
+        std::vector<unsigned long> nodemask;
+        int mode;
+        if(numa == tsl::hh::numa_policy::interleave) {
+            // The kernel restricts the mask to the nodes allowed for the thread.
+            nodemask.assign(1, std::numeric_limits<unsigned long>::max());
+            mode = MPOL_INTERLEAVE_MODE;
+        }
+        else {
+            nodemask.assign(numa_node / NB_BITS_PER_WORD + 1, 0);
+            nodemask.back() = 1ul << (numa_node % NB_BITS_PER_WORD);
+            mode = MPOL_BIND_MODE;
+        }
+        
+        ::syscall(SYS_mbind, data, size, mode, nodemask.data(),
+                  static_cast<unsigned long>(nodemask.size() * NB_BITS_PER_WORD), 0u);
+#else
+        (void) data; (void) size; (void) numa; (void) numa_node;
+#endif
+    }
+#endif
+};
+
+}
+
+
+/**
+ * Allocator backing its large allocations with huge pages and an optional NUMA placement.
+ * Used as allocator of a tsl::hopscotch_map/set (or tsl::bhopscotch_map/set), it reduces the number
+ * of TLB misses on lookups in the bucket array of large tables.
+ * 
+ * The allocations of at least MIN_MAPPING_SIZE bytes (2MB) are mapped with mmap,
+ * using the huge pages and the NUMA policy given on construction (see tsl::hh::huge_pages
+ * and tsl::hh::numa_policy). The smaller allocations (e.g. the nodes of the overflow list
+ * or the bucket array of small tables) use ::operator new as std::allocator.
+ * 
+ * Huge pages and NUMA placement are only supported on Linux. On other platforms the allocator
+ * always uses ::operator new.
+ * 
+ * Two allocators are equal if they use the same huge pages, the memory allocated by one
+ * can then be deallocated by the other.
+ */
+template<class T>
+class huge_page_allocator {
+public:
+    using value_type = T;
+    
+    static const std::size_t MIN_MAPPING_SIZE = detail_hopscotch_hash::huge_page_mapping::HUGE_PAGE_SIZE;
+    
+    explicit huge_page_allocator(tsl::hh::huge_pages pages = tsl::hh::huge_pages::transparent,
+                                 tsl::hh::numa_policy numa = tsl::hh::numa_policy::system_default,
+                                 unsigned int numa_node = 0) noexcept: m_pages(pages), m_numa(numa),
+                                                                       m_numa_node(numa_node)
+    {
+    }
+    
+    template<class U>
+    huge_page_allocator(const huge_page_allocator<U>& other) noexcept: m_pages(other.pages()), m_numa(other.numa()),
+                                                                        m_numa_node(other.numa_node())
+    {
+    }
+    
+    T* allocate(std::size_t n) {
+        if(n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        
+        const std::size_t nb_bytes = n * sizeof(T);
+        if(!use_mapping(nb_bytes)) {
+            return std::allocator<T>().allocate(n);
+        }
+
+#ifdef TSL_HH_HAS_HUGE_PAGES
+        return static_cast<T*>(detail_hopscotch_hash::huge_page_mapping::map(
+                                    detail_hopscotch_hash::huge_page_mapping::mapping_size(nb_bytes, m_pages),
+                                    m_pages, m_numa, m_numa_node));
+#else
+        return nullptr;
+#endif
+    }
+    
+    void deallocate(T* p, std::size_t n) noexcept {
+        const std::size_t nb_bytes = n * sizeof(T);
+        if(!use_mapping(nb_bytes)) {
+            std::allocator<T>().deallocate(p, n);
+            return;
+        }
+
+#ifdef TSL_HH_HAS_HUGE_PAGES
+        detail_hopscotch_hash::huge_page_mapping::unmap(p,
+                                    detail_hopscotch_hash::huge_page_mapping::mapping_size(nb_bytes, m_pages));
+#endif
+    }
+    
+    tsl::hh::huge_pages pages() const noexcept {
+        return m_pages;
+    }
+    
+    tsl::hh::numa_policy numa() const noexcept {
+        return m_numa;
+    }
+    
+    unsigned int numa_node() const noexcept {
+        return m_numa_node;
+    }
+    
+private:
+    static bool use_mapping(std::size_t nb_bytes) noexcept {
+#ifdef TSL_HH_HAS_HUGE_PAGES
+        return nb_bytes >= MIN_MAPPING_SIZE;
+#else
+        (void) nb_bytes;
+        return false;
+#endif
+    }
+    
+private:
+    tsl::hh::huge_pages m_pages;
+    tsl::hh::numa_policy m_numa;
+    unsigned int m_numa_node;
+};
+
+template<class T, class U>
+bool operator==(const huge_page_allocator<T>& lhs, const huge_page_allocator<U>& rhs) noexcept {
+    return lhs.pages() == rhs.pages();
+}
+
+template<class T, class U>
+bool operator!=(const huge_page_allocator<T>& lhs, const huge_page_allocator<U>& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+}
+
+#endif
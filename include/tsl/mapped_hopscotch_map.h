@@ -0,0 +1,581 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2017 Tessil
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef TSL_MAPPED_HOPSCOTCH_MAP_H
+#define TSL_MAPPED_HOPSCOTCH_MAP_H
+
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include "hopscotch_hash.h"
+
+
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+#    define TSL_HH_HAS_MMAP
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+
+namespace tsl {
+
+namespace detail_hopscotch_hash {
+
+#ifdef TSL_HH_HAS_MMAP
+/**
+ * Read-only memory mapping of a whole file, unmapped on destruction.
+ */
+class mapped_file {
+public:
+    mapped_file() noexcept: m_data(nullptr), m_size(0) {
+    }
+    
+    explicit mapped_file(const std::string& path): m_data(nullptr), m_size(0) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd == -1) {
+            throw std::system_error(errno, std::generic_category(), "Couldn't open '" + path + "'.");
+        }
+        
+        struct stat file_stat;
+        if(::fstat(fd, &file_stat) == -1) {
+            const int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "Couldn't stat '" + path + "'.");
+        }
+        
+        m_size = std::size_t(file_stat.st_size);
+        if(m_size > 0) {
+            void* data = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+            if(data == MAP_FAILED) {
+                const int error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::generic_category(), "Couldn't map '" + path + "'.");
+            }
+            
+            m_data = data;
+        }
+        
+        // The mapping stays valid after the file descriptor is closed
+        ::close(fd);
+    }
+    
+    mapped_file(const mapped_file& other) = delete;
+    mapped_file& operator=(const mapped_file& other) = delete;
+    
+    mapped_file(mapped_file&& other) noexcept: m_data(other.m_data), m_size(other.m_size) {
+        other.m_data = nullptr;
+        other.m_size = 0;
+    }
+    
+    mapped_file& operator=(mapped_file&& other) noexcept {
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+        
+        return *this;
+    }
+    
+    ~mapped_file() {
+        if(m_data != nullptr) {
+            ::munmap(m_data, m_size);
+        }
+    }
+    
+    const void* data() const noexcept { return m_data; }
+    std::size_t size() const noexcept { return m_size; }
+
+private:
+    void* m_data;
+    std::size_t m_size;
+};
+#endif
+
+}
+
+
+/**
+ * Read-only view of a map written by tsl::hopscotch_map::write_mapped. The lookups and the iteration are done
+ * directly on the written bytes, typically a memory-mapped file, without deserializing or rehashing anything:
+ * opening the map only validates the header.
+ * 
+ * The bucket array is stored as it was in the original map (neighborhood bitmaps, truncated hashes if StoreHash
+ * is true, keys and values) followed by the overflow elements, see detail_hopscotch_hash::mapped_header.
+ * 
+ * Key and T must be trivially copyable. Hash, KeyEqual, NeighborhoodSize, StoreHash and GrowthPolicy must be
+ * the same as the ones of the written map, only NeighborhoodSize and StoreHash can be checked. The file is
+ * not portable between platforms with a different endianness or a different layout of Key and T.
+ * 
+ * The data passed to the constructor must be aligned at least as the Key and T types (a memory-mapped
+ * file is page-aligned) and must outlive the map.
+ * 
+ * Iterators are only invalidated by the destruction of the map (or of the data it reads). An iterator gives
+ * access to the key and value with key() and value(), there is no std::pair<Key, T> in the data.
+ */
+template<class Key,
+         class T,
+         class Hash = std::hash<Key>,
+         class KeyEqual = std::equal_to<Key>,
+         unsigned int NeighborhoodSize = 62,
+         bool StoreHash = false,
+         class GrowthPolicy = tsl::hh::power_of_two_growth_policy<2>>
+class mapped_hopscotch_map: private Hash, private KeyEqual, private GrowthPolicy {
+private:
+    template<typename U>
+    using has_is_transparent = tsl::detail_hopscotch_hash::has_is_transparent<U>;
+    
+    using bucket = detail_hopscotch_hash::mapped_bucket<Key, T>;
+    
+    static_assert(detail_hopscotch_hash::is_trivially_copyable<Key>::value && 
+                  detail_hopscotch_hash::is_trivially_copyable<T>::value,
+                  "Key and T must be trivially copyable.");
+
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using size_type = std::size_t;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    
+    class const_iterator {
+        friend class mapped_hopscotch_map;
+    
+    private:
+        const_iterator(const bucket* it, const bucket* end) noexcept: m_it(it), m_end(end) {
+            skip_empty_buckets();
+        }
+    
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<const Key&, const T&>;
+        using difference_type = std::ptrdiff_t;
+        using reference = value_type;
+        using pointer = void;
+        
+        const_iterator() noexcept: m_it(nullptr), m_end(nullptr) {
+        }
+        
+        const Key& key() const { return m_it->key; }
+        const T& value() const { return m_it->value; }
+        
+        reference operator*() const { return reference(m_it->key, m_it->value); }
+        
+        const_iterator& operator++() {
+            ++m_it;
+            skip_empty_buckets();
+            
+            return *this;
+        }
+        
+        const_iterator operator++(int) {
+            const_iterator tmp(*this);
+            ++*this;
+            
+            return tmp;
+        }
+        
+        friend bool operator==(const const_iterator& lhs, const const_iterator& rhs) {
+            return lhs.m_it == rhs.m_it;
+        }
+        
+        friend bool operator!=(const const_iterator& lhs, const const_iterator& rhs) {
+            return !(lhs == rhs);
+        }
+    
+    private:
+        void skip_empty_buckets() noexcept {
+            while(m_it != m_end && (m_it->neighborhood_infos & 1) == 0) {
+                ++m_it;
+            }
+        }
+    
+    private:
+        const bucket* m_it;
+        const bucket* m_end;
+    };
+    
+    
+    /**
+     * View of a map written by write_mapped in [data, data + size). Throw std::runtime_error if the data
+     * is not a valid map for this type.
+     */
+    mapped_hopscotch_map(const void* data, std::size_t size,
+                         const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual()):
+                    mapped_hopscotch_map(read_header(data, size), data, hash, equal)
+    {
+    }
+
+#ifdef TSL_HH_HAS_MMAP
+    /**
+     * Memory-map the file at path, which must have been written by write_mapped. The mapping is owned by the map.
+     * Throw std::system_error if the file can't be mapped and std::runtime_error if it isn't a valid map
+     * for this type.
+     */
+    explicit mapped_hopscotch_map(const std::string& path,
+                                  const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual()):
+                    mapped_hopscotch_map(detail_hopscotch_hash::mapped_file(path), hash, equal)
+    {
+    }
+#endif
+
+    mapped_hopscotch_map(const mapped_hopscotch_map& other) = delete;
+    mapped_hopscotch_map& operator=(const mapped_hopscotch_map& other) = delete;
+    
+    mapped_hopscotch_map(mapped_hopscotch_map&& other) = default;
+    mapped_hopscotch_map& operator=(mapped_hopscotch_map&& other) = default;
+    
+    
+    /*
+     * Iterators
+     */
+    const_iterator begin() const noexcept { return cbegin(); }
+    const_iterator cbegin() const noexcept { return const_iterator(m_buckets, m_buckets_end); }
+    
+    const_iterator end() const noexcept { return cend(); }
+    const_iterator cend() const noexcept { return const_iterator(m_buckets_end, m_buckets_end); }
+    
+    
+    /*
+     * Capacity
+     */
+    bool empty() const noexcept { return m_nb_elements == 0; }
+    size_type size() const noexcept { return m_nb_elements; }
+    
+    
+    /*
+     * Lookup
+     */
+    
+    /**
+     * Throw std::out_of_range if the key is not in the map.
+     */
+    const T& at(const Key& key) const { return at(key, hash_key(key)); }
+    
+    /**
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    const T& at(const Key& key, std::size_t precalculated_hash) const { return at_impl(key, precalculated_hash); }
+    
+    /**
+     * This overload only participates in the overload resolution if the typedef KeyEqual::is_transparent exists.
+     * If so, K must be hashable and comparable to Key.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    const T& at(const K& key) const { return at(key, hash_key(key)); }
+    
+    /**
+     * @copydoc at(const K& key) const
+     * 
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    const T& at(const K& key, std::size_t precalculated_hash) const { return at_impl(key, precalculated_hash); }
+    
+    
+    size_type count(const Key& key) const { return count(key, hash_key(key)); }
+    
+    /**
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    size_type count(const Key& key, std::size_t precalculated_hash) const {
+        return (find(key, precalculated_hash) != cend())?1:0;
+    }
+    
+    /**
+     * This overload only participates in the overload resolution if the typedef KeyEqual::is_transparent exists.
+     * If so, K must be hashable and comparable to Key.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    size_type count(const K& key) const { return count(key, hash_key(key)); }
+    
+    /**
+     * @copydoc count(const K& key) const
+     * 
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    size_type count(const K& key, std::size_t precalculated_hash) const {
+        return (find(key, precalculated_hash) != cend())?1:0;
+    }
+    
+    
+    const_iterator find(const Key& key) const { return find(key, hash_key(key)); }
+    
+    /**
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    const_iterator find(const Key& key, std::size_t precalculated_hash) const {
+        return find_impl(key, precalculated_hash);
+    }
+    
+    /**
+     * This overload only participates in the overload resolution if the typedef KeyEqual::is_transparent exists.
+     * If so, K must be hashable and comparable to Key.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    const_iterator find(const K& key) const { return find(key, hash_key(key)); }
+    
+    /**
+     * @copydoc find(const K& key) const
+     * 
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    const_iterator find(const K& key, std::size_t precalculated_hash) const {
+        return find_impl(key, precalculated_hash);
+    }
+    
+    
+    bool contains(const Key& key) const { return count(key) != 0; }
+    
+    /**
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    bool contains(const Key& key, std::size_t precalculated_hash) const {
+        return count(key, precalculated_hash) != 0;
+    }
+    
+    /**
+     * This overload only participates in the overload resolution if the typedef KeyEqual::is_transparent exists.
+     * If so, K must be hashable and comparable to Key.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    bool contains(const K& key) const { return count(key) != 0; }
+    
+    /**
+     * @copydoc contains(const K& key) const
+     * 
+     * Use the hash value 'precalculated_hash' instead of hashing the key. The hash value should be the same
+     * as hash_function()(key). Useful to speed-up the lookup if you already have the hash.
+     */
+    template<class K, class KE = KeyEqual, typename std::enable_if<has_is_transparent<KE>::value>::type* = nullptr>
+    bool contains(const K& key, std::size_t precalculated_hash) const {
+        return count(key, precalculated_hash) != 0;
+    }
+    
+    
+    /*
+     * Bucket interface
+     */
+    size_type bucket_count() const noexcept { return m_bucket_count; }
+    
+    
+    /*
+     *  Hash policy
+     */
+    float load_factor() const noexcept {
+        if(bucket_count() == 0) {
+            return 0;
+        }
+        
+        return float(m_nb_elements)/float(bucket_count());
+    }
+    
+    float max_load_factor() const noexcept { return m_max_load_factor; }
+    
+    
+    /*
+     * Observers
+     */
+    hasher hash_function() const { return static_cast<const Hash&>(*this); }
+    key_equal key_eq() const { return static_cast<const KeyEqual&>(*this); }
+    
+    
+    /*
+     * Other
+     */
+    size_type overflow_size() const noexcept { return m_nb_overflow_elements; }
+
+private:
+    mapped_hopscotch_map(const detail_hopscotch_hash::mapped_header& header, const void* data,
+                         const Hash& hash, const KeyEqual& equal):
+                    mapped_hopscotch_map(header, std::size_t(header.bucket_count), data, hash, equal)
+    {
+    }
+    
+    /*
+     * bucket_count is a copy of header.bucket_count which may be modified by the GrowthPolicy constructor.
+     */
+    mapped_hopscotch_map(const detail_hopscotch_hash::mapped_header& header, std::size_t bucket_count,
+                         const void* data, const Hash& hash, const KeyEqual& equal):
+                    Hash(hash), KeyEqual(equal), GrowthPolicy(bucket_count),
+                    m_buckets(reinterpret_cast<const bucket*>(static_cast<const char*>(data) +
+                                                              detail_hopscotch_hash::MAPPED_BUCKETS_OFFSET)),
+                    m_buckets_end(m_buckets + header.nb_buckets + header.nb_overflow_elements),
+                    m_nb_buckets(std::size_t(header.nb_buckets)),
+                    m_bucket_count(std::size_t(header.bucket_count)),
+                    m_nb_elements(std::size_t(header.nb_elements)),
+                    m_nb_overflow_elements(std::size_t(header.nb_overflow_elements)),
+                    m_max_load_factor(header.max_load_factor)
+    {
+        if(bucket_count != header.bucket_count) {
+            throw std::runtime_error("The GrowthPolicy doesn't match the one of the written map.");
+        }
+    }
+
+#ifdef TSL_HH_HAS_MMAP
+    mapped_hopscotch_map(detail_hopscotch_hash::mapped_file file, const Hash& hash, const KeyEqual& equal):
+                    mapped_hopscotch_map(file.data(), file.size(), hash, equal)
+    {
+        m_file = std::move(file);
+    }
+#endif
+
+    /*
+     * Validate the header and the size of the data.
+     */
+    static detail_hopscotch_hash::mapped_header read_header(const void* data, std::size_t size) {
+        using namespace detail_hopscotch_hash;
+        
+        if(data == nullptr || size < MAPPED_BUCKETS_OFFSET) {
+            throw std::runtime_error("The data is too small to be a mapped map.");
+        }
+        
+        mapped_header header;
+        std::memcpy(&header, data, sizeof(header));
+        
+        if(std::memcmp(header.magic, MAPPED_MAGIC, sizeof(header.magic)) != 0) {
+            throw std::runtime_error("The data is not a mapped map.");
+        }
+        
+        if(header.format_version != MAPPED_FORMAT_VERSION) {
+            throw std::runtime_error("Unsupported mapped map format version.");
+        }
+        
+        if(header.byte_order_mark != MAPPED_BYTE_ORDER_MARK) {
+            throw std::runtime_error("The mapped map was written on a platform with a different endianness.");
+        }
+        
+        if(header.neighborhood_size != NeighborhoodSize || header.store_hash != (StoreHash?1u:0u)) {
+            throw std::runtime_error("The NeighborhoodSize or StoreHash of the mapped map doesn't match.");
+        }
+        
+        if(header.bucket_size != sizeof(bucket) || header.key_size != sizeof(Key) ||
+           header.value_size != sizeof(T))
+        {
+            throw std::runtime_error("The layout of the elements of the mapped map doesn't match.");
+        }
+        
+        if(header.nb_buckets != ((header.bucket_count == 0)?0:header.bucket_count + NeighborhoodSize - 1) ||
+           header.nb_overflow_elements > header.nb_elements)
+        {
+            throw std::runtime_error("Invalid mapped map header.");
+        }
+        
+        const std::uint64_t max_nb_buckets = (size - MAPPED_BUCKETS_OFFSET)/sizeof(bucket);
+        if(header.nb_buckets > max_nb_buckets || header.nb_overflow_elements > max_nb_buckets - header.nb_buckets) {
+            throw std::runtime_error("The data is truncated.");
+        }
+        
+        return header;
+    }
+    
+    template<class K>
+    std::size_t hash_key(const K& key) const {
+        return Hash::operator()(key);
+    }
+    
+    template<class K1, class K2>
+    bool compare_keys(const K1& key1, const K2& key2) const {
+        return KeyEqual::operator()(key1, key2);
+    }
+    
+    template<class K>
+    const T& at_impl(const K& key, std::size_t hash) const {
+        const_iterator it = find_impl(key, hash);
+        if(it == cend()) {
+            throw std::out_of_range("Couldn't find key.");
+        }
+        
+        return it.value();
+    }
+    
+    /*
+     * Same lookup as hopscotch_hash::find_in_buckets, then a linear search in the overflow elements if the
+     * neighborhood has overflown.
+     */
+    template<class K>
+    const_iterator find_impl(const K& key, std::size_t hash) const {
+        if(m_nb_buckets == 0) {
+            return cend();
+        }
+        
+        const bucket* bucket_for_hash = m_buckets + GrowthPolicy::bucket_for_hash(hash);
+        
+        std::uint64_t candidates = bucket_for_hash->neighborhood_infos >>
+                                   detail_hopscotch_hash::NB_RESERVED_BITS_IN_NEIGHBORHOOD;
+        while(candidates != 0) {
+            const bucket* candidate = bucket_for_hash + detail_hopscotch_hash::count_trailing_zeros(candidates);
+            if((!StoreHash || candidate->truncated_hash == detail_hopscotch_hash::truncated_hash_type(hash)) &&
+               compare_keys(candidate->key, key))
+            {
+                return const_iterator(candidate, m_buckets_end);
+            }
+            
+            candidates &= candidates - 1;
+        }
+        
+        if((bucket_for_hash->neighborhood_infos & 2) != 0) {
+            for(const bucket* it = m_buckets + m_nb_buckets; it != m_buckets_end; ++it) {
+                if(compare_keys(it->key, key)) {
+                    return const_iterator(it, m_buckets_end);
+                }
+            }
+        }
+        
+        return cend();
+    }
+
+private:
+#ifdef TSL_HH_HAS_MMAP
+    detail_hopscotch_hash::mapped_file m_file;
+#endif
+
+    const bucket* m_buckets;
+    const bucket* m_buckets_end;
+    std::size_t m_nb_buckets;
+    std::size_t m_bucket_count;
+    std::size_t m_nb_elements;
+    std::size_t m_nb_overflow_elements;
+    float m_max_load_factor;
+};
+
+} // end namespace tsl
+
+#endif
@@ -0,0 +1,399 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2017 Tessil
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef TSL_PERFECT_HASH_H
+#define TSL_PERFECT_HASH_H
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "hopscotch_growth_policy.h"
+#include "hopscotch_hash.h"
+
+
+namespace tsl {
+
+namespace detail_hopscotch_hash {
+
+/*
+ * Finalizer of MurmurHash3, a bijection on 64 bits mixing all the bits of the input into all the bits
+ * of the output.
+ */
+inline std::uint64_t mix_hash(std::uint64_t hash) noexcept {
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xff51afd7ed558ccd);
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xc4ceb9fe1a85ec53);
+    hash ^= hash >> 33;
+    
+    return hash;
+}
+
+
+/**
+ * Internal common class used by perfect_hash_map and perfect_hash_set.
+ * 
+ * Read-only container built once from a range of values with a minimal perfect hash function of their keys
+ * (PTHash, "PTHash: Revisiting FCH Minimal Perfect Hashing", Pibiri and Trani, 2021): each of the n keys
+ * is mapped to its own slot in [0, n) and the values are stored in a single array of n values, in the
+ * order of their slot.
+ * 
+ * The keys are split in about n / AVERAGE_KEYS_PER_PILOT buckets. For each bucket, a 'pilot' is searched
+ * such that the slots 'position(hash, pilot)' of all the keys of the bucket are free, the largest buckets
+ * first. A lookup hashes the key, reads the pilot of its bucket, computes the slot and compares the key
+ * of the value in the slot: one probe in the values whether the key is there or not.
+ * 
+ * The pilots only depend on the hashes of the keys, two different keys with the same hash
+ * can't be separated and the construction throws std::invalid_argument.
+ */
+template<class ValueType,
+         class KeySelect,
+         class ValueSelect,
+         class Hash,
+         class KeyEqual,
+         class Allocator>
+class perfect_hash: private Hash, private KeyEqual {
+private:
+    template<typename U>
+    using has_mapped_type = typename std::integral_constant<bool, !std::is_same<U, void>::value>;
+    
+    using values_container_type = std::vector<ValueType, Allocator>;
+    using pilots_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<std::uint32_t>;
+    using pilots_container_type = std::vector<std::uint32_t, pilots_allocator>;
+
+public:
+    using key_type = typename KeySelect::key_type;
+    using value_type = ValueType;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    using allocator_type = Allocator;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+    using pointer = value_type*;
+    using const_pointer = const value_type*;
+    using iterator = typename values_container_type::const_iterator;
+    using const_iterator = typename values_container_type::const_iterator;
+
+
+    /**
+     * Build the container from the values of [first, last), keeping only the first of equivalent keys.
+     */
+    template<class InputIt>
+    perfect_hash(InputIt first, InputIt last, const Hash& hash, const KeyEqual& equal, const Allocator& alloc):
+                    Hash(hash), KeyEqual(equal), m_values(alloc), m_pilots(pilots_allocator(alloc)), m_seed(0)
+    {
+        build(values_container_type(first, last, alloc));
+    }
+    
+    allocator_type get_allocator() const { return m_values.get_allocator(); }
+
+
+    /*
+     * Iterators
+     */
+    const_iterator begin() const noexcept { return m_values.cbegin(); }
+    const_iterator cbegin() const noexcept { return m_values.cbegin(); }
+    
+    const_iterator end() const noexcept { return m_values.cend(); }
+    const_iterator cend() const noexcept { return m_values.cend(); }
+
+
+    /*
+     * Capacity
+     */
+    bool empty() const noexcept { return m_values.empty(); }
+    size_type size() const noexcept { return m_values.size(); }
+
+
+    /*
+     * Lookup
+     */
+    template<class K, class U = ValueSelect, typename std::enable_if<has_mapped_type<U>::value>::type* = nullptr>
+    const typename U::value_type& at(const K& key, std::size_t hash) const {
+        const_iterator it = find(key, hash);
+        if(it == cend()) {
+            throw std::out_of_range("Couldn't find key.");
+        }
+        
+        return U()(*it);
+    }
+    
+    template<class K>
+    size_type count(const K& key, std::size_t hash) const {
+        return (find(key, hash) != cend())?1:0;
+    }
+    
+    template<class K>
+    const_iterator find(const K& key, std::size_t hash) const {
+        if(m_values.empty()) {
+            return cend();
+        }
+        
+        const std::size_t ivalue = position(hash);
+        if(compare_keys(KeySelect()(m_values[ivalue]), key)) {
+            return m_values.cbegin() + difference_type(ivalue);
+        }
+        
+        return cend();
+    }
+
+
+    /*
+     * Observers
+     */
+    hasher hash_function() const { return static_cast<const Hash&>(*this); }
+    key_equal key_eq() const { return static_cast<const KeyEqual&>(*this); }
+
+
+    /*
+     * Other
+     */
+    template<class K>
+    std::size_t hash_key(const K& key) const {
+        return Hash::operator()(key);
+    }
+    
+    /**
+     * Number of pilots (one std::uint32_t each) of the perfect hash function.
+     */
+    size_type pilot_count() const noexcept { return m_pilots.size(); }
+
+private:
+    /*
+     * Hash and index in the values passed to build of a value to place.
+     */
+    struct value_to_place {
+        std::size_t hash;
+        std::size_t index;
+    };
+    
+    template<class K1, class K2>
+    bool compare_keys(const K1& key1, const K2& key2) const {
+        return KeyEqual::operator()(key1, key2);
+    }
+    
+    std::uint64_t seeded_hash(std::size_t hash) const noexcept {
+        return mix_hash(std::uint64_t(hash) ^ m_seed);
+    }
+    
+    std::size_t pilot_bucket(std::uint64_t hash_seeded) const noexcept {
+        return tsl::hh::detail::multiply_high(std::size_t(hash_seeded), m_pilots.size());
+    }
+    
+    static std::size_t position(std::uint64_t hash_seeded, std::uint32_t pilot, std::size_t nb_values) noexcept {
+        const std::uint64_t pilot_hash = mix_hash(hash_seeded ^ mix_hash(pilot));
+        return tsl::hh::detail::multiply_high(std::size_t(pilot_hash), nb_values);
+    }
+    
+    std::size_t position(std::size_t hash) const noexcept {
+        const std::uint64_t hash_seeded = seeded_hash(hash);
+        return position(hash_seeded, m_pilots[pilot_bucket(hash_seeded)], m_values.size());
+    }
+    
+    /*
+     * 1. Sort the values by hash and remove the equivalent keys (throw if different keys have the same hash).
+     * 2. Split the keys in buckets, order the buckets by decreasing size and search a pilot for each
+     *    bucket. If no pilot is found for a bucket (very unlikely), retry with another seed.
+     * 3. Move the values into their slot.
+     */
+    void build(values_container_type values) {
+        std::vector<value_to_place> to_place;
+        to_place.reserve(values.size());
+        for(std::size_t i = 0; i < values.size(); i++) {
+            to_place.push_back({hash_key(KeySelect()(values[i])), i});
+        }
+        
+        remove_equivalent_keys(to_place, values);
+        if(to_place.empty()) {
+            return;
+        }
+        
+        const std::size_t nb_values = to_place.size();
+        m_pilots.resize((nb_values + AVERAGE_KEYS_PER_PILOT - 1)/AVERAGE_KEYS_PER_PILOT);
+        
+        std::vector<std::size_t> index_at_position(nb_values);
+        for(std::uint64_t attempt = 0; ; attempt++) {
+            if(attempt == MAX_SEED_ATTEMPTS) {
+                throw std::runtime_error("Couldn't find a perfect hash function for the keys.");
+            }
+            
+            m_seed = mix_hash(attempt + 1);
+            if(search_pilots(to_place, index_at_position)) {
+                break;
+            }
+        }
+        
+        values_container_type placed_values(m_values.get_allocator());
+        placed_values.reserve(nb_values);
+        for(std::size_t index: index_at_position) {
+            placed_values.push_back(std::move(values[index]));
+        }
+        
+        m_values.swap(placed_values);
+    }
+    
+    /*
+     * Keep the first of the values with equivalent keys. to_place is sorted by hash on return.
+     */
+    void remove_equivalent_keys(std::vector<value_to_place>& to_place, const values_container_type& values) const {
+        std::sort(to_place.begin(), to_place.end(), [](const value_to_place& lhs, const value_to_place& rhs) {
+            return lhs.hash < rhs.hash || (lhs.hash == rhs.hash && lhs.index < rhs.index);
+        });
+        
+        std::size_t nb_kept = 0;
+        for(std::size_t i = 0; i < to_place.size(); i++) {
+            if(nb_kept > 0 && to_place[nb_kept - 1].hash == to_place[i].hash) {
+                if(!compare_keys(KeySelect()(values[to_place[nb_kept - 1].index]),
+                                 KeySelect()(values[to_place[i].index])))
+                {
+                    throw std::invalid_argument("Two different keys have the same hash, "
+                                                "they can't be separated by a perfect hash function.");
+                }
+                
+                continue;
+            }
+            
+            to_place[nb_kept] = to_place[i];
+            nb_kept++;
+        }
+        
+        to_place.resize(nb_kept);
+    }
+    
+    /*
+     * Search a pilot for each bucket of keys with the current seed, the largest buckets first.
+     * Fill index_at_position with the index of the value in each slot. Return false if no pilot
+     * could be found for a bucket.
+     */
+    bool search_pilots(const std::vector<value_to_place>& to_place, std::vector<std::size_t>& index_at_position) {
+        const std::size_t nb_values = to_place.size();
+        const std::size_t nb_buckets = m_pilots.size();
+        
+        // Group the keys by bucket (counting sort)
+        std::vector<std::size_t> bucket_offsets(nb_buckets + 1, 0);
+        for(const value_to_place& value: to_place) {
+            bucket_offsets[pilot_bucket(seeded_hash(value.hash)) + 1]++;
+        }
+        for(std::size_t i = 1; i < bucket_offsets.size(); i++) {
+            bucket_offsets[i] += bucket_offsets[i - 1];
+        }
+        
+        std::vector<std::size_t> next_offsets(bucket_offsets.begin(), bucket_offsets.end() - 1);
+        std::vector<std::pair<std::uint64_t, std::size_t>> keys_by_bucket(nb_values);
+        for(const value_to_place& value: to_place) {
+            const std::uint64_t hash_seeded = seeded_hash(value.hash);
+            keys_by_bucket[next_offsets[pilot_bucket(hash_seeded)]++] = {hash_seeded, value.index};
+        }
+        
+        // Order the buckets by decreasing size (counting sort)
+        std::size_t max_bucket_size = 0;
+        for(std::size_t ibucket = 0; ibucket < nb_buckets; ibucket++) {
+            max_bucket_size = std::max(max_bucket_size, bucket_offsets[ibucket + 1] - bucket_offsets[ibucket]);
+        }
+        
+        std::vector<std::size_t> size_offsets(max_bucket_size + 2, 0);
+        for(std::size_t ibucket = 0; ibucket < nb_buckets; ibucket++) {
+            size_offsets[max_bucket_size - (bucket_offsets[ibucket + 1] - bucket_offsets[ibucket]) + 1]++;
+        }
+        for(std::size_t i = 1; i < size_offsets.size(); i++) {
+            size_offsets[i] += size_offsets[i - 1];
+        }
+        
+        std::vector<std::size_t> buckets_order(nb_buckets);
+        for(std::size_t ibucket = 0; ibucket < nb_buckets; ibucket++) {
+            const std::size_t bucket_size = bucket_offsets[ibucket + 1] - bucket_offsets[ibucket];
+            buckets_order[size_offsets[max_bucket_size - bucket_size]++] = ibucket;
+        }
+
+
+        std::vector<bool> taken(nb_values, false);
+        std::vector<std::size_t> positions(max_bucket_size);
+        for(std::size_t ibucket: buckets_order) {
+            const std::size_t bucket_begin = bucket_offsets[ibucket];
+            const std::size_t bucket_size = bucket_offsets[ibucket + 1] - bucket_begin;
+            
+            std::uint32_t pilot = 0;
+            while(!try_pilot(keys_by_bucket.data() + bucket_begin, bucket_size, pilot, taken, positions)) {
+                if(pilot == std::numeric_limits<std::uint32_t>::max()) {
+                    return false;
+                }
+                
+                pilot++;
+            }
+            
+            m_pilots[ibucket] = pilot;
+            for(std::size_t i = 0; i < bucket_size; i++) {
+                taken[positions[i]] = true;
+                index_at_position[positions[i]] = keys_by_bucket[bucket_begin + i].second;
+            }
+        }
+        
+        return true;
+    }
+    
+    /*
+     * True if the slots of the bucket_size keys with the pilot are free and all different.
+     * Store the slots in positions.
+     */
+    static bool try_pilot(const std::pair<std::uint64_t, std::size_t>* keys, std::size_t bucket_size,
+                          std::uint32_t pilot, const std::vector<bool>& taken, std::vector<std::size_t>& positions)
+    {
+        for(std::size_t i = 0; i < bucket_size; i++) {
+            positions[i] = position(keys[i].first, pilot, taken.size());
+            if(taken[positions[i]] || std::find(positions.begin(), positions.begin() + i, positions[i]) !=
+                                      positions.begin() + i)
+            {
+                return false;
+            }
+        }
+        
+        return true;
+    }
+
+private:
+    /*
+     * Average number of keys per pilot. Larger buckets need less memory for the pilots but make their search
+     * longer.
+     */
+    static const std::size_t AVERAGE_KEYS_PER_PILOT = 4;
+    static const std::uint64_t MAX_SEED_ATTEMPTS = 16;
+    
+    values_container_type m_values;
+    pilots_container_type m_pilots;
+    std::uint64_t m_seed;
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,353 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2018 Tessil
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <tsl/concurrent_hopscotch_map.h>
+#include "utils.h"
+
+
+BOOST_AUTO_TEST_SUITE(test_concurrent_hopscotch_map)
+
+/**
+ * insert, find, erase
+ */
+BOOST_AUTO_TEST_CASE(test_basic_operations) {
+    tsl::concurrent_hopscotch_map<std::string, std::string> map(0, 8);
+    BOOST_CHECK_EQUAL(map.shard_count(), 8);
+    BOOST_CHECK(map.empty());
+    
+    const std::size_t nb_values = 1000;
+    for(std::size_t i = 0; i < nb_values; i++) {
+        BOOST_CHECK(map.insert({utils::get_key<std::string>(i), utils::get_value<std::string>(i)}));
+    }
+    BOOST_CHECK(!map.insert({utils::get_key<std::string>(0), "other"}));
+    BOOST_CHECK(!map.try_emplace(utils::get_key<std::string>(0), "other"));
+    BOOST_CHECK(!map.emplace(utils::get_key<std::string>(0), "other"));
+    BOOST_CHECK_EQUAL(map.size(), nb_values);
+    
+    for(std::size_t i = 0; i < nb_values; i++) {
+        std::string value;
+        BOOST_REQUIRE(map.find(utils::get_key<std::string>(i), value));
+        BOOST_CHECK_EQUAL(value, utils::get_value<std::string>(i));
+        BOOST_CHECK_EQUAL(map.at(utils::get_key<std::string>(i)), utils::get_value<std::string>(i));
+    }
+    
+    std::string value = "unchanged";
+    BOOST_CHECK(!map.find(utils::get_key<std::string>(nb_values), value));
+    BOOST_CHECK_EQUAL(value, "unchanged");
+    BOOST_CHECK_THROW(map.at(utils::get_key<std::string>(nb_values)), std::out_of_range);
+    BOOST_CHECK(!map.contains(utils::get_key<std::string>(nb_values)));
+    
+    
+    BOOST_CHECK(!map.insert_or_assign(utils::get_key<std::string>(1), "assigned"));
+    BOOST_CHECK_EQUAL(map.at(utils::get_key<std::string>(1)), "assigned");
+    BOOST_CHECK(map.try_emplace(utils::get_key<std::string>(nb_values), "new"));
+    BOOST_CHECK_EQUAL(map.count(utils::get_key<std::string>(nb_values)), 1);
+    
+    
+    for(std::size_t i = 0; i <= nb_values; i += 2) {
+        BOOST_CHECK_EQUAL(map.erase(utils::get_key<std::string>(i)), 1);
+    }
+    BOOST_CHECK_EQUAL(map.erase(utils::get_key<std::string>(0)), 0);
+    BOOST_CHECK_EQUAL(map.size(), nb_values/2);
+    
+    for(std::size_t i = 0; i <= nb_values; i++) {
+        BOOST_CHECK_EQUAL(map.contains(utils::get_key<std::string>(i)), i % 2 == 1);
+    }
+    
+    map.clear();
+    BOOST_CHECK(map.empty());
+}
+
+/**
+ * visit, visit_all
+ */
+BOOST_AUTO_TEST_CASE(test_visit) {
+    tsl::concurrent_hopscotch_map<std::int64_t, std::int64_t> map = {{1, 10}, {2, 20}, {3, 30}};
+    
+    BOOST_CHECK(map.visit(2, [](std::int64_t key, std::int64_t& value) { value += key; }));
+    BOOST_CHECK_EQUAL(map.at(2), 22);
+    BOOST_CHECK(!map.visit(4, [](std::int64_t /*key*/, std::int64_t& value) { value = 0; }));
+    
+    map.visit_all([](std::int64_t /*key*/, std::int64_t& value) { value *= 2; });
+    
+    const auto& map_const = map;
+    std::int64_t sum = 0;
+    map_const.visit_all([&](std::int64_t key, const std::int64_t& value) { sum += key + value; });
+    BOOST_CHECK_EQUAL(sum, 1 + 2 + 3 + 20 + 44 + 60);
+}
+
+/**
+ * Weak hash: the keys must still be spread over the shards
+ */
+BOOST_AUTO_TEST_CASE(test_identity_hash_shards) {
+    tsl::concurrent_hopscotch_map<std::int64_t, std::int64_t, identity_hash<std::int64_t>> map(0, 16);
+    map.reserve(1600);
+    
+    const std::size_t bucket_count = map.bucket_count();
+    for(std::int64_t i = 0; i < 1600; i++) {
+        map.insert({i, i});
+    }
+    
+    // Each shard reserved space for 100 elements, no shard should need to grow
+    BOOST_CHECK_EQUAL(map.bucket_count(), bucket_count);
+    BOOST_CHECK_EQUAL(map.size(), 1600);
+}
+
+/**
+ * Concurrent insert, find and erase
+ */
+BOOST_AUTO_TEST_CASE(test_concurrent_insert_find_erase) {
+    tsl::concurrent_hopscotch_map<std::int64_t, std::int64_t, mod_hash<9>> map(0, 4);
+    
+    const std::size_t nb_threads = 8;
+    const std::int64_t nb_values_per_thread = 5000;
+    
+    std::vector<std::thread> threads;
+    std::vector<std::size_t> nb_errors(nb_threads, 0);
+    for(std::size_t ithread = 0; ithread < nb_threads; ithread++) {
+        threads.emplace_back([&, ithread]() {
+            const std::int64_t offset = std::int64_t(ithread)*nb_values_per_thread;
+            
+            for(std::int64_t i = offset; i < offset + nb_values_per_thread; i++) {
+                if(!map.insert({i, i*2})) {
+                    nb_errors[ithread]++;
+                }
+            }
+            
+            for(std::int64_t i = offset; i < offset + nb_values_per_thread; i++) {
+                std::int64_t value = 0;
+                if(!map.find(i, value) || value != i*2) {
+                    nb_errors[ithread]++;
+                }
+            }
+            
+            for(std::int64_t i = offset; i < offset + nb_values_per_thread; i += 2) {
+                if(map.erase(i) != 1) {
+                    nb_errors[ithread]++;
+                }
+            }
+        });
+    }
+    
+    for(std::thread& thread: threads) {
+        thread.join();
+    }
+    
+    for(std::size_t ithread = 0; ithread < nb_threads; ithread++) {
+        BOOST_CHECK_EQUAL(nb_errors[ithread], 0);
+    }
+    
+    BOOST_CHECK_EQUAL(map.size(), nb_threads*nb_values_per_thread/2);
+    for(std::int64_t i = 0; i < std::int64_t(nb_threads)*nb_values_per_thread; i++) {
+        BOOST_CHECK_EQUAL(map.count(i), (i % 2 == 0)?0:1);
+    }
+}
+
+/**
+ * Concurrent updates of the same keys
+ */
+BOOST_AUTO_TEST_CASE(test_concurrent_visit_same_keys) {
+    tsl::concurrent_hopscotch_map<std::int64_t, std::int64_t> map;
+    
+    const std::size_t nb_threads = 8;
+    const std::int64_t nb_keys = 100;
+    const std::int64_t nb_increments = 1000;
+    
+    std::vector<std::thread> threads;
+    for(std::size_t ithread = 0; ithread < nb_threads; ithread++) {
+        threads.emplace_back([&]() {
+            for(std::int64_t i = 0; i < nb_increments; i++) {
+                for(std::int64_t key = 0; key < nb_keys; key++) {
+                    map.try_emplace(key, 0);
+                    map.visit(key, [](std::int64_t /*key*/, std::int64_t& value) { value++; });
+                }
+            }
+        });
+    }
+    
+    for(std::thread& thread: threads) {
+        thread.join();
+    }
+    
+    for(std::int64_t key = 0; key < nb_keys; key++) {
+        BOOST_CHECK_EQUAL(map.at(key), std::int64_t(nb_threads)*nb_increments);
+    }
+}
+
+/**
+ * Lock-free lookups while a writer inserts, erases and rehashes the shard
+ */
+BOOST_AUTO_TEST_CASE(test_concurrent_lookups_during_rehash) {
+    // A single shard and a small neighborhood to have a lot of displacements and rehashes
+    tsl::concurrent_hopscotch_map<std::int64_t, std::int64_t, std::hash<std::int64_t>, 
+                                  std::equal_to<std::int64_t>, 
+                                  std::allocator<std::pair<std::int64_t, std::int64_t>>, 6> map(0, 1);
+    
+    const std::int64_t nb_stable_keys = 1000;
+    const std::int64_t nb_volatile_keys = 20000;
+    for(std::int64_t i = 0; i < nb_stable_keys; i++) {
+        map.insert({i, i*2});
+    }
+    
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> readers;
+    std::vector<std::size_t> nb_errors(4, 0);
+    for(std::size_t ireader = 0; ireader < nb_errors.size(); ireader++) {
+        readers.emplace_back([&, ireader]() {
+            std::int64_t i = 0;
+            while(!stop.load()) {
+                std::int64_t value = 0;
+                
+                const std::int64_t stable_key = i % nb_stable_keys;
+                if(!map.find(stable_key, value) || value != stable_key*2) {
+                    nb_errors[ireader]++;
+                }
+                
+                const std::int64_t volatile_key = nb_stable_keys + i % nb_volatile_keys;
+                if(map.find(volatile_key, value) && value != volatile_key*2) {
+                    nb_errors[ireader]++;
+                }
+                
+                i++;
+            }
+        });
+    }
+    
+    for(std::size_t round = 0; round < 3; round++) {
+        for(std::int64_t i = nb_stable_keys; i < nb_stable_keys + nb_volatile_keys; i++) {
+            map.insert({i, i*2});
+        }
+        for(std::int64_t i = nb_stable_keys; i < nb_stable_keys + nb_volatile_keys; i++) {
+            map.erase(i);
+        }
+        
+        // Rehash the table with the stable keys only
+        map.reserve(std::size_t(nb_stable_keys + std::int64_t(round + 2)*nb_volatile_keys));
+    }
+    
+    stop.store(true);
+    for(std::thread& reader: readers) {
+        reader.join();
+    }
+    
+    for(std::size_t ireader = 0; ireader < nb_errors.size(); ireader++) {
+        BOOST_CHECK_EQUAL(nb_errors[ireader], 0);
+    }
+    
+    for(std::int64_t i = 0; i < nb_stable_keys; i++) {
+        BOOST_CHECK_EQUAL(map.at(i), i*2);
+    }
+}
+
+/**
+ * Reclamation of the bucket arrays replaced by a rehash
+ */
+namespace {
+std::atomic<std::int64_t> nb_allocated_bytes(0);
+
+template<typename T>
+class counting_allocator {
+public:
+    using value_type = T;
+    
+    counting_allocator() = default;
+    
+    template<typename U> 
+    counting_allocator(const counting_allocator<U>&) {
+    }
+    
+    T* allocate(std::size_t n) {
+        nb_allocated_bytes += std::int64_t(n*sizeof(T));
+        return std::allocator<T>().allocate(n);
+    }
+    
+    void deallocate(T* p, std::size_t n) {
+        nb_allocated_bytes -= std::int64_t(n*sizeof(T));
+        std::allocator<T>().deallocate(p, n);
+    }
+};
+
+template<class T, class U>
+bool operator==(const counting_allocator<T>&, const counting_allocator<U>&) { 
+    return true; 
+}
+
+template<class T, class U>
+bool operator!=(const counting_allocator<T>&, const counting_allocator<U>&) { 
+    return false; 
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_replaced_buckets_reclaimed) {
+    using HMap = tsl::concurrent_hopscotch_map<std::int64_t, std::int64_t, std::hash<std::int64_t>, 
+                                               std::equal_to<std::int64_t>, 
+                                               counting_allocator<std::pair<std::int64_t, std::int64_t>>>;
+    
+    const std::int64_t nb_keys = 10000;
+    const std::int64_t nb_bytes_start = nb_allocated_bytes;
+    
+    HMap map(0, 1);
+    for(std::int64_t i = 0; i < nb_keys; i++) {
+        map.insert({i, i});
+    }
+    
+    // A reserve which doesn't change the bucket count doesn't replace the bucket array
+    const std::int64_t nb_bytes_filled = nb_allocated_bytes;
+    for(std::size_t i = 0; i < 20; i++) {
+        map.reserve(std::size_t(nb_keys));
+    }
+    BOOST_CHECK_EQUAL(nb_allocated_bytes, nb_bytes_filled);
+    
+    // Without any reader, the replaced bucket arrays are freed by the rehash itself
+    for(std::size_t count = 20000; count <= 320000; count *= 2) {
+        map.reserve(count);
+    }
+    const std::int64_t nb_bytes_map = nb_allocated_bytes - nb_bytes_start;
+    
+    HMap map_reference(0, 1);
+    map_reference.reserve(320000);
+    for(std::int64_t i = 0; i < nb_keys; i++) {
+        map_reference.insert({i, i});
+    }
+    BOOST_CHECK_EQUAL(nb_allocated_bytes - nb_bytes_start - nb_bytes_map, nb_bytes_map);
+    
+    for(std::int64_t i = 0; i < nb_keys; i++) {
+        BOOST_CHECK_EQUAL(map.at(i), i);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,153 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2018 Tessil
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <tsl/constexpr_hopscotch_map.h>
+
+
+#ifdef TSL_HH_HAS_CONSTEXPR_MAP
+namespace {
+
+enum class opcode { nop, load, store, jump };
+
+constexpr std::pair<std::int32_t, opcode> OPCODES[] = {{0x00, opcode::nop}, {0x10, opcode::load}, 
+                                                       {0x20, opcode::store}, {0x30, opcode::jump}};
+constexpr auto opcodes = tsl::make_constexpr_hopscotch_map(OPCODES);
+
+static_assert(opcodes.size() == 4, "");
+static_assert(opcodes.at(0x10) == opcode::load, "");
+static_assert(opcodes.find(0x30).value() == opcode::jump, "");
+static_assert(opcodes.count(0x40) == 0, "");
+static_assert(opcodes.find(0x40) == opcodes.end(), "");
+static_assert(opcodes.contains(0x00), "");
+
+
+constexpr std::pair<const char*, std::int32_t> HEADERS[] = {{"Accept", 1}, {"Content-Length", 2}, 
+                                                            {"Content-Type", 3}, {"Host", 4}};
+constexpr auto headers = tsl::make_constexpr_hopscotch_map(HEADERS);
+
+static_assert(headers.at("Content-Type") == 3, "");
+static_assert(!headers.contains("Content"), "");
+
+
+/*
+ * All the keys in the same home bucket, the elements must be displaced
+ */
+struct constant_hash {
+    constexpr std::size_t operator()(std::int32_t /*key*/) const noexcept {
+        return 0;
+    }
+};
+
+using collisions_map_t = tsl::constexpr_hopscotch_map<std::int32_t, std::int32_t, 8, constant_hash, 
+                                                      tsl::hh::constexpr_equal_to<std::int32_t>, 8, 16>;
+constexpr collisions_map_t collisions_map(std::array<std::pair<std::int32_t, std::int32_t>, 8>{{
+    {1, 10}, {2, 20}, {3, 30}, {4, 40}, {5, 50}, {6, 60}, {7, 70}, {8, 80}
+}});
+
+static_assert(collisions_map.at(1) == 10 && collisions_map.at(8) == 80, "");
+static_assert(!collisions_map.contains(9), "");
+
+}
+
+
+BOOST_AUTO_TEST_SUITE(test_constexpr_hopscotch_map)
+
+BOOST_AUTO_TEST_CASE(test_runtime_lookups) {
+    // The same map queried with runtime keys
+    const std::vector<std::int32_t> keys = {0x00, 0x10, 0x20, 0x30, 0x40};
+    
+    BOOST_CHECK(opcodes.at(keys[1]) == opcode::load);
+    BOOST_CHECK(opcodes.at(keys[3]) == opcode::jump);
+    BOOST_CHECK(opcodes.find(keys[4]) == opcodes.end());
+    BOOST_CHECK_THROW(opcodes.at(keys[4]), std::out_of_range);
+    
+    const std::string header = "Host";
+    BOOST_CHECK_EQUAL(headers.at(header.c_str()), 4);
+    BOOST_CHECK_EQUAL(headers.count(std::string("Accept").c_str()), 1);
+    BOOST_CHECK_EQUAL(headers.count(std::string("Accept-Encoding").c_str()), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_iterator) {
+    BOOST_CHECK_EQUAL(std::distance(headers.begin(), headers.end()), 4);
+    
+    std::int32_t sum = 0;
+    for(const auto& key_value: headers) {
+        BOOST_CHECK_EQUAL(headers.at(key_value.first), key_value.second);
+        sum += key_value.second;
+    }
+    BOOST_CHECK_EQUAL(sum, 1 + 2 + 3 + 4);
+}
+
+BOOST_AUTO_TEST_CASE(test_runtime_construction) {
+    std::array<std::pair<std::int64_t, std::int64_t>, 100> values{};
+    for(std::size_t i = 0; i < values.size(); i++) {
+        values[i] = {std::int64_t(i*i), std::int64_t(i)};
+    }
+    
+    const tsl::constexpr_hopscotch_map<std::int64_t, std::int64_t, 100> map(values);
+    BOOST_CHECK_EQUAL(map.bucket_count(), 128);
+    for(std::size_t i = 0; i < values.size(); i++) {
+        BOOST_CHECK_EQUAL(map.at(std::int64_t(i*i)), std::int64_t(i));
+    }
+    BOOST_CHECK(!map.contains(2));
+    
+    
+    // Duplicates are rejected
+    values[1].first = values[0].first;
+    BOOST_CHECK_THROW((tsl::constexpr_hopscotch_map<std::int64_t, std::int64_t, 100>(values)), 
+                      std::invalid_argument);
+    
+    
+    // More elements than the neighborhood can hold in the same home bucket
+    const std::pair<std::int32_t, std::int32_t> collisions[] = {{1, 1}, {2, 2}, {3, 3}, {4, 4}, {5, 5}};
+    using small_neighborhood_map_t = tsl::constexpr_hopscotch_map<std::int32_t, std::int32_t, 5, constant_hash, 
+                                                                  tsl::hh::constexpr_equal_to<std::int32_t>, 4>;
+    BOOST_CHECK_THROW(small_neighborhood_map_t map_collisions(collisions), std::length_error);
+}
+
+#ifdef TSL_HH_HAS_STRING_VIEW
+BOOST_AUTO_TEST_CASE(test_string_view) {
+    static constexpr std::pair<std::string_view, int> METHODS[] = {{"GET", 1}, {"POST", 2}, {"PUT", 3}};
+    static constexpr auto methods = tsl::make_constexpr_hopscotch_map(METHODS);
+    static_assert(methods.at("POST") == 2, "");
+    
+    const std::string buffer = "PUT /index.html";
+    BOOST_CHECK_EQUAL(methods.at(std::string_view(buffer).substr(0, 3)), 3);
+    BOOST_CHECK(!methods.contains(std::string_view(buffer).substr(0, 2)));
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
+#endif
@@ -29,8 +29,10 @@
 #include <stdexcept>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include <tsl/hopscotch_map.h>
+#include <tsl/huge_page_allocator.h>
 #include "utils.h"
 
 
@@ -141,4 +143,109 @@ BOOST_AUTO_TEST_CASE(test_custom_allocator_1) {
 //    BOOST_CHECK_EQUAL(nb_global_new, 0);
 }
 
+BOOST_AUTO_TEST_CASE(test_custom_allocator_soa_layout) {
+    nb_custom_allocs = 0;
+    
+    tsl::hopscotch_map<int, int, mod_hash<9>, std::equal_to<int>, 
+                        custom_allocator<std::pair<int, int>>, 6, false, 
+                        tsl::hh::power_of_two_growth_policy<2>, tsl::hh::soa_layout> map;
+    
+    const int nb_elements = 1000;
+    for(int i = 0; i < nb_elements; i++) {
+        map.insert({i, i*2});
+    }
+    
+    BOOST_CHECK_NE(map.overflow_size(), 0);
+    BOOST_CHECK_NE(nb_custom_allocs, 0);
+    
+    for(int i = 0; i < nb_elements; i++) {
+        BOOST_CHECK_EQUAL(map.at(i), i*2);
+    }
+}
+
+/**
+ * huge_page_allocator
+ */
+BOOST_AUTO_TEST_CASE(test_huge_page_allocator) {
+    const std::vector<tsl::huge_page_allocator<std::int64_t>> allocators = {
+        tsl::huge_page_allocator<std::int64_t>(tsl::hh::huge_pages::none),
+        tsl::huge_page_allocator<std::int64_t>(tsl::hh::huge_pages::transparent),
+        tsl::huge_page_allocator<std::int64_t>(tsl::hh::huge_pages::explicit_2mb),
+        tsl::huge_page_allocator<std::int64_t>(tsl::hh::huge_pages::transparent, tsl::hh::numa_policy::interleave),
+        tsl::huge_page_allocator<std::int64_t>(tsl::hh::huge_pages::transparent, tsl::hh::numa_policy::bind_node, 0)
+    };
+    
+    for(auto allocator: allocators) {
+        // Small allocation with ::operator new and large allocation mapped with mmap
+        for(std::size_t nb_elements: {std::size_t(10), 3*tsl::huge_page_allocator<std::int64_t>::MIN_MAPPING_SIZE/8}) {
+            std::int64_t* data = allocator.allocate(nb_elements);
+            BOOST_REQUIRE(data != nullptr);
+            
+            for(std::size_t i = 0; i < nb_elements; i++) {
+                data[i] = std::int64_t(i);
+            }
+            for(std::size_t i = 0; i < nb_elements; i++) {
+                BOOST_CHECK_EQUAL(data[i], std::int64_t(i));
+            }
+            
+            allocator.deallocate(data, nb_elements);
+        }
+    }
+    
+    BOOST_CHECK(allocators[0] != allocators[1]);
+    BOOST_CHECK(allocators[1] == allocators[3]);
+    BOOST_CHECK(tsl::huge_page_allocator<char>(allocators[3]) == allocators[3]);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_bulk_construct) {
+    using custom_map = tsl::hopscotch_map<int, int, std::hash<int>, std::equal_to<int>, 
+                                          custom_allocator<std::pair<int, int>>>;
+    
+    const int nb_elements = 10000;
+    std::vector<std::pair<int, int>> values;
+    for(int i = 0; i < nb_elements; i++) {
+        values.emplace_back(i, i*2);
+    }
+    
+    nb_custom_allocs = 0;
+    const custom_map map_reserved(values.size());
+    const std::size_t nb_buckets_allocs = nb_custom_allocs;
+    
+    // The scratch entries of the bulk construction also come from the allocator
+    nb_custom_allocs = 0;
+    const custom_map map(tsl::hh::bulk_construct, values.begin(), values.end());
+    BOOST_CHECK_GT(nb_custom_allocs, nb_buckets_allocs);
+    
+    BOOST_CHECK_EQUAL(map.size(), std::size_t(nb_elements));
+    for(int i = 0; i < nb_elements; i++) {
+        BOOST_CHECK_EQUAL(map.at(i), i*2);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_huge_page_allocator_map) {
+    using huge_page_map = tsl::hopscotch_map<std::int64_t, std::int64_t, std::hash<std::int64_t>, 
+                                             std::equal_to<std::int64_t>, 
+                                             tsl::huge_page_allocator<std::pair<std::int64_t, std::int64_t>>>;
+    
+    // Large enough for the bucket array to be mapped
+    const std::int64_t nb_elements = 200000;
+    huge_page_map map(0, std::hash<std::int64_t>(), std::equal_to<std::int64_t>(), 
+                      huge_page_map::allocator_type(tsl::hh::huge_pages::transparent, 
+                                                    tsl::hh::numa_policy::interleave));
+    for(std::int64_t i = 0; i < nb_elements; i++) {
+        map.insert({i, i*2});
+    }
+    BOOST_CHECK(map.bucket_count()*sizeof(std::pair<std::int64_t, std::int64_t>) >= 
+                std::size_t(huge_page_map::allocator_type::MIN_MAPPING_SIZE));
+    
+    const huge_page_map map_copy = map;
+    map.rehash(map.bucket_count() * 2);
+    
+    BOOST_CHECK_EQUAL(map.size(), std::size_t(nb_elements));
+    for(std::int64_t i = 0; i < nb_elements; i++) {
+        BOOST_CHECK_EQUAL(map.at(i), i*2);
+    }
+    BOOST_CHECK(map == map_copy);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
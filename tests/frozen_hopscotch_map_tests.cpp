@@ -0,0 +1,204 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2018 Tessil
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <boost/mpl/list.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <tsl/frozen_hopscotch_map.h>
+#include <tsl/hopscotch_map.h>
+#include "utils.h"
+
+
+namespace {
+
+template<class FrozenMap, class HMap>
+void check_same_content(const FrozenMap& frozen_map, const HMap& map) {
+    BOOST_CHECK_EQUAL(frozen_map.size(), map.size());
+    
+    for(const auto& key_value: map) {
+        auto it = frozen_map.find(key_value.first);
+        BOOST_REQUIRE(it != frozen_map.end());
+        BOOST_CHECK(it.key() == key_value.first);
+        BOOST_CHECK(it.value() == key_value.second);
+        BOOST_CHECK(frozen_map.at(key_value.first) == key_value.second);
+    }
+    
+    std::size_t nb_iterated = 0;
+    for(auto it = frozen_map.begin(); it != frozen_map.end(); ++it) {
+        auto it_map = map.find(it->first);
+        BOOST_REQUIRE(it_map != map.end());
+        BOOST_CHECK(it->second == it_map->second);
+        nb_iterated++;
+    }
+    BOOST_CHECK_EQUAL(nb_iterated, map.size());
+}
+
+}
+
+
+BOOST_AUTO_TEST_SUITE(test_frozen_hopscotch_map)
+
+using test_types = boost::mpl::list<
+                        tsl::frozen_hopscotch_map<std::int64_t, std::int64_t>,
+                        tsl::frozen_hopscotch_map<std::string, std::string, std::hash<std::string>, 
+                                                  std::equal_to<std::string>, 
+                                                  std::allocator<std::pair<std::string, std::string>>, 30, true>,
+                        tsl::frozen_hopscotch_map<std::int64_t, std::int64_t, std::hash<std::int64_t>, 
+                                                  std::equal_to<std::int64_t>, 
+                                                  std::allocator<std::pair<std::int64_t, std::int64_t>>, 8, false, 
+                                                  tsl::hh::power_of_two_growth_policy<2>>,
+                        tsl::frozen_hopscotch_map<std::string, std::int64_t, std::hash<std::string>, 
+                                                  std::equal_to<std::string>, 
+                                                  std::allocator<std::pair<std::string, std::int64_t>>, 62, false, 
+                                                  tsl::hh::prime_growth_policy>
+                        >;
+
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_freeze_map, FMap, test_types) {
+    using key_t = typename FMap::key_type;
+    using value_t = typename FMap::mapped_type;
+    
+    tsl::hopscotch_map<key_t, value_t> map;
+    for(std::size_t i = 0; i < 5000; i++) {
+        map.insert({utils::get_key<key_t>(i), utils::get_value<value_t>(i)});
+    }
+    
+    const FMap frozen_map(map.begin(), map.end());
+    check_same_content(frozen_map, map);
+    BOOST_CHECK_EQUAL(frozen_map.overflow_size(), 0);
+    BOOST_CHECK(frozen_map.load_factor() <= frozen_map.max_load_factor());
+    
+    for(std::size_t i = 5000; i < 5100; i++) {
+        BOOST_CHECK(frozen_map.find(utils::get_key<key_t>(i)) == frozen_map.end());
+        BOOST_CHECK_EQUAL(frozen_map.count(utils::get_key<key_t>(i)), 0);
+        BOOST_CHECK_THROW(frozen_map.at(utils::get_key<key_t>(i)), std::out_of_range);
+    }
+    
+    const FMap frozen_map_copy = frozen_map;
+    BOOST_CHECK(frozen_map_copy == frozen_map);
+    
+    const FMap frozen_map_moved = std::move(frozen_map_copy);
+    check_same_content(frozen_map_moved, map);
+}
+
+BOOST_AUTO_TEST_CASE(test_load_factor) {
+    // With fastrange_growth_policy, the bucket count can be chosen freely and a good hash
+    // gets close to max_load_factor
+    std::vector<std::pair<std::int64_t, std::int64_t>> values;
+    for(std::int64_t i = 0; i < 100000; i++) {
+        values.emplace_back(i, i);
+    }
+    
+    const tsl::frozen_hopscotch_map<std::int64_t, std::int64_t> frozen_map(values.begin(), values.end(), 0.95f);
+    BOOST_CHECK_EQUAL(frozen_map.size(), values.size());
+    BOOST_CHECK_EQUAL(frozen_map.overflow_size(), 0);
+    BOOST_CHECK(frozen_map.load_factor() <= frozen_map.max_load_factor());
+    BOOST_CHECK(frozen_map.load_factor() > 0.85f);
+    
+    const tsl::frozen_hopscotch_map<std::int64_t, std::int64_t> frozen_map_default(values.begin(), values.end());
+    BOOST_CHECK_EQUAL(frozen_map_default.max_load_factor(), 0.8f);
+    BOOST_CHECK(frozen_map_default.load_factor() <= 0.8f);
+    BOOST_CHECK(frozen_map_default.load_factor() > 0.75f);
+    BOOST_CHECK(frozen_map_default == frozen_map);
+    
+    const tsl::frozen_hopscotch_map<std::int64_t, std::int64_t> frozen_map_fast(values.begin(), values.end(), 0.5f);
+    BOOST_CHECK(frozen_map_fast.load_factor() <= 0.5f);
+    BOOST_CHECK(frozen_map_fast.load_factor() > 0.45f);
+    BOOST_CHECK(frozen_map_fast == frozen_map);
+}
+
+BOOST_AUTO_TEST_CASE(test_duplicates) {
+    // The first of the equivalent keys is kept
+    const tsl::frozen_hopscotch_map<std::string, std::int64_t> frozen_map = 
+                {{"a", 1}, {"b", 2}, {"a", 3}, {"c", 4}, {"b", 5}};
+    
+    BOOST_CHECK_EQUAL(frozen_map.size(), 3);
+    BOOST_CHECK_EQUAL(std::distance(frozen_map.begin(), frozen_map.end()), 3);
+    BOOST_CHECK_EQUAL(frozen_map.at("a"), 1);
+    BOOST_CHECK_EQUAL(frozen_map.at("b"), 2);
+    BOOST_CHECK_EQUAL(frozen_map.at("c"), 4);
+}
+
+/**
+ * Values which can't be placed in their neighborhood are stored after the buckets
+ */
+BOOST_AUTO_TEST_CASE(test_overflow) {
+    using hmap_t = tsl::hopscotch_map<std::int64_t, std::int64_t, mod_hash<9>, std::equal_to<std::int64_t>, 
+                                      std::allocator<std::pair<std::int64_t, std::int64_t>>, 6>;
+    using frozen_map_t = tsl::frozen_hopscotch_map<std::int64_t, std::int64_t, mod_hash<9>, 
+                                                   std::equal_to<std::int64_t>, 
+                                                   std::allocator<std::pair<std::int64_t, std::int64_t>>, 6>;
+    
+    hmap_t map;
+    for(std::int64_t i = 0; i < 500; i++) {
+        map.insert({i, i*2});
+    }
+    
+    const frozen_map_t frozen_map(map.begin(), map.end());
+    BOOST_CHECK(frozen_map.overflow_size() > 0);
+    check_same_content(frozen_map, map);
+    BOOST_CHECK(!frozen_map.contains(500));
+    BOOST_CHECK(!frozen_map.contains(-9));
+}
+
+BOOST_AUTO_TEST_CASE(test_empty) {
+    const tsl::frozen_hopscotch_map<std::int64_t, std::int64_t> frozen_map;
+    BOOST_CHECK(frozen_map.empty());
+    BOOST_CHECK_EQUAL(frozen_map.bucket_count(), 0);
+    BOOST_CHECK(frozen_map.begin() == frozen_map.end());
+    BOOST_CHECK(frozen_map.find(1) == frozen_map.end());
+    BOOST_CHECK_THROW(frozen_map.at(1), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(test_heterogeneous_lookups) {
+    struct hash_str_id {
+        std::size_t operator()(const std::string& str) const { return std::hash<std::string>()(str); }
+        std::size_t operator()(const char* str) const { return std::hash<std::string>()(str); }
+    };
+    
+    struct equal_str_id {
+        using is_transparent = void;
+        
+        bool operator()(const std::string& lhs, const std::string& rhs) const { return lhs == rhs; }
+        bool operator()(const std::string& lhs, const char* rhs) const { return lhs == rhs; }
+    };
+    
+    const tsl::frozen_hopscotch_map<std::string, std::int64_t, hash_str_id, equal_str_id> frozen_map = 
+                {{"one", 1}, {"two", 2}};
+    
+    BOOST_CHECK_EQUAL(frozen_map.at("one"), 1);
+    BOOST_CHECK(frozen_map.contains("two"));
+    BOOST_CHECK(frozen_map.contains("two", hash_str_id()("two")));
+    BOOST_CHECK_EQUAL(frozen_map.count("three"), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
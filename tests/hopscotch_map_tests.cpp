@@ -22,9 +22,14 @@
  * SOFTWARE.
  */
 #define BOOST_TEST_DYN_LINK
+// test_types has more than the default limit of 20 types
+#define BOOST_MPL_CFG_NO_PREPROCESSED_HEADERS
+#define BOOST_MPL_LIMIT_LIST_SIZE 30
 
 #include <boost/test/unit_test.hpp>
 #include <boost/mpl/list.hpp>
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <functional>
 #include <iterator>
@@ -65,19 +70,65 @@ using test_types = boost::mpl::list<
                         tsl::hopscotch_map<self_reference_member_test, self_reference_member_test, 
                             mod_hash<9>, std::equal_to<self_reference_member_test>, 
                             std::allocator<std::pair<self_reference_member_test, self_reference_member_test>>, 6, true>,
+                        tsl::hopscotch_map<std::int64_t, std::int64_t, truncated_collision_hash<3>, 
+                            std::equal_to<std::int64_t>, std::allocator<std::pair<std::int64_t, std::int64_t>>, 
+                            30, true, tsl::hh::mod_growth_policy<>>,
+                        // with tsl::hh::soa_layout
+                        tsl::hopscotch_map<std::string, std::string, mod_hash<9>, std::equal_to<std::string>, 
+                            std::allocator<std::pair<std::string, std::string>>, 6, false, 
+                            tsl::hh::power_of_two_growth_policy<2>, tsl::hh::soa_layout>,
+                        tsl::hopscotch_map<move_only_test, move_only_test, mod_hash<9>, std::equal_to<move_only_test>, 
+                            std::allocator<std::pair<move_only_test, move_only_test>>, 6, true, 
+                            tsl::hh::power_of_two_growth_policy<2>, tsl::hh::soa_layout>,
+                        tsl::hopscotch_map<copy_only_test, copy_only_test, mod_hash<9>, std::equal_to<copy_only_test>, 
+                            std::allocator<std::pair<copy_only_test, copy_only_test>>, 6, false, 
+                            tsl::hh::power_of_two_growth_policy<2>, tsl::hh::soa_layout>,
+                        tsl::hopscotch_map<std::int64_t, std::int64_t, truncated_collision_hash<3>, 
+                            std::equal_to<std::int64_t>, std::allocator<std::pair<std::int64_t, std::int64_t>>, 
+                            30, true, tsl::hh::mod_growth_policy<>, tsl::hh::soa_layout>,
+                        // with tsl::hh::flat_overflow
+                        tsl::hopscotch_map<std::string, std::string, mod_hash<9>, std::equal_to<std::string>, 
+                            std::allocator<std::pair<std::string, std::string>>, 6, false, 
+                            tsl::hh::power_of_two_growth_policy<2>, tsl::hh::aos_layout, tsl::hh::flat_overflow>,
+                        tsl::hopscotch_map<move_only_test, move_only_test, mod_hash<9>, std::equal_to<move_only_test>, 
+                            std::allocator<std::pair<move_only_test, move_only_test>>, 6, true, 
+                            tsl::hh::power_of_two_growth_policy<2>, tsl::hh::aos_layout, tsl::hh::flat_overflow>,
+                        tsl::hopscotch_map<copy_only_test, copy_only_test, mod_hash<9>, std::equal_to<copy_only_test>, 
+                            std::allocator<std::pair<copy_only_test, copy_only_test>>, 6, false, 
+                            tsl::hh::power_of_two_growth_policy<2>, tsl::hh::soa_layout, tsl::hh::flat_overflow>,
                         // bhopscotch_map
                         tsl::bhopscotch_map<std::int64_t, std::int64_t, mod_hash<9>>,
+                        tsl::bhopscotch_map<std::string, std::string, mod_hash<9>, std::equal_to<std::string>, 
+                            std::less<std::string>, std::allocator<std::pair<const std::string, std::string>>, 62, false, 
+                            tsl::hh::power_of_two_growth_policy<2>, tsl::hh::soa_layout>,
                         tsl::bhopscotch_pg_map<std::int64_t, std::int64_t, mod_hash<9>>,
                         // with tsl::hh::power_of_two_growth_policy<4>
                         tsl::hopscotch_map<std::string, std::string, mod_hash<9>, std::equal_to<std::string>, 
                             std::allocator<std::pair<std::string, std::string>>, 62, false, tsl::hh::power_of_two_growth_policy<4>>,
                         // with tsl::hh::prime_growth_policy
                         tsl::hopscotch_pg_map<std::string, std::string, mod_hash<9>>,
+                        // with tsl::hh::reciprocal_prime_growth_policy
+                        tsl::hopscotch_map<std::int64_t, std::int64_t, mod_hash<9>, std::equal_to<std::int64_t>, 
+                            std::allocator<std::pair<std::int64_t, std::int64_t>>, 6, true, 
+                            tsl::hh::reciprocal_prime_growth_policy>,
                         // with tsl::hh::mod_growth_policy
                         tsl::hopscotch_map<std::string, std::string, mod_hash<9>, std::equal_to<std::string>, 
                             std::allocator<std::pair<std::string, std::string>>, 62, false, tsl::hh::mod_growth_policy<>>,
                         tsl::hopscotch_map<std::string, std::string, mod_hash<9>, std::equal_to<std::string>, 
-                            std::allocator<std::pair<std::string, std::string>>, 30, true, tsl::hh::mod_growth_policy<std::ratio<4, 3>>>
+                            std::allocator<std::pair<std::string, std::string>>, 30, true, tsl::hh::mod_growth_policy<std::ratio<4, 3>>>,
+                        // with tsl::hh::fastrange_growth_policy
+                        tsl::hopscotch_map<std::string, std::string, mod_hash<9>, std::equal_to<std::string>, 
+                            std::allocator<std::pair<std::string, std::string>>, 62, false, tsl::hh::fastrange_growth_policy<>>,
+                        tsl::hopscotch_map<std::int64_t, std::int64_t, truncated_collision_hash<3>, 
+                            std::equal_to<std::int64_t>, std::allocator<std::pair<std::int64_t, std::int64_t>>, 
+                            30, true, tsl::hh::fastrange_growth_policy<std::ratio<4, 3>>>,
+                        // with tsl::hh::fibonacci_power_of_two_growth_policy
+                        tsl::hopscotch_map<std::string, std::string, mod_hash<9>, std::equal_to<std::string>, 
+                            std::allocator<std::pair<std::string, std::string>>, 62, false, 
+                            tsl::hh::fibonacci_power_of_two_growth_policy<2>>,
+                        tsl::hopscotch_map<std::int64_t, std::int64_t, std::hash<std::int64_t>, 
+                            std::equal_to<std::int64_t>, std::allocator<std::pair<std::int64_t, std::int64_t>>, 
+                            30, true, tsl::hh::fibonacci_power_of_two_growth_policy<4>>
                         >;
                                     
                               
@@ -127,6 +178,9 @@ static const unsigned int overflow_mod = 50;
 using test_overflow_rehash_types = boost::mpl::list<
                     tsl::hopscotch_map<std::int64_t, move_only_test, mod_hash<overflow_mod>, std::equal_to<std::int64_t>, 
                             std::allocator<std::pair<std::int64_t, move_only_test>>, 6>,
+                    tsl::hopscotch_map<std::int64_t, move_only_test, mod_hash<overflow_mod>, std::equal_to<std::int64_t>, 
+                            std::allocator<std::pair<std::int64_t, move_only_test>>, 6, false, 
+                            tsl::hh::power_of_two_growth_policy<2>, tsl::hh::aos_layout, tsl::hh::flat_overflow>,
                     tsl::bhopscotch_map<std::int64_t, move_only_test, mod_hash<overflow_mod>, std::equal_to<std::int64_t>, 
                             std::less<std::int64_t>, std::allocator<std::pair<const std::int64_t, move_only_test>>, 6>>;                   
 BOOST_AUTO_TEST_CASE_TEMPLATE(test_insert_overflow_rehash_nothrow_move_construbtible, HMap, test_overflow_rehash_types) {    
@@ -176,6 +230,9 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(test_insert_overflow_rehash_nothrow_move_construbt
 using test_overflow_rehash_copy_only_types = boost::mpl::list<
                     tsl::hopscotch_map<std::int64_t, copy_only_test, mod_hash<overflow_mod>, std::equal_to<std::int64_t>, 
                             std::allocator<std::pair<std::int64_t, copy_only_test>>, 6>,
+                    tsl::hopscotch_map<std::int64_t, copy_only_test, mod_hash<overflow_mod>, std::equal_to<std::int64_t>, 
+                            std::allocator<std::pair<std::int64_t, copy_only_test>>, 6, false, 
+                            tsl::hh::power_of_two_growth_policy<2>, tsl::hh::aos_layout, tsl::hh::flat_overflow>,
                     tsl::bhopscotch_map<std::int64_t, copy_only_test, mod_hash<overflow_mod>, std::equal_to<std::int64_t>, 
                             std::less<std::int64_t>, std::allocator<std::pair<const std::int64_t, copy_only_test>>, 6>>;                   
 BOOST_AUTO_TEST_CASE_TEMPLATE(test_insert_overflow_rehash_copy_only, HMap, test_overflow_rehash_copy_only_types) {
@@ -222,6 +279,62 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(test_insert_overflow_rehash_copy_only, HMap, test_
 }
 
 
+BOOST_AUTO_TEST_CASE(test_stats) {
+    // insert x values with a lot of collisions, check the counters and that the histograms
+    // are consistent with the content of the map
+    using HMap = tsl::hopscotch_map<std::int64_t, std::int64_t, mod_hash<overflow_mod>, std::equal_to<std::int64_t>, 
+                                    std::allocator<std::pair<std::int64_t, std::int64_t>>, 6, false, 
+                                    tsl::hh::power_of_two_growth_policy<2>, tsl::hh::aos_layout, 
+                                    tsl::hh::list_overflow, tsl::hh::collect_stats>;
+    
+    const std::size_t nb_values = 5000;
+    HMap map;
+    for(std::size_t i = 0; i < nb_values; i++) {
+        map.insert({utils::get_key<std::int64_t>(i), utils::get_value<std::int64_t>(i)});
+    }
+    
+    tsl::hh::hopscotch_stats stats = map.stats();
+    BOOST_CHECK_EQUAL(stats.size, nb_values);
+    BOOST_CHECK_EQUAL(stats.bucket_count, map.bucket_count());
+    BOOST_CHECK_EQUAL(stats.overflow_size, map.overflow_size());
+    BOOST_CHECK(stats.overflow_size > 0);
+    
+    BOOST_CHECK(stats.nb_swap_empty_bucket_closer > 0);
+    BOOST_CHECK(stats.nb_displacements <= stats.nb_swap_empty_bucket_closer);
+    BOOST_CHECK_EQUAL(stats.nb_inserts_in_overflow, map.overflow_size());
+    BOOST_CHECK(stats.nb_rehashes_on_load_factor > 0);
+    
+    BOOST_REQUIRE_EQUAL(stats.neighbor_offset_histogram.size(), 6);
+    BOOST_REQUIRE_EQUAL(stats.neighborhood_popcount_histogram.size(), 7);
+    
+    std::size_t nb_values_in_buckets = 0;
+    for(std::size_t offset = 0; offset < stats.neighbor_offset_histogram.size(); offset++) {
+        nb_values_in_buckets += stats.neighbor_offset_histogram[offset];
+    }
+    BOOST_CHECK_EQUAL(nb_values_in_buckets, nb_values - map.overflow_size());
+    
+    std::size_t nb_buckets = 0;
+    std::size_t nb_neighbors = 0;
+    for(std::size_t popcount = 0; popcount < stats.neighborhood_popcount_histogram.size(); popcount++) {
+        nb_buckets += stats.neighborhood_popcount_histogram[popcount];
+        nb_neighbors += popcount*stats.neighborhood_popcount_histogram[popcount];
+    }
+    BOOST_CHECK_EQUAL(nb_buckets, map.bucket_count());
+    BOOST_CHECK_EQUAL(nb_neighbors, nb_values_in_buckets);
+    
+    std::size_t nb_values_in_overflow = 0;
+    for(std::size_t size = 0; size < stats.overflow_size_histogram.size(); size++) {
+        nb_values_in_overflow += size*stats.overflow_size_histogram[size];
+    }
+    BOOST_CHECK_EQUAL(nb_values_in_overflow, map.overflow_size());
+    
+    
+    // The counters are not copied with the map
+    const HMap map_copy = map;
+    BOOST_CHECK_EQUAL(map_copy.stats().nb_swap_empty_bucket_closer, 0);
+    BOOST_CHECK_EQUAL(map_copy.stats().overflow_size, map.overflow_size());
+}
+
 BOOST_AUTO_TEST_CASE(test_range_insert) {
     // create a vector<std::pair> of values to insert, insert part of them in the map, check values
     const int nb_values = 1000;
@@ -245,6 +358,97 @@ BOOST_AUTO_TEST_CASE(test_range_insert) {
     }
 }
 
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_bulk_constructor, HMap, test_types) {
+    // Construct the map from a vector with duplicated keys, the first of the equivalent values must be kept
+    using key_t = typename HMap::key_type; using value_t = typename HMap:: mapped_type;
+    
+    const std::size_t nb_values = 5000;
+    std::vector<typename HMap::value_type> values;
+    for(std::size_t i = 0; i < nb_values; i++) {
+        values.emplace_back(utils::get_key<key_t>(i), utils::get_value<value_t>(i));
+        if(i % 3 == 0) {
+            values.emplace_back(utils::get_key<key_t>(i/2), utils::get_value<value_t>(i + nb_values));
+        }
+    }
+    
+    HMap map(tsl::hh::bulk_construct, std::make_move_iterator(values.begin()), std::make_move_iterator(values.end()));
+    BOOST_CHECK_EQUAL(map.size(), nb_values);
+    BOOST_CHECK_EQUAL(std::size_t(std::distance(map.begin(), map.end())), nb_values);
+    BOOST_CHECK(map.load_factor() <= map.max_load_factor());
+    
+    for(std::size_t i = 0; i < nb_values; i++) {
+        BOOST_CHECK(map.at(utils::get_key<key_t>(i)) == utils::get_value<value_t>(i));
+    }
+    
+    map.insert({utils::get_key<key_t>(nb_values), utils::get_value<value_t>(nb_values)});
+    BOOST_CHECK_EQUAL(map.size(), nb_values + 1);
+    BOOST_CHECK(map.erase(utils::get_key<key_t>(0)) == 1);
+    BOOST_CHECK_EQUAL(map.count(utils::get_key<key_t>(0)), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_bulk_constructor_collisions) {
+    // mod_hash<9> with a neighborhood of 6, most values of the bulk constructor can't be placed in their
+    // neighborhood and go through the overflow list
+    using HMap = tsl::hopscotch_map<std::int64_t, std::int64_t, mod_hash<9>, std::equal_to<std::int64_t>, 
+                                    std::allocator<std::pair<std::int64_t, std::int64_t>>, 6>;
+    
+    std::vector<std::pair<std::int64_t, std::int64_t>> values;
+    for(std::int64_t i = 0; i < 3000; i++) {
+        values.emplace_back(i % 1000, i);
+    }
+    
+    const HMap map(tsl::hh::bulk_construct, values.begin(), values.end());
+    BOOST_CHECK_EQUAL(map.size(), 1000);
+    BOOST_CHECK(map.overflow_size() > 0);
+    for(std::int64_t i = 0; i < 1000; i++) {
+        BOOST_CHECK_EQUAL(map.at(i), i);
+    }
+    
+    
+    // Same as inserting the values one by one
+    HMap map_insert;
+    for(const auto& value: values) {
+        map_insert.insert(value);
+    }
+    BOOST_CHECK(map == map_insert);
+    
+    const tsl::hopscotch_map<std::int64_t, std::int64_t> map_no_collision(tsl::hh::bulk_construct, 
+                                                                          values.begin(), values.end());
+    BOOST_CHECK_EQUAL(map_no_collision.size(), 1000);
+    for(std::int64_t i = 0; i < 1000; i++) {
+        BOOST_CHECK_EQUAL(map_no_collision.at(i), i);
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_insert_batch, HMap, test_types) {
+    // insert x/2 values, insert x values (with a duplicate) by batch, check results and values
+    using key_t = typename HMap::key_type; using value_t = typename HMap:: mapped_type;
+    
+    const std::size_t nb_values = 1000;
+    HMap map = utils::get_filled_hash_map<HMap>(nb_values/2);
+    
+    std::vector<typename HMap::value_type> values_to_insert;
+    for(std::size_t i = 0; i < nb_values; i++) {
+        values_to_insert.emplace_back(utils::get_key<key_t>(i), utils::get_value<value_t>(i));
+    }
+    values_to_insert.emplace_back(utils::get_key<key_t>(nb_values - 1), utils::get_value<value_t>(0));
+    
+    
+    std::vector<char> inserted;
+    map.insert_batch(std::make_move_iterator(values_to_insert.begin()), 
+                     std::make_move_iterator(values_to_insert.end()), 
+                     std::back_inserter(inserted));
+    
+    BOOST_CHECK_EQUAL(map.size(), nb_values);
+    BOOST_REQUIRE_EQUAL(inserted.size(), nb_values + 1);
+    for(std::size_t i = 0; i < nb_values; i++) {
+        BOOST_CHECK_EQUAL(bool(inserted[i]), i >= nb_values/2);
+        BOOST_CHECK_EQUAL(map.at(utils::get_key<key_t>(i)), utils::get_value<value_t>(i));
+    }
+    BOOST_CHECK(!inserted[nb_values]);
+}
+
 
 BOOST_AUTO_TEST_CASE(test_insert_with_hint) {
     tsl::hopscotch_map<int, int> map{{1, 0}, {2, 1}, {3, 2}};
@@ -595,6 +799,45 @@ BOOST_AUTO_TEST_CASE(test_range_erase_same_iterators) {
     BOOST_CHECK_EQUAL(it_const.value(), -100);
 }
 
+BOOST_AUTO_TEST_CASE(test_flat_overflow_erase_keeps_iterators) {
+    // insert x values with a lot of collisions, keep an iterator and a pointer to each value, 
+    // erase one value out of two, check that the iterators and pointers to the other values are still valid.
+    using HMap = tsl::hopscotch_map<std::int64_t, std::int64_t, mod_hash<9>, std::equal_to<std::int64_t>, 
+                                    std::allocator<std::pair<std::int64_t, std::int64_t>>, 6, false, 
+                                    tsl::hh::power_of_two_growth_policy<2>, tsl::hh::aos_layout, 
+                                    tsl::hh::flat_overflow>;
+    
+    const std::size_t nb_values = 1000;
+    HMap map = utils::get_filled_hash_map<HMap>(nb_values);
+    BOOST_REQUIRE(map.overflow_size() > 0);
+    
+    std::vector<HMap::iterator> iterators;
+    std::vector<const std::pair<std::int64_t, std::int64_t>*> pointers;
+    for(auto it = map.begin(); it != map.end(); ++it) {
+        iterators.push_back(it);
+        pointers.push_back(std::addressof(*it));
+    }
+    
+    for(std::size_t i = 0; i < iterators.size(); i += 2) {
+        map.erase(iterators[i]);
+    }
+    BOOST_CHECK_EQUAL(map.size(), nb_values/2);
+    
+    for(std::size_t i = 1; i < iterators.size(); i += 2) {
+        BOOST_CHECK(std::addressof(*iterators[i]) == pointers[i]);
+        BOOST_CHECK(std::addressof(*map.find(iterators[i]->first)) == pointers[i]);
+        BOOST_CHECK_EQUAL(iterators[i]->second, utils::get_value<std::int64_t>(std::size_t(iterators[i]->first)));
+    }
+    
+    
+    // Reinsert the erased values, the tombstones are removed when the overflow grows
+    for(std::size_t i = 0; i < nb_values; i++) {
+        map.insert({utils::get_key<std::int64_t>(i), utils::get_value<std::int64_t>(i)});
+    }
+    BOOST_CHECK_EQUAL(map.size(), nb_values);
+    BOOST_CHECK(map == utils::get_filled_hash_map<HMap>(nb_values));
+}
+
 /**
  * rehash
  */
@@ -621,6 +864,640 @@ BOOST_AUTO_TEST_CASE(test_rehash_empty) {
     BOOST_CHECK_EQUAL(map.at(1), 10);
 }
 
+/**
+ * shrink_to_fit
+ */
+BOOST_AUTO_TEST_CASE(test_shrink_to_fit) {
+    tsl::hopscotch_map<std::int64_t, std::int64_t> map;
+    for(std::int64_t i = 0; i < 10000; i++) {
+        map.insert({i, i*2});
+    }
+    
+    // Without min load factor, the erases never shrink the map
+    const std::size_t bucket_count = map.bucket_count();
+    for(std::int64_t i = 100; i < 10000; i++) {
+        BOOST_CHECK_EQUAL(map.erase(i), 1);
+    }
+    BOOST_CHECK_EQUAL(map.bucket_count(), bucket_count);
+    
+    map.shrink_to_fit();
+    BOOST_CHECK(map.bucket_count() < bucket_count);
+    BOOST_CHECK(map.load_factor() <= map.max_load_factor());
+    BOOST_CHECK(map.load_factor() > map.max_load_factor()/2);
+    
+    const std::size_t shrunk_bucket_count = map.bucket_count();
+    map.shrink_to_fit();
+    BOOST_CHECK_EQUAL(map.bucket_count(), shrunk_bucket_count);
+    
+    BOOST_CHECK_EQUAL(map.size(), 100);
+    for(std::int64_t i = 0; i < 100; i++) {
+        BOOST_CHECK_EQUAL(map.at(i), i*2);
+    }
+    
+    map.clear();
+    map.shrink_to_fit();
+    BOOST_CHECK_EQUAL(map.bucket_count(), 0);
+}
+
+/**
+ * min_load_factor
+ */
+BOOST_AUTO_TEST_CASE(test_min_load_factor) {
+    tsl::hopscotch_map<std::int64_t, std::int64_t> map;
+    BOOST_CHECK_EQUAL(map.min_load_factor(), 0.0f);
+    
+    // Limited to max_load_factor()/4
+    map.min_load_factor(0.9f);
+    BOOST_CHECK_EQUAL(map.min_load_factor(), map.max_load_factor()/4);
+    
+    map.min_load_factor(0.1f);
+    BOOST_CHECK_EQUAL(map.min_load_factor(), 0.1f);
+    
+    for(std::int64_t i = 0; i < 10000; i++) {
+        map.insert({i, i*2});
+    }
+    
+    // Erase through iterators, never shrink
+    const std::size_t bucket_count = map.bucket_count();
+    for(auto it = map.begin(); it != map.end();) {
+        if(it->first >= 5000) {
+            it = map.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    BOOST_CHECK_EQUAL(map.bucket_count(), bucket_count);
+    BOOST_CHECK_EQUAL(map.size(), 5000);
+    
+    // Erase by key, shrink once under the min load factor
+    std::int64_t key = 4999;
+    while(map.bucket_count() == bucket_count) {
+        BOOST_REQUIRE(key >= 0);
+        BOOST_CHECK(float(map.size()) >= float(bucket_count) * map.min_load_factor() - 1);
+        BOOST_CHECK_EQUAL(map.erase(key), 1);
+        key--;
+    }
+    BOOST_CHECK(map.bucket_count() < bucket_count);
+    BOOST_CHECK(map.load_factor() <= map.max_load_factor()/2);
+    BOOST_CHECK(map.load_factor() > map.min_load_factor());
+    BOOST_CHECK_EQUAL(map.min_load_factor(), 0.1f);
+    
+    for(std::int64_t i = 0; i <= key; i++) {
+        BOOST_CHECK_EQUAL(map.at(i), i*2);
+    }
+    
+    
+    // Alternating inserts and erases after a shrink or a growth don't rehash the map
+    const std::size_t shrunk_bucket_count = map.bucket_count();
+    for(std::int64_t i = 0; i < 1000; i++) {
+        map.insert({-1, -1});
+        map.erase(-1);
+        map.erase(key);
+        map.insert({key, key*2});
+    }
+    BOOST_CHECK_EQUAL(map.bucket_count(), shrunk_bucket_count);
+    
+    while(map.bucket_count() == shrunk_bucket_count) {
+        key++;
+        map.insert({key, key*2});
+    }
+    
+    const std::size_t grown_bucket_count = map.bucket_count();
+    for(std::int64_t i = 0; i < 1000; i++) {
+        map.erase(key);
+        map.insert({key, key*2});
+    }
+    BOOST_CHECK_EQUAL(map.bucket_count(), grown_bucket_count);
+    
+    
+    // The min load factor is kept by copies
+    const auto map_copy = map;
+    BOOST_CHECK_EQUAL(map_copy.min_load_factor(), 0.1f);
+}
+
+/**
+ * extract, insert node, merge
+ */
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_extract_insert_node, HMap, test_types) {
+    using key_t = typename HMap::key_type; using value_t = typename HMap:: mapped_type;
+    
+    const std::size_t nb_values = 1000;
+    HMap map = utils::get_filled_hash_map<HMap>(nb_values);
+    HMap map2;
+    
+    for(std::size_t i = 0; i < nb_values; i += 2) {
+        typename HMap::node_type node = map.extract(utils::get_key<key_t>(i));
+        BOOST_REQUIRE(!node.empty());
+        BOOST_CHECK(node.key() == utils::get_key<key_t>(i));
+        BOOST_CHECK(node.mapped() == utils::get_value<value_t>(i));
+        
+        auto it_inserted = map2.insert(std::move(node));
+        BOOST_CHECK(it_inserted.inserted);
+        BOOST_CHECK(it_inserted.node.empty());
+        BOOST_CHECK(it_inserted.position->first == utils::get_key<key_t>(i));
+    }
+    
+    BOOST_CHECK_EQUAL(map.size(), nb_values/2);
+    BOOST_CHECK_EQUAL(map2.size(), nb_values/2);
+    BOOST_CHECK(map.extract(utils::get_key<key_t>(0)).empty());
+    
+    for(std::size_t i = 0; i < nb_values; i++) {
+        BOOST_CHECK_EQUAL(map.count(utils::get_key<key_t>(i)), (i % 2 == 0)?0:1);
+        BOOST_CHECK_EQUAL(map2.count(utils::get_key<key_t>(i)), (i % 2 == 0)?1:0);
+        
+        if(i % 2 == 0) {
+            BOOST_CHECK(map2.at(utils::get_key<key_t>(i)) == utils::get_value<value_t>(i));
+        }
+    }
+    
+    // Extract through an iterator and insert back in the same map
+    typename HMap::node_type node = map.extract(map.find(utils::get_key<key_t>(1)));
+    BOOST_REQUIRE(!node.empty());
+    BOOST_CHECK_EQUAL(map.size(), nb_values/2 - 1);
+    
+    auto it_inserted = map.insert(std::move(node));
+    BOOST_CHECK(it_inserted.inserted);
+    BOOST_CHECK_EQUAL(map.size(), nb_values/2);
+    BOOST_CHECK(map.at(utils::get_key<key_t>(1)) == utils::get_value<value_t>(1));
+}
+
+BOOST_AUTO_TEST_CASE(test_insert_node_existing_key) {
+    tsl::hopscotch_map<std::string, move_only_test> map;
+    map.emplace("Key1", move_only_test(1));
+    map.emplace("Key2", move_only_test(2));
+    
+    tsl::hopscotch_map<std::string, move_only_test> map2;
+    map2.emplace("Key1", move_only_test(10));
+    
+    auto node = map.extract("Key1");
+    BOOST_REQUIRE(node);
+    
+    // Insertion fails, the node is given back
+    auto it_inserted = map2.insert(std::move(node));
+    BOOST_CHECK(!it_inserted.inserted);
+    BOOST_CHECK(it_inserted.position == map2.find("Key1"));
+    BOOST_REQUIRE(!it_inserted.node.empty());
+    BOOST_CHECK_EQUAL(it_inserted.node.key(), "Key1");
+    BOOST_CHECK_EQUAL(it_inserted.node.mapped(), move_only_test(1));
+    BOOST_CHECK_EQUAL(map2.at("Key1"), move_only_test(10));
+    
+    // Modify the key of the node, its hash is recomputed
+    it_inserted.node.key() = "Key3";
+    auto it = map2.insert(map2.cend(), std::move(it_inserted.node));
+    BOOST_CHECK_EQUAL(it->first, "Key3");
+    BOOST_CHECK_EQUAL(map2.size(), 2);
+    BOOST_CHECK_EQUAL(map2.at("Key3"), move_only_test(1));
+    
+    // Empty node
+    auto it_empty = map2.insert(decltype(map2)::node_type());
+    BOOST_CHECK(!it_empty.inserted);
+    BOOST_CHECK(it_empty.position == map2.end());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_merge, HMap, test_types) {
+    using key_t = typename HMap::key_type; using value_t = typename HMap:: mapped_type;
+    
+    // map: [0, 1000), source: [500, 3000) with other values on the common keys
+    const std::size_t nb_values = 1000;
+    HMap map = utils::get_filled_hash_map<HMap>(nb_values);
+    HMap source;
+    for(std::size_t i = nb_values/2; i < 3*nb_values; i++) {
+        source.insert({utils::get_key<key_t>(i), utils::get_value<value_t>(i + 1)});
+    }
+    
+    map.merge(source);
+    BOOST_CHECK_EQUAL(map.size(), 3*nb_values);
+    BOOST_CHECK_EQUAL(source.size(), nb_values/2);
+    
+    for(std::size_t i = 0; i < 3*nb_values; i++) {
+        BOOST_CHECK(map.at(utils::get_key<key_t>(i)) == 
+                    utils::get_value<value_t>((i < nb_values)?i:i + 1));
+        
+        if(i >= nb_values/2 && i < nb_values) {
+            BOOST_CHECK(source.at(utils::get_key<key_t>(i)) == utils::get_value<value_t>(i + 1));
+        }
+    }
+    
+    map.merge(std::move(source));
+    BOOST_CHECK_EQUAL(map.size(), 3*nb_values);
+    BOOST_CHECK_EQUAL(source.size(), nb_values/2);
+    
+    HMap empty_map;
+    empty_map.merge(map);
+    BOOST_CHECK_EQUAL(empty_map.size(), 3*nb_values);
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.begin() == map.end());
+}
+
+BOOST_AUTO_TEST_CASE(test_merge_stored_hash_growth) {
+    // Stateless hash with stored hashes and a power of two policy, the stored hashes are reused while
+    // the destination grows from a small bucket count.
+    using HMap = tsl::hopscotch_map<std::string, std::int64_t, std::hash<std::string>, std::equal_to<std::string>, 
+                                    std::allocator<std::pair<std::string, std::int64_t>>, 30, true>;
+    
+    HMap source;
+    for(std::int64_t i = 0; i < 5000; i++) {
+        source.insert({std::to_string(i), i});
+    }
+    
+    HMap map;
+    map.merge(source);
+    BOOST_CHECK(source.empty());
+    BOOST_CHECK_EQUAL(map.size(), 5000);
+    for(std::int64_t i = 0; i < 5000; i++) {
+        BOOST_CHECK_EQUAL(map.at(std::to_string(i)), i);
+    }
+    
+    map.rehash(0);
+    for(std::int64_t i = 0; i < 5000; i++) {
+        BOOST_CHECK_EQUAL(map.at(std::to_string(i)), i);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_bhopscotch_extract_merge) {
+    // mod_hash<9> with a neighborhood of 6 puts values in the overflow std::map
+    using HMap = tsl::bhopscotch_map<std::int64_t, std::int64_t, mod_hash<9>, std::equal_to<std::int64_t>, 
+                                     std::less<std::int64_t>, std::allocator<std::pair<const std::int64_t, std::int64_t>>, 6>;
+    
+    HMap map;
+    HMap source;
+    for(std::int64_t i = 0; i < 1000; i++) {
+        source.insert({i, i*2});
+    }
+    BOOST_CHECK(source.overflow_size() > 0);
+    
+    auto node = source.extract(std::int64_t(0));
+    BOOST_REQUIRE(node);
+    BOOST_CHECK(map.insert(std::move(node)).inserted);
+    
+    map.insert({1, -1});
+    map.merge(source);
+    BOOST_CHECK_EQUAL(map.size(), 1000);
+    BOOST_CHECK_EQUAL(source.size(), 1);
+    BOOST_CHECK_EQUAL(source.at(1), 2);
+    BOOST_CHECK_EQUAL(map.at(1), -1);
+    for(std::int64_t i = 2; i < 1000; i++) {
+        BOOST_CHECK_EQUAL(map.at(i), i*2);
+    }
+}
+
+
+/**
+ * incremental rehash
+ */
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_incremental_rehash, HMap, test_types) {
+    // insert x values with the incremental rehash, check values, erase half of them, check values
+    using key_t = typename HMap::key_type; using value_t = typename HMap:: mapped_type;
+    
+    const std::size_t nb_values = 2000;
+    HMap map;
+    map.incremental_rehash_step(2);
+    BOOST_CHECK_EQUAL(map.incremental_rehash_step(), 2);
+    
+    for(std::size_t i = 0; i < nb_values; i++) {
+        map.insert({utils::get_key<key_t>(i), utils::get_value<value_t>(i)});
+        
+        if(i % 100 == 0) {
+            BOOST_CHECK_EQUAL(std::size_t(std::distance(map.cbegin(), map.cend())), i + 1);
+        }
+    }
+    
+    BOOST_CHECK_EQUAL(map.size(), nb_values);
+    BOOST_CHECK_EQUAL(std::size_t(std::distance(map.begin(), map.end())), nb_values);
+    
+    for(std::size_t i = 0; i < nb_values; i++) {
+        auto it = map.find(utils::get_key<key_t>(i));
+        BOOST_REQUIRE(it != map.end());
+        BOOST_CHECK_EQUAL(it->second, utils::get_value<value_t>(i));
+    }
+    
+    for(std::size_t i = 0; i < nb_values; i += 2) {
+        BOOST_CHECK_EQUAL(map.erase(utils::get_key<key_t>(i)), 1);
+    }
+    
+    for(std::size_t i = 0; i < nb_values; i++) {
+        BOOST_CHECK_EQUAL(map.count(utils::get_key<key_t>(i)), i % 2);
+    }
+    
+    map.finish_incremental_rehash();
+    BOOST_CHECK(!map.incremental_rehash_in_progress());
+    BOOST_CHECK_EQUAL(map.size(), nb_values/2);
+    
+    for(std::size_t i = 0; i < nb_values; i++) {
+        BOOST_CHECK_EQUAL(map.count(utils::get_key<key_t>(i)), i % 2);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_incremental_rehash_in_progress) {
+    using HMap = tsl::hopscotch_map<std::int64_t, std::int64_t>;
+    
+    HMap map;
+    map.incremental_rehash_step(1);
+    
+    // insert values until a migration starts
+    std::int64_t nb_values = 0;
+    while(!map.incremental_rehash_in_progress()) {
+        BOOST_REQUIRE(nb_values < 100000);
+        BOOST_CHECK(map.insert({nb_values, nb_values}).second);
+        nb_values++;
+    }
+    
+    
+    // lookups, iteration and copy during the migration
+    const std::int64_t nb_values_before_migration = nb_values;
+    BOOST_CHECK_EQUAL(map.size(), std::size_t(nb_values));
+    for(std::int64_t i = 0; i < nb_values; i++) {
+        BOOST_CHECK_EQUAL(map.at(i), i);
+    }
+    
+    const HMap& map_const = map;
+    BOOST_CHECK_EQUAL(std::distance(map_const.begin(), map_const.end()), nb_values);
+    
+    HMap map_copy = map;
+    BOOST_CHECK(map_copy == map);
+    
+    
+    // erase with iterators during the migration
+    BOOST_REQUIRE(map.incremental_rehash_in_progress());
+    for(auto it = map.begin(); it != map.end(); ) {
+        if(it->first % 2 == 0) {
+            it = map.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    
+    BOOST_CHECK_EQUAL(map.size(), std::size_t(nb_values/2));
+    for(std::int64_t i = 0; i < nb_values; i++) {
+        BOOST_CHECK_EQUAL(map.count(i), std::size_t(i % 2));
+    }
+    
+    
+    // each insert continues the migration until it's complete
+    while(map.incremental_rehash_in_progress()) {
+        BOOST_CHECK(map.insert({nb_values, nb_values}).second);
+        nb_values++;
+    }
+    
+    for(std::int64_t i = 0; i < nb_values; i++) {
+        BOOST_CHECK_EQUAL(map.count(i), std::size_t((i % 2 == 1 || i >= nb_values_before_migration)?1:0));
+    }
+    BOOST_CHECK(!map.insert({1, -1}).second);
+    
+    
+    // move and rehash of a map during a migration
+    BOOST_REQUIRE(map_copy.incremental_rehash_in_progress());
+    HMap map_moved(std::move(map_copy));
+    BOOST_CHECK(map_moved.incremental_rehash_in_progress());
+    
+    map_moved.rehash(0);
+    BOOST_CHECK(!map_moved.incremental_rehash_in_progress());
+    for(std::int64_t i = 0; i < std::int64_t(map_moved.size()); i++) {
+        BOOST_CHECK_EQUAL(map_moved.at(i), i);
+    }
+}
+
+using test_incremental_rehash_growth_types = boost::mpl::list<
+                        tsl::hopscotch_map<std::int64_t, std::int64_t>,
+                        tsl::hopscotch_map<std::int64_t, std::int64_t, std::hash<std::int64_t>, 
+                            std::equal_to<std::int64_t>, std::allocator<std::pair<std::int64_t, std::int64_t>>, 
+                            62, false, tsl::hh::mod_growth_policy<std::ratio<3, 2>>>
+                        >;
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_incremental_rehash_finishes_before_growth, HMap, 
+                              test_incremental_rehash_growth_types) 
+{
+    // Even with a step of 1, the migration must be finished before the new bucket array reaches 
+    // its max load factor, the array never grows (with a full rehash) while a migration is in progress.
+    HMap map;
+    map.incremental_rehash_step(1);
+    
+    std::size_t nb_growths = 0;
+    for(std::int64_t i = 0; i < 200000; i++) {
+        const bool in_progress = map.incremental_rehash_in_progress();
+        const std::size_t bucket_count = map.bucket_count();
+        
+        map.insert({i, i});
+        if(map.bucket_count() != bucket_count) {
+            // A tiny new array may already be full once the migration is finished, the same insert 
+            // then finishes the migration and starts a new one.
+            BOOST_REQUIRE(!in_progress || bucket_count < 16);
+            nb_growths++;
+        }
+    }
+    
+    BOOST_CHECK(nb_growths > 5);
+    BOOST_CHECK_EQUAL(map.size(), 200000);
+    for(std::int64_t i = 0; i < 200000; i++) {
+        BOOST_REQUIRE_EQUAL(map.at(i), i);
+    }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_rehash_parallel, HMap, test_types) {
+    // insert x values, rehash_parallel, check values, reserve_parallel, check values
+    using key_t = typename HMap::key_type; using value_t = typename HMap:: mapped_type;
+    
+    const std::size_t nb_values = 20000;
+    HMap map = utils::get_filled_hash_map<HMap>(nb_values);
+    
+    map.rehash_parallel(map.bucket_count()*4, 4);
+    BOOST_CHECK_EQUAL(map.size(), nb_values);
+    BOOST_CHECK_EQUAL(std::size_t(std::distance(map.begin(), map.end())), nb_values);
+    for(std::size_t i = 0; i < nb_values; i++) {
+        BOOST_CHECK_EQUAL(map.count(utils::get_key<key_t>(i)), 1);
+    }
+    
+    map.reserve_parallel(nb_values*10, 3);
+    BOOST_CHECK(map.bucket_count() >= std::size_t(float(nb_values*10)/map.max_load_factor()));
+    
+    for(std::size_t i = 0; i < nb_values; i++) {
+        auto it = map.find(utils::get_key<key_t>(i));
+        BOOST_REQUIRE(it != map.end());
+        BOOST_CHECK_EQUAL(it->second, utils::get_value<value_t>(i));
+    }
+    
+    map.insert({utils::get_key<key_t>(nb_values), utils::get_value<value_t>(nb_values)});
+    BOOST_CHECK_EQUAL(map.size(), nb_values + 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_rehash_parallel_executor) {
+    // Use an identity hash to put many values near the borders of the ranges of the tasks, 
+    // these values must be deferred and placed after the parallel placement.
+    using HMap = tsl::hopscotch_map<std::int64_t, std::int64_t, identity_hash<std::int64_t>>;
+    const std::int64_t bucket_count = 65536;
+    const std::size_t nb_tasks = 4;
+    
+    HMap map;
+    for(std::int64_t i = 0; i < 20000; i++) {
+        map.insert({i, i});
+    }
+    for(std::size_t itask = 1; itask < nb_tasks; itask++) {
+        const std::int64_t border = std::int64_t(itask)*bucket_count/std::int64_t(nb_tasks);
+        for(std::int64_t j = 1; j <= 20; j++) {
+            map.insert({border - 4 + j*bucket_count, j});
+        }
+    }
+    const HMap map_copy = map;
+    
+    
+    std::size_t nb_executor_calls = 0;
+    std::vector<std::size_t> task_calls(nb_tasks, 0);
+    auto reverse_executor = [&](std::size_t nb_tasks_to_run, const std::function<void(std::size_t)>& task) {
+        BOOST_REQUIRE_EQUAL(nb_tasks_to_run, nb_tasks);
+        nb_executor_calls++;
+        
+        for(std::size_t itask = nb_tasks_to_run; itask > 0; itask--) {
+            task(itask - 1);
+            task_calls[itask - 1]++;
+        }
+    };
+    
+    map.rehash_parallel(bucket_count, nb_tasks, reverse_executor);
+    BOOST_CHECK_EQUAL(map.bucket_count(), std::size_t(bucket_count));
+    BOOST_CHECK(nb_executor_calls > 0);
+    for(const std::size_t calls: task_calls) {
+        BOOST_CHECK_EQUAL(calls, nb_executor_calls);
+    }
+    
+    BOOST_CHECK_EQUAL(map.size(), map_copy.size());
+    BOOST_CHECK(map == map_copy);
+    for(const auto& key_value: map_copy) {
+        BOOST_CHECK_EQUAL(map.at(key_value.first), key_value.second);
+    }
+    
+    
+    // A task throwing an exception leaves the map unchanged
+    auto throwing_executor = [&](std::size_t nb_tasks_to_run, const std::function<void(std::size_t)>& task) {
+        for(std::size_t itask = 0; itask < nb_tasks_to_run; itask++) {
+            task(itask);
+        }
+        throw std::runtime_error("executor");
+    };
+    
+    BOOST_CHECK_THROW(map.rehash_parallel(bucket_count*2, nb_tasks, throwing_executor), std::runtime_error);
+    BOOST_CHECK_EQUAL(map.bucket_count(), std::size_t(bucket_count));
+    BOOST_CHECK(map == map_copy);
+}
+
+
+/**
+ * partition and parallel_for_each
+ */
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_partition, HMap, test_types) {
+    // The partitions, one after the other, go through the same elements as begin() to end(), 
+    // whatever the number of partitions
+    const std::size_t nb_values = 5000;
+    HMap map = utils::get_filled_hash_map<HMap>(nb_values);
+    const HMap& const_map = map;
+    
+    for(std::size_t nb_partitions: {1, 2, 7, 64, 100000}) {
+        auto it = map.begin();
+        auto const_it = const_map.cbegin();
+        for(std::size_t ipartition = 0; ipartition < nb_partitions; ipartition++) {
+            for(auto& key_value: map.partition(ipartition, nb_partitions)) {
+                BOOST_REQUIRE(it != map.end());
+                BOOST_CHECK(&key_value == &*it);
+                ++it;
+            }
+            
+            for(const auto& key_value: const_map.partition(ipartition, nb_partitions)) {
+                BOOST_REQUIRE(const_it != const_map.cend());
+                BOOST_CHECK(&key_value == &*const_it);
+                ++const_it;
+            }
+        }
+        
+        BOOST_CHECK(it == map.end());
+        BOOST_CHECK(const_it == const_map.cend());
+    }
+}
+
+template<class HMap>
+static void check_partitions_modify_values(HMap& map) {
+    std::vector<std::int64_t> nb_seen(map.size(), 0);
+    const std::size_t nb_partitions = 5;
+    for(std::size_t ipartition = 0; ipartition < nb_partitions; ipartition++) {
+        for(auto it = map.partition(ipartition, nb_partitions).begin(); 
+            it != map.partition(ipartition, nb_partitions).end(); ++it) 
+        {
+            it.value() = -it->first;
+            nb_seen[std::size_t(it->first)]++;
+        }
+    }
+    
+    for(std::size_t i = 0; i < nb_seen.size(); i++) {
+        BOOST_CHECK_EQUAL(nb_seen[i], 1);
+        BOOST_CHECK_EQUAL(map.at(std::int64_t(i)), -std::int64_t(i));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_partition_overflow_incremental_rehash) {
+    // mod_hash<9> with a neighborhood of 6 puts values in the overflow list
+    tsl::hopscotch_map<std::int64_t, std::int64_t, mod_hash<9>, std::equal_to<std::int64_t>, 
+                       std::allocator<std::pair<std::int64_t, std::int64_t>>, 6> map_overflow;
+    for(std::int64_t i = 0; i < 200; i++) {
+        map_overflow.insert({i, i});
+    }
+    BOOST_REQUIRE(map_overflow.overflow_size() > 0);
+    check_partitions_modify_values(map_overflow);
+    
+    
+    tsl::hopscotch_map<std::int64_t, std::int64_t> map_incremental;
+    map_incremental.incremental_rehash_step(1);
+    for(std::int64_t i = 0; i < 1000 || !map_incremental.incremental_rehash_in_progress(); i++) {
+        map_incremental.insert({i, i});
+    }
+    BOOST_REQUIRE(map_incremental.incremental_rehash_in_progress());
+    check_partitions_modify_values(map_incremental);
+}
+
+BOOST_AUTO_TEST_CASE(test_parallel_for_each) {
+    tsl::hopscotch_map<std::int64_t, std::int64_t> map;
+    for(std::int64_t i = 0; i < 100000; i++) {
+        map.insert({i, i});
+    }
+    
+    for(std::size_t nb_threads: {0, 1, 4}) {
+        std::atomic<std::int64_t> sum(0);
+        std::atomic<std::size_t> nb_calls(0);
+        map.parallel_for_each(nb_threads, [&](const std::pair<std::int64_t, std::int64_t>& key_value) {
+            sum += key_value.second;
+            nb_calls++;
+        });
+        
+        BOOST_CHECK_EQUAL(sum.load(), std::int64_t(100000)*99999/2);
+        BOOST_CHECK_EQUAL(nb_calls.load(), 100000);
+    }
+    
+    
+    // Executor running the tasks in reverse order on the calling thread
+    std::vector<std::int64_t> values;
+    auto reverse_executor = [&](std::size_t nb_tasks, const std::function<void(std::size_t)>& task) {
+        BOOST_CHECK_EQUAL(nb_tasks, 3);
+        for(std::size_t itask = nb_tasks; itask > 0; itask--) {
+            task(itask - 1);
+        }
+    };
+    map.parallel_for_each(3, [&](const std::pair<std::int64_t, std::int64_t>& key_value) {
+        values.push_back(key_value.first);
+    }, reverse_executor);
+    
+    std::sort(values.begin(), values.end());
+    BOOST_REQUIRE_EQUAL(values.size(), 100000);
+    for(std::size_t i = 0; i < values.size(); i++) {
+        BOOST_CHECK_EQUAL(values[i], std::int64_t(i));
+    }
+    
+    
+    // An exception thrown by the function is rethrown once all the tasks are done
+    BOOST_CHECK_THROW(map.parallel_for_each(4, [&](const std::pair<std::int64_t, std::int64_t>& key_value) {
+        if(key_value.first == 5000) {
+            throw std::runtime_error("parallel_for_each");
+        }
+    }), std::runtime_error);
+}
 
 /**
  * operator== and operator!=
@@ -991,6 +1868,74 @@ BOOST_AUTO_TEST_CASE(test_contains) {
     BOOST_CHECK(!map.contains(-3));
 }
 
+/**
+ * find_batch, count_batch, contains_batch
+ */
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_lookup_batch, HMap, test_types) {
+    // insert x values, lookup 2*x keys by batch, half of them present
+    using key_t = typename HMap::key_type; using value_t = typename HMap:: mapped_type;
+    
+    const std::size_t nb_values = 1000;
+    HMap map = utils::get_filled_hash_map<HMap>(nb_values);
+    const HMap& map_const = map;
+    
+    std::vector<key_t> keys;
+    std::vector<std::size_t> hashes;
+    for(std::size_t i = 0; i < 2*nb_values; i++) {
+        keys.push_back(utils::get_key<key_t>(i));
+        hashes.push_back(map.hash_function()(keys.back()));
+    }
+    
+    
+    std::vector<typename HMap::iterator> its;
+    map.find_batch(keys.begin(), keys.end(), std::back_inserter(its));
+    
+    std::vector<typename HMap::const_iterator> its_const;
+    map_const.find_batch(keys.begin(), keys.end(), hashes.begin(), std::back_inserter(its_const));
+    
+    std::vector<typename HMap::size_type> counts(keys.size());
+    auto it_counts_end = map.count_batch(keys.begin(), keys.end(), counts.begin());
+    BOOST_CHECK(it_counts_end == counts.end());
+    
+    std::vector<char> contains;
+    map.contains_batch(keys.begin(), keys.end(), hashes.begin(), std::back_inserter(contains));
+    
+    BOOST_REQUIRE_EQUAL(its.size(), keys.size());
+    BOOST_REQUIRE_EQUAL(its_const.size(), keys.size());
+    BOOST_REQUIRE_EQUAL(contains.size(), keys.size());
+    for(std::size_t i = 0; i < keys.size(); i++) {
+        if(i < nb_values) {
+            BOOST_REQUIRE(its[i] != map.end());
+            BOOST_CHECK_EQUAL(its[i]->second, utils::get_value<value_t>(i));
+            BOOST_REQUIRE(its_const[i] != map_const.cend());
+            BOOST_CHECK_EQUAL(its_const[i]->second, utils::get_value<value_t>(i));
+            BOOST_CHECK_EQUAL(counts[i], 1);
+            BOOST_CHECK(contains[i]);
+        }
+        else {
+            BOOST_CHECK(its[i] == map.end());
+            BOOST_CHECK(its_const[i] == map_const.cend());
+            BOOST_CHECK_EQUAL(counts[i], 0);
+            BOOST_CHECK(!contains[i]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_lookup_batch_empty_map) {
+    tsl::hopscotch_map<std::int64_t, std::int64_t> map(0);
+    const std::vector<std::int64_t> keys = {1, 2, 3};
+    
+    std::vector<tsl::hopscotch_map<std::int64_t, std::int64_t>::iterator> its;
+    map.find_batch(keys.begin(), keys.end(), std::back_inserter(its));
+    BOOST_REQUIRE_EQUAL(its.size(), 3);
+    BOOST_CHECK(its[0] == map.end() && its[1] == map.end() && its[2] == map.end());
+    
+    std::vector<std::int64_t> empty_keys;
+    std::vector<bool> contains;
+    map.contains_batch(empty_keys.begin(), empty_keys.end(), std::back_inserter(contains));
+    BOOST_CHECK(contains.empty());
+}
+
 /**
  * equal_range
  */
@@ -1207,7 +2152,181 @@ BOOST_AUTO_TEST_CASE(test_heterogeneous_lookups) {
     BOOST_CHECK_EQUAL(map.size(), 1);
 }
 
+#ifdef __cpp_lib_string_view
+namespace {
+std::size_t nb_hash_calls = 0;
+std::size_t nb_keys_from_view = 0;
+
+struct owning_key {
+    explicit owning_key(std::string_view view): str(view) {
+        nb_keys_from_view++;
+    }
+    
+    std::string str;
+};
+
+struct owning_key_hash {
+    std::size_t operator()(const owning_key& key) const {
+        return (*this)(std::string_view(key.str));
+    }
+    
+    std::size_t operator()(std::string_view key) const {
+        nb_hash_calls++;
+        return std::hash<std::string_view>()(key);
+    }
+};
+
+struct owning_key_equal {
+    using is_transparent = std::true_type;
+    
+    bool operator()(const owning_key& k1, const owning_key& k2) const { return k1.str == k2.str; }
+    bool operator()(const owning_key& k1, std::string_view k2) const { return k1.str == k2; }
+    bool operator()(std::string_view k1, const owning_key& k2) const { return k1 == k2.str; }
+};
+}
+
+BOOST_AUTO_TEST_CASE(test_hashed_key) {
+    // Lookups with a tsl::hh::hashed_key neither hash the view nor construct an owning_key, 
+    // try_emplace only constructs one when it inserts.
+    tsl::hopscotch_map<owning_key, int, owning_key_hash, owning_key_equal> map;
+    map.reserve(16);
+    
+    const std::string buffer = "key1 key2 key3 unknown";
+    std::vector<tsl::hh::hashed_key<std::string_view>> keys;
+    for(std::size_t i = 0; i < 4; i++) {
+        const std::string_view view = std::string_view(buffer).substr(i * 5, i < 3?4:7);
+        keys.emplace_back(view, map.hash_function()(view));
+    }
+    
+    nb_hash_calls = 0;
+    nb_keys_from_view = 0;
+    
+    for(std::size_t i = 0; i < 3; i++) {
+        auto it = map.try_emplace(keys[i], int(i));
+        BOOST_CHECK(it.second);
+        BOOST_CHECK_EQUAL(it.first->first.str, keys[i].key());
+        BOOST_CHECK_EQUAL(it.first->second, int(i));
+    }
+    BOOST_CHECK_EQUAL(nb_keys_from_view, 3);
+    
+    auto it = map.try_emplace(keys[1], 10);
+    BOOST_CHECK(!it.second);
+    BOOST_CHECK_EQUAL(it.first->second, 1);
+    BOOST_CHECK_EQUAL(nb_keys_from_view, 3);
+    
+    
+    BOOST_REQUIRE(map.find(keys[2]) != map.end());
+    BOOST_CHECK_EQUAL(map.find(keys[2])->second, 2);
+    BOOST_CHECK(map.find(keys[3]) == map.end());
+    
+    const auto& cmap = map;
+    BOOST_REQUIRE(cmap.find(keys[0]) != cmap.cend());
+    BOOST_CHECK_EQUAL(cmap.find(keys[0])->second, 0);
+    
+    BOOST_CHECK_EQUAL(map.count(keys[0]), 1);
+    BOOST_CHECK_EQUAL(map.count(keys[3]), 0);
+    BOOST_CHECK(map.contains(keys[1]));
+    BOOST_CHECK(!map.contains(keys[3]));
+    
+    
+    BOOST_CHECK_EQUAL(map.erase(keys[1]), 1);
+    BOOST_CHECK_EQUAL(map.erase(keys[3]), 0);
+    BOOST_CHECK_EQUAL(map.size(), 2);
+    BOOST_CHECK(!map.contains(keys[1]));
+    
+    BOOST_CHECK_EQUAL(nb_hash_calls, 0);
+    BOOST_CHECK_EQUAL(nb_keys_from_view, 3);
+}
+#endif
+
+
+
+/**
+ * serialize and deserialize
+ */
+using test_serialize_types = boost::mpl::list<
+                        tsl::hopscotch_map<std::int64_t, std::int64_t>,
+                        tsl::hopscotch_map<std::string, std::string, mod_hash<9>, std::equal_to<std::string>, 
+                            std::allocator<std::pair<std::string, std::string>>, 6>,
+                        tsl::hopscotch_map<std::string, std::string, std::hash<std::string>, std::equal_to<std::string>, 
+                            std::allocator<std::pair<std::string, std::string>>, 30, true>,
+                        tsl::hopscotch_map<std::string, std::string, mod_hash<9>, std::equal_to<std::string>, 
+                            std::allocator<std::pair<std::string, std::string>>, 6, true, 
+                            tsl::hh::power_of_two_growth_policy<2>, tsl::hh::soa_layout>,
+                        tsl::bhopscotch_map<std::string, std::string, mod_hash<9>, std::equal_to<std::string>, 
+                            std::less<std::string>, std::allocator<std::pair<const std::string, std::string>>, 6>,
+                        tsl::hopscotch_pg_map<std::int64_t, std::int64_t, mod_hash<9>>,
+                        tsl::hopscotch_map<std::string, std::string, std::hash<std::string>, std::equal_to<std::string>, 
+                            std::allocator<std::pair<std::string, std::string>>, 62, false, tsl::hh::mod_growth_policy<>>
+                        >;
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_serialize_deserialize, HMap, test_serialize_types) {
+    using key_t = typename HMap::key_type; using value_t = typename HMap:: mapped_type;
+    
+    for(std::size_t nb_values: {0, 1, 1000}) {
+        HMap map = utils::get_filled_hash_map<HMap>(nb_values);
+        map.erase(utils::get_key<key_t>(0));
+        
+        serializer serial;
+        map.serialize(serial);
+        
+        for(bool hash_compatible: {true, false}) {
+            deserializer dserial(serial.str());
+            const HMap map_deserialized = HMap::deserialize(dserial, hash_compatible);
+            
+            BOOST_CHECK(map_deserialized == map);
+            BOOST_CHECK_EQUAL(map_deserialized.overflow_size(), hash_compatible?map.overflow_size():
+                                                                                map_deserialized.overflow_size());
+            if(hash_compatible) {
+                BOOST_CHECK_EQUAL(map_deserialized.bucket_count(), map.bucket_count());
+            }
+            
+            for(std::size_t i = 1; i < nb_values + 10; i++) {
+                BOOST_CHECK_EQUAL(map_deserialized.count(utils::get_key<key_t>(i)), (i < nb_values)?1:0);
+            }
+        }
+    }
+    
+    // The deserialized map can still be modified
+    HMap map = utils::get_filled_hash_map<HMap>(100);
+    serializer serial;
+    map.serialize(serial);
+    
+    deserializer dserial(serial.str());
+    HMap map_deserialized = HMap::deserialize(dserial, true);
+    for(std::size_t i = 0; i < 100; i += 2) {
+        BOOST_CHECK_EQUAL(map_deserialized.erase(utils::get_key<key_t>(i)), 1);
+    }
+    for(std::size_t i = 100; i < 1000; i++) {
+        BOOST_CHECK(map_deserialized.insert({utils::get_key<key_t>(i), utils::get_value<value_t>(i)}).second);
+    }
+    BOOST_CHECK_EQUAL(map_deserialized.size(), 950);
+}
 
+BOOST_AUTO_TEST_CASE(test_deserialize_not_hash_compatible) {
+    using hmap_t = tsl::hopscotch_map<std::int64_t, std::int64_t>;
+    using hmap_neighborhood_t = tsl::hopscotch_map<std::int64_t, std::int64_t, std::hash<std::int64_t>, 
+                                                   std::equal_to<std::int64_t>, 
+                                                   std::allocator<std::pair<std::int64_t, std::int64_t>>, 30, true>;
+    
+    const hmap_t map = utils::get_filled_hash_map<hmap_t>(1000);
+    serializer serial;
+    map.serialize(serial);
+    
+    deserializer dserial_incompatible(serial.str());
+    BOOST_CHECK_THROW(hmap_neighborhood_t::deserialize(dserial_incompatible, true), std::runtime_error);
+    
+    using hmap_prime_t = tsl::hopscotch_pg_map<std::int64_t, std::int64_t>;
+    deserializer dserial_prime(serial.str());
+    BOOST_CHECK_THROW(hmap_prime_t::deserialize(dserial_prime, true), std::runtime_error);
+    
+    deserializer dserial(serial.str());
+    const hmap_neighborhood_t map_deserialized = hmap_neighborhood_t::deserialize(dserial, false);
+    BOOST_CHECK_EQUAL(map_deserialized.size(), map.size());
+    for(const auto& key_value: map) {
+        BOOST_CHECK_EQUAL(map_deserialized.at(key_value.first), key_value.second);
+    }
+}
 
 /**
  * Various operations on empty map
@@ -1315,5 +2434,39 @@ BOOST_AUTO_TEST_CASE(test_precalculated_hash) {
     BOOST_CHECK_EQUAL(map.erase(4, map.hash_function()(2)), 0);
 }
 
+/**
+ * Lookup with StoreHash when the truncated hashes of different keys are equal
+ */
+BOOST_AUTO_TEST_CASE(test_find_truncated_hash_collisions) {
+    using HMap = tsl::hopscotch_map<std::int64_t, std::int64_t, truncated_collision_hash<3>, 
+                                    std::equal_to<std::int64_t>, std::allocator<std::pair<std::int64_t, std::int64_t>>, 
+                                    30, true, tsl::hh::mod_growth_policy<>>;
+    
+    const std::int64_t nb_values = 5000;
+    HMap map;
+    for(std::int64_t i = 0; i < nb_values; i += 2) {
+        map.insert({i, i*2});
+    }
+    
+    for(std::int64_t i = 0; i < nb_values; i++) {
+        auto it = map.find(i);
+        if(i % 2 == 0) {
+            BOOST_REQUIRE(it != map.end());
+            BOOST_CHECK_EQUAL(it->second, i*2);
+        }
+        else {
+            BOOST_CHECK(it == map.end());
+        }
+    }
+    
+    for(std::int64_t i = 0; i < nb_values; i += 4) {
+        BOOST_CHECK_EQUAL(map.erase(i), 1);
+    }
+    
+    for(std::int64_t i = 0; i < nb_values; i++) {
+        BOOST_CHECK_EQUAL(map.count(i), (i % 4 == 2)?1:0);
+    }
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
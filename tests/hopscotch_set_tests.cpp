@@ -26,7 +26,12 @@
 #include <boost/test/unit_test.hpp>
 #include <boost/mpl/list.hpp>
 #include <cstdint>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include <tsl/bhopscotch_set.h>
 #include <tsl/hopscotch_set.h>
@@ -39,6 +44,13 @@ using test_types = boost::mpl::list<tsl::hopscotch_set<std::int64_t, mod_hash<9>
                                     tsl::hopscotch_set<self_reference_member_test, mod_hash<9>>,
                                     tsl::hopscotch_set<move_only_test, mod_hash<9>>,
                                     tsl::hopscotch_pg_set<move_only_test, mod_hash<9>>,
+                                    tsl::hopscotch_set<move_only_test, mod_hash<9>, std::equal_to<move_only_test>, 
+                                                       std::allocator<move_only_test>, 62, false, 
+                                                       tsl::hh::power_of_two_growth_policy<2>, tsl::hh::soa_layout>,
+                                    tsl::hopscotch_set<move_only_test, mod_hash<9>, std::equal_to<move_only_test>, 
+                                                       std::allocator<move_only_test>, 6, false, 
+                                                       tsl::hh::power_of_two_growth_policy<2>, tsl::hh::aos_layout, 
+                                                       tsl::hh::flat_overflow>,
                                     tsl::bhopscotch_set<std::int64_t, mod_hash<9>>,
                                     tsl::bhopscotch_set<self_reference_member_test, mod_hash<9>>,
                                     tsl::bhopscotch_set<move_only_test, mod_hash<9>>,
@@ -119,4 +131,143 @@ BOOST_AUTO_TEST_CASE(test_insert_pointer) {
     BOOST_CHECK_EQUAL(**set.begin(), value);
 }
 
+/**
+ * find_batch, contains_batch
+ */
+BOOST_AUTO_TEST_CASE(test_lookup_batch) {
+    tsl::hopscotch_set<std::string> set = {"a", "b", "c"};
+    const std::vector<std::string> keys = {"a", "d", "c", "e"};
+    
+    std::vector<tsl::hopscotch_set<std::string>::const_iterator> its;
+    set.find_batch(keys.begin(), keys.end(), std::back_inserter(its));
+    BOOST_REQUIRE_EQUAL(its.size(), 4);
+    BOOST_REQUIRE(its[0] != set.end());
+    BOOST_CHECK_EQUAL(*its[0], "a");
+    BOOST_CHECK(its[1] == set.end());
+    BOOST_REQUIRE(its[2] != set.end());
+    BOOST_CHECK_EQUAL(*its[2], "c");
+    BOOST_CHECK(its[3] == set.end());
+    
+    std::vector<std::size_t> hashes;
+    for(const auto& key: keys) {
+        hashes.push_back(set.hash_function()(key));
+    }
+    
+    bool contains[4];
+    set.contains_batch(keys.begin(), keys.end(), hashes.begin(), contains);
+    BOOST_CHECK(contains[0] && !contains[1] && contains[2] && !contains[3]);
+}
+
+/**
+ * insert_batch
+ */
+BOOST_AUTO_TEST_CASE(test_insert_batch) {
+    tsl::hopscotch_set<std::int64_t, mod_hash<9>, std::equal_to<std::int64_t>, 
+                       std::allocator<std::int64_t>, 6> set = {0, 1, 2};
+    
+    std::vector<std::int64_t> values;
+    for(std::int64_t i = 0; i < 1000; i++) {
+        values.push_back(i);
+    }
+    values.push_back(500);
+    
+    std::vector<bool> inserted;
+    set.insert_batch(values.begin(), values.end(), std::back_inserter(inserted));
+    
+    BOOST_CHECK_EQUAL(set.size(), 1000);
+    BOOST_REQUIRE_EQUAL(inserted.size(), 1001);
+    for(std::size_t i = 0; i < inserted.size(); i++) {
+        BOOST_CHECK_EQUAL(inserted[i], i >= 3 && i < 1000);
+        BOOST_CHECK_EQUAL(set.count(values[i]), 1);
+    }
+}
+
+/**
+ * bulk constructor
+ */
+BOOST_AUTO_TEST_CASE(test_bulk_constructor) {
+    std::vector<std::string> values;
+    for(std::size_t i = 0; i < 5000; i++) {
+        values.push_back(utils::get_key<std::string>(i % 4000));
+    }
+    
+    const tsl::hopscotch_set<std::string> set(tsl::hh::bulk_construct, values.begin(), values.end());
+    BOOST_CHECK_EQUAL(set.size(), 4000);
+    BOOST_CHECK(set == tsl::hopscotch_set<std::string>(values.begin(), values.end()));
+    
+    // Not a random access iterator, same as the range constructor
+    const std::list<std::string> values_list(values.begin(), values.end());
+    const tsl::hopscotch_set<std::string> set_list(tsl::hh::bulk_construct, values_list.begin(), values_list.end());
+    BOOST_CHECK(set_list == set);
+}
+
+/**
+ * extract and merge
+ */
+BOOST_AUTO_TEST_CASE(test_extract_merge) {
+    tsl::hopscotch_set<std::string> set = {"Key1", "Key2", "Key3"};
+    tsl::hopscotch_set<std::string> set2 = {"Key3", "Key4"};
+    
+    auto node = set.extract("Key1");
+    BOOST_REQUIRE(!node.empty());
+    BOOST_CHECK_EQUAL(node.value(), "Key1");
+    BOOST_CHECK(set2.insert(std::move(node)).inserted);
+    BOOST_CHECK(set.extract("Key1").empty());
+    
+    set2.merge(set);
+    BOOST_CHECK(set == (tsl::hopscotch_set<std::string>{"Key3"}));
+    BOOST_CHECK(set2 == (tsl::hopscotch_set<std::string>{"Key1", "Key2", "Key3", "Key4"}));
+}
+
+#ifdef __cpp_lib_string_view
+/**
+ * hashed_key
+ */
+BOOST_AUTO_TEST_CASE(test_hashed_key) {
+    tsl::hopscotch_set<std::string, std::hash<std::string>, std::equal_to<>> set = {"Key1", "Key2", "Key3"};
+    
+    auto hashed = [](std::string_view key) { 
+        return tsl::hh::hashed_key<std::string_view>(key, std::hash<std::string_view>()(key)); 
+    };
+    
+    BOOST_REQUIRE(set.find(hashed("Key1")) != set.end());
+    BOOST_CHECK_EQUAL(*set.find(hashed("Key1")), "Key1");
+    BOOST_CHECK(set.find(hashed("Key4")) == set.end());
+    BOOST_CHECK_EQUAL(set.count(hashed("Key2")), 1);
+    BOOST_CHECK(!set.contains(hashed("Key4")));
+    
+    BOOST_CHECK_EQUAL(set.erase(hashed("Key3")), 1);
+    BOOST_CHECK_EQUAL(set.erase(hashed("Key3")), 0);
+    BOOST_CHECK(set == (tsl::hopscotch_set<std::string, std::hash<std::string>, std::equal_to<>>{"Key1", "Key2"}));
+}
+#endif
+
+/**
+ * serialize and deserialize
+ */
+using test_serialize_types = boost::mpl::list<tsl::hopscotch_set<std::string, mod_hash<9>, std::equal_to<std::string>, 
+                                                                 std::allocator<std::string>, 6>,
+                                               tsl::bhopscotch_set<std::int64_t, mod_hash<9>, 
+                                                                   std::equal_to<std::int64_t>, std::less<std::int64_t>, 
+                                                                   std::allocator<std::int64_t>, 6>>;
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_serialize_deserialize, HSet, test_serialize_types) {
+    using key_t = typename HSet::key_type;
+    
+    HSet set;
+    for(std::size_t i = 0; i < 1000; i++) {
+        set.insert(utils::get_key<key_t>(i));
+    }
+    BOOST_REQUIRE(set.overflow_size() > 0);
+    
+    serializer serial;
+    set.serialize(serial);
+    
+    for(bool hash_compatible: {true, false}) {
+        deserializer dserial(serial.str());
+        const HSet set_deserialized = HSet::deserialize(dserial, hash_compatible);
+        BOOST_CHECK(set_deserialized == set);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
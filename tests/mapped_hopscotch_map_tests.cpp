@@ -0,0 +1,221 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2018 Tessil
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <boost/mpl/list.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <tsl/hopscotch_map.h>
+#include <tsl/mapped_hopscotch_map.h>
+#include "utils.h"
+
+
+namespace {
+
+/*
+ * Write the map in a buffer of std::uint64_t to have the alignment of a memory-mapped file.
+ */
+template<class HMap>
+std::vector<std::uint64_t> write_mapped(const HMap& map) {
+    std::string bytes;
+    auto writer = [&](const char* data, std::size_t size) { bytes.append(data, size); };
+    map.write_mapped(writer);
+    
+    std::vector<std::uint64_t> buffer((bytes.size() + sizeof(std::uint64_t) - 1)/sizeof(std::uint64_t));
+    std::memcpy(buffer.data(), bytes.data(), bytes.size());
+    
+    return buffer;
+}
+
+template<class MappedMap, class HMap>
+void check_same_content(const MappedMap& mapped_map, const HMap& map) {
+    BOOST_CHECK_EQUAL(mapped_map.size(), map.size());
+    BOOST_CHECK_EQUAL(mapped_map.bucket_count(), map.bucket_count());
+    BOOST_CHECK_EQUAL(mapped_map.overflow_size(), map.overflow_size());
+    
+    for(const auto& key_value: map) {
+        auto it = mapped_map.find(key_value.first);
+        BOOST_REQUIRE(it != mapped_map.end());
+        BOOST_CHECK_EQUAL(it.key(), key_value.first);
+        BOOST_CHECK_EQUAL(it.value(), key_value.second);
+        BOOST_CHECK_EQUAL(mapped_map.at(key_value.first), key_value.second);
+    }
+    
+    std::size_t nb_iterated = 0;
+    for(auto it = mapped_map.begin(); it != mapped_map.end(); ++it) {
+        auto it_map = map.find(it.key());
+        BOOST_REQUIRE(it_map != map.end());
+        BOOST_CHECK_EQUAL((*it).second, it_map->second);
+        nb_iterated++;
+    }
+    BOOST_CHECK_EQUAL(nb_iterated, map.size());
+}
+
+}
+
+
+BOOST_AUTO_TEST_SUITE(test_mapped_hopscotch_map)
+
+using test_types = boost::mpl::list<
+                        tsl::hopscotch_map<std::int64_t, std::int64_t>,
+                        tsl::hopscotch_map<std::int64_t, std::int64_t, std::hash<std::int64_t>, 
+                                           std::equal_to<std::int64_t>, 
+                                           std::allocator<std::pair<std::int64_t, std::int64_t>>, 30, true>,
+                        tsl::hopscotch_map<std::int64_t, std::int64_t, std::hash<std::int64_t>, 
+                                           std::equal_to<std::int64_t>, 
+                                           std::allocator<std::pair<std::int64_t, std::int64_t>>, 62, false, 
+                                           tsl::hh::prime_growth_policy>,
+                        tsl::hopscotch_map<std::int64_t, std::int64_t, std::hash<std::int64_t>, 
+                                           std::equal_to<std::int64_t>, 
+                                           std::allocator<std::pair<std::int64_t, std::int64_t>>, 62, false, 
+                                           tsl::hh::mod_growth_policy<>, tsl::hh::soa_layout>
+                        >;
+
+template<class HMap>
+struct mapped_map_for;
+
+template<class Key, class T, class Hash, class KeyEqual, class Allocator, unsigned int NeighborhoodSize, 
+         bool StoreHash, class GrowthPolicy, class Layout>
+struct mapped_map_for<tsl::hopscotch_map<Key, T, Hash, KeyEqual, Allocator, NeighborhoodSize, StoreHash, 
+                                         GrowthPolicy, Layout>> 
+{
+    using type = tsl::mapped_hopscotch_map<Key, T, Hash, KeyEqual, NeighborhoodSize, StoreHash, GrowthPolicy>;
+};
+
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_write_and_map, HMap, test_types) {
+    using key_t = typename HMap::key_type;
+    using value_t = typename HMap::mapped_type;
+    using mapped_map_t = typename mapped_map_for<HMap>::type;
+    
+    HMap map;
+    for(std::size_t i = 0; i < 5000; i++) {
+        map.insert({utils::get_key<key_t>(i), utils::get_value<value_t>(i)});
+    }
+    
+    const std::vector<std::uint64_t> buffer = write_mapped(map);
+    mapped_map_t mapped_map(buffer.data(), buffer.size()*sizeof(std::uint64_t));
+    check_same_content(mapped_map, map);
+    
+    for(std::size_t i = 5000; i < 5100; i++) {
+        BOOST_CHECK(mapped_map.find(utils::get_key<key_t>(i)) == mapped_map.end());
+        BOOST_CHECK_EQUAL(mapped_map.count(utils::get_key<key_t>(i)), 0);
+        BOOST_CHECK_THROW(mapped_map.at(utils::get_key<key_t>(i)), std::out_of_range);
+    }
+}
+
+/**
+ * Overflow elements are written after the buckets
+ */
+BOOST_AUTO_TEST_CASE(test_write_and_map_overflow) {
+    using hmap_t = tsl::hopscotch_map<std::int64_t, std::int64_t, mod_hash<9>, std::equal_to<std::int64_t>, 
+                                      std::allocator<std::pair<std::int64_t, std::int64_t>>, 6>;
+    using mapped_map_t = tsl::mapped_hopscotch_map<std::int64_t, std::int64_t, mod_hash<9>, 
+                                                   std::equal_to<std::int64_t>, 6>;
+    
+    hmap_t map;
+    for(std::int64_t i = 0; i < 500; i++) {
+        map.insert({i, i*2});
+    }
+    BOOST_REQUIRE(map.overflow_size() > 0);
+    
+    const std::vector<std::uint64_t> buffer = write_mapped(map);
+    mapped_map_t mapped_map(buffer.data(), buffer.size()*sizeof(std::uint64_t));
+    check_same_content(mapped_map, map);
+    BOOST_CHECK(!mapped_map.contains(500));
+}
+
+BOOST_AUTO_TEST_CASE(test_write_and_map_empty) {
+    tsl::hopscotch_map<std::int64_t, std::int64_t> map;
+    
+    const std::vector<std::uint64_t> buffer = write_mapped(map);
+    tsl::mapped_hopscotch_map<std::int64_t, std::int64_t> mapped_map(buffer.data(), 
+                                                                     buffer.size()*sizeof(std::uint64_t));
+    BOOST_CHECK(mapped_map.empty());
+    BOOST_CHECK(mapped_map.begin() == mapped_map.end());
+    BOOST_CHECK(mapped_map.find(1) == mapped_map.end());
+}
+
+BOOST_AUTO_TEST_CASE(test_invalid_data) {
+    tsl::hopscotch_map<std::int64_t, std::int64_t> map = {{1, 10}, {2, 20}};
+    std::vector<std::uint64_t> buffer = write_mapped(map);
+    const std::size_t size = buffer.size()*sizeof(std::uint64_t);
+    
+    // Truncated
+    using mapped_map_t = tsl::mapped_hopscotch_map<std::int64_t, std::int64_t>;
+    BOOST_CHECK_THROW(mapped_map_t(buffer.data(), size - sizeof(std::uint64_t)), std::runtime_error);
+    BOOST_CHECK_THROW(mapped_map_t(buffer.data(), 16), std::runtime_error);
+    
+    // Different NeighborhoodSize and different value type
+    using mapped_map_neighborhood_t = tsl::mapped_hopscotch_map<std::int64_t, std::int64_t, std::hash<std::int64_t>, 
+                                                                std::equal_to<std::int64_t>, 30>;
+    BOOST_CHECK_THROW(mapped_map_neighborhood_t(buffer.data(), size), std::runtime_error);
+    BOOST_CHECK_THROW((tsl::mapped_hopscotch_map<std::int64_t, std::int32_t>(buffer.data(), size)), 
+                      std::runtime_error);
+    
+    // Bad magic
+    buffer[0] = 0;
+    BOOST_CHECK_THROW(mapped_map_t(buffer.data(), size), std::runtime_error);
+}
+
+#ifdef TSL_HH_HAS_MMAP
+BOOST_AUTO_TEST_CASE(test_memory_mapped_file) {
+    tsl::hopscotch_map<std::int64_t, std::int64_t> map;
+    for(std::int64_t i = 0; i < 10000; i++) {
+        map.insert({i, -i});
+    }
+    
+    const std::string path = "mapped_hopscotch_map_test.bin";
+    {
+        std::ofstream file(path, std::ios::binary);
+        auto writer = [&](const char* data, std::size_t size) { file.write(data, std::streamsize(size)); };
+        map.write_mapped(writer);
+    }
+    
+    {
+        tsl::mapped_hopscotch_map<std::int64_t, std::int64_t> mapped_map(path);
+        check_same_content(mapped_map, map);
+        
+        tsl::mapped_hopscotch_map<std::int64_t, std::int64_t> mapped_map_moved(std::move(mapped_map));
+        BOOST_CHECK_EQUAL(mapped_map_moved.at(42), -42);
+    }
+    
+    std::remove(path.c_str());
+    
+    BOOST_CHECK_THROW((tsl::mapped_hopscotch_map<std::int64_t, std::int64_t>(path)), std::system_error);
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,188 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2018 Tessil
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <boost/mpl/list.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <tsl/hopscotch_map.h>
+#include <tsl/hopscotch_set.h>
+#include <tsl/perfect_hash_map.h>
+#include <tsl/perfect_hash_set.h>
+#include "utils.h"
+
+
+BOOST_AUTO_TEST_SUITE(test_perfect_hash_map)
+
+using test_types = boost::mpl::list<
+                        tsl::perfect_hash_map<std::int64_t, std::int64_t>,
+                        tsl::perfect_hash_map<std::string, std::string>,
+                        tsl::perfect_hash_map<self_reference_member_test, self_reference_member_test>,
+                        tsl::perfect_hash_map<move_only_test, move_only_test>
+                        >;
+
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_build, PMap, test_types) {
+    using key_t = typename PMap::key_type;
+    using value_t = typename PMap::mapped_type;
+    
+    for(std::size_t nb_values: {1, 2, 3, 7, 50, 5000}) {
+        std::vector<typename PMap::value_type> values;
+        for(std::size_t i = 0; i < nb_values; i++) {
+            values.emplace_back(utils::get_key<key_t>(i), utils::get_value<value_t>(i));
+        }
+        
+        const PMap perfect_map(std::make_move_iterator(values.begin()), std::make_move_iterator(values.end()));
+        BOOST_CHECK_EQUAL(perfect_map.size(), nb_values);
+        BOOST_CHECK_EQUAL(std::size_t(std::distance(perfect_map.begin(), perfect_map.end())), nb_values);
+        
+        for(std::size_t i = 0; i < nb_values; i++) {
+            const key_t key = utils::get_key<key_t>(i);
+            
+            auto it = perfect_map.find(key);
+            BOOST_REQUIRE(it != perfect_map.end());
+            BOOST_CHECK(it->second == utils::get_value<value_t>(i));
+            BOOST_CHECK(perfect_map.at(key) == utils::get_value<value_t>(i));
+            BOOST_CHECK(perfect_map.at(key, perfect_map.hash_function()(key)) == utils::get_value<value_t>(i));
+            BOOST_CHECK_EQUAL(perfect_map.count(key), 1);
+        }
+        
+        for(std::size_t i = nb_values; i < nb_values + 100; i++) {
+            const key_t key = utils::get_key<key_t>(i);
+            
+            BOOST_CHECK(perfect_map.find(key) == perfect_map.end());
+            BOOST_CHECK(!perfect_map.contains(key));
+            BOOST_CHECK_THROW(perfect_map.at(key), std::out_of_range);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_build_from_hopscotch_map) {
+    tsl::hopscotch_map<std::string, std::int64_t> map;
+    for(std::size_t i = 0; i < 1000; i++) {
+        map.insert({utils::get_key<std::string>(i), utils::get_value<std::int64_t>(i)});
+    }
+    
+    // The typedef can be swapped for a read-only use
+    using map_t = tsl::perfect_hash_map<std::string, std::int64_t>;
+    const map_t perfect_map(map.begin(), map.end());
+    BOOST_CHECK_EQUAL(perfect_map.size(), map.size());
+    for(const auto& key_value: map) {
+        BOOST_CHECK_EQUAL(perfect_map.at(key_value.first), key_value.second);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_pilot_count) {
+    std::vector<std::pair<std::int64_t, std::int64_t>> values;
+    for(std::int64_t i = 0; i < 100000; i++) {
+        values.emplace_back(i*i, i);
+    }
+    
+    const tsl::perfect_hash_map<std::int64_t, std::int64_t> perfect_map(values.begin(), values.end());
+    BOOST_CHECK_EQUAL(perfect_map.size(), values.size());
+    BOOST_CHECK_EQUAL(perfect_map.pilot_count(), values.size()/4);
+    for(const auto& value: values) {
+        BOOST_CHECK_EQUAL(perfect_map.at(value.first), value.second);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_duplicates) {
+    // The first of the equivalent keys is kept
+    const tsl::perfect_hash_map<std::string, std::int64_t> perfect_map = 
+                {{"a", 1}, {"b", 2}, {"a", 3}, {"c", 4}, {"b", 5}};
+    
+    BOOST_CHECK_EQUAL(perfect_map.size(), 3);
+    BOOST_CHECK_EQUAL(perfect_map.at("a"), 1);
+    BOOST_CHECK_EQUAL(perfect_map.at("b"), 2);
+    BOOST_CHECK_EQUAL(perfect_map.at("c"), 4);
+    
+    const tsl::perfect_hash_map<std::string, std::int64_t> perfect_map2 = {{"c", 4}, {"a", 1}, {"b", 2}};
+    BOOST_CHECK(perfect_map == perfect_map2);
+}
+
+BOOST_AUTO_TEST_CASE(test_same_hash_different_keys) {
+    // mod_hash<9> gives the same hash to 0 and 9, they can't be separated
+    using perfect_map_t = tsl::perfect_hash_map<std::int64_t, std::int64_t, mod_hash<9>>;
+    BOOST_CHECK_THROW((perfect_map_t{{0, 0}, {9, 9}}), std::invalid_argument);
+    
+    const perfect_map_t perfect_map = {{0, 0}, {1, 1}, {2, 2}};
+    BOOST_CHECK_EQUAL(perfect_map.count(9), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_empty) {
+    const tsl::perfect_hash_map<std::int64_t, std::int64_t> perfect_map;
+    BOOST_CHECK(perfect_map.empty());
+    BOOST_CHECK(perfect_map.begin() == perfect_map.end());
+    BOOST_CHECK(perfect_map.find(1) == perfect_map.end());
+    BOOST_CHECK_THROW(perfect_map.at(1), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(test_heterogeneous_lookups) {
+    struct hash_str_id {
+        std::size_t operator()(const std::string& str) const { return std::hash<std::string>()(str); }
+        std::size_t operator()(const char* str) const { return std::hash<std::string>()(str); }
+    };
+    
+    struct equal_str_id {
+        using is_transparent = void;
+        
+        bool operator()(const std::string& lhs, const std::string& rhs) const { return lhs == rhs; }
+        bool operator()(const std::string& lhs, const char* rhs) const { return lhs == rhs; }
+    };
+    
+    const tsl::perfect_hash_map<std::string, std::int64_t, hash_str_id, equal_str_id> perfect_map = 
+                {{"one", 1}, {"two", 2}};
+    
+    BOOST_CHECK_EQUAL(perfect_map.at("one"), 1);
+    BOOST_CHECK(perfect_map.contains("two"));
+    BOOST_CHECK(perfect_map.contains("two", hash_str_id()("two")));
+    BOOST_CHECK_EQUAL(perfect_map.count("three"), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_perfect_hash_set) {
+    tsl::hopscotch_set<std::string> set;
+    for(std::size_t i = 0; i < 1000; i++) {
+        set.insert(utils::get_key<std::string>(i));
+    }
+    
+    const tsl::perfect_hash_set<std::string> perfect_set(set.begin(), set.end());
+    BOOST_CHECK_EQUAL(perfect_set.size(), set.size());
+    for(const std::string& key: set) {
+        BOOST_CHECK(*perfect_set.find(key) == key);
+    }
+    BOOST_CHECK(!perfect_set.contains(utils::get_key<std::string>(1000)));
+    
+    const tsl::perfect_hash_set<std::string> perfect_set_copy = perfect_set;
+    BOOST_CHECK(perfect_set_copy == perfect_set);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -25,10 +25,13 @@
 
 #include <boost/test/unit_test.hpp>
 #include <boost/mpl/list.hpp> 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <limits>
 #include <ratio>
 #include <stdexcept>
+#include <vector>
 
 #include <tsl/hopscotch_growth_policy.h>
 
@@ -37,9 +40,14 @@ BOOST_AUTO_TEST_SUITE(test_policy)
 
 using test_types = boost::mpl::list<tsl::hh::power_of_two_growth_policy<2>,
                                     tsl::hh::power_of_two_growth_policy<4>,
+                                    tsl::hh::fibonacci_power_of_two_growth_policy<2>,
+                                    tsl::hh::fibonacci_power_of_two_growth_policy<4>,
                                     tsl::hh::prime_growth_policy,
+                                    tsl::hh::reciprocal_prime_growth_policy,
                                     tsl::hh::mod_growth_policy<>,
-                                    tsl::hh::mod_growth_policy<std::ratio<7,2>>>;
+                                    tsl::hh::mod_growth_policy<std::ratio<7,2>>,
+                                    tsl::hh::fastrange_growth_policy<>,
+                                    tsl::hh::fastrange_growth_policy<std::ratio<7,2>>>;
 
 
 BOOST_AUTO_TEST_CASE_TEMPLATE(test_policy, Policy, test_types) {
@@ -97,4 +105,73 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(test_policy_max_bucket_count, Policy, test_types)
 }
 
 
+BOOST_AUTO_TEST_CASE(test_fastrange_policy_range) {
+    // Check that the buckets stay in [0, bucket_count) and that consecutive hashes are spread over the buckets
+    for(std::size_t bucket_count: {std::size_t(1), std::size_t(7), std::size_t(1000), std::size_t(1021)}) {
+        std::size_t bucket_count_in_out = bucket_count;
+        tsl::hh::fastrange_growth_policy<> policy(bucket_count_in_out);
+        BOOST_CHECK_EQUAL(bucket_count_in_out, bucket_count);
+        
+        std::vector<bool> used_buckets(bucket_count, false);
+        for(std::size_t hash = 0; hash < 4 * bucket_count; hash++) {
+            const std::size_t ibucket = policy.bucket_for_hash(hash);
+            BOOST_REQUIRE(ibucket < bucket_count);
+            used_buckets[ibucket] = true;
+        }
+        BOOST_CHECK(policy.bucket_for_hash(std::numeric_limits<std::size_t>::max()) < bucket_count);
+        
+        const std::size_t nb_used_buckets = std::size_t(std::count(used_buckets.begin(), used_buckets.end(), true));
+        BOOST_CHECK(nb_used_buckets > bucket_count / 2);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_fibonacci_policy_sequential_hashes) {
+    // Check that sequential and strided hashes (e.g. std::hash of integers) are spread over the buckets
+    // and that only the low 32 bits of the hash are used (needed to reuse the stored hashes on rehash).
+    std::size_t bucket_count = 1024;
+    tsl::hh::fibonacci_power_of_two_growth_policy<> policy(bucket_count);
+    BOOST_CHECK_EQUAL(bucket_count, 1024);
+    
+    for(std::size_t stride: {std::size_t(1), std::size_t(64), std::size_t(1024)}) {
+        std::vector<std::size_t> nb_values_in_buckets(bucket_count, 0);
+        for(std::size_t i = 0; i < bucket_count; i++) {
+            const std::size_t ibucket = policy.bucket_for_hash(i * stride);
+            BOOST_REQUIRE(ibucket < bucket_count);
+            BOOST_CHECK_EQUAL(ibucket, policy.bucket_for_hash(std::size_t(std::uint32_t(i * stride))));
+            
+            nb_values_in_buckets[ibucket]++;
+        }
+        
+        BOOST_CHECK(*std::max_element(nb_values_in_buckets.begin(), nb_values_in_buckets.end()) <= 4);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_reciprocal_prime_policy_same_buckets) {
+    // Check that the precomputed reciprocal gives the same buckets as the modulo of tsl::hh::prime_growth_policy
+    const std::size_t max_hash = std::numeric_limits<std::size_t>::max();
+    const std::vector<std::size_t> hashes = {0, 1, 2, 4, 5, 17, 1000, 4294967291ul, 4294967295ul, 
+                                             max_hash, max_hash - 1, max_hash / 2, max_hash / 2 + 1, 
+                                             std::size_t(0x9E3779B97F4A7C15ull), std::size_t(0x123456789ABCDEFull)};
+    
+    std::size_t bucket_count = 0;
+    while(true) {
+        tsl::hh::prime_growth_policy prime_policy(bucket_count);
+        tsl::hh::reciprocal_prime_growth_policy reciprocal_policy(bucket_count);
+        
+        for(std::size_t hash: hashes) {
+            BOOST_CHECK_EQUAL(reciprocal_policy.bucket_for_hash(hash), prime_policy.bucket_for_hash(hash));
+        }
+        for(std::size_t i = 0; i < 1000; i++) {
+            const std::size_t hash = i * std::size_t(0x9E3779B97F4A7C15ull);
+            BOOST_CHECK_EQUAL(reciprocal_policy.bucket_for_hash(hash), prime_policy.bucket_for_hash(hash));
+        }
+        
+        if(bucket_count == reciprocal_policy.max_bucket_count()) {
+            break;
+        }
+        bucket_count = reciprocal_policy.next_bucket_count();
+    }
+}
+
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -30,7 +30,9 @@
 #include <functional>
 #include <memory>
 #include <ostream>
+#include <sstream>
 #include <string>
+#include <type_traits>
 #include <utility>
 
 
@@ -51,6 +53,20 @@ public:
     }
 };
 
+/**
+ * Hash where only a few distinct values are possible for the least significant 32 bits,
+ * the truncated hashes stored with StoreHash will often be equal for different keys.
+ */
+template<unsigned int MOD>
+class truncated_collision_hash {
+public:
+    template<typename T>
+    std::size_t operator()(const T& value) const {
+        const std::uint64_t hash = std::hash<T>()(value);
+        return static_cast<std::size_t>((hash << 32) | (hash % MOD));
+    }
+};
+
 class self_reference_member_test {
 public:
     self_reference_member_test() : m_value(std::to_string(-1)), m_value_ptr(&m_value) {
@@ -234,6 +250,90 @@ namespace std {
 }
 
 
+/**
+ * Serializer and deserializer for the serialization tests. The arithmetic types are written as they are 
+ * in memory, the strings are prefixed by their size.
+ */
+class serializer {
+public:
+    serializer() {
+        m_ostream.exceptions(m_ostream.badbit | m_ostream.failbit);
+    }
+    
+    template<class T>
+    void operator()(const T& value) {
+        serialize_impl(value);
+    }
+    
+    std::string str() const {
+        return m_ostream.str();
+    }
+    
+private:
+    template<class T, typename std::enable_if<std::is_arithmetic<T>::value>::type* = nullptr>
+    void serialize_impl(const T& value) {
+        m_ostream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    
+    void serialize_impl(const std::string& value) {
+        serialize_impl(std::uint64_t(value.size()));
+        m_ostream.write(value.data(), std::streamsize(value.size()));
+    }
+    
+    template<class T1, class T2>
+    void serialize_impl(const std::pair<T1, T2>& value) {
+        serialize_impl(value.first);
+        serialize_impl(value.second);
+    }
+    
+private:
+    std::stringstream m_ostream;
+};
+
+class deserializer {
+public:
+    explicit deserializer(const std::string& init_str): m_istream(init_str) {
+        m_istream.exceptions(m_istream.badbit | m_istream.failbit | m_istream.eofbit);
+    }
+    
+    template<class T>
+    T operator()() {
+        return deserialize_impl(static_cast<T*>(nullptr));
+    }
+    
+private:
+    template<class T, typename std::enable_if<std::is_arithmetic<T>::value>::type* = nullptr>
+    T deserialize_impl(T* /*tag*/) {
+        T value;
+        m_istream.read(reinterpret_cast<char*>(&value), sizeof(T));
+        
+        return value;
+    }
+    
+    std::string deserialize_impl(std::string* /*tag*/) {
+        const std::uint64_t size = operator()<std::uint64_t>();
+        std::string value(std::size_t(size), '\0');
+        
+        if(size > 0) {
+            m_istream.read(&value[0], std::streamsize(size));
+        }
+        
+        return value;
+    }
+    
+    template<class T1, class T2>
+    std::pair<T1, T2> deserialize_impl(std::pair<T1, T2>* /*tag*/) {
+        auto first = operator()<typename std::remove_const<T1>::type>();
+        auto second = operator()<typename std::remove_const<T2>::type>();
+        
+        return std::pair<T1, T2>(std::move(first), std::move(second));
+    }
+    
+private:
+    std::stringstream m_istream;
+};
+
+
 class utils {
 public:
     template<typename T>